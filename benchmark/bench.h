@@ -0,0 +1,37 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2005-2011, Jari Sundell <jaris@ifi.uio.no>
+
+#ifndef LIBTORRENT_BENCHMARK_BENCH_H
+#define LIBTORRENT_BENCHMARK_BENCH_H
+
+#include <chrono>
+#include <cinttypes>
+
+// Micro benchmarks run by 'libtorrent_bench -m name', each comparing
+// a structure against the one it replaced. They print their results
+// and return false if the two disagree.
+
+namespace bench {
+
+bool run_candidates();
+bool run_connection_list();
+bool run_ip_filter();
+bool run_rate();
+bool run_resume();
+
+// Microseconds taken by 'func'.
+template <typename Func>
+int64_t
+time_usec(Func&& func) {
+  auto start = std::chrono::steady_clock::now();
+
+  func();
+
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+           std::chrono::steady_clock::now() - start)
+    .count();
+}
+
+} // namespace bench
+
+#endif
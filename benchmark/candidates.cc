@@ -0,0 +1,254 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2005-2011, Jari Sundell <jaris@ifi.uio.no>
+
+// Simulates connecting to candidates after a restart, where the
+// resumed peer list holds live addresses among many that refuse
+// connections or never answer, followed by fresh tracker addresses
+// without any history. Candidates are picked in random order, as the
+// removed AvailableList::pop_random did, and by AvailableList score.
+//
+// Handshakes run in simulated time with the limits of
+// DownloadMain::receive_connect_peers: new handshakes start while
+// fewer than 'wanted' peers are connected and connections plus
+// handshakes stay below the connection list max size. A live peer
+// completes the handshake after 200 ms, a closed port refuses after
+// 100 ms, and an unroutable address times out after the 60 second
+// connect timeout.
+
+#include "torrent/buildinfo.h"
+
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "download/available_list.h"
+#include "torrent/peer/peer_info.h"
+#include "torrent/utils/socket_address.h"
+
+#include "bench.h"
+
+namespace {
+
+enum candidate_state { state_live, state_refused, state_unroutable };
+
+const uint32_t resumed_candidates = 4000;
+const uint32_t tracker_candidates = 500;
+const uint32_t wanted             = 50;
+const uint32_t max_connections    = 100;
+const uint32_t now                = 100000;
+
+const uint32_t handshake_msec[] = { 200, 100, 60000 };
+
+struct candidate {
+  std::unique_ptr<torrent::PeerInfo> info;
+  candidate_state                    state;
+  int                                source;
+};
+
+torrent::utils::socket_address
+candidate_address(uint32_t index) {
+  torrent::utils::socket_address sa;
+
+  sa.sa_inet()->clear();
+  sa.sa_inet()->set_address_h(0x0a000000 + index);
+  sa.set_port(6881);
+
+  return sa;
+}
+
+// A fifth of the resumed addresses are alive, and a few of those were
+// connected in the last session while others were also down then.
+// Most dead ones failed their last handshakes a couple of minutes
+// before the restart. A third of the tracker addresses are alive.
+std::vector<candidate>
+make_candidates(std::mt19937& rng) {
+  std::vector<candidate> candidates;
+
+  for (uint32_t i = 0; i < resumed_candidates + tracker_candidates; i++) {
+    auto sa = candidate_address(i);
+
+    candidate c{ std::make_unique<torrent::PeerInfo>(sa.c_sockaddr()),
+                 state_live,
+                 torrent::AvailableList::source_resume };
+
+    uint32_t roll = rng() % 100;
+
+    if (i >= resumed_candidates) {
+      c.source = torrent::AvailableList::source_tracker;
+      c.state  = roll < 33 ? state_live
+                 : roll < 66 ? state_refused
+                             : state_unroutable;
+
+    } else if (roll < 20) {
+      if (roll == 0) {
+        c.info->set_last_connection(now - 600);
+
+      } else if (roll < 5) {
+        c.info->set_failed_handshakes(1);
+        c.info->set_last_handshake(now - 120);
+      }
+
+    } else {
+      c.state = roll < 60 ? state_refused : state_unroutable;
+
+      if (rng() % 4 != 0) {
+        c.info->set_failed_handshakes(1 + rng() % 3);
+        c.info->set_last_handshake(now - 120);
+      }
+    }
+
+    candidates.push_back(std::move(c));
+  }
+
+  return candidates;
+}
+
+struct connect_result {
+  uint32_t handshakes{ 0 };
+  uint32_t completed{ 0 };
+  uint32_t connected{ 0 };
+  uint64_t msec{ 0 };
+};
+
+// Runs handshakes until 'wanted' peers are connected or the
+// candidates run out, with 'pick' returning the index of the next
+// candidate.
+template <typename Pick>
+connect_result
+run_connect(const std::vector<candidate>& candidates, Pick&& pick) {
+  using event_type = std::pair<uint64_t, uint32_t>;
+
+  std::priority_queue<event_type,
+                      std::vector<event_type>,
+                      std::greater<event_type>>
+    handshakes;
+
+  connect_result result;
+  uint64_t       clock = 0;
+
+  while (result.connected < wanted) {
+    while (result.connected + handshakes.size() < max_connections) {
+      int64_t index = pick();
+
+      if (index < 0)
+        break;
+
+      result.handshakes++;
+      handshakes.emplace(clock + handshake_msec[candidates[index].state],
+                         index);
+    }
+
+    if (handshakes.empty())
+      break;
+
+    auto [finished, index] = handshakes.top();
+    handshakes.pop();
+
+    clock = finished;
+    result.completed++;
+    result.connected += candidates[index].state == state_live;
+  }
+
+  result.msec = clock;
+  return result;
+}
+
+} // namespace
+
+namespace bench {
+
+bool
+run_candidates() {
+  const unsigned int rounds = 20;
+
+  connect_result random_total;
+  connect_result scored_total;
+  int64_t        random_usec = 0;
+  int64_t        scored_usec = 0;
+
+  for (unsigned int r = 0; r < rounds; r++) {
+    std::mt19937 rng(r + 1);
+    auto         candidates = make_candidates(rng);
+
+    random_usec += time_usec([&]() {
+      std::vector<uint32_t> pool(candidates.size());
+
+      for (uint32_t i = 0; i < pool.size(); i++)
+        pool[i] = i;
+
+      auto result = run_connect(candidates, [&]() -> int64_t {
+        if (pool.empty())
+          return -1;
+
+        std::swap(pool[rng() % pool.size()], pool.back());
+
+        uint32_t index = pool.back();
+        pool.pop_back();
+        return index;
+      });
+
+      random_total.handshakes += result.handshakes;
+      random_total.completed += result.completed;
+      random_total.connected += result.connected;
+      random_total.msec += result.msec;
+    });
+
+    scored_usec += time_usec([&]() {
+      torrent::AvailableList list;
+
+      for (uint32_t i = 0; i < candidates.size(); i++) {
+        auto sa = candidate_address(i);
+
+        list.push_back(&sa,
+                       torrent::AvailableList::score(
+                         candidates[i].info.get(), candidates[i].source, now));
+      }
+
+      auto result = run_connect(candidates, [&]() -> int64_t {
+        if (list.empty())
+          return -1;
+
+        return list.pop_best().sa_inet()->address_h() - 0x0a000000;
+      });
+
+      scored_total.handshakes += result.handshakes;
+      scored_total.completed += result.completed;
+      scored_total.connected += result.connected;
+      scored_total.msec += result.msec;
+    });
+  }
+
+  // Success is counted over completed handshakes, those still in
+  // progress when enough peers connected are only in 'handshakes'.
+  std::printf("%-12s %12s %12s %12s %12s %12s\n",
+              "candidates",
+              "order",
+              "handshakes",
+              "success-%",
+              "time-to-N-s",
+              "wall-us");
+
+  auto print = [&](const char*           order,
+                   const connect_result& total,
+                   int64_t               usec) {
+    std::printf("%-12s %12s %12u %12.1f %12.1f %12" PRId64 "\n",
+                "",
+                order,
+                total.handshakes / rounds,
+                100.0 * total.connected / total.completed,
+                total.msec / 1000.0 / rounds,
+                usec / rounds);
+  };
+
+  print("random", random_total, random_usec);
+  print("scored", scored_total, scored_usec);
+
+  return random_total.connected == wanted * rounds &&
+         scored_total.connected == wanted * rounds;
+}
+
+} // namespace bench
@@ -0,0 +1,176 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2005-2011, Jari Sundell <jaris@ifi.uio.no>
+
+// Compares the linear scans previously done by ConnectionList against
+// ConnectionIndex, inserting, finding and erasing every connection of
+// a large set once. Inserts check for a duplicate address first, as
+// is done before connecting to a candidate, and erase swaps the last
+// connection into place like ConnectionList::erase.
+
+#include "torrent/buildinfo.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "download/connection_index.h"
+#include "torrent/utils/socket_address.h"
+
+#include "bench.h"
+
+namespace {
+
+struct fake_connection {
+  torrent::Peer*                 peer;
+  torrent::HashString            id;
+  torrent::utils::socket_address address;
+};
+
+using connection_vector = std::vector<const fake_connection*>;
+
+std::vector<fake_connection>
+make_connections(uint32_t count) {
+  std::vector<fake_connection> connections(count);
+
+  for (uint32_t i = 0; i < count; i++) {
+    auto& c = connections[i];
+
+    // The peers are never dereferenced.
+    c.peer = reinterpret_cast<torrent::Peer*>((uintptr_t(i) + 1) * 64);
+    // Client ids are a fixed prefix and random bytes, which is what
+    // HashString::hash() expects.
+    std::fill(c.id.begin(), c.id.end(), 0);
+    std::memcpy(c.id.begin(), "-lt0000-", 8);
+    std::memcpy(c.id.begin() + 8, &i, sizeof(i));
+
+    c.address.sa_inet()->clear();
+    c.address.sa_inet()->set_address_h(0x0a000000 + i);
+    c.address.set_port(6881);
+  }
+
+  return connections;
+}
+
+connection_vector::iterator
+scan_address(connection_vector& list, const fake_connection& c) {
+  return std::find_if(
+    list.begin(), list.end(), [&c](const fake_connection* other) {
+      return c.address == other->address;
+    });
+}
+
+connection_vector::iterator
+scan_id(connection_vector& list, const fake_connection& c) {
+  return std::find_if(
+    list.begin(), list.end(), [&c](const fake_connection* other) {
+      return c.id == other->id;
+    });
+}
+
+} // namespace
+
+namespace bench {
+
+bool
+run_connection_list() {
+  std::printf("%-12s %11s %11s %11s %11s %11s %11s %11s\n",
+              "connections",
+              "count",
+              "insert-scan",
+              "insert-idx",
+              "find-scan",
+              "find-idx",
+              "erase-scan",
+              "erase-idx");
+
+  bool success = true;
+
+  for (uint32_t count : { 1000, 2500, 5000, 10000 }) {
+    auto connections = make_connections(count);
+
+    connection_vector        scan_list;
+    connection_vector        index_list;
+    torrent::ConnectionIndex index;
+
+    uint32_t scan_found  = 0;
+    uint32_t index_found = 0;
+
+    auto insert_scan = time_usec([&]() {
+      for (const auto& c : connections)
+        if (scan_address(scan_list, c) == scan_list.end())
+          scan_list.push_back(&c);
+    });
+
+    auto insert_index = time_usec([&]() {
+      for (const auto& c : connections) {
+        if (index.find(c.address.c_sockaddr()) != nullptr)
+          continue;
+
+        index_list.push_back(&c);
+        index.insert(
+          c.peer, c.id, c.address.c_sockaddr(), index_list.size() - 1);
+      }
+    });
+
+    auto find_scan = time_usec([&]() {
+      for (const auto& c : connections) {
+        scan_found += scan_id(scan_list, c) != scan_list.end();
+        scan_found += scan_address(scan_list, c) != scan_list.end();
+      }
+    });
+
+    auto find_index = time_usec([&]() {
+      for (const auto& c : connections) {
+        index_found += index.find(c.id) != nullptr;
+        index_found += index.find(c.address.c_sockaddr()) != nullptr;
+      }
+    });
+
+    // Erase in reverse order of insertion, so that the connections
+    // swapped into place end up spread through the list.
+    auto erase_scan = time_usec([&]() {
+      for (auto c = connections.rbegin(); c != connections.rend(); c++) {
+        auto itr = std::find(scan_list.begin(), scan_list.end(), &*c);
+
+        *itr = scan_list.back();
+        scan_list.pop_back();
+      }
+    });
+
+    auto erase_index = time_usec([&]() {
+      for (auto c = connections.rbegin(); c != connections.rend(); c++) {
+        auto itr = index_list.begin() + index.position(c->peer);
+
+        index.erase(c->peer);
+        *itr = index_list.back();
+        index_list.pop_back();
+
+        if (itr != index_list.end())
+          index.set_position((*itr)->peer, itr - index_list.begin());
+      }
+    });
+
+    bool matches = scan_found == 2 * count && index_found == 2 * count &&
+                   scan_list.empty() && index_list.empty() &&
+                   index.size() == 0;
+
+    std::printf("%-12s %11u %11" PRId64 " %11" PRId64 " %11" PRId64
+                " %11" PRId64 " %11" PRId64 " %11" PRId64 "%s\n",
+                "",
+                count,
+                insert_scan,
+                insert_index,
+                find_scan,
+                find_index,
+                erase_scan,
+                erase_index,
+                matches ? "" : " (mismatch)");
+
+    success = success && matches;
+  }
+
+  return success;
+}
+
+} // namespace bench
@@ -0,0 +1,120 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2005-2011, Jari Sundell <jaris@ifi.uio.no>
+
+// Compares lookups in an ordered map of ranges, as a client would
+// implement the filter slot, against the compiled ip_filter.
+
+#include "torrent/buildinfo.h"
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "torrent/net/ip_filter.h"
+
+#include "bench.h"
+
+namespace {
+
+// Keeps the compiled buffer 8-byte aligned.
+struct compiled_filter {
+  compiled_filter(const std::string& data)
+    : buffer((data.size() + 7) / 8),
+      size(data.size()) {
+    std::memcpy(buffer.data(), data.data(), data.size());
+  }
+
+  const char* data() const {
+    return reinterpret_cast<const char*>(buffer.data());
+  }
+
+  std::vector<uint64_t> buffer;
+  size_t                size;
+};
+
+} // namespace
+
+namespace bench {
+
+bool
+run_ip_filter() {
+  const unsigned int lookups = 250000;
+
+  std::printf("%-12s %12s %12s %12s %12s\n",
+              "ip_filter",
+              "ranges",
+              "bytes",
+              "map-us",
+              "filter-us");
+
+  bool success = true;
+
+  for (unsigned int ranges : { 2000, 20000, 200000 }) {
+    std::mt19937                              rng(1);
+    std::vector<torrent::ip_filter::range_v4> list;
+    std::map<uint32_t, uint32_t>              map;
+
+    for (unsigned int i = 0; i < ranges; i++) {
+      uint32_t first = rng() & ~uint32_t(0xff);
+      uint32_t last  = first + (rng() & 0xfff);
+
+      if (last < first || map.find(first) != map.end())
+        continue;
+
+      list.push_back({ first, last, 0 });
+      map.emplace(first, last);
+    }
+
+    compiled_filter compiled(torrent::ip_filter::compile(list, {}));
+
+    torrent::ip_filter filter;
+
+    if (!filter.open(compiled.data(), compiled.size))
+      return false;
+
+    std::vector<uint32_t> addresses(lookups);
+
+    for (auto& address : addresses)
+      address = rng();
+
+    unsigned int map_blocked    = 0;
+    unsigned int filter_blocked = 0;
+
+    auto map_usec = time_usec([&]() {
+      for (auto address : addresses) {
+        auto itr = map.upper_bound(address);
+
+        // Ranges may overlap, so earlier ones can still cover the
+        // address. Only check the closest, like a typical client.
+        if (itr != map.begin() && (--itr)->second >= address)
+          map_blocked++;
+      }
+    });
+
+    auto filter_usec = time_usec([&]() {
+      for (auto address : addresses)
+        filter_blocked += filter.lookup_v4(address) == 0;
+    });
+
+    // The filter also blocks addresses covered by an earlier,
+    // overlapping range, so it may block more than the map.
+    bool matches = filter_blocked >= map_blocked;
+
+    std::printf("%-12s %12zu %12zu %12" PRId64 " %12" PRId64 "%s\n",
+                "",
+                list.size(),
+                compiled.size,
+                map_usec,
+                filter_usec,
+                matches ? "" : " (mismatch)");
+
+    success = success && matches;
+  }
+
+  return success;
+}
+
+} // namespace bench
@@ -0,0 +1,117 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2005-2011, Jari Sundell <jaris@ifi.uio.no>
+
+// Compares the ring buffer Rate against the deque it replaced, with
+// every peer of a large swarm inserting and querying once a second.
+
+#include "torrent/buildinfo.h"
+
+#include <cstdio>
+#include <deque>
+#include <utility>
+#include <vector>
+
+#include "globals.h"
+#include "torrent/rate.h"
+
+#include "bench.h"
+
+namespace {
+
+// The previous deque based implementation.
+class deque_rate {
+public:
+  deque_rate(int32_t span)
+    : m_span(span) {}
+
+  uint64_t rate() {
+    discard_old();
+    return m_current / m_span;
+  }
+
+  void insert(uint64_t bytes) {
+    discard_old();
+
+    if (m_container.empty() ||
+        m_container.front().first != torrent::cachedTime.seconds())
+      m_container.emplace_front(torrent::cachedTime.seconds(), bytes);
+    else
+      m_container.front().second += bytes;
+
+    m_current += bytes;
+  }
+
+private:
+  void discard_old() {
+    while (!m_container.empty() &&
+           m_container.back().first <
+             torrent::cachedTime.seconds() - m_span) {
+      m_current -= m_container.back().second;
+      m_container.pop_back();
+    }
+  }
+
+  std::deque<std::pair<int32_t, uint64_t>> m_container;
+
+  uint64_t m_current{ 0 };
+  int32_t  m_span;
+};
+
+template <typename List>
+uint64_t
+run_list(List& list, unsigned int rounds) {
+  uint64_t sum = 0;
+
+  torrent::cachedTime = torrent::utils::timer::from_seconds(1000);
+
+  for (unsigned int r = 0; r < rounds; r++) {
+    for (auto& rate : list) {
+      rate.insert(16 << 10);
+      sum += rate.rate();
+    }
+
+    torrent::cachedTime += torrent::utils::timer::from_seconds(1);
+  }
+
+  return sum;
+}
+
+} // namespace
+
+namespace bench {
+
+bool
+run_rate() {
+  const unsigned int rounds = 100;
+
+  std::printf(
+    "%-12s %12s %12s %12s\n", "rate", "peers", "ring-us", "deque-us");
+
+  bool success = true;
+
+  for (unsigned int peers : { 1000, 10000, 100000 }) {
+    std::vector<torrent::Rate> rates(peers, torrent::Rate(30));
+    std::vector<deque_rate>    references(peers, deque_rate(30));
+
+    uint64_t ring_sum  = 0;
+    uint64_t deque_sum = 0;
+
+    auto ring_usec =
+      time_usec([&]() { ring_sum = run_list(rates, rounds); });
+    auto deque_usec =
+      time_usec([&]() { deque_sum = run_list(references, rounds); });
+
+    std::printf("%-12s %12u %12" PRId64 " %12" PRId64 "%s\n",
+                "",
+                peers,
+                ring_usec,
+                deque_usec,
+                ring_sum == deque_sum ? "" : " (mismatch)");
+
+    success = success && ring_sum == deque_sum;
+  }
+
+  return success;
+}
+
+} // namespace bench
@@ -0,0 +1,227 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2005-2011, Jari Sundell <jaris@ifi.uio.no>
+
+// Compares saving and loading the resume data of many torrents as
+// bencode against the binary form. Both are saved through a synced
+// temporary file and a rename. The binary form is then saved again
+// unchanged, which skips the write. Times are in microseconds.
+
+#include "torrent/buildinfo.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <ftw.h>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "torrent/object.h"
+#include "torrent/object_stream.h"
+#include "torrent/utils/resume_binary.h"
+
+#include "bench.h"
+
+namespace {
+
+const unsigned int torrent_files = 100;
+const unsigned int torrent_peers = 500;
+
+torrent::Object
+create_resume(unsigned int index) {
+  torrent::Object resume = torrent::Object::create_map();
+
+  resume.insert_key("bitfield", std::string(1024, char(0xf0 + index % 16)));
+
+  auto& file_list =
+    resume.insert_key("files", torrent::Object::create_list()).as_list();
+
+  for (unsigned int i = 0; i < torrent_files; i++) {
+    auto& file = file_list.emplace_back(torrent::Object::create_map());
+
+    file.insert_key("completed", int64_t(i));
+    file.insert_key("mtime", int64_t(1600000000 + i));
+    file.insert_key("priority", int64_t(i % 3));
+  }
+
+  auto& peer_list =
+    resume.insert_key("peers", torrent::Object::create_list()).as_list();
+
+  for (unsigned int i = 0; i < torrent_peers; i++) {
+    auto& peer = peer_list.emplace_back(torrent::Object::create_map());
+    char  inet[6] = {
+      10, char(index), char(i >> 8), char(i), 0x1a, char(0xe1)
+    };
+
+    peer.insert_key("inet", std::string(inet, sizeof(inet)));
+    peer.insert_key("failed", int64_t(i % 4));
+    peer.insert_key("last", int64_t(1000 + i));
+  }
+
+  auto& trackers = resume.insert_key("trackers", torrent::Object::create_map());
+  auto& tracker  = trackers.insert_key("http://example.com/announce",
+                                      torrent::Object::create_map());
+
+  tracker.insert_key("enabled", int64_t(1));
+
+  return resume;
+}
+
+bool
+write_synced(const std::string& path, const std::string& data) {
+  std::string tmp = path + ".new";
+  int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+  if (fd == -1)
+    return false;
+
+  bool result =
+    ::write(fd, data.data(), data.size()) == ssize_t(data.size()) &&
+    ::fsync(fd) == 0;
+  ::close(fd);
+
+  return result && ::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+bool
+read_file(const std::string& path, std::string* data) {
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+  if (fd == -1)
+    return false;
+
+  struct stat st;
+  bool        result = ::fstat(fd, &st) == 0;
+
+  if (result) {
+    data->resize(st.st_size);
+    result = ::read(fd, &(*data)[0], data->size()) == st.st_size;
+  }
+
+  ::close(fd);
+  return result;
+}
+
+int
+remove_entry(const char* path, const struct stat*, int, FTW*) {
+  return remove(path);
+}
+
+} // namespace
+
+namespace bench {
+
+bool
+run_resume() {
+  char base[] = "/tmp/libtorrent_bench_resume.XXXXXX";
+
+  if (mkdtemp(base) == nullptr)
+    return false;
+
+  std::string dir     = base;
+  bool        success = true;
+
+  std::printf("%-8s %8s %11s %11s %12s %12s %12s %12s %12s\n",
+              "resume",
+              "torrents",
+              "bencode-KiB",
+              "binary-KiB",
+              "bencode-save",
+              "binary-save",
+              "unchanged",
+              "bencode-load",
+              "binary-load");
+
+  for (unsigned int count : { 100, 1000 }) {
+    std::vector<torrent::Object> resumes;
+    std::vector<std::string>     bencoded(count);
+    std::vector<std::string>     binary(count);
+    uint64_t                     bencoded_size = 0;
+    uint64_t                     binary_size   = 0;
+
+    for (unsigned int i = 0; i < count; i++)
+      resumes.push_back(create_resume(i));
+
+    auto path = [&](const char* type, unsigned int i) {
+      return dir + "/" + std::to_string(count) + "." + std::to_string(i) +
+             "." + type;
+    };
+
+    // Encoding is part of saving.
+    auto bencode_save = time_usec([&]() {
+      for (unsigned int i = 0; i < count; i++) {
+        std::stringstream stream;
+        torrent::object_write_bencode(&stream, &resumes[i]);
+
+        bencoded[i] = stream.str();
+        bencoded_size += bencoded[i].size();
+        success = write_synced(path("bencode", i), bencoded[i]) && success;
+      }
+    });
+
+    auto binary_save = time_usec([&]() {
+      for (unsigned int i = 0; i < count; i++) {
+        binary[i] = torrent::resume_binary_encode(resumes[i]);
+        binary_size += binary[i].size();
+        success =
+          torrent::resume_binary_write(path("binary", i), binary[i]) > 0 &&
+          success;
+      }
+    });
+
+    auto binary_resave = time_usec([&]() {
+      for (unsigned int i = 0; i < count; i++)
+        success =
+          torrent::resume_binary_write(
+            path("binary", i), torrent::resume_binary_encode(resumes[i])) ==
+            0 &&
+          success;
+    });
+
+    // Peers are left out of the binary decode, as they are read in
+    // place when adding them to the peer list.
+    auto bencode_load = time_usec([&]() {
+      for (unsigned int i = 0; i < count; i++) {
+        std::string     data;
+        torrent::Object object;
+
+        success = read_file(path("bencode", i), &data) &&
+                  torrent::object_read_bencode_c(
+                    data.data(), data.data() + data.size(), &object) ==
+                    data.data() + data.size() &&
+                  success;
+      }
+    });
+
+    auto binary_load = time_usec([&]() {
+      for (unsigned int i = 0; i < count; i++) {
+        torrent::resume_binary file;
+        torrent::Object        object = torrent::Object::create_map();
+
+        success = file.open_file(path("binary", i)) &&
+                  torrent::resume_binary_decode(file, object, false) &&
+                  success;
+      }
+    });
+
+    std::printf("%-8s %8u %11" PRIu64 " %11" PRIu64 " %12" PRId64
+                " %12" PRId64 " %12" PRId64 " %12" PRId64 " %12" PRId64 "\n",
+                "",
+                count,
+                bencoded_size >> 10,
+                binary_size >> 10,
+                bencode_save,
+                binary_save,
+                binary_resave,
+                bencode_load,
+                binary_load);
+  }
+
+  nftw(dir.c_str(), &remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+
+  return success;
+}
+
+} // namespace bench
@@ -0,0 +1,1191 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2005-2011, Jari Sundell <jaris@ifi.uio.no>
+
+// Loopback swarm benchmark.
+//
+// Creates a synthetic torrent in a temporary directory and runs a
+// seeder and a number of leechers connected over loopback, using the
+// regular handshake, peer connection and chunk list code. The library
+// keeps a single global manager, so each peer runs in its own forked
+// process and reports back to the parent through a pipe.
+//
+// Usage: libtorrent_bench [-l leechers] [-s size_mib] [-t timeout]
+//                         [-p port] [-i log_prefix] [-P min:max]
+//                         [-L bytes] [-u] [scenario ...]
+//        libtorrent_bench -k count
+//        libtorrent_bench -m benchmark
+//
+// Scenarios with latency connect the peers through a proxy process
+// that holds the data in each direction for a fixed time, so the
+// peers see a longer request round trip while the loopback TCP
+// connections themselves stay fast. '-P' sets the request pipeline
+// bounds of every download, with '-P 2:0' sizing from the rate alone.
+// '-L' limits the unsent data in peer sockets with TCP_NOTSENT_LOWAT.
+// '-u' connects the peers over uTP, except through the latency proxy
+// which only relays TCP.
+//
+// For every peer the wall time, throughput, CPU time per GiB
+// transferred, socket, polling and memory mapping syscalls and context
+// switches are printed. The syscalls are counted by wrapping the libc
+// functions below, so only calls made through libc are seen. Builds
+// with USE_INSTRUMENTATION also write the instrumentation log of each peer to
+// '<log_prefix><scenario>.<peer>' when '-i' is given.
+//
+// '-k' instead fills a peer list with 'count' known addresses and
+// prints the heap used per address and the time taken to insert and
+// cull them.
+//
+// '-m' runs one of the micro benchmarks in 'micro_benchmarks', which
+// compare a structure against the one it replaced.
+
+#include "torrent/buildinfo.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <malloc.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#include "torrent/connection_manager.h"
+#include "torrent/data/file_list.h"
+#include "torrent/download.h"
+#include "torrent/download_info.h"
+#include "torrent/exceptions.h"
+#include "torrent/object.h"
+#include "torrent/object_stream.h"
+#include "torrent/peer/connection_list.h"
+#include "torrent/peer/peer_list.h"
+#include "torrent/poll_epoll.h"
+#include "torrent/poll_select.h"
+#include "torrent/rate.h"
+#include "torrent/throttle.h"
+#include "torrent/torrent.h"
+#include "torrent/utils/log.h"
+#include "torrent/utils/thread_base.h"
+#include "utils/sha1.h"
+
+#include "bench.h"
+
+namespace {
+
+std::atomic<uint64_t> count_net{ 0 };
+std::atomic<uint64_t> count_poll{ 0 };
+std::atomic<uint64_t> count_mm{ 0 };
+
+template <typename Func>
+Func
+next_symbol(Func, const char* name) {
+  static_assert(std::is_pointer_v<Func>);
+  return reinterpret_cast<Func>(dlsym(RTLD_NEXT, name));
+}
+
+} // namespace
+
+//
+// Syscall counting:
+//
+
+#define BENCH_WRAP(COUNTER, RET, NAME, PARAMS, ARGS, ...)       \
+  extern "C" RET NAME PARAMS __VA_ARGS__ {                      \
+    static auto next = next_symbol(&::NAME, #NAME);             \
+    COUNTER.fetch_add(1, std::memory_order_relaxed);            \
+    return next ARGS;                                           \
+  }
+
+BENCH_WRAP(count_net, ssize_t, recv,
+           (int fd, void* buf, size_t n, int flags), (fd, buf, n, flags))
+BENCH_WRAP(count_net, ssize_t, send,
+           (int fd, const void* buf, size_t n, int flags), (fd, buf, n, flags))
+BENCH_WRAP(count_net, ssize_t, recvfrom,
+           (int fd, void* buf, size_t n, int flags, sockaddr* sa,
+            socklen_t* len),
+           (fd, buf, n, flags, sa, len))
+BENCH_WRAP(count_net, ssize_t, sendto,
+           (int fd, const void* buf, size_t n, int flags, const sockaddr* sa,
+            socklen_t len),
+           (fd, buf, n, flags, sa, len))
+BENCH_WRAP(count_poll, int, epoll_wait,
+           (int fd, epoll_event* events, int max, int timeout),
+           (fd, events, max, timeout))
+BENCH_WRAP(count_poll, int, select,
+           (int n, fd_set* r, fd_set* w, fd_set* e, timeval* tv),
+           (n, r, w, e, tv))
+BENCH_WRAP(count_mm, void*, mmap,
+           (void* addr, size_t len, int prot, int flags, int fd, off_t offset),
+           (addr, len, prot, flags, fd, offset), noexcept)
+BENCH_WRAP(count_mm, int, munmap,
+           (void* addr, size_t len), (addr, len), noexcept)
+BENCH_WRAP(count_mm, int, msync,
+           (void* addr, size_t len, int flags), (addr, len, flags))
+BENCH_WRAP(count_mm, int, madvise,
+           (void* addr, size_t len, int advice), (addr, len, advice), noexcept)
+BENCH_WRAP(count_mm, int, mincore,
+           (void* addr, size_t len, unsigned char* vec), (addr, len, vec),
+           noexcept)
+
+#undef BENCH_WRAP
+
+namespace {
+
+struct scenario {
+  const char* name;
+  const char* description;
+  uint32_t    file_count;
+  uint64_t    size;
+  uint32_t    piece_length;
+  bool        encrypted;
+  uint32_t    upload_rate; // Seeder upload limit in bytes/s, 0 for none.
+  uint32_t    latency_ms;  // Delay in each direction, 0 for none.
+};
+
+const scenario scenarios[] = {
+  { "baseline", "single file", 1, 256 << 20, 256 << 10, false, 0, 0 },
+  { "encrypted", "RC4 required", 1, 256 << 20, 256 << 10, true, 0, 0 },
+  { "small_files", "4096 files", 4096, 128 << 20, 64 << 10, false, 0, 0 },
+  { "many_pieces", "16 KiB pieces", 1, 256 << 20, 16 << 10, false, 0, 0 },
+  { "throttled", "seeder at 32 MiB/s", 1, 256 << 20, 256 << 10, false,
+    32 << 20, 0 },
+  { "latency", "50 ms round trip", 1, 128 << 20, 256 << 10, false, 0, 25 },
+};
+
+struct micro_benchmark {
+  const char* name;
+  const char* description;
+  bool (*run)();
+};
+
+const micro_benchmark micro_benchmarks[] = {
+  { "candidates",
+    "scored connection candidates against random order",
+    &bench::run_candidates },
+  { "connections",
+    "ConnectionIndex against scanning the connection list",
+    &bench::run_connection_list },
+  { "ip_filter",
+    "compiled ip_filter against an ordered map",
+    &bench::run_ip_filter },
+  { "rate", "ring buffer Rate against the deque version", &bench::run_rate },
+  { "resume", "binary resume data against bencode", &bench::run_resume },
+};
+
+struct options {
+  uint32_t    leechers{ 2 };
+  uint64_t    size{ 0 };
+  uint32_t    timeout{ 300 };
+  uint16_t    port{ 26881 };
+  std::string log_prefix;
+  bool        pipeline{ false };
+  uint32_t    pipeline_min{ 0 };
+  uint32_t    pipeline_max{ 0 };
+  uint32_t    send_lowat{ 0 };
+  bool        utp{ false };
+};
+
+// Written by each peer as a single pipe write.
+struct peer_result {
+  int      index;
+  int      complete;
+  uint64_t bytes;
+  double   seconds;
+  double   cpu_user;
+  double   cpu_system;
+  uint64_t syscalls_net;
+  uint64_t syscalls_poll;
+  uint64_t syscalls_mm;
+  uint64_t switches_voluntary;
+  uint64_t switches_involuntary;
+};
+
+struct usage {
+  double   seconds;
+  double   cpu_user;
+  double   cpu_system;
+  uint64_t syscalls_net;
+  uint64_t syscalls_poll;
+  uint64_t syscalls_mm;
+  uint64_t switches_voluntary;
+  uint64_t switches_involuntary;
+};
+
+[[noreturn]] void
+fail(const std::string& message) {
+  std::fprintf(stderr, "libtorrent_bench: %s\n", message.c_str());
+  std::exit(1);
+}
+
+double
+timeval_seconds(const timeval& tv) {
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+usage
+current_usage() {
+  usage  result{};
+  rusage ru;
+
+  result.seconds = std::chrono::duration<double>(
+                     std::chrono::steady_clock::now().time_since_epoch())
+                     .count();
+
+  if (getrusage(RUSAGE_SELF, &ru) == 0) {
+    result.cpu_user             = timeval_seconds(ru.ru_utime);
+    result.cpu_system           = timeval_seconds(ru.ru_stime);
+    result.switches_voluntary   = ru.ru_nvcsw;
+    result.switches_involuntary = ru.ru_nivcsw;
+  }
+
+  result.syscalls_net  = count_net.load(std::memory_order_relaxed);
+  result.syscalls_poll = count_poll.load(std::memory_order_relaxed);
+  result.syscalls_mm   = count_mm.load(std::memory_order_relaxed);
+
+  return result;
+}
+
+//
+// Synthetic torrent:
+//
+
+uint64_t
+xorshift(uint64_t& state) {
+  state ^= state << 13;
+  state ^= state >> 7;
+  state ^= state << 17;
+  return state;
+}
+
+// Writes the files of 'sc' below 'dir' and returns the metainfo.
+torrent::Object
+create_torrent(const std::string& dir, const scenario& sc, uint64_t size) {
+  torrent::Object metainfo = torrent::Object::create_map();
+  torrent::Object& info =
+    metainfo.insert_key("info", torrent::Object::create_map());
+
+  // Downloads require a tracker, this one is never reachable.
+  metainfo.insert_key("announce", "udp://127.0.0.1:1/announce");
+
+  info.insert_key("name", "bench");
+  info.insert_key("piece length", int64_t(sc.piece_length));
+
+  if (sc.file_count > 1 && mkdir((dir + "/bench").c_str(), 0755) == -1)
+    fail("could not create data directory");
+
+  torrent::Object::list_type* files = nullptr;
+
+  if (sc.file_count > 1)
+    files = &info.insert_key("files", torrent::Object::create_list()).as_list();
+  else
+    info.insert_key("length", int64_t(size));
+
+  std::string       pieces;
+  torrent::Sha1     sha1;
+  uint64_t          piece_remaining = sc.piece_length;
+  std::vector<char> buffer(1 << 16);
+
+  sha1.init();
+
+  for (uint32_t i = 0; i < sc.file_count; i++) {
+    uint64_t file_size = size / sc.file_count +
+                         (i == 0 ? size % sc.file_count : 0);
+    uint64_t state     = i + 1;
+
+    char name[32];
+    std::snprintf(name, sizeof(name), "file.%05" PRIu32, i);
+
+    std::string path = sc.file_count > 1 ? dir + "/bench/" + name
+                                         : dir + "/bench";
+    int         fd   = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    if (fd == -1)
+      fail("could not create '" + path + "'");
+
+    if (files != nullptr) {
+      auto& file = files->emplace_back(torrent::Object::create_map());
+
+      file.insert_key("length", int64_t(file_size));
+      file.insert_key("path", torrent::Object::create_list())
+        .as_list()
+        .emplace_back(name);
+    }
+
+    for (uint64_t left = file_size; left != 0;) {
+      uint32_t length = std::min<uint64_t>(left, buffer.size());
+
+      for (uint32_t j = 0; j < length; j += sizeof(uint64_t)) {
+        uint64_t value = xorshift(state);
+        std::memcpy(&buffer[j], &value, std::min<uint32_t>(8, length - j));
+      }
+
+      if (write(fd, buffer.data(), length) != length)
+        fail("could not write '" + path + "'");
+
+      for (uint32_t offset = 0; offset != length;) {
+        uint32_t part = std::min<uint64_t>(length - offset, piece_remaining);
+
+        sha1.update(&buffer[offset], part);
+        offset += part;
+
+        if ((piece_remaining -= part) == 0) {
+          char hash[20];
+          sha1.final_c(hash);
+          pieces.append(hash, 20);
+
+          sha1.init();
+          piece_remaining = sc.piece_length;
+        }
+      }
+
+      left -= length;
+    }
+
+    close(fd);
+  }
+
+  if (piece_remaining != sc.piece_length) {
+    char hash[20];
+    sha1.final_c(hash);
+    pieces.append(hash, 20);
+  }
+
+  info.insert_key("pieces", pieces);
+  return metainfo;
+}
+
+int
+remove_entry(const char* path, const struct stat*, int, FTW*) {
+  return remove(path);
+}
+
+void
+remove_directory(const std::string& dir) {
+  nftw(dir.c_str(), &remove_entry, 64, FTW_DEPTH | FTW_PHYS);
+}
+
+//
+// Peer process:
+//
+
+// Peers are told apart by address, so each one gets its own in
+// 127.0.0.0/8.
+sockaddr_in
+peer_address(int index, uint16_t port) {
+  sockaddr_in sa{};
+  sa.sin_family      = AF_INET;
+  sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK + index);
+  sa.sin_port        = htons(port);
+  return sa;
+}
+
+// The latency proxy listens for peer 'index' on another /24, and
+// connects from a third so that peers are still told apart.
+sockaddr_in
+proxy_address(int index, uint16_t port) {
+  sockaddr_in sa{};
+  sa.sin_family      = AF_INET;
+  sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK + (1 << 8) + index);
+  sa.sin_port        = htons(port);
+  return sa;
+}
+
+sockaddr_in
+proxy_source_address(in_addr_t client) {
+  sockaddr_in sa{};
+  sa.sin_family      = AF_INET;
+  sa.sin_addr.s_addr =
+    htonl((INADDR_LOOPBACK & ~0xffu) + (2 << 8) + (ntohl(client) & 0xff));
+  return sa;
+}
+
+void
+initialize_torrent() {
+  torrent::Poll::slot_create_poll() = []() -> torrent::Poll* {
+    int max_open = sysconf(_SC_OPEN_MAX);
+
+    if (torrent::Poll* poll = torrent::PollEPoll::create(max_open))
+      return poll;
+
+    return torrent::PollSelect::create(std::min(max_open, FD_SETSIZE));
+  };
+
+  torrent::initialize();
+}
+
+// Index 0 is the seeder. Leechers connect to the seeder and to the
+// leechers started before them.
+[[noreturn]] void
+run_peer(int                index,
+         const scenario&    sc,
+         const options&     opts,
+         const std::string& dir,
+         const std::string& metainfo,
+         int                ready_fd,
+         int                result_fd,
+         int                control_fd) {
+  bool       seeder = index == 0;
+  uint16_t   port   = opts.port + index;
+  peer_result result{};
+
+  result.index = index;
+
+  initialize_torrent();
+
+#ifdef LT_INSTRUMENTATION
+  if (!opts.log_prefix.empty()) {
+    std::string path = opts.log_prefix + sc.name + "." + std::to_string(index);
+
+    torrent::log_open_file_output("instrumentation", path.c_str());
+    torrent::log_add_group_output(torrent::LOG_INSTRUMENTATION_MEMORY,
+                                  "instrumentation");
+    torrent::log_add_group_output(torrent::LOG_INSTRUMENTATION_MINCORE,
+                                  "instrumentation");
+    torrent::log_add_group_output(torrent::LOG_INSTRUMENTATION_POLLING,
+                                  "instrumentation");
+    torrent::log_add_group_output(torrent::LOG_INSTRUMENTATION_TRANSFERS,
+                                  "instrumentation");
+  }
+#endif
+
+  if (sc.encrypted)
+    torrent::connection_manager()->set_encryption_options(
+      torrent::ConnectionManager::encryption_allow_incoming |
+      torrent::ConnectionManager::encryption_try_outgoing |
+      torrent::ConnectionManager::encryption_require |
+      torrent::ConnectionManager::encryption_require_RC4);
+
+  if (seeder && sc.upload_rate != 0)
+    torrent::up_throttle_global()->set_max_rate(sc.upload_rate);
+
+  if (opts.send_lowat != 0)
+    torrent::connection_manager()->set_send_lowat(opts.send_lowat);
+
+  if (opts.utp && sc.latency_ms == 0)
+    torrent::connection_manager()->set_utp_enabled(true);
+
+  sockaddr_in bind_address = peer_address(index, 0);
+  torrent::connection_manager()->set_bind_address(
+    reinterpret_cast<sockaddr*>(&bind_address));
+
+  if (!torrent::connection_manager()->listen_open(port, port))
+    fail("could not listen on port " + std::to_string(port));
+
+  auto object = new torrent::Object;
+
+  const char* metainfo_end = metainfo.data() + metainfo.size();
+
+  if (torrent::object_read_bencode_c(metainfo.data(), metainfo_end, object) !=
+      metainfo_end)
+    fail("could not parse metainfo");
+
+  torrent::Download download = torrent::download_add(object);
+
+  if (sc.file_count > 1)
+    download.file_list()->set_root_dir(dir + "/bench");
+  else
+    download.file_list()->set_root_dir(dir);
+
+  download.open();
+  download.hash_check(false);
+
+  if (opts.pipeline)
+    download.set_request_pipeline(opts.pipeline_min, opts.pipeline_max);
+
+  bool  started = false;
+  usage start{};
+  auto  deadline =
+    std::chrono::steady_clock::now() + std::chrono::seconds(opts.timeout);
+
+  auto finish = [&](bool complete) {
+    usage end = current_usage();
+
+    result.complete       = complete;
+    result.bytes          = seeder ? download.info()->up_rate()->total()
+                                   : download.info()->down_rate()->total();
+    result.seconds        = end.seconds - start.seconds;
+    result.cpu_user       = end.cpu_user - start.cpu_user;
+    result.cpu_system     = end.cpu_system - start.cpu_system;
+    result.syscalls_net   = end.syscalls_net - start.syscalls_net;
+    result.syscalls_poll  = end.syscalls_poll - start.syscalls_poll;
+    result.syscalls_mm    = end.syscalls_mm - start.syscalls_mm;
+    result.switches_voluntary =
+      end.switches_voluntary - start.switches_voluntary;
+    result.switches_involuntary =
+      end.switches_involuntary - start.switches_involuntary;
+
+    if (write(result_fd, &result, sizeof(result)) != sizeof(result))
+      _exit(1);
+
+    throw torrent::shutdown_exception();
+  };
+
+  torrent::main_thread()->slot_next_timeout() = []() { return 10000; };
+  torrent::main_thread()->slot_do_work()      = [&]() {
+    if (!started) {
+      if (!download.is_hash_checked())
+        return;
+
+      download.start();
+      download.connection_list()->set_min_size(opts.leechers + 1);
+      download.connection_list()->set_max_size(opts.leechers + 1);
+
+      start   = current_usage();
+      started = true;
+
+      for (int i = 0; i < index; i++) {
+        sockaddr_in sa = sc.latency_ms != 0 ? proxy_address(i, opts.port + i)
+                                            : peer_address(i, opts.port + i);
+        download.add_peer(reinterpret_cast<sockaddr*>(&sa), opts.port + i);
+      }
+
+      if (seeder && write(ready_fd, "", 1) != 1)
+        _exit(1);
+    }
+
+    if (seeder) {
+      pollfd pfd{ control_fd, POLLIN, 0 };
+
+      // The parent closes the control pipe once all leechers are done.
+      if (::poll(&pfd, 1, 0) == 1)
+        finish(true);
+
+    } else if (download.file_list()->is_done()) {
+      finish(true);
+
+    } else if (std::chrono::steady_clock::now() >= deadline) {
+      finish(false);
+    }
+  };
+
+  torrent::thread_base::event_loop(torrent::main_thread());
+
+  // Skip cleanup, the data directories are removed by the parent.
+  _exit(0);
+}
+
+//
+// Latency proxy:
+//
+
+int64_t
+monotonic_msec() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+           std::chrono::steady_clock::now().time_since_epoch())
+    .count();
+}
+
+// Data read from 'from' is written to 'to' once it has been held for
+// the scenario latency. Reading stops while too much is held, which
+// pushes back on the sender.
+struct proxy_direction {
+  static constexpr size_t max_held = 16 << 20;
+
+  int                                        from;
+  int                                        to;
+  std::deque<std::pair<int64_t, std::string>> held;
+  size_t                                     held_bytes{ 0 };
+  bool                                       eof{ false };
+};
+
+struct proxy_link {
+  proxy_direction dir[2];
+  bool            closed{ false };
+};
+
+void
+proxy_close(proxy_link& link) {
+  close(link.dir[0].from);
+  close(link.dir[0].to);
+  link.closed = true;
+}
+
+// Returns false if the link failed.
+bool
+proxy_read(proxy_direction& dir, int64_t now, int64_t latency) {
+  char    buffer[64 << 10];
+  ssize_t n = ::read(dir.from, buffer, sizeof(buffer));
+
+  if (n == 0) {
+    dir.eof = true;
+    return true;
+  }
+
+  if (n < 0)
+    return errno == EAGAIN || errno == EINTR;
+
+  dir.held.emplace_back(now + latency, std::string(buffer, n));
+  dir.held_bytes += n;
+  return true;
+}
+
+bool
+proxy_write(proxy_direction& dir, int64_t now) {
+  while (!dir.held.empty() && dir.held.front().first <= now) {
+    auto&   data = dir.held.front().second;
+    ssize_t n    = ::write(dir.to, data.data(), data.size());
+
+    if (n < 0)
+      return errno == EAGAIN || errno == EINTR;
+
+    dir.held_bytes -= n;
+
+    if (size_t(n) < data.size()) {
+      data.erase(0, n);
+      return true;
+    }
+
+    dir.held.pop_front();
+  }
+
+  if (dir.held.empty() && dir.eof)
+    shutdown(dir.to, SHUT_WR);
+
+  return true;
+}
+
+[[noreturn]] void
+run_proxy(const scenario& sc, const options& opts, int ready_fd) {
+  std::vector<int>        listeners;
+  std::vector<proxy_link> links;
+
+  for (uint32_t i = 0; i <= opts.leechers; i++) {
+    sockaddr_in sa  = proxy_address(i, opts.port + i);
+    int         fd  = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    int         one = 1;
+
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    if (bind(fd, reinterpret_cast<sockaddr*>(&sa), sizeof(sa)) == -1 ||
+        listen(fd, 64) == -1)
+      fail("proxy could not listen");
+
+    listeners.push_back(fd);
+  }
+
+  if (write(ready_fd, "", 1) != 1)
+    _exit(1);
+
+  // Links are never erased so that indices into 'links' stay valid.
+  links.reserve(4 * (opts.leechers + 1) * (opts.leechers + 1));
+
+  while (true) {
+    int64_t now     = monotonic_msec();
+    int     timeout = -1;
+
+    std::vector<pollfd>                 pfds;
+    std::vector<std::pair<size_t, int>> owners;
+
+    for (auto fd : listeners) {
+      pfds.push_back({ fd, POLLIN, 0 });
+      owners.emplace_back(~size_t(), 0);
+    }
+
+    for (size_t i = 0; i < links.size(); i++) {
+      if (links[i].closed)
+        continue;
+
+      for (int d = 0; d < 2; d++) {
+        auto& dir = links[i].dir[d];
+
+        if (!dir.eof && dir.held_bytes < proxy_direction::max_held) {
+          pfds.push_back({ dir.from, POLLIN, 0 });
+          owners.emplace_back(i, d);
+        }
+
+        if (!dir.held.empty()) {
+          int64_t wait = std::max<int64_t>(dir.held.front().first - now, 0);
+
+          if (wait == 0) {
+            pfds.push_back({ dir.to, POLLOUT, 0 });
+            owners.emplace_back(i, d | 2);
+          } else if (timeout == -1 || wait < timeout) {
+            timeout = wait;
+          }
+        }
+      }
+    }
+
+    if (::poll(pfds.data(), pfds.size(), timeout) == -1 && errno != EINTR)
+      fail("proxy poll failed");
+
+    now = monotonic_msec();
+
+    for (size_t i = 0; i < pfds.size(); i++) {
+      if (pfds[i].revents == 0)
+        continue;
+
+      if (owners[i].first == ~size_t()) {
+        sockaddr_in client{};
+        socklen_t   client_len = sizeof(client);
+        int         in         = accept4(pfds[i].fd,
+                                 reinterpret_cast<sockaddr*>(&client),
+                                 &client_len,
+                                 SOCK_NONBLOCK);
+
+        if (in == -1)
+          continue;
+
+        int         target = i;
+        sockaddr_in source = proxy_source_address(client.sin_addr.s_addr);
+        sockaddr_in dest =
+          peer_address(target, opts.port + target);
+        int out = socket(AF_INET, SOCK_STREAM, 0);
+
+        if (bind(out, reinterpret_cast<sockaddr*>(&source), sizeof(source)) ==
+              -1 ||
+            connect(out, reinterpret_cast<sockaddr*>(&dest), sizeof(dest)) ==
+              -1) {
+          close(in);
+          close(out);
+          continue;
+        }
+
+        fcntl(out, F_SETFL, fcntl(out, F_GETFL) | O_NONBLOCK);
+
+        proxy_link link;
+        link.dir[0].from = in;
+        link.dir[0].to   = out;
+        link.dir[1].from = out;
+        link.dir[1].to   = in;
+        links.push_back(std::move(link));
+        continue;
+      }
+
+      auto& link = links[owners[i].first];
+
+      if (link.closed)
+        continue;
+
+      auto& dir = link.dir[owners[i].second & 1];
+      bool  ok  = owners[i].second & 2
+                    ? proxy_write(dir, now)
+                    : proxy_read(dir, now, sc.latency_ms);
+
+      if (!ok || (link.dir[0].eof && link.dir[1].eof &&
+                  link.dir[0].held.empty() && link.dir[1].held.empty()))
+        proxy_close(link);
+    }
+  }
+}
+
+//
+// Parent process:
+//
+
+void
+print_result(const scenario& sc, const peer_result& result) {
+  double mib    = result.bytes / double(1 << 20);
+  double cpu    = result.cpu_user + result.cpu_system;
+  double gib    = result.bytes / double(1 << 30);
+  char   role[16];
+
+  if (result.index == 0)
+    std::snprintf(role, sizeof(role), "seeder");
+  else
+    std::snprintf(role, sizeof(role), "leecher%d", result.index);
+
+  std::printf("%-12s %-10s %9.1f %8.2f %9.1f %9.2f %9" PRIu64 " %9" PRIu64
+              " %9" PRIu64 " %8" PRIu64 " %8" PRIu64 "%s\n",
+              sc.name,
+              role,
+              mib,
+              result.seconds,
+              result.seconds > 0 ? mib / result.seconds : 0.0,
+              gib > 0 ? cpu / gib : 0.0,
+              result.syscalls_net,
+              result.syscalls_poll,
+              result.syscalls_mm,
+              result.switches_voluntary,
+              result.switches_involuntary,
+              result.complete ? "" : " (incomplete)");
+}
+
+bool
+read_result(int fd, peer_result* result, int timeout_ms) {
+  pollfd pfd{ fd, POLLIN, 0 };
+
+  if (::poll(&pfd, 1, timeout_ms) != 1)
+    return false;
+
+  return read(fd, result, sizeof(*result)) == sizeof(*result);
+}
+
+pid_t
+fork_peer(int                index,
+          const scenario&    sc,
+          const options&     opts,
+          const std::string& dir,
+          const std::string& metainfo,
+          int                pipes[3][2]) {
+  std::fflush(stdout);
+
+  pid_t pid = fork();
+
+  if (pid == -1)
+    fail("fork failed");
+
+  if (pid == 0) {
+    close(pipes[0][0]);
+    close(pipes[1][0]);
+    close(pipes[2][1]);
+
+    try {
+      run_peer(index,
+               sc,
+               opts,
+               dir,
+               metainfo,
+               pipes[0][1],
+               pipes[1][1],
+               pipes[2][0]);
+    } catch (torrent::base_error& e) {
+      fail(std::string("peer ") + std::to_string(index) + ": " + e.what());
+    }
+  }
+
+  return pid;
+}
+
+pid_t
+fork_proxy(const scenario& sc, const options& opts, int pipes[3][2]) {
+  std::fflush(stdout);
+
+  pid_t pid = fork();
+
+  if (pid == -1)
+    fail("fork failed");
+
+  if (pid == 0) {
+    close(pipes[0][0]);
+    close(pipes[1][0]);
+    close(pipes[2][1]);
+
+    run_proxy(sc, opts, pipes[0][1]);
+  }
+
+  return pid;
+}
+
+bool
+run_scenario(const scenario& sc, const options& opts) {
+  char base[] = "/tmp/libtorrent_bench.XXXXXX";
+
+  if (mkdtemp(base) == nullptr)
+    fail("could not create temporary directory");
+
+  std::string root = base;
+  uint64_t    size = opts.size != 0 ? opts.size : sc.size;
+
+  std::vector<std::string> dirs;
+
+  for (uint32_t i = 0; i <= opts.leechers; i++) {
+    dirs.push_back(root + "/peer" + std::to_string(i));
+
+    if (mkdir(dirs.back().c_str(), 0755) == -1)
+      fail("could not create peer directory");
+  }
+
+  std::stringstream metainfo_stream;
+  torrent::Object   object = create_torrent(dirs[0], sc, size);
+
+  torrent::object_write_bencode(&metainfo_stream, &object);
+
+  std::string metainfo = metainfo_stream.str();
+
+  // Ready, result and control pipes.
+  int pipes[3][2];
+
+  for (auto& p : pipes)
+    if (pipe(p) == -1)
+      fail("could not create pipe");
+
+  char   ready;
+  bool   success = true;
+  pollfd ready_pfd{ pipes[0][0], POLLIN, 0 };
+  pid_t  proxy   = -1;
+
+  if (sc.latency_ms != 0) {
+    proxy = fork_proxy(sc, opts, pipes);
+
+    if (::poll(&ready_pfd, 1, 10000) != 1 ||
+        read(pipes[0][0], &ready, 1) != 1)
+      fail("proxy did not start");
+  }
+
+  std::vector<pid_t> pids;
+  pids.push_back(fork_peer(0, sc, opts, dirs[0], metainfo, pipes));
+
+  if (::poll(&ready_pfd, 1, opts.timeout * 1000) != 1 ||
+      read(pipes[0][0], &ready, 1) != 1) {
+    std::fprintf(stderr, "%s: seeder did not start\n", sc.name);
+    success = false;
+  }
+
+  for (uint32_t i = 1; success && i <= opts.leechers; i++)
+    pids.push_back(fork_peer(i, sc, opts, dirs[i], metainfo, pipes));
+
+  std::vector<peer_result> results;
+
+  for (uint32_t i = 1; i < pids.size(); i++) {
+    peer_result result;
+
+    if (!read_result(pipes[1][0], &result, (opts.timeout + 30) * 1000)) {
+      std::fprintf(stderr, "%s: leecher did not report\n", sc.name);
+      success = false;
+      break;
+    }
+
+    success = success && result.complete;
+    results.push_back(result);
+  }
+
+  // Closing the control pipe tells the seeder to report.
+  close(pipes[2][1]);
+
+  peer_result seeder_result;
+
+  if (read_result(pipes[1][0], &seeder_result, 30000))
+    results.insert(results.begin(), seeder_result);
+
+  if (proxy != -1)
+    pids.push_back(proxy);
+
+  for (auto pid : pids) {
+    kill(pid, SIGTERM);
+    waitpid(pid, nullptr, 0);
+  }
+
+  for (auto& p : pipes) {
+    close(p[0]);
+
+    if (&p != &pipes[2])
+      close(p[1]);
+  }
+
+  for (const auto& result : results)
+    print_result(sc, result);
+
+  remove_directory(root);
+  return success;
+}
+
+//
+// Peer list memory:
+//
+
+size_t
+heap_in_use() {
+  struct mallinfo2 info = mallinfo2();
+  return info.uordblks + info.hblkhd;
+}
+
+double
+elapsed_seconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+    .count();
+}
+
+// The addresses are not made available for connecting, so only the
+// peer list and PeerInfo storage is measured and not the bounded
+// available list.
+bool
+run_peer_list(uint32_t count) {
+  initialize_torrent();
+
+  auto   list   = new torrent::PeerList;
+  size_t before = heap_in_use();
+  auto   start  = std::chrono::steady_clock::now();
+
+  for (uint32_t i = 0; i < count; i++) {
+    sockaddr_in sa{};
+    sa.sin_family      = AF_INET;
+    sa.sin_addr.s_addr = htonl((10u << 24) + i);
+    sa.sin_port        = htons(6881);
+
+    list->insert_address(reinterpret_cast<sockaddr*>(&sa), 0);
+  }
+
+  double insert_seconds = elapsed_seconds(start);
+  size_t used           = heap_in_use() - before;
+
+  start               = std::chrono::steady_clock::now();
+  uint32_t culled     = list->cull_peers(torrent::PeerList::cull_old);
+  double cull_seconds = elapsed_seconds(start);
+
+  std::printf("%-12s %12s %14s %14s %12s %12s\n",
+              "peer_list",
+              "peers",
+              "heap-MiB",
+              "bytes/peer",
+              "insert-s",
+              "cull-s");
+  std::printf("%-12s %12zu %14.1f %14.1f %12.3f %12.3f\n",
+              "",
+              list->size() + culled,
+              used / double(1 << 20),
+              count != 0 ? used / double(count) : 0.0,
+              insert_seconds,
+              cull_seconds);
+
+  delete list;
+  torrent::cleanup();
+
+  return culled == count;
+}
+
+void
+usage_error() {
+  std::fprintf(stderr,
+               "usage: libtorrent_bench [-l leechers] [-s size_mib] "
+               "[-t timeout] [-p port] [-i log_prefix] [-P min:max] "
+               "[-L bytes] [-u] [scenario ...]\n"
+               "       libtorrent_bench -k count\n"
+               "       libtorrent_bench -m benchmark\n\n"
+               "scenarios:\n");
+
+  for (const auto& sc : scenarios)
+    std::fprintf(stderr, "  %-12s %s\n", sc.name, sc.description);
+
+  std::fprintf(stderr, "\nbenchmarks:\n");
+
+  for (const auto& mb : micro_benchmarks)
+    std::fprintf(stderr, "  %-12s %s\n", mb.name, mb.description);
+
+  std::exit(1);
+}
+
+} // namespace
+
+int
+main(int argc, char** argv) {
+  options     opts;
+  uint32_t    known_peers = 0;
+  const char* micro       = nullptr;
+  int         c;
+
+  while ((c = getopt(argc, argv, "l:s:t:p:i:P:L:uk:m:h")) != -1) {
+    switch (c) {
+    case 'l':
+      opts.leechers = std::max(1, std::atoi(optarg));
+      break;
+    case 's':
+      opts.size = uint64_t(std::max(1, std::atoi(optarg))) << 20;
+      break;
+    case 't':
+      opts.timeout = std::max(1, std::atoi(optarg));
+      break;
+    case 'p':
+      opts.port = std::atoi(optarg);
+      break;
+    case 'i':
+      opts.log_prefix = optarg;
+      break;
+    case 'P':
+      if (std::sscanf(optarg,
+                      "%" SCNu32 ":%" SCNu32,
+                      &opts.pipeline_min,
+                      &opts.pipeline_max) != 2 ||
+          (opts.pipeline_max != 0 && opts.pipeline_min > opts.pipeline_max))
+        usage_error();
+
+      opts.pipeline = true;
+      break;
+    case 'L':
+      opts.send_lowat = std::max(0, std::atoi(optarg));
+      break;
+    case 'u':
+      opts.utp = true;
+      break;
+    case 'k':
+      known_peers = std::max(1, std::atoi(optarg));
+      break;
+    case 'm':
+      micro = optarg;
+      break;
+    default:
+      usage_error();
+    }
+  }
+
+  if (known_peers != 0)
+    return run_peer_list(known_peers) ? 0 : 1;
+
+  if (micro != nullptr) {
+    auto itr = std::find_if(std::begin(micro_benchmarks),
+                            std::end(micro_benchmarks),
+                            [&](const micro_benchmark& mb) {
+                              return std::strcmp(mb.name, micro) == 0;
+                            });
+
+    if (itr == std::end(micro_benchmarks))
+      usage_error();
+
+    return itr->run() ? 0 : 1;
+  }
+
+  std::vector<const scenario*> selected;
+
+  for (int i = optind; i < argc; i++) {
+    auto itr = std::find_if(
+      std::begin(scenarios), std::end(scenarios), [&](const scenario& sc) {
+        return std::strcmp(sc.name, argv[i]) == 0;
+      });
+
+    if (itr == std::end(scenarios))
+      usage_error();
+
+    selected.push_back(&*itr);
+  }
+
+  if (selected.empty())
+    for (const auto& sc : scenarios)
+      selected.push_back(&sc);
+
+  // Peers are killed once done, so broken connections are expected.
+  signal(SIGPIPE, SIG_IGN);
+
+  std::printf("%-12s %-10s %9s %8s %9s %9s %9s %9s %9s %8s %8s\n",
+              "scenario",
+              "peer",
+              "MiB",
+              "seconds",
+              "MiB/s",
+              "cpu-s/GiB",
+              "net",
+              "poll",
+              "mm",
+              "vcsw",
+              "ivcsw");
+
+  bool success = true;
+
+  for (const auto* sc : selected) {
+    success = run_scenario(*sc, opts) && success;
+    std::fflush(stdout);
+
+    // Keep sockets from earlier scenarios in TIME_WAIT out of the way.
+    opts.port += opts.leechers + 1;
+  }
+
+  return success ? 0 : 1;
+}
@@ -80,6 +80,59 @@ if(HAVE_INOTIFY)
   file(APPEND ${BUILDINFO_H} "#define LT_HAVE_INOTIFY 1\n\n")
 endif()
 
+check_cxx_source_compiles(
+  "
+  #include <sys/socket.h>
+  int main() {
+    mmsghdr msgs[2] = {};
+    recvmmsg(0, msgs, 2, MSG_DONTWAIT, nullptr);
+    sendmmsg(0, msgs, 2, 0);
+  }
+  "
+  HAVE_RECVMMSG)
+
+if(HAVE_RECVMMSG)
+  file(APPEND ${BUILDINFO_H} "/* recvmmsg and sendmmsg supported */\n")
+  file(APPEND ${BUILDINFO_H} "#define LT_HAVE_RECVMMSG 1\n\n")
+endif()
+
+check_cxx_source_compiles(
+  "
+  #include <netinet/in.h>
+  #include <netinet/tcp.h>
+  #include <sys/socket.h>
+  int main() {
+    tcp_info  info;
+    socklen_t length = sizeof(info);
+    getsockopt(0, IPPROTO_TCP, TCP_INFO, &info, &length);
+    return info.tcpi_rtt + info.tcpi_rttvar + info.tcpi_snd_cwnd +
+           info.tcpi_snd_mss + info.tcpi_total_retrans;
+  }
+  "
+  HAVE_TCP_INFO)
+
+if(HAVE_TCP_INFO)
+  file(APPEND ${BUILDINFO_H} "/* Linux's TCP_INFO supported */\n")
+  file(APPEND ${BUILDINFO_H} "#define LT_HAVE_TCP_INFO 1\n\n")
+endif()
+
+check_cxx_source_compiles(
+  "
+  #include <netinet/in.h>
+  #include <netinet/tcp.h>
+  #include <sys/socket.h>
+  int main() {
+    int opt = 16384;
+    setsockopt(0, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &opt, sizeof(opt));
+  }
+  "
+  HAVE_TCP_NOTSENT_LOWAT)
+
+if(HAVE_TCP_NOTSENT_LOWAT)
+  file(APPEND ${BUILDINFO_H} "/* TCP_NOTSENT_LOWAT supported */\n")
+  file(APPEND ${BUILDINFO_H} "#define LT_HAVE_TCP_NOTSENT_LOWAT 1\n\n")
+endif()
+
 file(APPEND ${BUILDINFO_H} "/* Default address space size */\n")
 check_type_size("long" LONG_SIZE)
 if(LONG_SIZE GREATER_EQUAL 8)
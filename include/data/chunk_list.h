@@ -6,6 +6,7 @@
 
 #include <functional>
 #include <string>
+#include <sys/types.h>
 #include <vector>
 
 #include "chunk.h"
@@ -86,6 +87,14 @@ public:
     return m_queue.size();
   }
 
+  // The device holding the download's files, used to group syncs.
+  dev_t device() const {
+    return m_device;
+  }
+  void set_device(dev_t device) {
+    m_device = device;
+  }
+
   download_data* data() {
     return m_data;
   }
@@ -112,8 +121,9 @@ public:
   // keyword. Then use that flag to decide if we should skip
   // non-continious regions.
 
-  // Returns the number of failed syncs.
-  uint32_t sync_chunks(int flags);
+  // Syncs at most 'max_chunks', lowest index first, leaving the rest
+  // queued. Returns the number of failed syncs.
+  uint32_t sync_chunks(int flags, uint32_t max_chunks = ~uint32_t());
 
   slot_string& slot_storage_error() {
     return m_slot_storage_error;
@@ -149,6 +159,7 @@ private:
 
   int      m_flags{ 0 };
   uint32_t m_chunk_size{ 0 };
+  dev_t    m_device{ 0 };
 
   slot_string      m_slot_storage_error;
   slot_chunk_index m_slot_create_chunk;
@@ -0,0 +1,84 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2005-2011, Jari Sundell <jaris@ifi.uio.no>
+
+#ifndef LIBTORRENT_DATA_HASH_SCHEDULER_H
+#define LIBTORRENT_DATA_HASH_SCHEDULER_H
+
+#include <cinttypes>
+#include <list>
+#include <sys/types.h>
+#include <unordered_map>
+
+#include "torrent/torrent.h"
+#include "torrent/utils/timer.h"
+
+namespace torrent {
+
+class HashTorrent;
+
+// Shares the memory of outstanding hash checks between all downloads
+// checking files on the same device. Downloads that find the device
+// budget used up wait in a per-device queue and get resumed in order
+// as chunks complete, so rechecks on a disk are interleaved rather
+// than each download queueing up to the full amount.
+
+class HashScheduler {
+public:
+  static constexpr uint64_t default_max_outstanding = 128 << 20;
+
+  struct device_type {
+    uint64_t                outstanding{ 0 };
+    std::list<HashTorrent*> waiting;
+  };
+
+  struct entry_type {
+    dev_t    device;
+    uint64_t outstanding;
+  };
+
+  using device_map = std::unordered_map<dev_t, device_type>;
+  using entry_map  = std::unordered_map<HashTorrent*, entry_type>;
+
+  ~HashScheduler();
+
+  uint64_t max_outstanding() const {
+    return m_maxOutstanding;
+  }
+  void set_max_outstanding(uint64_t bytes) {
+    m_maxOutstanding = bytes;
+  }
+
+  bool has(HashTorrent* torrent) const {
+    return m_entries.find(torrent) != m_entries.end();
+  }
+  bool is_waiting(HashTorrent* torrent) const;
+
+  void insert(HashTorrent* torrent, dev_t device);
+  void erase(HashTorrent* torrent);
+
+  // Returns false and queues the download if the device can't take
+  // another 'bytes' right now. A device with nothing outstanding
+  // always accepts, so a chunk larger than the budget still
+  // progresses.
+  bool is_available(HashTorrent* torrent, uint64_t bytes);
+
+  void acquire(HashTorrent* torrent, uint64_t bytes);
+  void release(HashTorrent* torrent, uint64_t bytes);
+
+  hash_check_progress progress() const;
+
+private:
+  void wake(device_type& device);
+
+  uint64_t m_maxOutstanding{ default_max_outstanding };
+
+  device_map m_devices;
+  entry_map  m_entries;
+
+  uint64_t     m_bytesChecked{ 0 };
+  utils::timer m_started;
+};
+
+} // namespace torrent
+
+#endif
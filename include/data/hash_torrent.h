@@ -7,6 +7,7 @@
 #include <cinttypes>
 #include <functional>
 #include <string>
+#include <sys/types.h>
 
 #include "data/chunk_handle.h"
 #include "torrent/utils/priority_queue_default.h"
@@ -15,6 +16,7 @@
 namespace torrent {
 
 class ChunkList;
+class HashScheduler;
 
 class HashTorrent {
 public:
@@ -47,6 +49,18 @@ public:
     return m_outstanding;
   }
 
+  // Bytes left to check, assuming all remaining chunks are checked.
+  uint64_t bytes_remaining() const;
+
+  // The device the files are on, used to share the hash check budget
+  // between downloads on the same disk.
+  dev_t device() const {
+    return m_device;
+  }
+  void set_device(dev_t d) {
+    m_device = d;
+  }
+
   std::errc error_number() const {
     return m_errno;
   }
@@ -62,6 +76,8 @@ public:
   void receive_chunkdone(uint32_t index);
   void receive_chunk_cleared(uint32_t index);
 
+  void receive_budget();
+
 private:
   void queue(bool quick);
 
@@ -70,8 +86,10 @@ private:
   Ranges       m_ranges;
 
   std::errc m_errno;
+  dev_t     m_device{ 0 };
 
-  ChunkList* m_chunk_list;
+  ChunkList*     m_chunk_list;
+  HashScheduler* m_scheduler{ nullptr };
 
   slot_chunk_handle m_slot_check_chunk;
 
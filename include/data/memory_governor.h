@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2005-2011, Jari Sundell <jaris@ifi.uio.no>
+
+#ifndef LIBTORRENT_DATA_MEMORY_GOVERNOR_H
+#define LIBTORRENT_DATA_MEMORY_GOVERNOR_H
+
+#include <cinttypes>
+#include <string>
+
+namespace torrent {
+
+// Memory state of the process from the cgroup v2 memory controller
+// and pressure stall information. Pressure is the 'avg10' share of
+// time stalled, in hundredths of a percent.
+struct memory_sample {
+  uint64_t cgroup_max{ 0 }; // Zero if no limit was found.
+  uint64_t cgroup_current{ 0 }; // Of the cgroup setting 'cgroup_max'.
+  uint64_t cgroup_file{ 0 };    // Reclaimable page cache in the above.
+
+  bool     has_pressure{ false };
+  uint32_t pressure_some{ 0 };
+  uint32_t pressure_full{ 0 };
+};
+
+// Decides how much memory ChunkManager may map. The limit is kept
+// below memory.max of the cgroup, less a reserve for the rest of the
+// process and the memory that can't be reclaimed, and while memory
+// pressure is high it is cut to a fraction of the memory in use,
+// growing back slowly once pressure is gone.
+class MemoryGovernor {
+public:
+  static constexpr uint32_t pressure_high = 1000;
+  static constexpr uint32_t pressure_low  = 100;
+
+  MemoryGovernor(std::string cgroup_root = "/sys/fs/cgroup",
+                 std::string proc_root   = "/proc");
+
+  memory_sample sample() const;
+
+  // The smallest memory.max of the cgroup of the process and its
+  // ancestors, or zero if none is set.
+  uint64_t cgroup_max() const;
+
+  // Returns the new limit, between an eighth of 'max' and 'max', for
+  // chunk memory currently at 'usage' bytes.
+  static uint64_t next_limit(const memory_sample& sample,
+                             uint64_t             limit,
+                             uint64_t             usage,
+                             uint64_t             max);
+
+  // Parsers for the content of the respective files, exposed for
+  // testing.
+  static bool     parse_cgroup_path(const std::string& proc_cgroup,
+                                    std::string*       path);
+  static uint64_t parse_memory_value(const std::string& value);
+  static uint64_t parse_memory_stat(const std::string& stat,
+                                    const std::string& key);
+  static bool     parse_pressure(const std::string& pressure,
+                                 uint32_t*          some,
+                                 uint32_t*          full);
+
+private:
+  bool     cgroup_path(std::string* path) const;
+  uint64_t cgroup_limit(std::string* limit_path) const;
+
+  std::string m_cgroupRoot;
+  std::string m_procRoot;
+};
+
+} // namespace torrent
+
+#endif
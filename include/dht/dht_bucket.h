@@ -129,8 +129,8 @@ private:
   size_t m_fullCacheLength;
 
   // These are 40 bytes together, so might as well put them last.
-  // m_end is const because it is used as key for the DhtRouter routing table
-  // map, which would be inconsistent if m_end were changed carelessly.
+  // m_end is const because splitting a bucket only ever moves m_begin,
+  // the new lower half is created as a separate bucket.
   HashString       m_begin;
   const HashString m_end;
 
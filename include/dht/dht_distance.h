@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2005-2011, Jari Sundell <jaris@ifi.uio.no>
+
+#ifndef LIBTORRENT_DHT_DISTANCE_H
+#define LIBTORRENT_DHT_DISTANCE_H
+
+#include <algorithm>
+#include <cinttypes>
+
+#include "torrent/hash_string.h"
+
+namespace torrent {
+
+// XOR metric helpers working on the 160-bit IDs as two 64-bit and one
+// 32-bit big-endian words, rather than byte by byte.
+
+inline uint64_t
+dht_load_word(const char* data, unsigned int length) {
+  uint64_t word = 0;
+
+  for (unsigned int i = 0; i < length; i++)
+    word = (word << 8) | static_cast<uint8_t>(data[i]);
+
+  return word;
+}
+
+// Number of leading bits shared by the two IDs, 160 if equal.
+inline unsigned int
+dht_common_prefix(const HashString& one, const HashString& two) {
+  static_assert(HashString::size_data == 20, "DHT IDs must be 160 bits.");
+
+  uint64_t diff = dht_load_word(one.data(), 8) ^ dht_load_word(two.data(), 8);
+
+  if (diff != 0)
+    return __builtin_clzll(diff);
+
+  diff = dht_load_word(one.data() + 8, 8) ^ dht_load_word(two.data() + 8, 8);
+
+  if (diff != 0)
+    return 64 + __builtin_clzll(diff);
+
+  diff = dht_load_word(one.data() + 16, 4) ^ dht_load_word(two.data() + 16, 4);
+
+  if (diff != 0)
+    return 128 + __builtin_clzll(diff) - 32;
+
+  return 160;
+}
+
+// Returns true if 'one' is strictly closer to 'target' than 'two'.
+inline bool
+dht_is_closer(const HashString& target,
+              const HashString& one,
+              const HashString& two) {
+  for (unsigned int offset = 0; offset < HashString::size_data; offset += 8) {
+    unsigned int length =
+      std::min<unsigned int>(8, HashString::size_data - offset);
+
+    uint64_t t = dht_load_word(target.data() + offset, length);
+    uint64_t a = dht_load_word(one.data() + offset, length) ^ t;
+    uint64_t b = dht_load_word(two.data() + offset, length) ^ t;
+
+    if (a != b)
+      return a < b;
+  }
+
+  return false;
+}
+
+} // namespace torrent
+
+#endif
@@ -11,12 +11,15 @@
 #include "dht_node.h"
 #include "dht_tracker.h"
 #include "torrent/hash_string.h"
+#include "torrent/utils/socket_address.h"
 
 namespace torrent {
 
+// Nodes are indexed by ID, with a secondary index by IPv4 address.
 class DhtNodeList : public std::unordered_map<const HashString*, DhtNode*> {
 public:
-  using base_type = std::unordered_map<const HashString*, DhtNode*>;
+  using base_type     = std::unordered_map<const HashString*, DhtNode*>;
+  using address_index = std::unordered_multimap<uint32_t, DhtNode*>;
 
   // Define accessor iterator with more convenient access to the key and
   // element values.  Allows changing the map definition more easily if needed.
@@ -37,6 +40,13 @@ public:
   using accessor       = accessor_wrapper<iterator>;
 
   DhtNode* add_node(DhtNode* n);
+  void     erase_node(const accessor& itr);
+
+  // Return any node with the given address, disregarding the port.
+  DhtNode* find_address(const utils::socket_address* sa) const;
+
+private:
+  address_index m_addresses;
 };
 
 class DhtTrackerList : public std::unordered_map<HashString, DhtTracker*> {
@@ -62,10 +72,35 @@ public:
 
 inline DhtNode*
 DhtNodeList::add_node(DhtNode* n) {
-  insert(std::make_pair((const HashString*)n, (DhtNode*)n));
+  if (insert(std::make_pair((const HashString*)n, (DhtNode*)n)).second)
+    m_addresses.emplace(n->address()->sa_inet()->address_n(), n);
+
   return n;
 }
 
+inline void
+DhtNodeList::erase_node(const accessor& itr) {
+  auto range =
+    m_addresses.equal_range(itr.node()->address()->sa_inet()->address_n());
+
+  for (auto address_itr = range.first; address_itr != range.second;
+       ++address_itr) {
+    if (address_itr->second == itr.node()) {
+      m_addresses.erase(address_itr);
+      break;
+    }
+  }
+
+  erase(itr);
+}
+
+inline DhtNode*
+DhtNodeList::find_address(const utils::socket_address* sa) const {
+  auto itr = m_addresses.find(sa->sa_inet()->address_n());
+
+  return itr != m_addresses.end() ? itr->second : nullptr;
+}
+
 } // namespace torrent
 
 #endif
@@ -4,6 +4,8 @@
 #ifndef LIBTORRENT_DHT_ROUTER_H
 #define LIBTORRENT_DHT_ROUTER_H
 
+#include <vector>
+
 #include "torrent/dht_manager.h"
 #include "torrent/hash_string.h"
 #include "torrent/object.h"
@@ -39,6 +41,11 @@ public:
   static constexpr unsigned int timeout_peer_announce =
     30 * 60; // Remove peers which haven't reannounced for 30 minutes.
 
+  // Limits on announces stored for other nodes, the least recently
+  // announced torrents are dropped first.
+  static constexpr unsigned int max_trackers      = 1 << 14;
+  static constexpr unsigned int max_tracker_peers = 1 << 17;
+
   // A node ID of all zero.
   static HashString zero_id;
 
@@ -64,6 +71,9 @@ public:
   // Returns NULL if not tracking the torrent unless create is true.
   DhtTracker* get_tracker(const HashString& hash, bool create);
 
+  // Store an announce, evicting old torrents when over the limits.
+  void add_peer(const HashString& hash, uint32_t addr, uint16_t port, bool seed);
+
   // Check if we are interested in inserting a new node of the given ID
   // into our table (i.e. if we have space or bad nodes in the corresponding
   // bucket).
@@ -78,7 +88,7 @@ public:
   // unless it's our own ID in which case it returns the DhtRouter object.
   DhtNode* get_node(const HashString& id);
 
-  // Search for node with given address in O(n), disregarding the port.
+  // Search for node with given address, disregarding the port.
   DhtNode* find_node(const utils::socket_address* sa);
 
   // Whenever a node queries us, replies, or is confirmed inactive (no reply) or
@@ -91,7 +101,7 @@ public:
   // Store compact node information (26 bytes) for nodes closest to the
   // given ID in the given buffer, return new buffer end.
   raw_string get_closest_nodes(const HashString& id) {
-    return find_bucket(id)->second->full_bucket();
+    return find_bucket(id)->full_bucket();
   }
 
   // Store DHT cache in the given container.
@@ -124,17 +134,21 @@ private:
   // Maximum number of potential contacts to keep until bootstrap complete.
   static constexpr unsigned int num_bootstrap_contacts = 1024;
 
-  using DhtBucketList = std::map<const HashString, DhtBucket*>;
+  // The routing table is indexed by the length of the ID prefix shared
+  // with our own ID. Only our own bucket is ever split, so every bucket
+  // but the last holds the IDs sharing exactly that many bits, and the
+  // last one is our own bucket holding the rest.
+  using DhtBucketList = std::vector<DhtBucket*>;
 
-  DhtBucketList::iterator find_bucket(const HashString& id);
+  DhtBucket* find_bucket(const HashString& id);
 
   bool add_node_to_bucket(DhtNode* node);
   void delete_node(const DhtNodeList::accessor& itr);
+  void evict_tracker();
 
   void store_closest_nodes(const HashString& id, DhtBucket* bucket);
 
-  DhtBucketList::iterator split_bucket(const DhtBucketList::iterator& itr,
-                                       DhtNode*                       node);
+  DhtBucket* split_bucket(DhtBucket* b, DhtNode* node);
 
   void bootstrap();
   void bootstrap_bucket(const DhtBucket* bucket);
@@ -154,6 +168,9 @@ private:
   DhtBucketList  m_routingTable;
   DhtTrackerList m_trackers;
 
+  DhtTracker::age_list m_trackerAge;
+  size_t               m_trackerPeers{ 0 };
+
   std::deque<contact_t>* m_contacts;
 
   int m_numRefresh;
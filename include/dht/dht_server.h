@@ -6,6 +6,7 @@
 
 #include <deque>
 #include <map>
+#include <vector>
 
 #include "net/socket_datagram.h"
 #include "net/throttle_node.h"
@@ -110,6 +111,9 @@ private:
   static constexpr int dht_error_protocol   = 203;
   static constexpr int dht_error_bad_method = 204;
 
+  // Size of the buffer for each received datagram.
+  static constexpr unsigned int read_buffer_size = 2048;
+
   // number of concurrent transactions
   static constexpr int num_max_transactions = 100;
   static_assert(num_max_transactions < (std::numeric_limits<char>::max() -
@@ -148,6 +152,11 @@ private:
 
   void start_write();
 
+  void process_datagram(char*                  buffer,
+                        int32_t                read,
+                        utils::socket_address& sa,
+                        uint32_t*              total);
+
   void process_query(const HashString&            id,
                      const utils::socket_address* sa,
                      const DhtMessage&            req);
@@ -197,6 +206,7 @@ private:
   void receive_timeout();
 
   DhtRouter*        m_router;
+  std::vector<char> m_readBuffer;
   packet_queue      m_highQueue;
   packet_queue      m_lowQueue;
   transaction_map   m_transactions;
@@ -4,9 +4,12 @@
 #ifndef LIBTORRENT_DHT_TRACKER_H
 #define LIBTORRENT_DHT_TRACKER_H
 
+#include <list>
+#include <unordered_map>
 #include <vector>
 
 #include "globals.h"
+#include "torrent/hash_string.h"
 #include "net/address_list.h" // For SA.
 #include "torrent/object_raw_bencode.h"
 #include "torrent/utils/socket_address.h"
@@ -14,6 +17,9 @@
 namespace torrent {
 
 // Container for peers tracked in a torrent.
+//
+// Peers are kept in a contiguous vector so get_peers can return them
+// without copying, with an index by address for duplicate checks.
 
 class DhtTracker {
 public:
@@ -28,6 +34,13 @@ public:
   // large peer tables for very active torrents.
   static constexpr unsigned int max_size = 128;
 
+  // Size of the BEP 33 scrape bloom filters in bytes.
+  static constexpr unsigned int bloom_size = 256;
+
+  // Position in the router's list of trackers ordered by last announce.
+  using age_list     = std::list<HashString>;
+  using age_iterator = age_list::iterator;
+
   bool empty() const {
     return m_peers.empty();
   }
@@ -35,13 +48,24 @@ public:
     return m_peers.size();
   }
 
-  void     add_peer(uint32_t addr, uint16_t port);
+  // Returns true if a new peer was added rather than an existing one
+  // updated or the oldest one replaced.
+  bool     add_peer(uint32_t addr, uint16_t port, bool seed = false);
   raw_list get_peers(unsigned int maxPeers = max_peers);
 
+  // BEP 33 bloom filters of the addresses of seeds and of downloading
+  // peers, rebuilt only when the peer list has changed.
+  raw_string bloom_seeds();
+  raw_string bloom_peers();
+
   // Remove old announces from the tracker that have not reannounced for
   // more than the given number of seconds.
   void prune(uint32_t maxAge);
 
+  age_iterator& age_position() {
+    return m_agePosition;
+  }
+
 private:
   // We need to store the address as a bencoded string.
   struct BencodeAddress {
@@ -65,8 +89,19 @@ private:
 
   using PeerList = std::vector<BencodeAddress>;
 
-  PeerList              m_peers;
-  std::vector<uint32_t> m_lastSeen;
+  void erase(unsigned int index);
+  void build_bloom();
+
+  PeerList                               m_peers;
+  std::vector<uint32_t>                  m_lastSeen;
+  std::vector<bool>                      m_seed;
+  std::unordered_map<uint32_t, uint32_t> m_index;
+
+  bool m_bloomValid{ false };
+  char m_bloomSeeds[bloom_size];
+  char m_bloomPeers[bloom_size];
+
+  age_iterator m_agePosition;
 };
 
 } // namespace torrent
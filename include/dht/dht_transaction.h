@@ -6,6 +6,7 @@
 
 #include <map>
 
+#include "dht/dht_distance.h"
 #include "dht/dht_node.h"
 #include "torrent/hash_string.h"
 #include "torrent/object_static_map.h"
@@ -29,35 +30,28 @@ class DhtTransactionFindNodeAnnounce;
 class DhtTransactionGetPeers;
 class DhtTransactionAnnouncePeer;
 
-using dht_compare_closer_type =
-  std::function<bool(torrent::DhtNode*, torrent::DhtNode*)>;
+// Orders nodes by XOR distance to the target.
+struct dht_compare_closer {
+  dht_compare_closer(const HashString* target)
+    : m_target(target) {}
 
-const std::function<dht_compare_closer_type(const torrent::HashString&)>
-  get_dht_compare_closer = [](const torrent::HashString& target) {
-    return [&target](torrent::DhtNode* left, torrent::DhtNode* right) {
-      const torrent::HashString one = *left;
-      const torrent::HashString two = *right;
-
-      for (unsigned int i = 0; i < one.size(); i++) {
-        if (one[i] != two[i]) {
-          return (uint8_t)(one[i] ^ target[i]) < (uint8_t)(two[i] ^ target[i]);
-        }
-      }
+  bool operator()(const DhtNode* one, const DhtNode* two) const {
+    return dht_is_closer(*m_target, *one, *two);
+  }
 
-      return false;
-    };
-  };
+  const HashString* m_target;
+};
 
 // DhtSearch contains a list of nodes sorted by closeness to the given target,
 // and returns what nodes to contact with up to three concurrent transactions
 // pending. The map element is the DhtSearch object itself to allow the returned
 // accessors to know which search a given node belongs to.
 class DhtSearch
-  : protected std::map<DhtNode*, DhtSearch*, dht_compare_closer_type> {
+  : protected std::map<DhtNode*, DhtSearch*, dht_compare_closer> {
   friend class DhtTransactionSearch;
 
 public:
-  using base_type = std::map<DhtNode*, DhtSearch*, dht_compare_closer_type>;
+  using base_type = std::map<DhtNode*, DhtSearch*, dht_compare_closer>;
 
   // Number of closest potential contact nodes to keep.
   static constexpr unsigned int max_contacts = 18;
@@ -194,6 +188,8 @@ enum dht_keys {
   key_a_id,
   key_a_infoHash,
   key_a_port,
+  key_a_scrape,
+  key_a_seed,
   key_a_target,
   key_a_token,
 
@@ -202,6 +198,8 @@ enum dht_keys {
 
   key_q,
 
+  key_r_BFpe,
+  key_r_BFsd,
   key_r_id,
   key_r_nodes,
   key_r_token,
@@ -4,41 +4,76 @@
 #ifndef LIBTORRENT_DOWNLOAD_AVAILABLE_LIST_H
 #define LIBTORRENT_DOWNLOAD_AVAILABLE_LIST_H
 
-#include <list>
+#include <unordered_map>
 #include <vector>
 
+#include "torrent/net/socket_address_key.h"
 #include "torrent/utils/socket_address.h"
 
 #include "net/address_list.h"
 
 namespace torrent {
 
+class PeerInfo;
+
+// Connection candidates, kept in a binary heap ordered by a score of
+// how likely a connection is to succeed and be useful. A hash index
+// from address to heap position keeps duplicate checks, erase and
+// score updates from scanning the container.
 class AvailableList : private std::vector<utils::socket_address> {
 public:
-  using base_type = std::vector<utils::socket_address>;
-  using size_type = uint32_t;
+  using base_type  = std::vector<utils::socket_address>;
+  using size_type  = uint32_t;
+  using score_type = uint32_t;
+
+  // Where an address was learned from.
+  static constexpr int source_unknown   = 0;
+  static constexpr int source_resume    = 1;
+  static constexpr int source_tracker   = 2;
+  static constexpr int source_pex       = 3;
+  static constexpr int source_reconnect = 4;
+
+  struct address_hash {
+    size_t operator()(const utils::socket_address& sa) const {
+      return socket_address_key_hash()(
+               socket_address_key::from_sockaddr(sa.c_sockaddr())) ^
+             (size_t(sa.port()) * 0x9e3779b97f4a7c15ull);
+    }
+  };
+
+  using index_type =
+    std::unordered_map<utils::socket_address, size_type, address_hash>;
 
   using base_type::const_reference;
   using base_type::reference;
   using base_type::value_type;
 
   using base_type::capacity;
-  using base_type::clear;
   using base_type::const_iterator;
   using base_type::empty;
   using base_type::iterator;
-  using base_type::reserve;
   using base_type::reverse_iterator;
   using base_type::size;
 
   using base_type::back;
   using base_type::begin;
   using base_type::end;
-  using base_type::pop_back;
   using base_type::rbegin;
   using base_type::rend;
 
-  value_type pop_random();
+  void clear();
+  void reserve(size_type s);
+
+  bool contains(const utils::socket_address& sa) const {
+    return m_index.find(sa) != m_index.end();
+  }
+
+  // Highest score first, ties are broken randomly.
+  value_type pop_best();
+
+  score_type best_score() const {
+    return m_scores.front();
+  }
 
   // Fuzzy size limit.
   size_type max_size() const {
@@ -52,16 +87,27 @@ public:
     return size() <= m_maxSize;
   }
 
-  // This push is somewhat inefficient as it iterates through the
-  // whole container to see if the address already exists.
-  void push_back(const utils::socket_address* sa);
+  // Ranks by source and the history in 'peerInfo', which may be
+  // NULL. Failed handshakes back off exponentially from the last
+  // attempt, and the low bits are random to spread equal candidates.
+  static score_type score(const PeerInfo* peerInfo,
+                          int             source = source_unknown,
+                          uint32_t        now    = 0);
+
+  // Returns false if the address already exists or isn't an inet
+  // address.
+  bool push_back(const utils::socket_address* sa,
+                 score_type                   value = score(nullptr));
+
+  // Bulk insertion, returns the number of new addresses. Each address
+  // is scored separately so that ties are broken randomly.
+  size_type insert(const AddressList* l, int source = source_unknown);
+
+  // Does nothing if the address isn't in the list.
+  void update(const utils::socket_address& sa, score_type value);
 
-  void insert(AddressList* l);
   void erase(const utils::socket_address& sa);
-  void erase(iterator itr) {
-    *itr = back();
-    pop_back();
-  }
+  void erase(iterator itr);
 
   // A place to temporarily put addresses before re-adding them to the
   // AvailableList.
@@ -70,8 +116,15 @@ public:
   }
 
 private:
+  void      swap_positions(size_type a, size_type b);
+  // Returns the new position.
+  size_type sift_up(size_type pos);
+  void      sift_down(size_type pos);
+
   size_type m_maxSize{ 1000 };
 
+  std::vector<score_type> m_scores;
+  index_type              m_index;
   AddressList m_buffer;
 };
 
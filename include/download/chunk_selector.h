@@ -10,6 +10,7 @@
 #include "torrent/data/download_data.h"
 #include "torrent/utils/partial_queue.h"
 #include "torrent/utils/ranges.h"
+#include "torrent/utils/timer.h"
 
 namespace torrent {
 
@@ -58,6 +59,39 @@ public:
     m_sequential = enabled;
   };
 
+  // Deadline mode for streaming. The 'window' chunks from 'playhead'
+  // get deadlines 'interval_ms' apart, starting now, and are picked
+  // ahead of everything else. A zero window disables it.
+  bool is_deadline_enabled() const {
+    return m_deadlineWindow != 0;
+  }
+  uint32_t deadline_playhead() const {
+    return m_deadlinePlayhead;
+  }
+  uint32_t deadline_window() const {
+    return m_deadlineWindow;
+  }
+
+  void set_deadline(uint32_t playhead, uint32_t window, uint32_t interval_ms);
+
+  // Returns a zero timer if 'index' is outside the window.
+  utils::timer deadline(uint32_t index) const;
+
+  // The earliest wanted chunk in the window that the peer has and is
+  // not being downloaded.
+  uint32_t find_deadline(PeerChunks* pc) const;
+
+  // Call when a chunk passed the hash check to count missed deadlines
+  // and the time playback would have stalled.
+  void received_deadline_chunk(uint32_t index);
+
+  uint32_t deadline_misses() const {
+    return m_deadlineMisses;
+  }
+  uint64_t deadline_stall_usec() const {
+    return m_deadlineStall;
+  }
+
   // Call this once you've modified the bitfield or priorities to
   // update cached information. This must be called once before using
   // find.
@@ -112,6 +146,15 @@ private:
   uint32_t m_position;
 
   bool m_sequential = false;
+
+  uint32_t     m_deadlinePlayhead{ 0 };
+  uint32_t     m_deadlineWindow{ 0 };
+  utils::timer m_deadlineStart;
+  utils::timer m_deadlineInterval;
+
+  uint32_t     m_deadlineMisses{ 0 };
+  uint64_t     m_deadlineStall{ 0 };
+  utils::timer m_deadlineStalledTo;
 };
 
 } // namespace torrent
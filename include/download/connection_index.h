@@ -0,0 +1,67 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2005-2011, Jari Sundell <jaris@ifi.uio.no>
+
+#ifndef LIBTORRENT_DOWNLOAD_CONNECTION_INDEX_H
+#define LIBTORRENT_DOWNLOAD_CONNECTION_INDEX_H
+
+#include <cinttypes>
+#include <unordered_map>
+
+#include "torrent/hash_string.h"
+#include "torrent/net/socket_address_key.h"
+
+namespace torrent {
+
+class Peer;
+
+// Hash indexes on the peer id and address of the connections in a
+// ConnectionList, and the position of each connection in the list.
+//
+// The keys are copied on insert so that erase does not depend on the
+// peer info still being intact. Positions are only a hint as the list
+// may be reordered without the index knowing, the caller must check
+// them.
+class ConnectionIndex {
+public:
+  using size_type = uint32_t;
+
+  static constexpr size_type npos = ~size_type();
+
+  size_type size() const {
+    return m_entries.size();
+  }
+
+  void insert(Peer* peer, const HashString& id, const sockaddr* sa,
+              size_type position);
+  void erase(Peer* peer);
+  void clear();
+
+  Peer* find(const HashString& id) const;
+
+  // Matches the port as well as the address.
+  Peer* find(const sockaddr* sa) const;
+
+  size_type position(Peer* peer) const;
+  void      set_position(Peer* peer, size_type position);
+
+private:
+  struct entry_type {
+    size_type          position;
+    HashString         id;
+    socket_address_key key;
+    const sockaddr*    address;
+  };
+
+  using entry_map = std::unordered_map<Peer*, entry_type>;
+  using id_map    = std::unordered_multimap<HashString, Peer*>;
+  using address_map =
+    std::unordered_multimap<socket_address_key, Peer*, socket_address_key_hash>;
+
+  entry_map   m_entries;
+  id_map      m_ids;
+  address_map m_addresses;
+};
+
+} // namespace torrent
+
+#endif
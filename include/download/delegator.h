@@ -9,6 +9,7 @@
 #include <vector>
 
 #include "torrent/data/transfer_list.h"
+#include "torrent/utils/timer.h"
 
 namespace torrent {
 
@@ -23,9 +24,18 @@ class Delegator {
 public:
   using slot_peer_chunk = std::function<uint32_t(PeerChunks*, bool)>;
   using slot_size       = std::function<uint32_t(uint32_t)>;
+  using slot_peer_index = std::function<uint32_t(PeerChunks*)>;
+  using slot_peer_bool  = std::function<bool(PeerChunks*)>;
+  using slot_deadline   = std::function<utils::timer(uint32_t)>;
 
   static constexpr unsigned int block_size = 1 << 14;
 
+  // Blocks of pieces with a deadline get requested again from
+  // another peer when no request was made in this many seconds, up
+  // to 'deadline_max_requests' per block.
+  static constexpr int32_t  deadline_timeout      = 2;
+  static constexpr uint32_t deadline_max_requests = 3;
+
   TransferList* transfer_list() {
     return &m_transfers;
   }
@@ -35,6 +45,23 @@ public:
 
   BlockTransfer* delegate(PeerChunks* peerChunks, int affinity);
 
+  // Bounds on the requests queued per peer when sized from the
+  // measured round trip, see RequestList::calculate_pipe_size. A zero
+  // maximum sizes from the download rate alone.
+  static constexpr uint32_t default_pipe_min = 16;
+  static constexpr uint32_t default_pipe_max = 1024;
+
+  uint32_t pipe_min() const {
+    return m_pipe_min;
+  }
+  uint32_t pipe_max() const {
+    return m_pipe_max;
+  }
+  void set_pipe_bounds(uint32_t min, uint32_t max) {
+    m_pipe_min = min;
+    m_pipe_max = max;
+  }
+
   bool get_aggressive() {
     return m_aggressive;
   }
@@ -42,34 +69,77 @@ public:
     m_aggressive = a;
   }
 
+  // When enabled, pieces with a deadline are handed to fast peers
+  // first, earliest deadline first, and kept from slow peers. Must be
+  // called again whenever the deadlines change.
+  bool is_deadline_enabled() const {
+    return m_deadline;
+  }
+  void set_deadline_enabled(bool state) {
+    m_deadline = state;
+    m_deadlineOrder.clear();
+    m_deadlineValid = false;
+  }
+
   slot_peer_chunk& slot_chunk_find() {
     return m_slot_chunk_find;
   }
   slot_size& slot_chunk_size() {
     return m_slot_chunk_size;
   }
+  slot_peer_index& slot_chunk_find_deadline() {
+    return m_slot_chunk_find_deadline;
+  }
+  slot_deadline& slot_chunk_deadline() {
+    return m_slot_chunk_deadline;
+  }
+  slot_peer_bool& slot_peer_fast() {
+    return m_slot_peer_fast;
+  }
 
   // Don't call this from the outside.
   Block* delegate_piece(BlockList* c, const PeerInfo* peerInfo);
   Block* delegate_aggressive(BlockList*      c,
                              uint16_t*       overlapped,
                              const PeerInfo* peerInfo);
+  Block* delegate_timed_out(BlockList* c, const PeerInfo* peerInfo);
 
 private:
   // Start on a new chunk, returns .end() if none possible. bf is
   // remote peer's bitfield.
-  Block* new_chunk(PeerChunks* pc, bool highPriority);
+  Block* new_chunk(PeerChunks* pc, bool highPriority, bool slow);
+  Block* insert_chunk(PeerChunks* pc, uint32_t index, bool highPriority);
+
+  Block* delegate_deadline(PeerChunks* peerChunks);
+
+  bool is_deadline(const BlockList* blockList) const;
 
-  Block* delegate_seeder(PeerChunks* peerChunks);
+  void update_deadline_order();
+
+  Block* delegate_seeder(PeerChunks* peerChunks, bool slow);
 
   TransferList m_transfers;
 
   bool m_aggressive{ false };
+  bool m_deadline{ false };
+
+  uint32_t m_pipe_min{ default_pipe_min };
+  uint32_t m_pipe_max{ default_pipe_max };
+
+  // Transfers with a deadline, earliest first. Rebuilt only when the
+  // transfer list or the deadlines have changed.
+  std::vector<std::pair<utils::timer, BlockList*>> m_deadlineOrder;
+
+  bool     m_deadlineValid{ false };
+  uint32_t m_deadlineVersion{ 0 };
 
   // Propably should add a m_slotChunkStart thing, which will take
   // care of enabling etc, and will be possible to listen to.
   slot_peer_chunk m_slot_chunk_find;
   slot_size       m_slot_chunk_size;
+  slot_peer_index m_slot_chunk_find_deadline;
+  slot_deadline   m_slot_chunk_deadline;
+  slot_peer_bool  m_slot_peer_fast;
 };
 
 } // namespace torrent
@@ -6,10 +6,12 @@
 
 #include <deque>
 #include <utility>
+#include <vector>
 
 #include "data/chunk_handle.h"
 #include "delegator.h"
 #include "download/available_list.h"
+#include "download/have_queue.h"
 #include "globals.h"
 #include "net/data_buffer.h"
 #include "torrent/data/file_list.h"
@@ -35,7 +37,7 @@ class InitialSeeding;
 
 class DownloadMain {
 public:
-  using have_queue_type = std::deque<std::pair<utils::timer, uint32_t>>;
+  using have_queue_type = HaveQueue;
   using pex_list        = std::vector<SocketAddressCompact>;
 
   DownloadMain();
@@ -99,6 +101,11 @@ public:
   FileList* file_list() {
     return &m_fileList;
   }
+
+  // Peers that announce HAVE_ALL share this bitfield rather than each
+  // allocating their own.
+  const Bitfield* seed_bitfield();
+
   PeerList* peer_list() {
     return &m_peerList;
   }
@@ -130,6 +137,12 @@ public:
     return (initial ? m_ut_pex_initial : m_ut_pex_delta).clone();
   }
 
+  // Encoded ut_metadata data messages indexed by metadata piece, built
+  // on first request and shared by all peers.
+  std::vector<DataBuffer>* ut_metadata_pieces() {
+    return &m_ut_metadata_pieces;
+  }
+
   bool want_pex_msg() {
     return m_info->is_pex_active() && m_peerList.available_list()->want_more();
   };
@@ -249,11 +262,14 @@ private:
   ConnectionList* m_connectionList;
   FileList        m_fileList;
   PeerList        m_peerList;
+  Bitfield        m_seedBitfield;
 
   DataBuffer m_ut_pex_delta;
   DataBuffer m_ut_pex_initial;
   pex_list   m_ut_pex_list;
 
+  std::vector<DataBuffer> m_ut_metadata_pieces;
+
   ThrottleList* m_uploadThrottle;
   ThrottleList* m_downloadThrottle;
 
@@ -0,0 +1,65 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2005-2011, Jari Sundell <jaris@ifi.uio.no>
+
+#ifndef LIBTORRENT_DOWNLOAD_HAVE_QUEUE_H
+#define LIBTORRENT_DOWNLOAD_HAVE_QUEUE_H
+
+#include <cinttypes>
+#include <vector>
+
+#include "torrent/utils/timer.h"
+
+namespace torrent {
+
+// Completed chunks waiting to be announced to peers, kept in
+// completion order as pre-encoded HAVE messages. A peer that has seen
+// everything up to some point in time appends the remaining messages
+// to its write buffer with a single copy.
+//
+// Timestamps are strictly increasing, which allows peers to track
+// their position in the queue with PeerChunks::have_timer().
+class HaveQueue {
+public:
+  using size_type = uint32_t;
+
+  static constexpr size_type message_size = 9;
+
+  bool empty() const {
+    return m_times.size() == m_begin;
+  }
+  size_type size() const {
+    return m_times.size() - m_begin;
+  }
+
+  utils::timer back_time() const {
+    return m_times.back();
+  }
+
+  // Returns the position of the first message queued at or after
+  // 't', or size() if there are none.
+  size_type find(utils::timer t) const;
+
+  utils::timer time_at(size_type pos) const {
+    return m_times[m_begin + pos];
+  }
+  const char* message_at(size_type pos) const {
+    return m_messages.data() + (m_begin + pos) * message_size;
+  }
+
+  void push_back(utils::timer t, uint32_t index);
+
+  // Remove all messages queued at or before 't'.
+  void prune(utils::timer t);
+
+  void clear();
+
+private:
+  size_type m_begin{ 0 };
+
+  std::vector<utils::timer> m_times;
+  std::vector<char>         m_messages;
+};
+
+} // namespace torrent
+
+#endif
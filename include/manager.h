@@ -14,6 +14,7 @@ namespace torrent {
 class Poll;
 
 class HashQueue;
+class HashScheduler;
 class HandshakeManager;
 class DownloadManager;
 class DownloadWrapper;
@@ -45,6 +46,9 @@ public:
   HashQueue* hash_queue() {
     return m_hashQueue;
   }
+  HashScheduler* hash_scheduler() {
+    return m_hashScheduler;
+  }
   ResourceManager* resource_manager() {
     return m_resourceManager;
   }
@@ -88,6 +92,7 @@ public:
   void cleanup_download(DownloadWrapper* d);
 
   void receive_tick();
+  void receive_memory_governor();
 
 private:
   thread_main m_main_thread_main;
@@ -97,6 +102,7 @@ private:
   FileManager*      m_fileManager;
   HandshakeManager* m_handshakeManager;
   HashQueue*        m_hashQueue;
+  HashScheduler*    m_hashScheduler;
   ResourceManager*  m_resourceManager;
 
   ChunkManager*      m_chunkManager;
@@ -110,6 +116,7 @@ private:
   EncodingList m_encodingList;
 
   utils::priority_item m_taskTick;
+  utils::priority_item m_taskMemoryGovernor;
   unsigned int         m_ticks{ 0 };
 };
 
@@ -9,22 +9,26 @@
 
 namespace torrent {
 
-// Recipient must call clear() when done with the buffer.
+// Reference-counted message buffer. Copies share the underlying
+// storage, so a message encoded once may be queued on any number of
+// peer connections. The storage is freed when the last reference is
+// cleared.
+//
+// The contents must be treated as immutable unless owned() returns
+// true, i.e. this is the only reference to the storage.
 struct DataBuffer {
   DataBuffer() = default;
   DataBuffer(char* data, char* end)
-    : m_data(data)
-    , m_end(end)
-    , m_owned(true) {}
+    : m_storage(data, std::default_delete<char[]>())
+    , m_data(data)
+    , m_end(end) {}
 
   DataBuffer clone() const {
-    DataBuffer d = *this;
-    d.m_owned    = false;
-    return d;
+    return *this;
   }
   DataBuffer release() {
-    DataBuffer d = *this;
-    set(nullptr, nullptr, false);
+    DataBuffer d = std::move(*this);
+    clear();
     return d;
   }
 
@@ -36,7 +40,7 @@ struct DataBuffer {
   }
 
   bool owned() const {
-    return m_owned;
+    return m_storage.use_count() == 1;
   }
   bool empty() const {
     return m_data == nullptr;
@@ -46,31 +50,24 @@ struct DataBuffer {
   }
 
   void clear();
-  void set(char* data, char* end, bool owned);
+
+  // Only valid on an owned buffer, used when appending data after the
+  // initially written part.
+  void set_end(char* end) {
+    m_end = end;
+  }
 
 private:
+  std::shared_ptr<char> m_storage;
+
   char* m_data{ nullptr };
   char* m_end{ nullptr };
-
-  // Used to indicate if buffer held by PCB is its own and needs to be
-  // deleted after transmission (false if shared with other connections).
-  bool m_owned{ true };
 };
 
 inline void
 DataBuffer::clear() {
-  if (!empty() && m_owned)
-    delete[] m_data;
-
+  m_storage.reset();
   m_data = m_end = nullptr;
-  m_owned        = false;
-}
-
-inline void
-DataBuffer::set(char* data, char* end, bool owned) {
-  m_data  = data;
-  m_end   = end;
-  m_owned = owned;
 }
 
 } // namespace torrent
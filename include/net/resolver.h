@@ -0,0 +1,165 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2005-2011, Jari Sundell <jaris@ifi.uio.no>
+
+#ifndef LIBTORRENT_NET_RESOLVER_H
+#define LIBTORRENT_NET_RESOLVER_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+
+#include "torrent/connection_manager.h"
+#include "torrent/utils/socket_address.h"
+#include "torrent/utils/timer.h"
+
+namespace torrent {
+
+// Default implementation of ConnectionManager::resolver().
+//
+// Lookups are done by a small pool of worker threads and the results
+// delivered on the main thread through work(). Concurrent requests
+// for the same host are coalesced into a single lookup, and results
+// are cached; getaddrinfo does not expose record TTLs, so successful
+// and failed lookups are kept for fixed, configurable periods.
+class Resolver {
+public:
+  using result_slot = ConnectionManager::slot_resolver_result_type;
+  using slot_void   = std::function<void()>;
+  using slot_lookup =
+    std::function<int(const char*, int, int, utils::socket_address*)>;
+
+  static constexpr unsigned int default_max_workers  = 4;
+  static constexpr unsigned int default_ttl          = 5 * 60;
+  static constexpr unsigned int default_negative_ttl = 30;
+
+  // Expired entries are dropped first once the cache is full.
+  static constexpr unsigned int max_cache_size = 1024;
+
+  Resolver();
+  ~Resolver();
+
+  Resolver(const Resolver&)            = delete;
+  Resolver& operator=(const Resolver&) = delete;
+
+  unsigned int max_workers() const {
+    return m_maxWorkers;
+  }
+  void set_max_workers(unsigned int v) {
+    m_maxWorkers = std::max(v, 1u);
+  }
+
+  unsigned int ttl() const {
+    return m_ttl;
+  }
+  void set_ttl(unsigned int seconds) {
+    m_ttl = seconds;
+  }
+
+  unsigned int negative_ttl() const {
+    return m_negativeTtl;
+  }
+  void set_negative_ttl(unsigned int seconds) {
+    m_negativeTtl = seconds;
+  }
+
+  size_t cache_size() const {
+    return m_cache.size();
+  }
+  size_t pending_size() const {
+    return m_requests.size();
+  }
+
+  // Number of lookups handed to the workers.
+  uint64_t lookups() const {
+    return m_lookups;
+  }
+
+  // Main thread functions.
+  //
+  // Cached results are delivered before returning NULL, otherwise the
+  // returned slot may be cleared by the caller to block the result.
+  result_slot* resolve(const char*        host,
+                       int                family,
+                       int                socktype,
+                       const result_slot& slot);
+
+  void clear_cache();
+
+  // Deliver completed lookups and update the cache.
+  void work();
+
+  // Called from the worker threads when there are results for
+  // work(). Must be set before the first resolve.
+  slot_void& slot_has_work() {
+    return m_shared->has_work;
+  }
+
+  // Defaults to getaddrinfo, replaceable for testing. Called from the
+  // worker threads.
+  slot_lookup& slot_lookup_host() {
+    return m_shared->lookup;
+  }
+
+private:
+  using key_type = std::tuple<std::string, int, int>;
+
+  struct cache_entry {
+    utils::socket_address address;
+    int                   error;
+    utils::timer          expires;
+  };
+
+  // The slots are kept in a list as the caller holds on to pointers
+  // to them.
+  struct request {
+    std::list<result_slot> slots;
+  };
+
+  struct job {
+    key_type              key;
+    utils::socket_address address;
+    int                   error;
+  };
+
+  // Shared with the worker threads, which are detached so that a
+  // hanging lookup does not block shutdown.
+  struct shared_type {
+    std::mutex              lock;
+    std::condition_variable cond;
+
+    std::deque<job> pending;
+    std::deque<job> done;
+
+    unsigned int workers{ 0 };
+    unsigned int idle{ 0 };
+    bool         shutdown{ false };
+
+    slot_void   has_work;
+    slot_lookup lookup;
+  };
+
+  static void perform(std::shared_ptr<shared_type> shared);
+
+  void insert_cache(const key_type& key, const job& result);
+
+  std::shared_ptr<shared_type> m_shared;
+
+  std::map<key_type, cache_entry> m_cache;
+  std::map<key_type, request>     m_requests;
+
+  unsigned int m_maxWorkers{ default_max_workers };
+  unsigned int m_ttl{ default_ttl };
+  unsigned int m_negativeTtl{ default_negative_ttl };
+  uint64_t     m_lookups{ 0 };
+};
+
+} // namespace torrent
+
+#endif
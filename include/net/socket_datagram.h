@@ -5,11 +5,29 @@
 #define LIBTORRENT_NET_SOCKET_DGRAM_H
 
 #include "socket_base.h"
+#include "torrent/utils/socket_address.h"
 
 namespace torrent {
 
 class SocketDatagram : public SocketBase {
 public:
+  // Maximum number of datagrams transferred by a single batched call.
+  static constexpr unsigned int max_batch = 32;
+
+  struct read_entry {
+    void*                 buffer;
+    unsigned int          length;
+    utils::socket_address address;
+    int                   read;
+  };
+
+  struct write_entry {
+    const void*                  buffer;
+    unsigned int                 length;
+    const utils::socket_address* address;
+    int                          written;
+  };
+
   // TODO: Make two seperate functions depending on whetever sa is
   // used.
   int read_datagram(void*                  buffer,
@@ -18,6 +36,16 @@ public:
   int write_datagram(const void*            buffer,
                      unsigned int           length,
                      utils::socket_address* sa = nullptr);
+
+  // Batched versions using recvmmsg and sendmmsg where available,
+  // transferring up to max_batch datagrams per system call.
+  //
+  // Returns the number of datagrams read, or -1 if none were.
+  int read_datagrams(read_entry* entries, unsigned int count);
+
+  // Attempts to send every entry, setting 'written' to the result of
+  // each. A failed datagram doesn't stop the rest of the batch.
+  void write_datagrams(write_entry* entries, unsigned int count);
 };
 
 } // namespace torrent
@@ -13,6 +13,8 @@ struct sockaddr;
 
 namespace torrent {
 
+struct tcp_stats;
+
 class SocketFd {
 public:
   using priority_type = uint8_t;
@@ -44,6 +46,14 @@ public:
   bool set_send_buffer_size(uint32_t s);
   bool set_receive_buffer_size(uint32_t s);
 
+  // Limit unsent data in the send buffer, the socket only polls as
+  // writable once below 's' bytes. Returns false where unsupported.
+  bool set_notsent_lowat(uint32_t s);
+
+  // Fills 'stats' from TCP_INFO, except for the sample time. Returns
+  // false where unsupported.
+  bool get_tcp_stats(tcp_stats* stats) const;
+
   int get_error() const;
 
   bool open_stream();
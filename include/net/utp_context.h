@@ -0,0 +1,125 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2005-2011, Jari Sundell <jaris@ifi.uio.no>
+
+#ifndef LIBTORRENT_NET_UTP_CONTEXT_H
+#define LIBTORRENT_NET_UTP_CONTEXT_H
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "net/socket_datagram.h"
+#include "net/socket_fd.h"
+#include "torrent/net/socket_address_key.h"
+#include "torrent/utils/priority_queue_default.h"
+#include "torrent/utils/socket_address.h"
+
+namespace torrent {
+
+class UtpStream;
+
+// Carries uTP connections over a single datagram socket, normally
+// bound to the same port as the TCP listener.
+//
+// Each connection is exposed to the rest of the library as one end
+// of a local stream socket pair, with the other end relayed to and
+// from the uTP socket. Handshakes and peer connections thus work on
+// uTP connections without knowing about them, at the cost of a copy
+// through the socket pair.
+class UtpContext : public SocketDatagram {
+public:
+  using slot_connection =
+    std::function<void(SocketFd, const utils::socket_address&)>;
+  using slot_bool = std::function<bool()>;
+
+  // Called once with the local end of the connection, or with an
+  // invalid fd and the error if connecting failed.
+  using slot_connect_result = std::function<void(SocketFd, int)>;
+
+  static constexpr unsigned int read_buffer_size = 2048;
+  static constexpr unsigned int max_output_queue = 4096;
+  static constexpr int64_t      tick_interval    = 100000;
+
+  UtpContext();
+  ~UtpContext() override;
+
+  UtpContext(const UtpContext&)            = delete;
+  UtpContext& operator=(const UtpContext&) = delete;
+
+  bool open(const utils::socket_address* bindAddress, uint16_t port);
+  void close();
+
+  bool is_open() const {
+    return get_fd().is_valid();
+  }
+
+  size_t size() const {
+    return m_streams.size();
+  }
+
+  slot_connection& slot_accepted() {
+    return m_slot_accepted;
+  }
+
+  // Checked before accepting a connection, so that no socket pair is
+  // opened for a SYN that the handshake admission would refuse.
+  slot_bool& slot_can_accept() {
+    return m_slot_can_accept;
+  }
+
+  // The returned stream is owned by the context, and is only valid
+  // until the result slot has been called or the attempt cancelled.
+  UtpStream* connect(const utils::socket_address& sa,
+                     slot_connect_result          slot);
+  void       cancel(UtpStream* stream);
+
+  void event_read() override;
+  void event_write() override;
+  void event_error() override;
+
+  // Used by the streams.
+  void send_packet(const utils::socket_address& sa,
+                   const char*                  data,
+                   unsigned int                 length);
+  void flush_output();
+  void finished(UtpStream* stream);
+
+private:
+  using stream_key = std::tuple<socket_address_key, uint16_t, uint16_t>;
+  using stream_map = std::map<stream_key, std::unique_ptr<UtpStream>>;
+
+  static stream_key make_key(const utils::socket_address& sa, uint16_t id);
+
+  void process_packet(const char*                  data,
+                      unsigned int                 length,
+                      const utils::socket_address& sa);
+  void accept_stream(const char*                  data,
+                     unsigned int                 length,
+                     const utils::socket_address& sa);
+
+  stream_map::iterator find_stream(const utils::socket_address& sa,
+                                   uint8_t                      type,
+                                   uint16_t                     id);
+
+  void start_tick();
+  void receive_tick();
+
+  stream_map                               m_streams;
+  std::vector<std::unique_ptr<UtpStream>> m_finished;
+
+  std::deque<std::pair<utils::socket_address, std::string>> m_output;
+
+  std::vector<char>    m_readBuffer;
+  utils::priority_item m_taskTick;
+
+  slot_connection m_slot_accepted;
+  slot_bool       m_slot_can_accept;
+};
+
+} // namespace torrent
+
+#endif
@@ -0,0 +1,257 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2005-2011, Jari Sundell <jaris@ifi.uio.no>
+
+#ifndef LIBTORRENT_NET_UTP_SOCKET_H
+#define LIBTORRENT_NET_UTP_SOCKET_H
+
+#include <cinttypes>
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+
+namespace torrent {
+
+// Micro Transport Protocol (BEP 29) connection state, independent of
+// the datagram socket carrying it. Packets are passed in through
+// receive() and handed out through the send slot, and every call
+// takes the time in microseconds so the protocol can be driven by a
+// simulated clock.
+//
+// Congestion control is LEDBAT: the window grows while the one-way
+// queueing delay reported by the peer stays below 'target_delay' and
+// shrinks once it rises above, so uTP yields to competing TCP flows.
+// Selective acks are neither sent nor used; losses are recovered
+// through three duplicate acks, partial acks during recovery and the
+// retransmission timeout.
+class UtpSocket {
+public:
+  using slot_send = std::function<void(const char*, unsigned int)>;
+
+  static constexpr uint8_t st_data  = 0;
+  static constexpr uint8_t st_fin   = 1;
+  static constexpr uint8_t st_state = 2;
+  static constexpr uint8_t st_reset = 3;
+  static constexpr uint8_t st_syn   = 4;
+
+  static constexpr uint8_t version = 1;
+
+  enum state_type {
+    state_idle,
+    state_syn_sent,
+    state_connected,
+    state_closed,
+  };
+
+  static constexpr unsigned int header_size  = 20;
+  static constexpr unsigned int packet_size  = 1400;
+  static constexpr unsigned int payload_size = packet_size - header_size;
+
+  // Bytes buffered in each direction, also the largest window.
+  static constexpr uint32_t buffer_size = 1 << 20;
+
+  static constexpr uint32_t target_delay      = 100000;
+  static constexpr uint32_t max_cwnd_increase = 3000;
+  static constexpr uint32_t min_window        = payload_size;
+
+  static constexpr uint32_t initial_timeout = 1000000;
+  static constexpr uint32_t min_timeout     = 500000;
+  static constexpr uint32_t max_timeout     = 30000000;
+
+  static constexpr unsigned int max_retries = 8;
+
+  // Connecting gives up after 3.5 seconds, as the peer may only
+  // support TCP and has to wait for the uTP attempt to fail.
+  static constexpr uint32_t     syn_timeout     = 500000;
+  static constexpr unsigned int max_syn_retries = 2;
+
+  // The delay base is the lowest sample over the current and the
+  // previous minute, following changes in the clock offset and
+  // route.
+  static constexpr uint64_t delay_base_interval = 60000000;
+
+  struct header {
+    uint8_t  type;
+    uint16_t connection_id;
+    uint32_t timestamp;
+    uint32_t timestamp_difference;
+    uint32_t wnd_size;
+    uint16_t seq_nr;
+    uint16_t ack_nr;
+  };
+
+  // Returns the offset of the payload, or zero if the packet is not
+  // a valid uTP packet. Extensions are skipped.
+  static unsigned int read_header(const char* data,
+                                  unsigned int length,
+                                  header*      h);
+  static void         write_header(char* data, const header& h);
+
+  state_type state() const {
+    return m_state;
+  }
+  bool is_connected() const {
+    return m_state == state_connected;
+  }
+  bool is_closed() const {
+    return m_state == state_closed;
+  }
+
+  // Zero, ECONNRESET or ETIMEDOUT once closed.
+  int error() const {
+    return m_error;
+  }
+
+  // The peer has finished sending and everything has been read.
+  bool is_eof() const {
+    return m_remoteFin && read_size() == 0;
+  }
+
+  uint16_t recv_id() const {
+    return m_recvId;
+  }
+  uint16_t send_id() const {
+    return m_sendId;
+  }
+
+  uint32_t cwnd() const {
+    return m_cwnd;
+  }
+  uint32_t rtt_usec() const {
+    return m_rtt;
+  }
+  uint32_t queue_delay() const {
+    return m_queueDelay;
+  }
+  uint32_t bytes_in_flight() const {
+    return m_inFlight;
+  }
+  uint32_t retransmits() const {
+    return m_retransmits;
+  }
+
+  slot_send& slot_send_packet() {
+    return m_slotSend;
+  }
+
+  void connect(uint16_t recv_id, uint64_t now);
+  void accept(const header& syn, uint64_t now);
+
+  void receive(const header& h,
+               const char*   payload,
+               unsigned int  length,
+               uint64_t      now);
+
+  // Buffers up to 'length' bytes for sending, returning the number
+  // accepted.
+  unsigned int write(const char* data, unsigned int length);
+  uint32_t     write_space() const;
+
+  // Received data is read in place and then consumed.
+  const char* read_data() const {
+    return m_readBuffer.data() + m_readOffset;
+  }
+  uint32_t read_size() const {
+    return m_readBuffer.size() - m_readOffset;
+  }
+  void consume(uint32_t length);
+
+  // Send a FIN once the buffered data has been sent.
+  void close();
+
+  // Send a reset and close right away.
+  void reset(uint64_t now);
+
+  // Transmit whatever the windows allow, and any pending ack.
+  void flush(uint64_t now);
+
+  // Handles retransmission and linger timeouts.
+  void tick(uint64_t now);
+
+private:
+  struct packet {
+    uint8_t     type;
+    uint16_t    seq_nr;
+    std::string payload;
+    uint64_t    sent{ 0 };
+    uint32_t    transmissions{ 0 };
+    bool        pending{ true };
+  };
+
+  uint32_t receive_window() const;
+
+  void transmit(packet& p, uint64_t now);
+  void send_state(uint64_t now);
+  void close_with(int error);
+
+  void receive_ack(const header& h, uint64_t now);
+  void receive_payload(const header& h,
+                       const char*   payload,
+                       unsigned int  length);
+  void check_finished();
+
+  void update_rtt(uint32_t sample);
+  void update_delay_base(uint32_t delay, uint64_t now);
+  void update_window(uint32_t acked, bool limited);
+
+  state_type m_state{ state_idle };
+  int        m_error{ 0 };
+
+  uint16_t m_recvId{ 0 };
+  uint16_t m_sendId{ 0 };
+  uint16_t m_seqNr{ 0 };
+  uint16_t m_ackNr{ 0 };
+
+  // Timing reply for the peer's delay measurement.
+  uint32_t m_replyMicro{ 0 };
+
+  // Sent packets waiting for an ack, and those marked for resending
+  // after a timeout. Only transmitted bytes count as in flight.
+  std::deque<packet> m_outstanding;
+  uint32_t           m_outstandingSize{ 0 };
+  uint32_t           m_inFlight{ 0 };
+
+  std::string m_sendBuffer;
+  uint32_t    m_sendOffset{ 0 };
+
+  std::string                     m_readBuffer;
+  uint32_t                        m_readOffset{ 0 };
+  std::map<uint16_t, std::string> m_reorder;
+  uint32_t                        m_reorderSize{ 0 };
+
+  bool     m_needAck{ false };
+  bool     m_finPending{ false };
+  bool     m_finSent{ false };
+  bool     m_remoteFin{ false };
+  uint16_t m_remoteFinSeq{ 0 };
+  bool     m_remoteFinSeen{ false };
+
+  uint32_t m_peerWindow{ min_window };
+  uint32_t m_cwnd{ 2 * min_window };
+  bool     m_slowStart{ true };
+
+  uint16_t     m_lastAck{ 0 };
+  unsigned int m_dupAcks{ 0 };
+  bool         m_recovery{ false };
+  uint16_t     m_recoverySeq{ 0 };
+
+  uint32_t m_rtt{ 0 };
+  uint32_t m_rttVar{ 0 };
+  uint32_t m_timeout{ initial_timeout };
+  uint64_t m_timeoutAt{ 0 };
+  uint32_t m_timeouts{ 0 };
+  uint32_t m_retransmits{ 0 };
+
+  uint32_t m_delayBase{ 0 };
+  uint32_t m_delayBaseCurrent{ 0 };
+  uint32_t m_delayBasePrevious{ 0 };
+  uint64_t m_delayBaseStart{ 0 };
+  bool     m_hasDelayBase{ false };
+  uint32_t m_queueDelay{ 0 };
+
+  slot_send m_slotSend;
+};
+
+} // namespace torrent
+
+#endif
@@ -0,0 +1,29 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2005-2011, Jari Sundell <jaris@ifi.uio.no>
+
+#ifndef LIBTORRENT_PROTOCOL_FAST_EXTENSION_H
+#define LIBTORRENT_PROTOCOL_FAST_EXTENSION_H
+
+#include <cinttypes>
+#include <vector>
+
+#include <sys/socket.h>
+
+namespace torrent {
+
+// Number of chunks a new peer may request while choked, and the
+// number of chunks it may have before it no longer counts as new.
+constexpr uint32_t allowed_fast_count = 10;
+
+// The canonical allowed fast set of BEP 6, derived from the /24
+// network of the peer and the info hash so that reconnecting from a
+// neighbouring address yields the same chunks. IPv6 peers, which the
+// canonical algorithm does not cover, get an empty set.
+std::vector<uint32_t> allowed_fast_set(const sockaddr* sa,
+                                       const char*     hash,
+                                       uint32_t        size_chunks,
+                                       uint32_t        count);
+
+} // namespace torrent
+
+#endif
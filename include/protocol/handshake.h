@@ -11,6 +11,7 @@
 #include "torrent/bitfield.h"
 #include "torrent/peer/peer_info.h"
 #include "torrent/utils/priority_queue_default.h"
+#include "utils/diffie_hellman_pool.h"
 #include "utils/sha1.h"
 
 namespace torrent {
@@ -26,6 +27,8 @@ public:
 
   static constexpr uint32_t protocol_bitfield  = 5;
   static constexpr uint32_t protocol_port      = 9;
+  static constexpr uint32_t protocol_have_all  = 14;
+  static constexpr uint32_t protocol_have_none = 15;
   static constexpr uint32_t protocol_extension = 20;
 
   static constexpr uint32_t enc_negotiation_size = 8 + 4 + 2;
@@ -47,6 +50,7 @@ public:
     PROXY_DONE,
 
     READ_ENC_KEY,
+    READ_ENC_SECRET,
     READ_ENC_SYNC,
     READ_ENC_SKEY,
     READ_ENC_NEGOT,
@@ -122,6 +126,10 @@ public:
   void event_write() override;
   void event_error() override;
 
+  // Called on the main thread when the shared secret computed by the
+  // worker thread is ready.
+  void receive_secret(DiffieHellmanPool::key_ptr key, bool result);
+
   HandshakeEncryption* encryption() {
     return &m_encryption;
   }
@@ -155,10 +163,12 @@ protected:
 
   void prepare_proxy_connect();
   void prepare_key_plus_pad();
+  void prepare_encryption_sync();
   void prepare_enc_negotiation();
   void prepare_handshake();
   void prepare_peer_info();
   void prepare_bitfield();
+  void prepare_have_all(bool s);
   void prepare_post_handshake(bool must_write);
 
   void write_extension_handshake();
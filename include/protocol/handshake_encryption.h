@@ -50,6 +50,17 @@ public:
   DiffieHellman* key() {
     return m_key;
   }
+
+  // Used to hand the key to the worker thread while it computes the
+  // shared secret.
+  DiffieHellman* release_key() {
+    DiffieHellman* key = m_key;
+    m_key              = nullptr;
+    return key;
+  }
+  void set_key(DiffieHellman* key) {
+    m_key = key;
+  }
   EncryptionInfo* info() {
     return &m_info;
   }
@@ -4,11 +4,14 @@
 #include <cinttypes>
 #include <functional>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "net/socket_fd.h"
 #include "torrent/connection_manager.h"
+#include "torrent/net/socket_address_key.h"
 #include "torrent/utils/socket_address.h"
-#include "torrent/utils/unordered_vector.h"
+#include "utils/token_bucket.h"
 
 namespace torrent {
 
@@ -16,12 +19,24 @@ class Handshake;
 class DownloadManager;
 class DownloadMain;
 class PeerConnectionBase;
+class PeerInfo;
+class UtpStream;
 
-class HandshakeManager : private utils::unordered_vector<Handshake*> {
+// Pending handshakes are indexed by peer address and by download, so
+// that lookups done per incoming connection and per connection
+// attempt don't scan every handshake in flight.
+class HandshakeManager : private std::unordered_set<Handshake*> {
 public:
-  using base_type = utils::unordered_vector<Handshake*>;
+  using base_type = std::unordered_set<Handshake*>;
   using size_type = uint32_t;
 
+  using address_index =
+    std::unordered_multimap<socket_address_key,
+                            Handshake*,
+                            socket_address_key_hash>;
+  using download_index =
+    std::unordered_map<DownloadMain*, std::unordered_set<Handshake*>>;
+
   using slot_download = std::function<DownloadMain*(const char*)>;
 
   // Do not connect to peers with this many or more failed chunks.
@@ -45,8 +60,20 @@ public:
 
   void erase_download(DownloadMain* info);
 
+  // Called by handshakes when the download of an incoming connection
+  // has been identified.
+  void update_download(Handshake* h, DownloadMain* old_download);
+
+  // Check the handshake admission limit without consuming from it.
+  bool can_admit();
+
   // Cleanup.
   void add_incoming(SocketFd fd, const utils::socket_address& sa);
+
+  // Incoming uTP connections arrive as local sockets relayed by the
+  // uTP context, and skip the TCP socket options.
+  void add_incoming_utp(SocketFd fd, const utils::socket_address& sa);
+
   void add_outgoing(const utils::socket_address& sa, DownloadMain* info);
 
   slot_download& slot_download_id() {
@@ -72,18 +99,66 @@ public:
     return &DefaultExtensions;
   }
 
+  size_type utp_pending_size() const {
+    return m_utpPending.size();
+  }
+
 private:
+  // Outgoing uTP connections waiting for the peer to answer.
+  struct utp_pending {
+    UtpStream*            stream;
+    DownloadMain*         download;
+    PeerInfo*             peer_info;
+    utils::socket_address address;
+    int                   encryption_options;
+  };
+
+  using utp_pending_map  = std::unordered_map<uint32_t, utp_pending>;
+  using utp_download_map  = std::unordered_map<DownloadMain*, size_type>;
+
   void create_outgoing(const utils::socket_address& sa,
                        DownloadMain*                info,
                        int                          encryptionOptions);
+  void connect_tcp(const utils::socket_address& sa,
+                   DownloadMain*                info,
+                   PeerInfo*                    peerInfo,
+                   int                          encryptionOptions);
+  void connect_utp(const utils::socket_address& sa,
+                   DownloadMain*                info,
+                   PeerInfo*                    peerInfo,
+                   int                          encryptionOptions);
+  void start_outgoing(SocketFd                     fd,
+                      const utils::socket_address& sa,
+                      DownloadMain*                info,
+                      PeerInfo*                    peerInfo,
+                      int                          encryptionOptions);
+
+  void        receive_utp_connected(uint32_t id, SocketFd fd, int error);
+  void        cancel_utp(utp_pending_map::iterator itr);
+  utp_pending erase_utp(utp_pending_map::iterator itr);
+
+  void insert(Handshake* handshake);
   void erase(Handshake* handshake);
 
+  bool admit();
+
   bool setup_socket(SocketFd fd);
 
   static ProtocolExtension DefaultExtensions;
 
   slot_download m_slot_download_id;
   slot_download m_slot_download_obfuscated;
+
+  address_index  m_addresses;
+  download_index m_downloads;
+
+  // Pending uTP connections count as handshakes of their download,
+  // and hold the socket their handshake will use.
+  utp_pending_map  m_utpPending;
+  utp_download_map m_utpDownloads;
+  uint32_t         m_utpNextId{ 0 };
+
+  TokenBucket m_admission;
 };
 
 } // namespace torrent
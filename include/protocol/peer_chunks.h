@@ -4,7 +4,9 @@
 #ifndef LIBTORRENT_PROTOCOL_PEER_CHUNKS_H
 #define LIBTORRENT_PROTOCOL_PEER_CHUNKS_H
 
+#include <algorithm>
 #include <list>
+#include <vector>
 
 #include "net/throttle_node.h"
 #include "torrent/bitfield.h"
@@ -20,6 +22,7 @@ class PeerInfo;
 class PeerChunks {
 public:
   using piece_list_type = std::list<Piece>;
+  using index_list_type = std::vector<uint32_t>;
 
   bool is_seeder() const {
     return m_bitfield.is_all_set();
@@ -63,6 +66,31 @@ public:
     return &m_cancelQueue;
   }
 
+  // Fast extension messages waiting to be sent.
+  piece_list_type* reject_queue() {
+    return &m_rejectQueue;
+  }
+  index_list_type* suggest_queue() {
+    return &m_suggestQueue;
+  }
+  index_list_type* allowed_fast_queue() {
+    return &m_allowedFastQueue;
+  }
+
+  // Chunks the peer may request while choked.
+  index_list_type* allowed_fast() {
+    return &m_allowedFast;
+  }
+  bool is_allowed_fast(uint32_t index) const {
+    return std::find(m_allowedFast.begin(), m_allowedFast.end(), index) !=
+           m_allowedFast.end();
+  }
+
+  // Chunks the peer suggested we request, most recent last.
+  index_list_type* suggested() {
+    return &m_suggested;
+  }
+
   // Timer used to figure out what HAVE_PIECE messages have not been
   // sent.
   utils::timer have_timer() const {
@@ -103,6 +131,12 @@ private:
 
   piece_list_type m_uploadQueue;
   piece_list_type m_cancelQueue;
+  piece_list_type m_rejectQueue;
+
+  index_list_type m_suggestQueue;
+  index_list_type m_allowedFastQueue;
+  index_list_type m_allowedFast;
+  index_list_type m_suggested;
 
   utils::timer m_haveTimer;
 
@@ -56,6 +56,11 @@ public:
   static constexpr int PEX_ENABLE  = (1 << 1);
   static constexpr int PEX_DISABLE = (1 << 2);
 
+  // Most SUGGEST messages sent when unchoking a fast extension peer,
+  // and most suggestions from the peer remembered.
+  static constexpr uint32_t max_suggest   = 4;
+  static constexpr uint32_t max_suggested = 16;
+
   PeerConnectionBase();
   ~PeerConnectionBase() override;
 
@@ -141,9 +146,9 @@ public:
   ProtocolExtension* extensions() {
     return m_extensions;
   }
-  DataBuffer* extension_message() {
-    return &m_extensionMessage;
-  }
+
+  // Refresh the peer info's TCP_INFO sample.
+  void sample_tcp_stats();
 
   void do_peer_exchange() {
     m_sendPEXMask |= PEX_DO;
@@ -213,6 +218,9 @@ protected:
   bool should_request();
   bool try_request_pieces();
 
+  void prepare_allowed_fast();
+  void prepare_suggest();
+
   bool send_pex_message();
   bool send_ext_message();
 
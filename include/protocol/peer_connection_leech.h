@@ -43,6 +43,7 @@ public:
 private:
   inline bool read_message();
   void        read_have_chunk(uint32_t index);
+  void        read_suggest_chunk(uint32_t index);
 
   void offer_chunk();
   bool should_upload();
@@ -32,6 +32,13 @@ public:
     CANCEL,
     PORT, // = 9
 
+    // Fast extension, BEP 6.
+    SUGGEST = 13,
+    HAVE_ALL,
+    HAVE_NONE,
+    REJECT,
+    ALLOWED_FAST, // = 17
+
     EXTENSION_PROTOCOL = 20,
 
     NONE,      // These are not part of the protocol
@@ -89,29 +96,41 @@ public:
   void write_choke(bool s);
   void write_interested(bool s);
   void write_have(uint32_t index);
+  void write_have_messages(const char* messages, uint32_t count);
   void write_bitfield(size_type length);
   void write_request(const Piece& p);
   void write_cancel(const Piece& p);
   void write_piece(const Piece& p);
   void write_port(uint16_t port);
   void write_extension(uint8_t id, uint32_t length);
-
-  static constexpr size_type sizeof_keepalive      = 4;
-  static constexpr size_type sizeof_choke          = 5;
-  static constexpr size_type sizeof_interested     = 5;
-  static constexpr size_type sizeof_have           = 9;
-  static constexpr size_type sizeof_have_body      = 4;
-  static constexpr size_type sizeof_bitfield       = 5;
-  static constexpr size_type sizeof_request        = 17;
-  static constexpr size_type sizeof_request_body   = 12;
-  static constexpr size_type sizeof_cancel         = 17;
-  static constexpr size_type sizeof_cancel_body    = 12;
-  static constexpr size_type sizeof_piece          = 13;
-  static constexpr size_type sizeof_piece_body     = 8;
-  static constexpr size_type sizeof_port           = 7;
-  static constexpr size_type sizeof_port_body      = 2;
-  static constexpr size_type sizeof_extension      = 6;
-  static constexpr size_type sizeof_extension_body = 1;
+  void write_suggest(uint32_t index);
+  void write_have_all(bool s);
+  void write_reject(const Piece& p);
+  void write_allowed_fast(uint32_t index);
+
+  static constexpr size_type sizeof_keepalive         = 4;
+  static constexpr size_type sizeof_choke             = 5;
+  static constexpr size_type sizeof_interested        = 5;
+  static constexpr size_type sizeof_have              = 9;
+  static constexpr size_type sizeof_have_body         = 4;
+  static constexpr size_type sizeof_bitfield          = 5;
+  static constexpr size_type sizeof_request           = 17;
+  static constexpr size_type sizeof_request_body      = 12;
+  static constexpr size_type sizeof_cancel            = 17;
+  static constexpr size_type sizeof_cancel_body       = 12;
+  static constexpr size_type sizeof_piece             = 13;
+  static constexpr size_type sizeof_piece_body        = 8;
+  static constexpr size_type sizeof_port              = 7;
+  static constexpr size_type sizeof_port_body         = 2;
+  static constexpr size_type sizeof_extension         = 6;
+  static constexpr size_type sizeof_extension_body    = 1;
+  static constexpr size_type sizeof_suggest           = 9;
+  static constexpr size_type sizeof_suggest_body      = 4;
+  static constexpr size_type sizeof_have_all          = 5;
+  static constexpr size_type sizeof_reject            = 17;
+  static constexpr size_type sizeof_reject_body       = 12;
+  static constexpr size_type sizeof_allowed_fast      = 9;
+  static constexpr size_type sizeof_allowed_fast_body = 4;
 
   bool can_write_keepalive() const {
     return m_buffer.reserved_left() >= sizeof_keepalive;
@@ -143,6 +162,15 @@ public:
   bool can_write_extension() const {
     return m_buffer.reserved_left() >= sizeof_extension;
   }
+  bool can_write_suggest() const {
+    return m_buffer.reserved_left() >= sizeof_suggest;
+  }
+  bool can_write_reject() const {
+    return m_buffer.reserved_left() >= sizeof_reject;
+  }
+  bool can_write_allowed_fast() const {
+    return m_buffer.reserved_left() >= sizeof_allowed_fast;
+  }
 
   bool can_read_have_body() const {
     return m_buffer.remaining() >= sizeof_have_body;
@@ -162,6 +190,15 @@ public:
   bool can_read_extension_body() const {
     return m_buffer.remaining() >= sizeof_extension_body;
   }
+  bool can_read_suggest_body() const {
+    return m_buffer.remaining() >= sizeof_suggest_body;
+  }
+  bool can_read_reject_body() const {
+    return m_buffer.remaining() >= sizeof_reject_body;
+  }
+  bool can_read_allowed_fast_body() const {
+    return m_buffer.remaining() >= sizeof_allowed_fast_body;
+  }
 
 protected:
   State         m_state{ IDLE };
@@ -213,6 +250,13 @@ ProtocolBase::write_have(uint32_t index) {
   m_buffer.write_32(index);
 }
 
+// Append 'count' HAVE messages already encoded in wire format.
+inline void
+ProtocolBase::write_have_messages(const char* messages, uint32_t count) {
+  m_buffer.write_len(messages, count * sizeof_have);
+  m_lastCommand = HAVE;
+}
+
 inline void
 ProtocolBase::write_bitfield(size_type length) {
   m_buffer.write_32(1 + length);
@@ -259,6 +303,35 @@ ProtocolBase::write_extension(uint8_t id, uint32_t length) {
   m_buffer.write_8(id);
 }
 
+inline void
+ProtocolBase::write_suggest(uint32_t index) {
+  m_buffer.write_32(5);
+  write_command(SUGGEST);
+  m_buffer.write_32(index);
+}
+
+inline void
+ProtocolBase::write_have_all(bool s) {
+  m_buffer.write_32(1);
+  write_command(s ? HAVE_ALL : HAVE_NONE);
+}
+
+inline void
+ProtocolBase::write_reject(const Piece& p) {
+  m_buffer.write_32(13);
+  write_command(REJECT);
+  m_buffer.write_32(p.index());
+  m_buffer.write_32(p.offset());
+  m_buffer.write_32(p.length());
+}
+
+inline void
+ProtocolBase::write_allowed_fast(uint32_t index) {
+  m_buffer.write_32(5);
+  write_command(ALLOWED_FAST);
+  m_buffer.write_32(index);
+}
+
 } // namespace torrent
 
 #endif
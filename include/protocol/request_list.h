@@ -46,6 +46,10 @@ public:
   static constexpr int timeout_remove_choked     = 6;
   static constexpr int timeout_choked_received   = 60;
   static constexpr int timeout_process_unordered = 60;
+  static constexpr int timeout_rtt_probe         = 30;
+  static constexpr int timeout_rtt_refresh       = 10;
+
+  static constexpr int64_t delivery_window_usec = 200000;
 
   RequestList();
   ~RequestList();
@@ -60,6 +64,9 @@ public:
   void choked();
   void unchoked();
 
+  // The peer will not send this piece, return it to the delegator.
+  void rejected(const Piece& piece);
+
   void clear();
 
   // The returned transfer must still be valid.
@@ -109,6 +116,15 @@ public:
   uint32_t pipe_size() const;
   uint32_t calculate_pipe_size(uint32_t rate);
 
+  // Smoothed time from sending a request with an empty queue to the
+  // start of the piece. Zero until measured.
+  uint32_t rtt_usec() const {
+    return m_rtt_usec;
+  }
+  uint32_t delivery_rate() const {
+    return m_delivery_rate;
+  }
+
   void set_delegator(Delegator* d) {
     m_delegator = d;
   }
@@ -130,6 +146,9 @@ public:
 private:
   void delay_remove_choked();
 
+  void sample_rtt();
+  void sample_delivery_rate(uint32_t length);
+
   void prepare_process_unordered(const queues_type::iterator& itr);
   void delay_process_unordered();
 
@@ -146,6 +165,18 @@ private:
   utils::timer m_last_unchoke;
   size_t       m_last_unordered_position{ 0 };
 
+  // One request at a time is timed. The probe is dropped when the
+  // queues are cleared, and replaced if it never gets a reply.
+  Piece        m_rtt_probe;
+  utils::timer m_rtt_probe_time;
+  utils::timer m_rtt_sampled;
+  uint32_t     m_rtt_usec{ 0 };
+
+  utils::timer m_delivery_start;
+  uint64_t     m_delivery_start_pos{ 0 };
+  uint64_t     m_delivered{ 0 };
+  uint32_t     m_delivery_rate{ 0 };
+
   utils::priority_item m_delay_remove_choked;
   utils::priority_item m_delay_process_unordered;
 };
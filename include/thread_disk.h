@@ -3,6 +3,7 @@
 
 #include "data/hash_check_queue.h"
 #include "torrent/utils/thread_base.h"
+#include "utils/diffie_hellman_pool.h"
 
 namespace torrent {
 
@@ -14,6 +15,9 @@ public:
   HashCheckQueue* hash_queue() {
     return &m_hash_queue;
   }
+  DiffieHellmanPool* dh_pool() {
+    return &m_dh_pool;
+  }
 
   void init_thread() override;
 
@@ -21,7 +25,8 @@ protected:
   void    call_events() override;
   int64_t next_timeout_usec() override;
 
-  HashCheckQueue m_hash_queue;
+  HashCheckQueue    m_hash_queue;
+  DiffieHellmanPool m_dh_pool;
 };
 
 } // namespace torrent
@@ -76,6 +76,14 @@ public:
   void copy(const Bitfield& bf);
   void swap(Bitfield& bf);
 
+  // Refer to the data of 'bf' rather than owning a copy. The data
+  // must outlive this bitfield and must not be modified through it.
+  void share(const Bitfield& bf);
+
+  bool is_shared() const {
+    return m_shared;
+  }
+
   void set_all();
   void set_range(size_type first, size_type last);
 
@@ -138,6 +146,7 @@ private:
   size_type m_set{ 0 };
 
   value_type* m_data{ nullptr };
+  bool        m_shared{ false };
 };
 
 } // namespace torrent
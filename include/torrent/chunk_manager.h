@@ -6,6 +6,9 @@
 #ifndef LIBTORRENT_CHUNK_MANAGER_H
 #define LIBTORRENT_CHUNK_MANAGER_H
 
+#include <map>
+#include <memory>
+#include <sys/types.h>
 #include <vector>
 
 #include <torrent/common.h>
@@ -13,6 +16,45 @@
 
 namespace torrent {
 
+// Totals for the chunks synced on a single device, 'usec' being the
+// time spent in msync.
+struct LIBTORRENT_EXPORT chunk_sync_stats {
+  uint64_t syncs{ 0 };
+  uint64_t failed{ 0 };
+  uint64_t bytes{ 0 };
+  uint64_t usec{ 0 };
+  uint64_t max_usec{ 0 };
+
+  uint64_t average_usec() const {
+    return syncs != 0 ? usec / syncs : 0;
+  }
+
+  // Bytes per second of time spent syncing.
+  uint64_t throughput() const {
+    return usec != 0 ? bytes * 1000000 / usec : 0;
+  }
+};
+
+// Last sample and decisions of the memory governor. Pressure is the
+// PSI 'some avg10' share of time stalled, in hundredths of a percent.
+struct LIBTORRENT_EXPORT memory_governor_stats {
+  uint64_t cgroup_max{ 0 }; // Zero if no cgroup limit was found.
+  uint64_t cgroup_current{ 0 };
+  uint32_t pressure_some{ 0 };
+  uint32_t pressure_full{ 0 };
+
+  uint64_t updates{ 0 };
+  uint64_t lowered{ 0 };
+  uint64_t raised{ 0 };
+
+  // Syncs started because usage was above the governed limit, and
+  // the bytes of chunk memory they released.
+  uint64_t reclaims{ 0 };
+  uint64_t reclaimed{ 0 };
+};
+
+class MemoryGovernor;
+
 // TODO: Currently all chunk lists are inserted, despite the download
 // not being open/active.
 
@@ -30,6 +72,8 @@ public:
   using base_type::end;
   using base_type::size;
 
+  using sync_stats_map = std::map<dev_t, chunk_sync_stats>;
+
   ChunkManager();
   ~ChunkManager();
 
@@ -54,12 +98,35 @@ public:
       throw input_error("Max memory usage is larger than RAM available.");
     }
 
-    m_maxMemoryUsage = bytes;
+    m_maxMemoryUsage      = bytes;
+    m_governedMemoryUsage = bytes;
   }
 
-  // Estimate the max memory usage possible.
+  // Estimate the max memory usage possible. The memory.max limit of
+  // the cgroup is left out, as the memory governor enforces it.
   static uint64_t estimate_max_memory_usage();
 
+  // The memory governor keeps the limit used when allocating chunks
+  // below max_memory_usage() while the cgroup of the process is close
+  // to memory.max or PSI reports memory pressure, and syncs chunks
+  // ahead of allocations when usage is above it. When disabled the
+  // limit is max_memory_usage().
+  bool memory_governor() const {
+    return m_memoryGovernorEnabled;
+  }
+  void set_memory_governor(bool state);
+
+  uint64_t governed_memory_usage() const {
+    return m_governedMemoryUsage;
+  }
+
+  const memory_governor_stats& governor_stats() const {
+    return m_governorStats;
+  }
+
+  // Called every few seconds by the library.
+  void update_memory_governor();
+
   uint64_t safe_free_diskspace() const;
 
   bool safe_sync() const {
@@ -86,6 +153,16 @@ public:
     m_timeoutSafeSync = seconds;
   }
 
+  // Maximum number of chunks synced per device on each periodic
+  // sync, with the remainder left for the next one. Set to 0 to
+  // disable. Syncs made to free memory are not limited.
+  uint32_t sync_queue_depth() const {
+    return m_syncQueueDepth;
+  }
+  void set_sync_queue_depth(uint32_t chunks) {
+    m_syncQueueDepth = chunks;
+  }
+
   // Set to 0 to disable preloading.
   //
   // How the value is used is yet to be determined, but it won't be
@@ -138,6 +215,13 @@ public:
 
   void periodic_sync();
 
+  const sync_stats_map& sync_stats() const {
+    return m_syncStats;
+  }
+
+  // Called by ChunkList for every chunk it syncs.
+  void receive_sync(dev_t device, uint32_t bytes, uint64_t usec, bool success);
+
   // Not sure if I wnt these here. Consider implementing a generic
   // statistics API.
   uint32_t stats_preloaded() const {
@@ -162,12 +246,14 @@ private:
 
   uint64_t m_memoryUsage{ 0 };
   uint64_t m_maxMemoryUsage;
+  uint64_t m_governedMemoryUsage;
 
   uint32_t m_memoryBlockCount{ 0 };
 
   bool     m_safeSync{ false };
   uint32_t m_timeoutSync{ 600 };
   uint32_t m_timeoutSafeSync{ 900 };
+  uint32_t m_syncQueueDepth{ 0 };
 
   uint32_t m_preloadType{ 0 };
   uint32_t m_preloadMinSize{ 256 << 10 };
@@ -176,6 +262,12 @@ private:
   uint32_t m_statsPreloaded{ 0 };
   uint32_t m_statsNotPreloaded{ 0 };
 
+  sync_stats_map m_syncStats;
+
+  bool                            m_memoryGovernorEnabled{ true };
+  std::unique_ptr<MemoryGovernor> m_memoryGovernor;
+  memory_governor_stats           m_governorStats;
+
   int32_t   m_timerStarved{ 0 };
   size_type m_lastFreed{ 0 };
 };
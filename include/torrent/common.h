@@ -58,11 +58,14 @@ class Piece;
 class Poll;
 class ProtocolExtension;
 class Rate;
+class Resolver;
 class SocketSet;
 class Throttle;
 class Tracker;
 class TrackerList;
 class TransferList;
+class UtpContext;
+class ip_filter;
 
 // This should only need to be set when compiling libtorrent.
 #ifdef EXPORT_LIBTORRENT_SYMBOLS
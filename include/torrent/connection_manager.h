@@ -9,6 +9,7 @@
 #include <arpa/inet.h>
 #include <functional>
 #include <list>
+#include <memory>
 #include <netinet/in.h>
 #include <netinet/in_systm.h>
 #include <netinet/ip.h>
@@ -109,10 +110,28 @@ public:
   uint32_t receive_buffer_size() const {
     return m_receiveBufferSize;
   }
+
+  // Unsent bytes allowed in a peer socket's send buffer before it
+  // stops polling as writable, using TCP_NOTSENT_LOWAT. This keeps
+  // choke and request messages from queueing behind megabytes of piece
+  // data. Zero disables the limit, throws input_error if not supported.
+  uint32_t send_lowat() const {
+    return m_sendLowat;
+  }
   uint32_t encryption_options() {
     return m_encryptionOptions;
   }
 
+  // Admission control for new incoming and outgoing handshakes, at
+  // most 'rate' per second with bursts of 'burst'. Zero rate disables
+  // the limit.
+  uint32_t handshake_rate() const {
+    return m_handshakeRate;
+  }
+  uint32_t handshake_burst() const {
+    return m_handshakeBurst;
+  }
+
   void set_max_size(size_type s) {
     m_maxSize = s;
   }
@@ -121,7 +140,9 @@ public:
   }
   void set_send_buffer_size(uint32_t s);
   void set_receive_buffer_size(uint32_t s);
+  void set_send_lowat(uint32_t s);
   void set_encryption_options(uint32_t options);
+  void set_handshake_rate(uint32_t rate, uint32_t burst);
 
   // Setting the addresses creates a copy of the address.
   const sockaddr* bind_address() const {
@@ -138,11 +159,19 @@ public:
   void set_local_address(const sockaddr* sa);
   void set_proxy_address(const sockaddr* sa);
 
+  // Addresses are checked against the address filter, if any, and
+  // then the filter slot. A zero return value rejects the address.
   uint32_t filter(const sockaddr* sa);
   void     set_filter(const slot_filter_type& s) {
     m_slot_filter = s;
   }
 
+  // The address filter may be replaced from any thread, so a new
+  // filter can be loaded and validated without blocking the main
+  // thread. Lookups in progress keep the old filter alive.
+  std::shared_ptr<const ip_filter> address_filter() const;
+  void set_address_filter(std::shared_ptr<const ip_filter> f);
+
   bool listen_open(port_type begin, port_type end);
   void listen_close();
 
@@ -160,10 +189,22 @@ public:
   }
   void set_listen_backlog(int v);
 
+  // Accept and make uTP connections on the UDP port matching the
+  // listening port, falling back to TCP for outgoing connections the
+  // peer doesn't answer. Must be set before 'listen_open(...)', and
+  // the DHT port must then differ from the listening port.
+  bool utp_enabled() const {
+    return m_utpEnabled;
+  }
+  void set_utp_enabled(bool state);
+
   // The resolver returns a pointer to its copy of the result slot
   // which the caller may set blocked to prevent the slot from being
   // called. The pointer must be NULL if the result slot was already
   // called because the resolve was synchronous.
+  //
+  // The default resolver looks up hosts asynchronously and caches the
+  // results, see 'default_resolver()'.
   slot_resolver_type& resolver() {
     return m_slot_resolver;
   }
@@ -178,6 +219,12 @@ public:
   Listen* listen() {
     return m_listen;
   }
+  Resolver* default_resolver() {
+    return m_resolver;
+  }
+  UtpContext* utp() {
+    return m_utp;
+  }
 
 private:
   ConnectionManager(const ConnectionManager&) = delete;
@@ -189,15 +236,23 @@ private:
   priority_type m_priority{ iptos_throughput };
   uint32_t      m_sendBufferSize{ 0 };
   uint32_t      m_receiveBufferSize{ 0 };
+  uint32_t      m_sendLowat{ 0 };
   int           m_encryptionOptions{ encryption_none };
+  uint32_t      m_handshakeRate{ 0 };
+  uint32_t      m_handshakeBurst{ 0 };
 
   sockaddr* m_bindAddress;
   sockaddr* m_localAddress;
   sockaddr* m_proxyAddress;
 
-  Listen*   m_listen;
-  port_type m_listen_port{ 0 };
-  uint32_t  m_listen_backlog{ SOMAXCONN };
+  Listen*     m_listen;
+  Resolver*   m_resolver;
+  UtpContext* m_utp;
+  port_type   m_listen_port{ 0 };
+  uint32_t    m_listen_backlog{ SOMAXCONN };
+  bool        m_utpEnabled{ false };
+
+  std::shared_ptr<const ip_filter> m_addressFilter;
 
   slot_filter_type   m_slot_filter;
   slot_resolver_type m_slot_resolver;
@@ -49,6 +49,11 @@ public:
     return m_failedCount;
   }
 
+  // Changes whenever a transfer is inserted or erased.
+  uint32_t version() const {
+    return m_version;
+  }
+
   //
   // Internal to libTorrent:
   //
@@ -97,6 +102,7 @@ private:
 
   uint32_t m_succeededCount{ 0 };
   uint32_t m_failedCount{ 0 };
+  uint32_t m_version{ 0 };
 };
 
 } // namespace torrent
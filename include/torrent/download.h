@@ -73,6 +73,25 @@ public:
   bool is_sequential_enabled();
   void set_sequential_enabled(bool enabled);
 
+  // Streaming: the 'window' chunks from 'playhead' get deadlines
+  // 'interval_ms' apart and are requested ahead of others, preferably
+  // from fast peers. Call again as playback progresses, or with a
+  // zero window to disable.
+  void set_deadline(uint32_t playhead, uint32_t window, uint32_t interval_ms);
+
+  // Chunks completed after their deadline, and the total time
+  // playback would have stalled waiting for them.
+  uint32_t deadline_misses() const;
+  uint64_t deadline_stall_usec() const;
+
+  // Requests queued per peer are sized to four times the product of its
+  // download rate and measured request round trip, within 'min' and
+  // 'max'. A zero 'max' sizes from the rate alone. Throws input_error
+  // if 'min' is larger than a non-zero 'max'.
+  void     set_request_pipeline(uint32_t min, uint32_t max);
+  uint32_t request_pipeline_min() const;
+  uint32_t request_pipeline_max() const;
+
   Object*       bencode();
   const Object* bencode() const;
 
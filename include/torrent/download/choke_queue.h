@@ -159,7 +159,7 @@ private:
   group_stats retrieve_connections(group_stats     gs,
                                    container_type* queued,
                                    container_type* unchoked);
-  void rebuild_containers(container_type* queued, container_type* unchoked);
+  uint32_t    count_unchoked() const;
 
   inline uint32_t max_alternate() const;
 
@@ -0,0 +1,119 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2005-2011, Jari Sundell <jaris@ifi.uio.no>
+
+// Compiled IPv4 and IPv6 address range filter, used by
+// 'ConnectionManager::filter' before the filter slot.
+//
+// Range lists are compiled into sorted arrays of disjoint interval
+// starts with a value for each, plus an index on the upper 16 bits of
+// IPv4 addresses that narrows each lookup to a few entries. The
+// compiled form is a flat file in host byte order that can be
+// memory-mapped and used in place, so large blocklists load without
+// parsing.
+
+#ifndef LIBTORRENT_NET_IP_FILTER_H
+#define LIBTORRENT_NET_IP_FILTER_H
+
+#include <cinttypes>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <vector>
+#include <torrent/common.h>
+
+namespace torrent {
+
+class LIBTORRENT_EXPORT ip_filter {
+public:
+  // Inclusive ranges, IPv4 addresses in host byte order.
+  struct range_v4 {
+    uint32_t first;
+    uint32_t last;
+    uint32_t value;
+  };
+
+  struct range_v6 {
+    in6_addr first;
+    in6_addr last;
+    uint32_t value;
+  };
+
+  static constexpr uint32_t magic   = 0x4c544946; // "LTIF"
+  static constexpr uint16_t version = 1;
+
+  static constexpr uint32_t header_size = 32;
+  static constexpr uint32_t index_bits  = 16;
+  static constexpr uint32_t index_size  = (1 << index_bits) + 1;
+
+  ip_filter() = default;
+  ~ip_filter() {
+    close();
+  }
+
+  ip_filter(const ip_filter&)            = delete;
+  ip_filter& operator=(const ip_filter&) = delete;
+
+  bool is_open() const {
+    return m_data != nullptr;
+  }
+
+  // Number of disjoint intervals, including those with the default
+  // value.
+  uint32_t size_v4() const {
+    return m_sizeV4;
+  }
+  uint32_t size_v6() const {
+    return m_sizeV6;
+  }
+
+  uint32_t default_value() const {
+    return m_defaultValue;
+  }
+
+  // Validate a compiled filter, which must be 8-byte aligned and
+  // outlive this object. Returns false if anything is invalid.
+  bool open(const char* data, size_t size);
+
+  // Map 'path' read-only and validate it in place.
+  bool open_file(const std::string& path);
+
+  void close();
+
+  // Returns the value of the range containing the address, or the
+  // default value. IPv4-mapped IPv6 addresses use the IPv4 ranges,
+  // other families always get the default value.
+  uint32_t lookup(const sockaddr* sa) const;
+  uint32_t lookup_v4(uint32_t address) const;
+  uint32_t lookup_v6(const in6_addr& address) const;
+
+  // Where ranges overlap the lowest value wins, so a range with value
+  // zero blocks regardless of any other range covering it. Throws
+  // input_error on ranges with 'first' larger than 'last'.
+  static std::string compile(const std::vector<range_v4>& ranges_v4,
+                             const std::vector<range_v6>& ranges_v6,
+                             uint32_t                     default_value = 1);
+
+private:
+  struct key_v6 {
+    uint64_t high;
+    uint64_t low;
+  };
+
+  const char* m_data{ nullptr };
+  size_t      m_size{ 0 };
+  bool        m_mapped{ false };
+
+  uint32_t m_defaultValue{ 1 };
+  uint32_t m_sizeV4{ 0 };
+  uint32_t m_sizeV6{ 0 };
+
+  const uint32_t* m_startsV4{ nullptr };
+  const uint32_t* m_valuesV4{ nullptr };
+  const uint32_t* m_indexV4{ nullptr };
+  const key_v6*   m_startsV6{ nullptr };
+  const uint32_t* m_valuesV6{ nullptr };
+};
+
+} // namespace torrent
+
+#endif
@@ -6,7 +6,9 @@
 
 #include <cinttypes>
 #include <cstring>
+#include <functional>
 #include <netinet/in.h>
+#include <string_view>
 
 // Unique key for the socket address, excluding port numbers, etc.
 
@@ -46,6 +48,15 @@ private:
   };
 } __attribute__((packed));
 
+// Hash over the packed key bytes, the from_* functions zero the
+// unused part of the union so equal keys hash equally.
+struct socket_address_key_hash {
+  size_t operator()(const socket_address_key& sa) const {
+    return std::hash<std::string_view>()(std::string_view(
+      reinterpret_cast<const char*>(&sa), sizeof(socket_address_key)));
+  }
+};
+
 inline bool
 socket_address_key::is_comparable_sockaddr(const sockaddr* sa) {
   return sa != nullptr &&
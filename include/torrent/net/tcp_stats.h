@@ -0,0 +1,26 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2005-2011, Jari Sundell <jaris@ifi.uio.no>
+
+#ifndef LIBTORRENT_NET_TCP_STATS_H
+#define LIBTORRENT_NET_TCP_STATS_H
+
+#include <cstdint>
+
+namespace torrent {
+
+// Kernel TCP state of a peer connection, from TCP_INFO. Left zeroed
+// where TCP_INFO is not supported.
+struct tcp_stats {
+  uint32_t rtt_usec{ 0 };
+  uint32_t rtt_var_usec{ 0 };
+  uint32_t cwnd{ 0 }; // In segments of 'mss' bytes.
+  uint32_t mss{ 0 };
+  uint32_t retransmits{ 0 }; // Total over the connection.
+
+  // Seconds of cachedTime at the last sample, zero if never sampled.
+  uint32_t sampled{ 0 };
+};
+
+} // namespace torrent
+
+#endif
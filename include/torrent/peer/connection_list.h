@@ -15,6 +15,7 @@ namespace torrent {
 
 class AddressList;
 class Bitfield;
+class ConnectionIndex;
 class DownloadMain;
 class DownloadWrapper;
 class Peer;
@@ -64,6 +65,7 @@ public:
   static constexpr int disconnect_delayed   = (1 << 3);
 
   ConnectionList(DownloadMain* download);
+  ~ConnectionList();
 
   // Make these protected?
   iterator erase(iterator pos, int flags);
@@ -73,6 +75,7 @@ public:
   void erase_remaining(iterator pos, int flags);
   void erase_seeders();
 
+  // Hash lookups, see ConnectionIndex.
   iterator find(const char* id);
   iterator find(const sockaddr* sa);
 
@@ -126,10 +129,14 @@ protected:
   void disconnect_queued() LIBTORRENT_NO_EXPORT;
 
 private:
+  iterator find_position(Peer* peer) LIBTORRENT_NO_EXPORT;
+  void     update_positions() LIBTORRENT_NO_EXPORT;
+
   ConnectionList(const ConnectionList&) LIBTORRENT_NO_EXPORT = delete;
   void operator=(const ConnectionList&) LIBTORRENT_NO_EXPORT = delete;
 
-  DownloadMain* m_download;
+  DownloadMain*    m_download;
+  ConnectionIndex* m_index;
 
   size_type m_minSize;
   size_type m_maxSize;
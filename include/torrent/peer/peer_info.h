@@ -4,8 +4,11 @@
 #ifndef LIBTORRENT_PEER_INFO_H
 #define LIBTORRENT_PEER_INFO_H
 
+#include <memory>
+#include <netinet/in.h>
 #include <torrent/exceptions.h>
 #include <torrent/hash_string.h>
+#include <torrent/net/tcp_stats.h>
 #include <torrent/peer/client_info.h>
 
 namespace torrent {
@@ -16,6 +19,7 @@ public:
   friend class Handshake;
   friend class HandshakeManager;
   friend class InitialSeeding;
+  friend class PeerConnectionBase;
   friend class PeerList;
   friend class ProtocolExtension;
 
@@ -30,6 +34,10 @@ public:
   PeerInfo(const sockaddr* address);
   ~PeerInfo();
 
+  // Allocated from a shared pool, see peer_info.cc.
+  static void* operator new(size_t size);
+  static void  operator delete(void* ptr, size_t size);
+
   bool is_connected() const {
     return m_flags & flag_connected;
   }
@@ -57,10 +65,10 @@ public:
   }
 
   const HashString& id() const {
-    return m_id;
+    return details().id;
   }
   const char* id_hex() const {
-    return m_id_hex;
+    return details().id_hex;
   }
 
   const ClientInfo& client_info() const {
@@ -71,7 +79,7 @@ public:
     return m_options;
   }
   const sockaddr* socket_address() const {
-    return m_address;
+    return &m_address;
   }
 
   uint16_t listen_port() const {
@@ -89,6 +97,25 @@ public:
     return m_transferCounter;
   }
 
+  // Handshakes that failed since the last connection.
+  uint32_t failed_handshakes() const {
+    return m_failedHandshakes;
+  }
+  void set_failed_handshakes(uint32_t c) {
+    m_failedHandshakes = c;
+  }
+
+  // Bytes downloaded over all past connections.
+  uint64_t downloaded() const {
+    return m_downloaded;
+  }
+
+  // Last sample of the current or most recent connection, refreshed
+  // every 30 seconds while connected.
+  const tcp_stats& tcp() const {
+    return details().tcp;
+  }
+
   uint32_t last_connection() const {
     return m_lastConnection;
   }
@@ -109,6 +136,9 @@ public:
   bool supports_extensions() const {
     return m_options[5] & 0x10;
   }
+  bool supports_fast() const {
+    return m_options[7] & 0x04;
+  }
 
   //
   // Internal to libTorrent:
@@ -130,15 +160,23 @@ protected:
   }
 
   HashString& mutable_id() {
-    return m_id;
+    return mutable_details().id;
   }
   char* mutable_id_hex() {
-    return m_id_hex;
+    return mutable_details().id_hex;
   }
   ClientInfo& mutable_client_info() {
     return m_clientInfo;
   }
 
+  void add_downloaded(uint64_t bytes) {
+    m_downloaded += bytes;
+  }
+
+  tcp_stats& mutable_tcp() {
+    return mutable_details().tcp;
+  }
+
   void set_port(uint16_t port) LIBTORRENT_NO_EXPORT;
   void set_listen_port(uint16_t port) {
     m_listenPort = port;
@@ -155,27 +193,46 @@ private:
   PeerInfo(const PeerInfo&) = delete;
   void operator=(const PeerInfo&) = delete;
 
-  // Replace id with a char buffer, or a cheap struct?
-  int        m_flags;
-  HashString m_id;
-  char       m_id_hex[40];
+  // Only peers that got through a handshake need these, so they are
+  // allocated on first use to keep the many addresses that were never
+  // connected to small.
+  struct connection_details {
+    HashString id;
+    char       id_hex[40];
+    tcp_stats  tcp;
+  };
 
-  ClientInfo m_clientInfo;
+  static const connection_details empty_details;
+
+  const connection_details& details() const {
+    return m_details ? *m_details : empty_details;
+  }
+  connection_details& mutable_details() LIBTORRENT_NO_EXPORT;
+
+  int      m_flags{ 0 };
+  uint32_t m_failedCounter{ 0 };
+  uint32_t m_transferCounter{ 0 };
+  uint32_t m_lastConnection{ 0 };
+  uint32_t m_lastHandshake{ 0 };
+  uint32_t m_failedHandshakes{ 0 };
 
   char m_options[8];
 
-  uint32_t m_failedCounter;
-  uint32_t m_transferCounter;
-  uint32_t m_lastConnection;
-  uint32_t m_lastHandshake;
+  // Since the user never copies PeerInfo the address can be stored
+  // inline.
+  union {
+    sockaddr     m_address;
+    sockaddr_in  m_addressInet;
+    sockaddr_in6 m_addressInet6;
+  };
 
-  uint16_t m_listenPort;
+  uint16_t m_listenPort{ 0 };
 
-  // Replace this with a union. Since the user never copies PeerInfo
-  // it should be safe to not require sockaddr_in6 to be part of it.
-  sockaddr* m_address;
+  uint64_t   m_downloaded{ 0 };
+  ClientInfo m_clientInfo;
 
-  PeerConnectionBase* m_connection;
+  std::unique_ptr<connection_details> m_details;
+  PeerConnectionBase*                 m_connection{ nullptr };
 };
 
 inline void
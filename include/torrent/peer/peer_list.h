@@ -4,7 +4,9 @@
 #ifndef LIBTORRENT_PEER_LIST_H
 #define LIBTORRENT_PEER_LIST_H
 
-#include <map>
+#include <iterator>
+#include <utility>
+#include <vector>
 #include <torrent/common.h>
 #include <torrent/net/socket_address_key.h>
 
@@ -12,28 +14,22 @@ namespace torrent {
 
 class DownloadInfo;
 
-class LIBTORRENT_EXPORT PeerList
-  : private std::multimap<socket_address_key, PeerInfo*> {
+// The peers are kept in an open addressing hash table keyed on the
+// address, with empty slots holding a null PeerInfo. Iteration order
+// is unspecified.
+class LIBTORRENT_EXPORT PeerList {
 public:
   friend class DownloadWrapper;
   friend class Handshake;
   friend class HandshakeManager;
   friend class ConnectionList;
 
-  using base_type  = std::multimap<socket_address_key, PeerInfo*>;
-  using range_type = std::pair<base_type::iterator, base_type::iterator>;
+  using value_type      = std::pair<socket_address_key, PeerInfo*>;
+  using reference       = const value_type&;
+  using size_type       = size_t;
+  using difference_type = std::ptrdiff_t;
 
-  using base_type::difference_type;
-  using base_type::reference;
-  using base_type::value_type;
-
-  using base_type::const_iterator;
-  using base_type::const_reverse_iterator;
-  using base_type::iterator;
-  using base_type::reverse_iterator;
-
-  using base_type::empty;
-  using base_type::size;
+  class const_iterator;
 
   static constexpr int address_available = (1 << 0);
 
@@ -53,10 +49,19 @@ public:
   PeerList();
   ~PeerList();
 
+  bool empty() const {
+    return m_size == 0;
+  }
+  size_type size() const {
+    return m_size;
+  }
+
   PeerInfo* insert_address(const sockaddr* address, int flags);
 
-  // This will be used internally only for the moment.
-  uint32_t insert_available(const void* al) LIBTORRENT_NO_EXPORT;
+  // This will be used internally only for the moment. The source is
+  // one of AvailableList::source_*.
+  uint32_t insert_available(const void* al,
+                            int         source = 0) LIBTORRENT_NO_EXPORT;
 
   AvailableList* available_list() {
     return m_available_list;
@@ -65,18 +70,8 @@ public:
 
   uint32_t cull_peers(int flags);
 
-  const_iterator begin() const {
-    return base_type::begin();
-  }
-  const_iterator end() const {
-    return base_type::end();
-  }
-  const_reverse_iterator rbegin() const {
-    return base_type::rbegin();
-  }
-  const_reverse_iterator rend() const {
-    return base_type::rend();
-  }
+  const_iterator begin() const;
+  const_iterator end() const;
 
 protected:
   void set_info(DownloadInfo* info) LIBTORRENT_NO_EXPORT;
@@ -85,17 +80,88 @@ protected:
   // if no more connections are allowed from that host.
   PeerInfo* connected(const sockaddr* sa, int flags) LIBTORRENT_NO_EXPORT;
 
-  void     disconnected(PeerInfo* p, int flags) LIBTORRENT_NO_EXPORT;
-  iterator disconnected(iterator itr, int flags) LIBTORRENT_NO_EXPORT;
+  void disconnected(PeerInfo* p, int flags) LIBTORRENT_NO_EXPORT;
 
 private:
   PeerList(const PeerList&) = delete;
   void operator=(const PeerList&) = delete;
 
-  DownloadInfo*  m_info;
+  PeerInfo* find(const socket_address_key& key) const LIBTORRENT_NO_EXPORT;
+  void insert(const socket_address_key& key, PeerInfo* peerInfo)
+    LIBTORRENT_NO_EXPORT;
+
+  size_type find_slot(const socket_address_key& key) const
+    LIBTORRENT_NO_EXPORT;
+  void rehash(size_type capacity) LIBTORRENT_NO_EXPORT;
+
+  DownloadInfo*  m_info{ nullptr };
   AvailableList* m_available_list;
+
+  std::vector<value_type> m_table;
+  size_type               m_size{ 0 };
 };
 
+class PeerList::const_iterator {
+public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type        = PeerList::value_type;
+  using difference_type   = std::ptrdiff_t;
+  using pointer           = const value_type*;
+  using reference         = const value_type&;
+
+  const_iterator() = default;
+  const_iterator(pointer pos, pointer last)
+    : m_pos(pos)
+    , m_last(last) {
+    skip_empty();
+  }
+
+  reference operator*() const {
+    return *m_pos;
+  }
+  pointer operator->() const {
+    return m_pos;
+  }
+
+  const_iterator& operator++() {
+    ++m_pos;
+    skip_empty();
+    return *this;
+  }
+  const_iterator operator++(int) {
+    const_iterator tmp = *this;
+    ++*this;
+    return tmp;
+  }
+
+  bool operator==(const const_iterator& itr) const {
+    return m_pos == itr.m_pos;
+  }
+  bool operator!=(const const_iterator& itr) const {
+    return m_pos != itr.m_pos;
+  }
+
+private:
+  void skip_empty() {
+    while (m_pos != m_last && m_pos->second == nullptr)
+      ++m_pos;
+  }
+
+  pointer m_pos{ nullptr };
+  pointer m_last{ nullptr };
+};
+
+inline PeerList::const_iterator
+PeerList::begin() const {
+  return const_iterator(m_table.data(), m_table.data() + m_table.size());
+}
+
+inline PeerList::const_iterator
+PeerList::end() const {
+  return const_iterator(m_table.data() + m_table.size(),
+                        m_table.data() + m_table.size());
+}
+
 } // namespace torrent
 
 #endif
@@ -4,14 +4,17 @@
 #ifndef LIBTORRENT_UTILS_RATE_H
 #define LIBTORRENT_UTILS_RATE_H
 
-#include <deque>
 #include <torrent/common.h>
 
 namespace torrent {
 
 // Keep the current rate count up to date for each call to rate() and
 // insert(...). This requires a mutable since rate() can be const, but
-// is justified as we avoid iterating the deque for each call.
+// is justified as we avoid iterating the samples for each call.
+//
+// Samples are kept in a fixed ring of buckets, each covering
+// 'bucket_width()' seconds, so the span is split into at most
+// 'bucket_count' buckets and no memory is allocated.
 
 class LIBTORRENT_EXPORT Rate {
 public:
@@ -19,13 +22,11 @@ public:
   using rate_type  = uint64_t;
   using total_type = uint64_t;
 
-  using value_type = std::pair<timer_type, rate_type>;
-  using queue_type = std::deque<value_type>;
+  static constexpr unsigned int bucket_count = 32;
 
   Rate(timer_type span)
-    : m_current(0)
-    , m_total(0)
-    , m_span(span) {}
+    : m_span(span)
+    , m_width(width_for_span(span)) {}
 
   // Bytes per second.
   rate_type rate() const;
@@ -42,16 +43,16 @@ public:
   timer_type span() const {
     return m_span;
   }
-  void set_span(timer_type s) {
-    m_span = s;
+  void set_span(timer_type s);
+
+  // Seconds covered by each bucket.
+  timer_type bucket_width() const {
+    return m_width;
   }
 
   void insert(rate_type bytes);
 
-  void reset_rate() {
-    m_current = 0;
-    m_container.clear();
-  }
+  void reset_rate();
 
   bool operator<(Rate& r) const {
     return rate() < r.rate();
@@ -80,13 +81,24 @@ public:
   }
 
 private:
+  static timer_type width_for_span(timer_type span) {
+    return span / bucket_count + 1;
+  }
+
+  // Number of buckets in use, covering at least 'm_span + 1' seconds.
+  timer_type window() const {
+    return (m_span + m_width) / m_width;
+  }
+
   inline void discard_old() const;
 
-  mutable queue_type m_container;
+  mutable rate_type  m_buckets[bucket_count]{};
+  mutable timer_type m_epoch{ 0 };
 
-  mutable rate_type m_current;
-  total_type        m_total;
+  mutable rate_type m_current{ 0 };
+  total_type        m_total{ 0 };
   timer_type        m_span;
+  timer_type        m_width;
 };
 
 } // namespace torrent
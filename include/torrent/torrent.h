@@ -67,6 +67,26 @@ version() LIBTORRENT_EXPORT;
 uint32_t
 hash_queue_size() LIBTORRENT_EXPORT;
 
+// Bytes of chunks that may be outstanding for hash checking on each
+// device, shared by all downloads checking files on it.
+uint64_t
+hash_check_max_outstanding() LIBTORRENT_EXPORT;
+void
+set_hash_check_max_outstanding(uint64_t bytes) LIBTORRENT_EXPORT;
+
+// Progress of all running hash checks. The 'eta' is in seconds at the
+// rate seen since checking started, or -1 if not yet known.
+struct hash_check_progress {
+  uint32_t downloads;
+  uint32_t waiting;
+  uint64_t bytes_checked;
+  uint64_t bytes_remaining;
+  int64_t  eta;
+};
+
+hash_check_progress
+hash_check_status() LIBTORRENT_EXPORT;
+
 using DList        = std::list<Download>;
 using EncodingList = std::list<std::string>;
 
@@ -6,6 +6,7 @@
 
 #include <cinttypes>
 #include <string>
+#include <fcntl.h>
 #include <sys/stat.h>
 
 namespace torrent {
@@ -25,6 +26,12 @@ public:
     return update(filename.c_str());
   }
 
+  // Stat 'filename' relative to the directory 'dirfd', avoiding
+  // resolving the full path for every file in a directory.
+  bool update_at(int dirfd, const char* filename) {
+    return fstatat(dirfd, filename, &m_stat, 0) == 0;
+  }
+
   bool update_link(const char* filename) {
     return lstat(filename, &m_stat) == 0;
   }
@@ -58,6 +65,10 @@ public:
     return m_stat.st_size;
   }
 
+  dev_t device() const {
+    return m_stat.st_dev;
+  }
+
   time_t access_time() const {
     return m_stat.st_atime;
   }
@@ -14,6 +14,9 @@
 
 #include <torrent/common.h>
 
+#include <utility>
+#include <vector>
+
 namespace torrent {
 
 // When saving resume data for a torrent that is currently active, set
@@ -24,6 +27,16 @@ void
 resume_load_progress(Download download, const Object& object) LIBTORRENT_EXPORT;
 void
 resume_save_progress(Download download, Object& object) LIBTORRENT_EXPORT;
+
+// Load the progress of many downloads, such as on startup. The files
+// of all downloads are stat'ed up front on 'workers' threads, grouped
+// by directory, before the resume data is applied in order on the
+// calling thread.
+using resume_progress_list = std::vector<std::pair<Download, const Object*>>;
+
+void
+resume_load_progress_list(const resume_progress_list& list,
+                          unsigned int workers = 4) LIBTORRENT_EXPORT;
 void
 resume_clear_progress(Download download, Object& object) LIBTORRENT_EXPORT;
 
@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2005-2011, Jari Sundell <jaris@ifi.uio.no>
+
+// Versioned binary alternative to the bencoded resume data written by
+// the 'resume_save_*' functions.
+//
+// The file starts with a header and a table of sections, each with
+// its own checksum, so it can be memory-mapped and validated in place
+// without building an Object tree. Saving compares the checksums with
+// the existing file and skips the write when nothing changed.
+
+#ifndef LIBTORRENT_UTILS_RESUME_BINARY_H
+#define LIBTORRENT_UTILS_RESUME_BINARY_H
+
+#include <cinttypes>
+#include <string>
+#include <string_view>
+#include <torrent/common.h>
+
+namespace torrent {
+
+class LIBTORRENT_EXPORT resume_binary {
+public:
+  enum section_type : uint16_t {
+    section_bitfield = 1,
+    section_files,
+    section_uncertain,
+    section_peers,
+    section_trackers,
+    section_max
+  };
+
+  static constexpr uint32_t magic   = 0x4c545242; // "LTRB"
+  static constexpr uint16_t version = 2;
+
+  static constexpr uint32_t header_size = 8;
+  static constexpr uint32_t entry_size  = 16;
+
+  resume_binary() = default;
+  ~resume_binary() {
+    close();
+  }
+
+  resume_binary(const resume_binary&)            = delete;
+  resume_binary& operator=(const resume_binary&) = delete;
+
+  bool is_open() const {
+    return m_data != nullptr;
+  }
+
+  const char* data() const {
+    return m_data;
+  }
+  size_t size() const {
+    return m_size;
+  }
+
+  // Validate the header, section table and checksums of 'data', which
+  // must outlive this object. Returns false if anything is invalid.
+  bool open(const char* data, size_t size);
+
+  // Map 'path' read-only and validate it in place.
+  bool open_file(const std::string& path);
+
+  void close();
+
+  bool has_section(section_type type) const {
+    return type < section_max && m_sections[type].data() != nullptr;
+  }
+  std::string_view section(section_type type) const {
+    return has_section(type) ? m_sections[type] : std::string_view();
+  }
+
+  static uint32_t checksum(const char* data, size_t size);
+
+private:
+  const char* m_data{ nullptr };
+  size_t      m_size{ 0 };
+  bool        m_mapped{ false };
+
+  std::string_view m_sections[section_max];
+};
+
+// Convert the bencoded resume fields, as written by the
+// 'resume_save_*' functions, to the binary form and back. Unknown
+// keys are not carried over.
+std::string
+resume_binary_encode(const Object& object) LIBTORRENT_EXPORT;
+
+// Peers are left out unless 'with_peers' is set, as
+// 'resume_binary_load_addresses' reads them directly.
+bool
+resume_binary_decode(const resume_binary& binary,
+                     Object&              object,
+                     bool                 with_peers = true) LIBTORRENT_EXPORT;
+
+void
+resume_binary_load_addresses(Download             download,
+                             const resume_binary& binary) LIBTORRENT_EXPORT;
+
+// Write 'encoded' to 'path' through a synced temporary file. Nothing
+// is written if the existing file has the same layout and checksums.
+// Returns the number of sections that changed, or -1 on error.
+int
+resume_binary_write(const std::string& path,
+                    const std::string& encoded) LIBTORRENT_EXPORT;
+
+} // namespace torrent
+
+#endif
@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2005-2011, Jari Sundell <jaris@ifi.uio.no>
+
+#ifndef LIBTORRENT_UTILS_DIFFIE_HELLMAN_POOL_H
+#define LIBTORRENT_UTILS_DIFFIE_HELLMAN_POOL_H
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include "utils/diffie_hellman.h"
+
+namespace torrent {
+
+// Precomputed Diffie-Hellman key pairs for encrypted handshakes,
+// refilled by a worker thread so that the modexp of key generation
+// does not stall the main thread during connection storms.
+//
+// Shared secrets may also be computed by the worker. The key is
+// handed over with the peer's public key and returned through
+// slot_secret_done() on the main thread once computed.
+class DiffieHellmanPool {
+public:
+  using key_ptr   = std::unique_ptr<DiffieHellman>;
+  using id_type   = const void*;
+  using size_type = uint32_t;
+
+  using slot_void        = std::function<void()>;
+  using slot_generate    = std::function<key_ptr()>;
+  using slot_secret_done = std::function<void(id_type, key_ptr, bool)>;
+
+  static constexpr size_type    default_target    = 32;
+  static constexpr unsigned int max_pubkey_length = 96;
+
+  size_type size();
+
+  size_type target() const {
+    return m_target;
+  }
+  void set_target(size_type target);
+
+  // Main thread functions.
+  //
+  // Returns a pooled key, or generates one inline if the pool has run
+  // dry. The worker is poked when the pool drops below half its
+  // target.
+  key_ptr acquire();
+
+  void compute_secret(id_type              id,
+                      key_ptr              key,
+                      const unsigned char* pubkey,
+                      unsigned int         length);
+
+  // Drop any pending or completed secret computation for 'id', it
+  // will not be delivered.
+  void cancel(id_type id);
+
+  // Deliver completed secrets through slot_secret_done().
+  void work();
+
+  // Worker thread function.
+  void perform();
+
+  slot_generate& slot_generate_key() {
+    return m_slot_generate;
+  }
+  slot_void& slot_need_work() {
+    return m_slot_need_work;
+  }
+  slot_void& slot_has_work() {
+    return m_slot_has_work;
+  }
+  slot_secret_done& slot_done() {
+    return m_slot_secret_done;
+  }
+
+private:
+  struct secret_job {
+    id_type       id;
+    key_ptr       key;
+    unsigned char pubkey[max_pubkey_length];
+    unsigned int  length;
+    bool          result;
+  };
+
+  std::mutex m_lock;
+
+  size_type           m_target{ default_target };
+  std::deque<key_ptr> m_keys;
+
+  std::deque<secret_job> m_pending;
+  std::deque<secret_job> m_done;
+
+  // Id of the job the worker is currently computing, cleared by
+  // cancel() to have the result discarded.
+  id_type m_performing{ nullptr };
+
+  slot_generate    m_slot_generate;
+  slot_void        m_slot_need_work;
+  slot_void        m_slot_has_work;
+  slot_secret_done m_slot_secret_done;
+};
+
+} // namespace torrent
+
+#endif
@@ -74,6 +74,11 @@ enum instrumentation_enum {
 
   INSTRUMENTATION_TRANSFER_PEER_INFO_UNACCOUNTED,
 
+  INSTRUMENTATION_TRANSFER_HAVE_MESSAGES,
+  INSTRUMENTATION_TRANSFER_HAVE_BYTES,
+
+  INSTRUMENTATION_TRANSFER_REQUESTS_REJECTED,
+
   INSTRUMENTATION_MAX_SIZE
 };
 
@@ -0,0 +1,83 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2005-2011, Jari Sundell <jaris@ifi.uio.no>
+
+#ifndef LIBTORRENT_UTILS_TOKEN_BUCKET_H
+#define LIBTORRENT_UTILS_TOKEN_BUCKET_H
+
+#include <algorithm>
+#include <cinttypes>
+
+#include "torrent/utils/timer.h"
+
+namespace torrent {
+
+// Token bucket admitting up to 'rate' events per second on average,
+// with bursts of up to 'burst' events. A rate of zero admits
+// everything.
+class TokenBucket {
+public:
+  bool is_unlimited() const {
+    return m_rate == 0;
+  }
+
+  uint32_t rate() const {
+    return m_rate;
+  }
+  uint32_t burst() const {
+    return m_burst;
+  }
+
+  void set_rate(uint32_t rate, uint32_t burst, utils::timer now) {
+    m_rate   = rate;
+    m_burst  = std::max<uint32_t>(burst, 1);
+    m_tokens = int64_t(m_burst) * token_scale;
+    m_last   = now;
+  }
+
+  bool can_consume(utils::timer now) {
+    if (is_unlimited())
+      return true;
+
+    refill(now);
+    return m_tokens >= token_scale;
+  }
+
+  bool try_consume(utils::timer now) {
+    if (!can_consume(now))
+      return false;
+
+    if (!is_unlimited())
+      m_tokens -= token_scale;
+
+    return true;
+  }
+
+private:
+  // Tokens are counted in millionths to refill from microsecond
+  // timestamps without rounding away slow rates.
+  static constexpr int64_t token_scale = 1000000;
+
+  void refill(utils::timer now) {
+    if (now <= m_last)
+      return;
+
+    int64_t elapsed = (now - m_last).usec();
+    int64_t full    = int64_t(m_burst) * token_scale;
+
+    if (elapsed >= (full - m_tokens) / m_rate + 1)
+      m_tokens = full;
+    else
+      m_tokens += elapsed * m_rate;
+
+    m_last = now;
+  }
+
+  uint32_t     m_rate{ 0 };
+  uint32_t     m_burst{ 1 };
+  int64_t      m_tokens{ 0 };
+  utils::timer m_last;
+};
+
+} // namespace torrent
+
+#endif
@@ -266,7 +266,13 @@ ChunkList::sync_chunk(ChunkListNode* node, std::pair<int, bool> options) {
     throw internal_error(
       "ChunkList::sync_chunk(...) got a node with invalid reference count.");
 
-  if (!node->chunk()->sync(options.first))
+  int64_t start   = utils::timer::current_usec();
+  bool    success = node->chunk()->sync(options.first);
+
+  m_manager->receive_sync(
+    m_device, m_chunk_size, utils::timer::current_usec() - start, success);
+
+  if (!success)
     return false;
 
   node->set_sync_triggered(true);
@@ -286,8 +292,9 @@ ChunkList::sync_chunk(ChunkListNode* node, std::pair<int, bool> options) {
 }
 
 uint32_t
-ChunkList::sync_chunks(int flags) {
-  LT_LOG_THIS(DEBUG, "Sync chunks: flags:%#x.", flags);
+ChunkList::sync_chunks(int flags, uint32_t max_chunks) {
+  LT_LOG_THIS(
+    DEBUG, "Sync chunks: flags:%#x max:%" PRIu32 ".", flags, max_chunks);
 
   Queue::iterator split;
 
@@ -305,6 +312,7 @@ ChunkList::sync_chunks(int flags) {
   // How does this interact with timers, should be make it so that
   // only areas with timers are (preferably) synced?
 
+  // Nodes are stored by index, so this orders them by file offset.
   std::sort(split, m_queue.end());
 
   // If we got enough diskspace and have not requested safe syncing,
@@ -322,8 +330,12 @@ ChunkList::sync_chunks(int flags) {
     split = partition_optimize(split, m_queue.end(), 50, 5, false);
 
   uint32_t failed = 0;
+  auto     last   = m_queue.end();
 
-  for (auto itr = split, last = m_queue.end(); itr != last; ++itr) {
+  if (static_cast<uint32_t>(std::distance(split, last)) > max_chunks)
+    last = split + max_chunks;
+
+  for (auto itr = split; itr != last; ++itr) {
 
     // We can easily skip pieces by swap_iter, so there should be no
     // problem being selective about the ranges we sync.
@@ -347,6 +359,9 @@ ChunkList::sync_chunks(int flags) {
       std::iter_swap(itr, split++);
   }
 
+  // Keep the chunks beyond 'max_chunks' queued.
+  split = std::rotate(split, last, m_queue.end());
+
   if (lt_log_is_valid(LOG_INSTRUMENTATION_MINCORE)) {
     instrumentation_update(INSTRUMENTATION_MINCORE_SYNC_SUCCESS,
                            std::distance(split, m_queue.end()));
@@ -0,0 +1,154 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2005-2011, Jari Sundell <jaris@ifi.uio.no>
+
+#include <algorithm>
+
+#include "data/hash_torrent.h"
+#include "globals.h"
+#include "torrent/exceptions.h"
+
+#include "data/hash_scheduler.h"
+
+namespace torrent {
+
+HashScheduler::~HashScheduler() {
+  if (!m_entries.empty())
+    destruct_error("HashScheduler::~HashScheduler() downloads still checking.");
+}
+
+bool
+HashScheduler::is_waiting(HashTorrent* torrent) const {
+  auto itr = m_entries.find(torrent);
+
+  if (itr == m_entries.end())
+    return false;
+
+  auto& waiting = m_devices.at(itr->second.device).waiting;
+
+  return std::find(waiting.begin(), waiting.end(), torrent) != waiting.end();
+}
+
+void
+HashScheduler::insert(HashTorrent* torrent, dev_t device) {
+  // Restarting a quick check keeps the existing entry.
+  if (!m_entries.emplace(torrent, entry_type{ device, 0 }).second)
+    return;
+
+  if (m_entries.size() == 1) {
+    m_bytesChecked = 0;
+    m_started      = cachedTime;
+  }
+
+  m_devices[device];
+}
+
+void
+HashScheduler::erase(HashTorrent* torrent) {
+  auto itr = m_entries.find(torrent);
+
+  if (itr == m_entries.end())
+    return;
+
+  // Device entries are kept as waking a download may erase others.
+  auto& device = m_devices[itr->second.device];
+
+  device.outstanding -= itr->second.outstanding;
+  device.waiting.remove(torrent);
+
+  m_entries.erase(itr);
+
+  wake(device);
+}
+
+bool
+HashScheduler::is_available(HashTorrent* torrent, uint64_t bytes) {
+  auto itr = m_entries.find(torrent);
+
+  if (itr == m_entries.end())
+    throw internal_error("HashScheduler::is_available(...) not inserted.");
+
+  auto& device = m_devices[itr->second.device];
+
+  if (device.outstanding == 0 ||
+      device.outstanding + bytes <= m_maxOutstanding)
+    return true;
+
+  if (std::find(device.waiting.begin(), device.waiting.end(), torrent) ==
+      device.waiting.end())
+    device.waiting.push_back(torrent);
+
+  return false;
+}
+
+void
+HashScheduler::acquire(HashTorrent* torrent, uint64_t bytes) {
+  auto itr = m_entries.find(torrent);
+
+  if (itr == m_entries.end())
+    throw internal_error("HashScheduler::acquire(...) not inserted.");
+
+  itr->second.outstanding += bytes;
+  m_devices[itr->second.device].outstanding += bytes;
+}
+
+void
+HashScheduler::release(HashTorrent* torrent, uint64_t bytes) {
+  auto itr = m_entries.find(torrent);
+
+  if (itr == m_entries.end())
+    throw internal_error("HashScheduler::release(...) not inserted.");
+
+  if (itr->second.outstanding < bytes)
+    throw internal_error("HashScheduler::release(...) bytes > outstanding.");
+
+  auto& device = m_devices[itr->second.device];
+
+  itr->second.outstanding -= bytes;
+  device.outstanding -= bytes;
+  m_bytesChecked += bytes;
+
+  wake(device);
+}
+
+// Resume waiting downloads in order until one of them finds the
+// device full again, which puts it back at the end of the queue.
+void
+HashScheduler::wake(device_type& device) {
+  for (auto count = device.waiting.size(); count != 0; count--) {
+    if (device.waiting.empty() ||
+        (device.outstanding != 0 && device.outstanding >= m_maxOutstanding))
+      return;
+
+    HashTorrent* torrent = device.waiting.front();
+    device.waiting.pop_front();
+
+    torrent->receive_budget();
+
+    if (!device.waiting.empty() && device.waiting.back() == torrent)
+      return;
+  }
+}
+
+hash_check_progress
+HashScheduler::progress() const {
+  hash_check_progress result{};
+
+  result.downloads     = m_entries.size();
+  result.bytes_checked = m_bytesChecked;
+  result.eta           = -1;
+
+  for (const auto& [torrent, entry] : m_entries)
+    result.bytes_remaining += torrent->bytes_remaining();
+
+  for (const auto& [dev, device] : m_devices)
+    result.waiting += device.waiting.size();
+
+  int64_t elapsed = (cachedTime - m_started).seconds();
+
+  if (!m_entries.empty() && m_bytesChecked != 0 && elapsed > 0)
+    result.eta = result.bytes_remaining / (m_bytesChecked / elapsed + 1);
+
+  return result;
+}
+
+} // namespace torrent
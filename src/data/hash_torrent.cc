@@ -3,7 +3,9 @@
 
 #include "data/chunk_list.h"
 #include "data/hash_queue.h"
+#include "data/hash_scheduler.h"
 #include "globals.h"
+#include "manager.h"
 #include "torrent/data/download_data.h"
 #include "torrent/exceptions.h"
 #include "torrent/utils/log.h"
@@ -43,6 +45,9 @@ HashTorrent::start(bool try_quick) {
 
   m_outstanding = 0;
 
+  m_scheduler = manager->hash_scheduler();
+  m_scheduler->insert(this, m_device);
+
   queue(try_quick);
   return m_position == m_chunk_list->size();
 }
@@ -51,6 +56,12 @@ void
 HashTorrent::clear() {
   LT_LOG_THIS(INFO, "Clear.", 0);
 
+  // Any outstanding chunks are ignored from now on, so give back
+  // their share of the device budget.
+  if (m_scheduler != nullptr)
+    m_scheduler->erase(this);
+
+  m_scheduler   = nullptr;
   m_outstanding = -1;
   m_position    = 0;
   m_errno       = static_cast<std::errc>(0);
@@ -78,6 +89,10 @@ HashTorrent::confirm_checked() {
   if (m_outstanding != 0)
     throw internal_error("HashTorrent::confirm_checked() m_outstanding != 0.");
 
+  if (m_scheduler != nullptr)
+    m_scheduler->erase(this);
+
+  m_scheduler   = nullptr;
   m_outstanding = -1;
 }
 
@@ -96,6 +111,8 @@ HashTorrent::receive_chunkdone(uint32_t index) {
   // trigger.
   m_outstanding--;
 
+  m_scheduler->release(this, m_chunk_list->chunk_size());
+
   queue(false);
 }
 
@@ -116,6 +133,24 @@ HashTorrent::receive_chunk_cleared(uint32_t index) {
 
   m_outstanding--;
   m_ranges.insert(index, index + 1);
+
+  m_scheduler->release(this, m_chunk_list->chunk_size());
+}
+
+// Called by HashScheduler when the device has room for more chunks.
+void
+HashTorrent::receive_budget() {
+  if (is_checking())
+    queue(false);
+}
+
+uint64_t
+HashTorrent::bytes_remaining() const {
+  if (m_outstanding < 0 || m_position >= m_chunk_list->size())
+    return 0;
+
+  return (uint64_t)(m_chunk_list->size() - m_position) *
+         m_chunk_list->chunk_size();
 }
 
 void
@@ -130,8 +165,8 @@ HashTorrent::queue(bool quick) {
     throw internal_error("HashTorrent::queue() called but it's not running.");
 
   while (m_position < m_chunk_list->size()) {
-    if (m_outstanding > 10 &&
-        m_outstanding * m_chunk_list->chunk_size() > (128 << 20))
+    if (!quick &&
+        !m_scheduler->is_available(this, m_chunk_list->chunk_size()))
       return;
 
     // Not very efficient, but this is seldomly done.
@@ -223,6 +258,7 @@ HashTorrent::queue(bool quick) {
       m_slot_check_chunk(handle);
 
     m_outstanding++;
+    m_scheduler->acquire(this, m_chunk_list->chunk_size());
   }
 
   if (m_outstanding == 0) {
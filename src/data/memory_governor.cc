@@ -0,0 +1,229 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2005-2011, Jari Sundell <jaris@ifi.uio.no>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <utility>
+
+#include "data/memory_governor.h"
+
+namespace torrent {
+
+static bool
+read_file(const std::string& path, std::string* content) {
+  std::ifstream file(path);
+
+  if (!file)
+    return false;
+
+  std::stringstream stream;
+  stream << file.rdbuf();
+
+  *content = stream.str();
+  return true;
+}
+
+MemoryGovernor::MemoryGovernor(std::string cgroup_root, std::string proc_root)
+  : m_cgroupRoot(std::move(cgroup_root))
+  , m_procRoot(std::move(proc_root)) {}
+
+memory_sample
+MemoryGovernor::sample() const {
+  memory_sample result;
+  std::string   path;
+  std::string   limit_path;
+  std::string   content;
+  bool          has_cgroup = cgroup_path(&path);
+
+  if (has_cgroup) {
+    result.cgroup_max = cgroup_limit(&limit_path);
+
+    // The usage must be that of the cgroup setting the limit, which
+    // includes any siblings sharing it.
+    std::string usage_path =
+      m_cgroupRoot + (result.cgroup_max != 0 ? limit_path : path);
+
+    if (read_file(usage_path + "/memory.current", &content))
+      result.cgroup_current = parse_memory_value(content);
+
+    if (read_file(usage_path + "/memory.stat", &content))
+      result.cgroup_file = parse_memory_stat(content, "active_file") +
+                           parse_memory_stat(content, "inactive_file");
+  }
+
+  // Use the pressure of the cgroup when available, as that is what
+  // memory.max stalls on, else that of the whole system.
+  if ((has_cgroup &&
+       read_file(m_cgroupRoot + path + "/memory.pressure", &content)) ||
+      read_file(m_procRoot + "/pressure/memory", &content))
+    result.has_pressure =
+      parse_pressure(content, &result.pressure_some, &result.pressure_full);
+
+  return result;
+}
+
+uint64_t
+MemoryGovernor::cgroup_max() const {
+  std::string limit_path;
+
+  return cgroup_limit(&limit_path);
+}
+
+uint64_t
+MemoryGovernor::next_limit(const memory_sample& sample,
+                           uint64_t             limit,
+                           uint64_t             usage,
+                           uint64_t             max) {
+  uint64_t target = max;
+
+  // A tenth of memory.max is left for the rest of the process. The
+  // page cache in memory.current, which includes the mapped chunks,
+  // is reclaimed by the kernel before memory.max is hit and so does
+  // not take from the headroom. Without memory.stat, 'usage' is at
+  // least known to be part of memory.current.
+  if (sample.cgroup_max != 0) {
+    uint64_t available = sample.cgroup_max - sample.cgroup_max / 10;
+    uint64_t used      = sample.cgroup_current;
+
+    if (sample.cgroup_file != 0)
+      used -= std::min(used, sample.cgroup_file);
+    else
+      available += usage;
+
+    target = available > used ? std::min(target, available - used) : 0;
+  }
+
+  if (sample.has_pressure) {
+    if (sample.pressure_some >= pressure_high)
+      target = std::min(target, std::min(limit, usage) / 4 * 3);
+    else if (sample.pressure_some >= pressure_low)
+      target = std::min(target, limit);
+    else
+      target = std::min(target, limit + max / 16);
+  }
+
+  return std::clamp(target, max / 8, max);
+}
+
+// Only the cgroup v2 entry, '0::<path>', is used. The root cgroup is
+// returned as an empty path.
+bool
+MemoryGovernor::parse_cgroup_path(const std::string& proc_cgroup,
+                                  std::string*       path) {
+  std::istringstream stream(proc_cgroup);
+  std::string        line;
+
+  while (std::getline(stream, line)) {
+    if (line.compare(0, 3, "0::") != 0)
+      continue;
+
+    *path = line.substr(3);
+
+    while (!path->empty() && path->back() == '/')
+      path->pop_back();
+
+    return true;
+  }
+
+  return false;
+}
+
+// Returns zero for 'max' and anything that isn't a number.
+uint64_t
+MemoryGovernor::parse_memory_value(const std::string& value) {
+  char*    end;
+  uint64_t result = std::strtoull(value.c_str(), &end, 10);
+
+  if (end == value.c_str() || (*end != '\0' && *end != '\n'))
+    return 0;
+
+  return result;
+}
+
+// Returns zero if 'key' isn't found.
+uint64_t
+MemoryGovernor::parse_memory_stat(const std::string& stat,
+                                  const std::string& key) {
+  std::istringstream stream(stat);
+  std::string        line;
+
+  while (std::getline(stream, line)) {
+    if (line.size() > key.size() && line[key.size()] == ' ' &&
+        line.compare(0, key.size(), key) == 0)
+      return parse_memory_value(line.substr(key.size() + 1));
+  }
+
+  return 0;
+}
+
+bool
+MemoryGovernor::parse_pressure(const std::string& pressure,
+                               uint32_t*          some,
+                               uint32_t*          full) {
+  std::istringstream stream(pressure);
+  std::string        line;
+  bool               found = false;
+
+  while (std::getline(stream, line)) {
+    char   type[5];
+    double avg10;
+
+    if (std::sscanf(line.c_str(), "%4s avg10=%lf", type, &avg10) != 2 ||
+        avg10 < 0.0)
+      continue;
+
+    uint32_t value = avg10 * 100.0 + 0.5;
+
+    if (std::string(type) == "some") {
+      *some = value;
+      found = true;
+    } else if (std::string(type) == "full") {
+      *full = value;
+    }
+  }
+
+  return found;
+}
+
+// A limit on any ancestor also applies to the process, so the
+// smallest one is used and 'limit_path' set to its cgroup.
+uint64_t
+MemoryGovernor::cgroup_limit(std::string* limit_path) const {
+  std::string path;
+  std::string content;
+  uint64_t    result = 0;
+
+  if (!cgroup_path(&path))
+    return 0;
+
+  while (true) {
+    if (read_file(m_cgroupRoot + path + "/memory.max", &content)) {
+      uint64_t value = parse_memory_value(content);
+
+      if (value != 0 && (result == 0 || value < result)) {
+        result      = value;
+        *limit_path = path;
+      }
+    }
+
+    if (path.empty())
+      break;
+
+    path.erase(path.rfind('/'));
+  }
+
+  return result;
+}
+
+bool
+MemoryGovernor::cgroup_path(std::string* path) const {
+  std::string content;
+
+  return read_file(m_procRoot + "/self/cgroup", &content) &&
+         parse_cgroup_path(content, path);
+}
+
+} // namespace torrent
@@ -7,6 +7,7 @@
 #include <sstream>
 
 #include "dht/dht_bucket.h"
+#include "dht/dht_distance.h"
 #include "dht/dht_router.h"
 #include "dht/dht_tracker.h"
 #include "dht/dht_transaction.h"
@@ -65,7 +66,8 @@ DhtRouter::DhtRouter(const Object& cache, const utils::socket_address* sa)
   LT_LOG_THIS("creating (address:%s)", sa->pretty_address_str().c_str());
 
   set_bucket(new DhtBucket(zero_id, ones_id));
-  m_routingTable.insert(std::make_pair(bucket()->id_range_end(), bucket()));
+  m_routingTable.reserve(HashString::size_data * 8 + 1);
+  m_routingTable.push_back(bucket());
 
   if (cache.has_key("nodes")) {
     const Object::map_type& nodes = cache.get_key_map("nodes");
@@ -101,8 +103,8 @@ DhtRouter::~DhtRouter() {
 
   delete m_contacts;
 
-  for (auto& bucket_pair : m_routingTable) {
-    delete bucket_pair.second;
+  for (auto& bucket : m_routingTable) {
+    delete bucket;
   }
 
   for (auto& tracker : m_trackers) {
@@ -138,7 +140,7 @@ DhtRouter::stop() {
 // Start a DHT get_peers and announce_peer request.
 void
 DhtRouter::announce(DownloadInfo* info, TrackerDht* tracker) {
-  m_server.announce(*find_bucket(info->hash())->second, info->hash(), tracker);
+  m_server.announce(*find_bucket(info->hash()), info->hash(), tracker);
 }
 
 // Cancel any running requests from the given tracker.
@@ -158,6 +160,11 @@ DhtRouter::get_tracker(const HashString& hash, bool create) {
   if (!create)
     return nullptr;
 
+  // Make room by dropping the trackers that were announced to least
+  // recently.
+  while (m_trackers.size() >= max_trackers)
+    evict_tracker();
+
   std::pair<DhtTrackerList::accessor, bool> res =
     m_trackers.insert(std::make_pair(hash, new DhtTracker()));
 
@@ -165,9 +172,46 @@ DhtRouter::get_tracker(const HashString& hash, bool create) {
     throw internal_error(
       "DhtRouter::get_tracker did not actually insert tracker.");
 
+  res.first.tracker()->age_position() =
+    m_trackerAge.insert(m_trackerAge.begin(), hash);
+
   return res.first.tracker();
 }
 
+void
+DhtRouter::add_peer(const HashString& hash,
+                    uint32_t          addr,
+                    uint16_t          port,
+                    bool              seed) {
+  DhtTracker* tracker = get_tracker(hash, true);
+
+  m_trackerAge.splice(
+    m_trackerAge.begin(), m_trackerAge, tracker->age_position());
+
+  if (tracker->add_peer(addr, port, seed))
+    m_trackerPeers++;
+
+  while (m_trackerPeers > max_tracker_peers && m_trackerAge.size() > 1)
+    evict_tracker();
+}
+
+void
+DhtRouter::evict_tracker() {
+  if (m_trackerAge.empty())
+    throw internal_error("DhtRouter::evict_tracker called with no trackers.");
+
+  DhtTrackerList::accessor itr = m_trackers.find(m_trackerAge.back());
+
+  if (itr == m_trackers.end())
+    throw internal_error("DhtRouter::evict_tracker could not find tracker.");
+
+  m_trackerPeers -= itr.tracker()->size();
+  m_trackerAge.pop_back();
+
+  delete itr.tracker();
+  m_trackers.erase(itr);
+}
+
 bool
 DhtRouter::want_node(const HashString& id) {
   // We don't want to add ourself.  Also, too many broken implementations
@@ -177,7 +221,7 @@ DhtRouter::want_node(const HashString& id) {
 
   // We are always interested in more nodes for our own bucket (causing it
   // to be split if full); in other buckets only if there's space.
-  DhtBucket* b = find_bucket(id)->second;
+  DhtBucket* b = find_bucket(id);
   return b == bucket() || b->has_space();
 }
 
@@ -195,20 +239,18 @@ DhtRouter::get_node(const HashString& id) {
   return itr.node();
 }
 
-DhtRouter::DhtBucketList::iterator
+DhtBucket*
 DhtRouter::find_bucket(const HashString& id) {
-  auto itr = m_routingTable.lower_bound(id);
+  size_t     depth = dht_common_prefix(id, this->id());
+  DhtBucket* b     = m_routingTable[std::min(depth, m_routingTable.size() - 1)];
 
 #ifdef LT_USE_EXTRA_DEBUG
-  if (itr == m_routingTable.end())
-    throw internal_error("DHT Buckets not covering entire ID space.");
-
-  if (!itr->second->is_in_range(id))
-    throw internal_error("DhtRouter::find_bucket, m_routingTable.lower_bound "
-                         "did not find correct bucket.");
+  if (!b->is_in_range(id))
+    throw internal_error(
+      "DhtRouter::find_bucket, prefix length did not find correct bucket.");
 #endif
 
-  return itr;
+  return b;
 }
 
 void
@@ -475,7 +517,7 @@ DhtRouter::receive_timeout() {
 
   // If bucket isn't full yet or hasn't received replies/queries from
   // its nodes for a while, try to find new nodes now.
-  for (const auto& [cur_id, cur_bucket] : m_routingTable) {
+  for (const auto& cur_bucket : m_routingTable) {
     cur_bucket->update();
 
     if (!cur_bucket->is_full() || cur_bucket == bucket() ||
@@ -484,11 +526,15 @@ DhtRouter::receive_timeout() {
   }
 
   // Remove old peers and empty torrents from the tracker.
+  m_trackerPeers = 0;
+
   for (DhtTrackerList::accessor itr = m_trackers.begin();
        itr != m_trackers.end();) {
     itr.tracker()->prune(timeout_peer_announce);
+    m_trackerPeers += itr.tracker()->size();
 
     if (itr.tracker()->empty()) {
+      m_trackerAge.erase(itr.tracker()->age_position());
       delete itr.tracker();
       m_trackers.erase(itr++);
 
@@ -537,19 +583,14 @@ DhtRouter::token_valid(raw_string token, const utils::socket_address* sa) {
 
 DhtNode*
 DhtRouter::find_node(const utils::socket_address* sa) {
-  for (DhtNodeList::accessor itr = m_nodes.begin(); itr != m_nodes.end(); ++itr)
-    if (itr.node()->address()->sa_inet()->address_n() ==
-        sa->sa_inet()->address_n())
-      return itr.node();
-
-  return nullptr;
+  return m_nodes.find_address(sa);
 }
 
-DhtRouter::DhtBucketList::iterator
-DhtRouter::split_bucket(const DhtBucketList::iterator& itr, DhtNode* node) {
-  // Split bucket. Current bucket keeps the upper half thus keeping the
-  // map key valid, new bucket is the lower half of the original bucket.
-  DhtBucket* newBucket = itr->second->split(id());
+DhtBucket*
+DhtRouter::split_bucket(DhtBucket* b, DhtNode* node) {
+  // Split bucket. Current bucket keeps the upper half, new bucket is
+  // the lower half of the original bucket.
+  DhtBucket* newBucket = b->split(id());
 
   // If our bucket has a child now (the new bucket), move ourself into it.
   if (bucket()->child() != nullptr)
@@ -559,33 +600,33 @@ DhtRouter::split_bucket(const DhtBucketList::iterator& itr, DhtNode* node) {
     throw internal_error(
       "DhtRouter::split_bucket router ID ended up in wrong bucket.");
 
-  // Insert new bucket with iterator hint = just before current bucket.
-  auto other = m_routingTable.insert(
-    itr, std::make_pair(newBucket->id_range_end(), newBucket));
+  // The half without our ID stays at the split bucket's depth, and our
+  // own bucket moves one level deeper.
+  m_routingTable.back() = bucket() == b ? newBucket : b;
+  m_routingTable.push_back(bucket());
 
   // Check that the bucket we're not adding the node to isn't empty.
-  if (other->second->is_in_range(node->id())) {
-    if (itr->second->empty())
-      bootstrap_bucket(itr->second);
+  if (newBucket->is_in_range(node->id())) {
+    if (b->empty())
+      bootstrap_bucket(b);
 
-  } else {
-    if (other->second->empty())
-      bootstrap_bucket(other->second);
-
-    other = itr;
+    return newBucket;
   }
 
-  return other;
+  if (newBucket->empty())
+    bootstrap_bucket(newBucket);
+
+  return b;
 }
 
 bool
 DhtRouter::add_node_to_bucket(DhtNode* node) {
-  auto itr = find_bucket(node->id());
+  DhtBucket* b = find_bucket(node->id());
 
-  while (itr->second->is_full()) {
+  while (b->is_full()) {
     // Bucket is full. If there are any bad nodes, remove the oldest.
-    auto nodeItr = itr->second->find_replacement_candidate();
-    if (nodeItr == itr->second->end())
+    auto nodeItr = b->find_replacement_candidate();
+    if (nodeItr == b->end())
       throw internal_error("DhtBucket::find_candidate returned no node.");
 
     if ((*nodeItr)->is_bad()) {
@@ -594,17 +635,17 @@ DhtRouter::add_node_to_bucket(DhtNode* node) {
     } else {
       // Bucket is full of good nodes; if our own ID falls in
       // range then split the bucket else discard new node.
-      if (itr->second != bucket()) {
+      if (b != bucket()) {
         delete_node(m_nodes.find(&node->id()));
         return false;
       }
 
-      itr = split_bucket(itr, node);
+      b = split_bucket(b, node);
     }
   }
 
-  itr->second->add_node(node);
-  node->set_bucket(itr->second);
+  b->add_node(node);
+  node->set_bucket(b);
   return true;
 }
 
@@ -614,12 +655,13 @@ DhtRouter::delete_node(const DhtNodeList::accessor& itr) {
     throw internal_error(
       "DhtRouter::delete_node called with invalid iterator.");
 
-  if (itr.node()->bucket() != nullptr)
-    itr.node()->bucket()->remove_node(itr.node());
+  DhtNode* node = itr.node();
 
-  delete itr.node();
+  if (node->bucket() != nullptr)
+    node->bucket()->remove_node(node);
 
-  m_nodes.erase(itr);
+  m_nodes.erase_node(itr);
+  delete node;
 }
 
 struct contact_node_t {
@@ -665,11 +707,11 @@ DhtRouter::bootstrap() {
   if (m_routingTable.size() < 2)
     return;
 
-  auto itr = m_routingTable.begin();
-  std::advance(itr, random_uniform_size(0, m_routingTable.size() - 1));
+  DhtBucket* b =
+    m_routingTable[random_uniform_size(0, m_routingTable.size() - 1)];
 
-  if (itr->second != bucket() && itr != m_routingTable.end())
-    bootstrap_bucket(itr->second);
+  if (b != bucket())
+    bootstrap_bucket(b);
 }
 
 void
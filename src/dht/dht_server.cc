@@ -47,6 +47,8 @@ const DhtMessage::key_list_type DhtMessage::base_type::keys = {
     key_a_port,
     "a::port",
   },
+  { key_a_scrape, "a::scrape" },
+  { key_a_seed, "a::seed" },
   { key_a_target, "a::target*S" },
   { key_a_token, "a::token*S" },
 
@@ -55,6 +57,8 @@ const DhtMessage::key_list_type DhtMessage::base_type::keys = {
 
   { key_q, "q*S" },
 
+  { key_r_BFpe, "r::BFpe*S" },
+  { key_r_BFsd, "r::BFsd*S" },
   { key_r_id, "r::id*S" },
   { key_r_nodes, "r::nodes*S" },
   { key_r_token, "r::token*S" },
@@ -86,6 +90,7 @@ private:
 
 DhtServer::DhtServer(DhtRouter* router)
   : m_router(router)
+  , m_readBuffer(max_batch * read_buffer_size)
   ,
 
   m_uploadNode(60)
@@ -361,6 +366,13 @@ DhtServer::create_get_peers_response(const DhtMessage&            req,
   } else {
     reply[key_r_values] = tracker->get_peers();
   }
+
+  // BEP 33 scrape.
+  if (tracker != nullptr && req[key_a_scrape].is_value() &&
+      req[key_a_scrape].as_value() == 1) {
+    reply[key_r_BFsd] = tracker->bloom_seeds();
+    reply[key_r_BFpe] = tracker->bloom_peers();
+  }
 }
 
 void
@@ -375,9 +387,12 @@ DhtServer::create_announce_peer_response(const DhtMessage&            req,
   if (!m_router->token_valid(req[key_a_token].as_raw_string(), sa))
     throw dht_error(dht_error_protocol, "Token invalid.");
 
-  DhtTracker* tracker =
-    m_router->get_tracker(*HashString::cast_from(info_hash.data()), true);
-  tracker->add_peer(sa->sa_inet()->address_n(), req[key_a_port].as_value());
+  bool seed = req[key_a_seed].is_value() && req[key_a_seed].as_value() == 1;
+
+  m_router->add_peer(*HashString::cast_from(info_hash.data()),
+                     sa->sa_inet()->address_n(),
+                     req[key_a_port].as_value(),
+                     seed);
 }
 
 void
@@ -821,199 +836,236 @@ DhtServer::clear_transactions() {
 
 void
 DhtServer::event_read() {
-  uint32_t total = 0;
+  uint32_t   total = 0;
+  read_entry entries[max_batch];
+
+  for (unsigned int i = 0; i < max_batch; i++) {
+    entries[i].buffer = m_readBuffer.data() + i * read_buffer_size;
+    entries[i].length = read_buffer_size;
+  }
 
   while (true) {
-    Object                request;
-    utils::socket_address sa;
-    int                   type = '?';
-    DhtMessage            message;
-    const HashString*     nodeId = nullptr;
+    int count = read_datagrams(entries, max_batch);
 
-    char buffer[2048];
+    for (int i = 0; i < count; i++)
+      process_datagram(static_cast<char*>(entries[i].buffer),
+                       entries[i].read,
+                       entries[i].address,
+                       &total);
 
-    try {
-      int32_t read = read_datagram(buffer, sizeof(buffer), &sa);
+    // A short batch means the socket has been drained.
+    if (count < static_cast<int>(max_batch))
+      break;
+  }
 
-      if (read < 0)
-        break;
+  m_downloadThrottle->node_used_unthrottled(total);
+  m_downloadNode.rate()->insert(total);
 
-      // We can currently only process mapped-IPv4 addresses, not real IPv6.
-      // Translate them to an af_inet socket_address.
-      if (sa.family() == utils::socket_address::af_inet6)
-        sa = sa.sa_inet6()->normalize_address();
+  dequeue_transaction();
+  start_write();
+}
 
-      if (sa.family() != utils::socket_address::af_inet)
-        continue;
+void
+DhtServer::process_datagram(char*                  buffer,
+                            int32_t                read,
+                            utils::socket_address& sa,
+                            uint32_t*              total) {
+  int               type = '?';
+  DhtMessage        message;
+  const HashString* nodeId = nullptr;
 
-      total += read;
+  try {
+    // We can currently only process mapped-IPv4 addresses, not real IPv6.
+    // Translate them to an af_inet socket_address.
+    if (sa.family() == utils::socket_address::af_inet6)
+      sa = sa.sa_inet6()->normalize_address();
 
-      // If it's not a valid bencode dictionary at all, it's probably not a DHT
-      // packet at all, so we don't throw an error to prevent bounce loops.
-      try {
-        static_map_read_bencode(buffer, buffer + read, message);
-      } catch (bencode_error& e) {
-        continue;
-      }
+    if (sa.family() != utils::socket_address::af_inet)
+      return;
 
-      if (!message[key_t].is_raw_string())
-        throw dht_error(dht_error_protocol, "No transaction ID");
+    *total += read;
 
-      // Restrict the length of Transaction IDs. We echo them in our replies.
-      if (message[key_t].as_raw_string().size() > 20) {
-        throw dht_error(dht_error_protocol, "Transaction ID length too long");
-      }
+    // If it's not a valid bencode dictionary at all, it's probably not a DHT
+    // packet at all, so we don't throw an error to prevent bounce loops.
+    try {
+      static_map_read_bencode(buffer, buffer + read, message);
+    } catch (bencode_error& e) {
+      return;
+    }
 
-      if (!message[key_y].is_raw_string())
-        throw dht_error(dht_error_protocol, "No message type");
+    if (!message[key_t].is_raw_string())
+      throw dht_error(dht_error_protocol, "No transaction ID");
 
-      if (message[key_y].as_raw_string().size() != 1)
-        throw dht_error(dht_error_bad_method, "Unsupported message type");
+    // Restrict the length of Transaction IDs. We echo them in our replies.
+    if (message[key_t].as_raw_string().size() > 20) {
+      throw dht_error(dht_error_protocol, "Transaction ID length too long");
+    }
 
-      type = message[key_y].as_raw_string().data()[0];
+    if (!message[key_y].is_raw_string())
+      throw dht_error(dht_error_protocol, "No message type");
 
-      // Queries and replies have node ID in different dictionaries.
-      if (type == 'r' || type == 'q') {
-        if (!message[type == 'q' ? key_a_id : key_r_id].is_raw_string())
-          throw dht_error(dht_error_protocol, "Invalid `id' value");
+    if (message[key_y].as_raw_string().size() != 1)
+      throw dht_error(dht_error_bad_method, "Unsupported message type");
 
-        raw_string nodeIdStr =
-          message[type == 'q' ? key_a_id : key_r_id].as_raw_string();
+    type = message[key_y].as_raw_string().data()[0];
 
-        if (nodeIdStr.size() < HashString::size_data)
-          throw dht_error(dht_error_protocol, "`id' value too short");
+    // Queries and replies have node ID in different dictionaries.
+    if (type == 'r' || type == 'q') {
+      if (!message[type == 'q' ? key_a_id : key_r_id].is_raw_string())
+        throw dht_error(dht_error_protocol, "Invalid `id' value");
 
-        nodeId = HashString::cast_from(nodeIdStr.data());
+      raw_string nodeIdStr =
+        message[type == 'q' ? key_a_id : key_r_id].as_raw_string();
 
-        if (nodeId == nullptr) {
-          throw bencode_error("Failed to parse nodeId.");
-        }
-      }
+      if (nodeIdStr.size() < HashString::size_data)
+        throw dht_error(dht_error_protocol, "`id' value too short");
 
-      // Sanity check the returned transaction ID.
-      if ((type == 'r' || type == 'e') &&
-          (!message[key_t].is_raw_string() ||
-           message[key_t].as_raw_string().size() != 1))
-        throw dht_error(dht_error_protocol,
-                        "Invalid transaction ID type/length.");
+      nodeId = HashString::cast_from(nodeIdStr.data());
 
-      // Stupid broken implementations.
-      if (nodeId != nullptr && *nodeId == m_router->id())
-        throw dht_error(dht_error_protocol, "Send your own ID, not mine");
+      if (nodeId == nullptr) {
+        throw bencode_error("Failed to parse nodeId.");
+      }
+    }
 
-      switch (type) {
-        case 'q':
-          process_query(*nodeId, &sa, message);
-          break;
+    // Sanity check the returned transaction ID.
+    if ((type == 'r' || type == 'e') &&
+        (!message[key_t].is_raw_string() ||
+         message[key_t].as_raw_string().size() != 1))
+      throw dht_error(dht_error_protocol,
+                      "Invalid transaction ID type/length.");
 
-        case 'r':
-          process_response(*nodeId, &sa, message);
-          break;
+    // Stupid broken implementations.
+    if (nodeId != nullptr && *nodeId == m_router->id())
+      throw dht_error(dht_error_protocol, "Send your own ID, not mine");
 
-        case 'e':
-          process_error(&sa, message);
-          break;
+    switch (type) {
+      case 'q':
+        process_query(*nodeId, &sa, message);
+        break;
 
-        default:
-          throw dht_error(dht_error_bad_method, "Unknown message type.");
-      }
+      case 'r':
+        process_response(*nodeId, &sa, message);
+        break;
 
-      // If node was querying us, reply with error packet, otherwise mark the
-      // node as "query failed", so that if it repeatedly sends malformed
-      // replies we will drop it instead of propagating it to other nodes.
-    } catch (bencode_error& e) {
-      if ((type == 'r' || type == 'e') && nodeId != nullptr) {
-        m_router->node_inactive(*nodeId, &sa);
-      } else {
-        snprintf(message.data_end,
-                 message.data + message.data_size - message.data_end - 1,
-                 "Malformed packet: %s",
-                 e.what());
-        message.data[message.data_size - 1] = '\0';
-        create_error(message, &sa, dht_error_protocol, message.data_end);
-      }
+      case 'e':
+        process_error(&sa, message);
+        break;
 
-    } catch (dht_error& e) {
-      if ((type == 'r' || type == 'e') && nodeId != nullptr)
-        m_router->node_inactive(*nodeId, &sa);
-      else
-        create_error(message, &sa, e.code(), e.what());
+      default:
+        throw dht_error(dht_error_bad_method, "Unknown message type.");
+    }
 
-    } catch (network_error& e) {
+    // If node was querying us, reply with error packet, otherwise mark the
+    // node as "query failed", so that if it repeatedly sends malformed
+    // replies we will drop it instead of propagating it to other nodes.
+  } catch (bencode_error& e) {
+    if ((type == 'r' || type == 'e') && nodeId != nullptr) {
+      m_router->node_inactive(*nodeId, &sa);
+    } else {
+      snprintf(message.data_end,
+               message.data + message.data_size - message.data_end - 1,
+               "Malformed packet: %s",
+               e.what());
+      message.data[message.data_size - 1] = '\0';
+      create_error(message, &sa, dht_error_protocol, message.data_end);
     }
-  }
 
-  m_downloadThrottle->node_used_unthrottled(total);
-  m_downloadNode.rate()->insert(total);
+  } catch (dht_error& e) {
+    if ((type == 'r' || type == 'e') && nodeId != nullptr)
+      m_router->node_inactive(*nodeId, &sa);
+    else
+      create_error(message, &sa, e.code(), e.what());
 
-  dequeue_transaction();
-  start_write();
+  } catch (network_error& e) {
+  }
 }
 
 bool
 DhtServer::process_queue(packet_queue& queue, uint32_t* quota) {
-  uint32_t used = 0;
-
-  while (!queue.empty()) {
-    DhtTransactionPacket*    packet         = queue.front();
-    DhtTransaction::key_type transactionKey = 0;
-    if (packet->has_transaction())
-      transactionKey = packet->transaction()->key(packet->id());
-
-    // Make sure its transaction hasn't timed out yet, if it has/had one
-    // and don't bother sending non-transaction packets (replies) after
-    // more than 15 seconds in the queue.
-    if (packet->has_failed() || packet->age() > 15) {
-      delete packet;
-      queue.pop_front();
-      continue;
-    }
+  uint32_t used       = 0;
+  bool     quota_left = true;
+
+  while (!queue.empty() && quota_left) {
+    DhtTransactionPacket*    packets[max_batch];
+    DhtTransaction::key_type keys[max_batch];
+    write_entry              entries[max_batch];
+
+    unsigned int count  = 0;
+    uint32_t     length = 0;
+
+    while (!queue.empty() && count < max_batch) {
+      DhtTransactionPacket* packet = queue.front();
+
+      // Make sure its transaction hasn't timed out yet, if it has/had one
+      // and don't bother sending non-transaction packets (replies) after
+      // more than 15 seconds in the queue.
+      if (packet->has_failed() || packet->age() > 15) {
+        delete packet;
+        queue.pop_front();
+        continue;
+      }
 
-    if (packet->length() > *quota) {
-      m_uploadThrottle->node_used(&m_uploadNode, used);
-      return false;
-    }
+      if (length + packet->length() > *quota) {
+        quota_left = false;
+        break;
+      }
 
-    queue.pop_front();
+      queue.pop_front();
+      length += packet->length();
+
+      packets[count] = packet;
+      keys[count] =
+        packet->has_transaction() ? packet->transaction()->key(packet->id()) : 0;
+      entries[count] = { packet->c_str(),
+                         static_cast<unsigned int>(packet->length()),
+                         packet->address(),
+                         0 };
+      count++;
+    }
 
-    try {
-      int written =
-        write_datagram(packet->c_str(), packet->length(), packet->address());
+    write_datagrams(entries, count);
 
-      if (written == -1)
-        throw network_error();
+    for (unsigned int i = 0; i < count; i++) {
+      DhtTransactionPacket* packet  = packets[i];
+      int                   written = entries[i].written;
 
-      used += written;
-      *quota -= written;
+      if (written > 0) {
+        used += written;
+        *quota -= written;
+      }
 
-      if ((unsigned int)written != packet->length())
-        throw network_error();
+      // The transaction may have been deleted while handling an earlier
+      // packet in the batch.
+      if (packet->has_failed()) {
+        delete packet;
+        continue;
+      }
 
-    } catch (network_error& e) {
       // Couldn't write packet, maybe something wrong with node address or
       // routing, so mark node as bad.
-      if (packet->has_transaction()) {
-        auto itr = m_transactions.find(transactionKey);
+      if ((unsigned int)written != packet->length() &&
+          packet->has_transaction()) {
+        auto itr = m_transactions.find(keys[i]);
         if (itr == m_transactions.end())
           throw internal_error(
             "DhtServer::process_queue could not find transaction.");
 
         failed_transaction(itr, false);
       }
-    }
 
-    if (packet->has_transaction()) {
-      // here transaction can be already deleted by failed_transaction.
-      auto itr = m_transactions.find(transactionKey);
-      if (itr != m_transactions.end())
-        packet->transaction()->set_packet(nullptr);
-    }
+      if (packet->has_transaction()) {
+        // here transaction can be already deleted by failed_transaction.
+        auto itr = m_transactions.find(keys[i]);
+        if (itr != m_transactions.end())
+          packet->transaction()->set_packet(nullptr);
+      }
 
-    delete packet;
+      delete packet;
+    }
   }
 
   m_uploadThrottle->node_used(&m_uploadNode, used);
-  return true;
+  return quota_left;
 }
 
 void
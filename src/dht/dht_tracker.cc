@@ -1,45 +1,60 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 // Copyright (C) 2005-2011, Jari Sundell <jaris@ifi.uio.no>
 
+#include <algorithm>
+#include <cstring>
+
 #include "dht/dht_tracker.h"
 #include "torrent/object.h"
 #include "torrent/utils/random.h"
+#include "utils/sha1.h"
 
 namespace torrent {
 
-void
-DhtTracker::add_peer(uint32_t addr, uint16_t port) {
+bool
+DhtTracker::add_peer(uint32_t addr, uint16_t port, bool seed) {
   if (port == 0)
-    return;
+    return false;
 
   SocketAddressCompact compact(addr, port);
 
-  unsigned int oldest  = 0;
-  uint32_t     minSeen = ~uint32_t();
+  // Check if peer exists.
+  auto itr = m_index.find(addr);
 
-  // Check if peer exists. If not, find oldest peer.
-  for (unsigned int i = 0; i < size(); i++) {
-    if (m_peers[i].peer.addr == compact.addr) {
-      m_peers[i].peer.port = compact.port;
-      m_lastSeen[i]        = cachedTime.seconds();
-      return;
+  if (itr != m_index.end()) {
+    if (m_seed[itr->second] != seed)
+      m_bloomValid = false;
 
-    } else if (m_lastSeen[i] < minSeen) {
-      minSeen = m_lastSeen[i];
-      oldest  = i;
-    }
+    m_peers[itr->second].peer.port = compact.port;
+    m_lastSeen[itr->second]        = cachedTime.seconds();
+    m_seed[itr->second]            = seed;
+    return false;
   }
 
+  m_bloomValid = false;
+
   // If peer doesn't exist, append to list if the table is not full.
   if (size() < max_size) {
+    m_index.emplace(addr, size());
     m_peers.push_back(compact);
     m_lastSeen.push_back(cachedTime.seconds());
-
-    // Peer doesn't exist and table is full: replace oldest peer.
-  } else {
-    m_peers[oldest]    = compact;
-    m_lastSeen[oldest] = cachedTime.seconds();
+    m_seed.push_back(seed);
+    return true;
   }
+
+  // Peer doesn't exist and table is full: replace oldest peer. The
+  // table size is bounded, so this scan is too.
+  unsigned int oldest =
+    std::distance(m_lastSeen.begin(),
+                  std::min_element(m_lastSeen.begin(), m_lastSeen.end()));
+
+  m_index.erase(uint32_t(m_peers[oldest].peer.addr));
+  m_index.emplace(addr, oldest);
+
+  m_peers[oldest]    = compact;
+  m_lastSeen[oldest] = cachedTime.seconds();
+  m_seed[oldest]     = seed;
+  return false;
 }
 
 // Return compact info as bencoded string (8 bytes per peer) for up to 30 peers,
@@ -64,28 +79,81 @@ DhtTracker::get_peers(unsigned int maxPeers) {
                   distance(first, last) * sizeof(BencodeAddress));
 }
 
+raw_string
+DhtTracker::bloom_seeds() {
+  if (!m_bloomValid)
+    build_bloom();
+
+  return raw_string(m_bloomSeeds, bloom_size);
+}
+
+raw_string
+DhtTracker::bloom_peers() {
+  if (!m_bloomValid)
+    build_bloom();
+
+  return raw_string(m_bloomPeers, bloom_size);
+}
+
 // Remove old announces.
 void
 DhtTracker::prune(uint32_t maxAge) {
   uint32_t minSeen = cachedTime.seconds() - maxAge;
 
-  for (unsigned int i = 0; i < m_lastSeen.size(); i++)
-    if (m_lastSeen[i] < minSeen)
-      m_peers[i].peer.port = 0;
-
-  m_peers.erase(std::remove_if(m_peers.begin(),
-                               m_peers.end(),
-                               std::mem_fn(&BencodeAddress::empty)),
-                m_peers.end());
-  m_lastSeen.erase(std::remove_if(m_lastSeen.begin(),
-                                  m_lastSeen.end(),
-                                  [minSeen](uint32_t seen) {
-                                    return std::less<uint32_t>()(seen, minSeen);
-                                  }),
-                   m_lastSeen.end());
-
-  if (m_peers.size() != m_lastSeen.size())
+  for (unsigned int i = m_lastSeen.size(); i > 0; i--)
+    if (m_lastSeen[i - 1] < minSeen)
+      erase(i - 1);
+
+  if (m_peers.size() != m_lastSeen.size() || m_peers.size() != m_index.size())
     throw internal_error("DhtTracker::prune did inconsistent peer pruning.");
 }
 
+void
+DhtTracker::erase(unsigned int index) {
+  m_index.erase(uint32_t(m_peers[index].peer.addr));
+  m_bloomValid = false;
+
+  if (index != m_peers.size() - 1) {
+    m_peers[index]    = m_peers.back();
+    m_lastSeen[index] = m_lastSeen.back();
+    m_seed[index]     = m_seed.back();
+
+    m_index[uint32_t(m_peers[index].peer.addr)] = index;
+  }
+
+  m_peers.pop_back();
+  m_lastSeen.pop_back();
+  m_seed.pop_back();
+}
+
+// Bloom filter with 2048 bits and two hash functions taken from the
+// SHA1 of the address, as specified by BEP 33.
+void
+DhtTracker::build_bloom() {
+  std::memset(m_bloomSeeds, 0, bloom_size);
+  std::memset(m_bloomPeers, 0, bloom_size);
+
+  for (unsigned int i = 0; i < m_peers.size(); i++) {
+    char* bloom = m_seed[i] ? m_bloomSeeds : m_bloomPeers;
+    char  hash[20];
+
+    uint32_t addr = m_peers[i].peer.addr;
+
+    Sha1 sha;
+    sha.init();
+    sha.update(&addr, sizeof(addr));
+    sha.final_c(hash);
+
+    unsigned int index1 =
+      ((uint8_t)hash[0] | ((uint8_t)hash[1] << 8)) % (bloom_size * 8);
+    unsigned int index2 =
+      ((uint8_t)hash[2] | ((uint8_t)hash[3] << 8)) % (bloom_size * 8);
+
+    bloom[index1 / 8] |= 1 << (index1 % 8);
+    bloom[index2 / 8] |= 1 << (index2 % 8);
+  }
+
+  m_bloomValid = true;
+}
+
 } // namespace torrent
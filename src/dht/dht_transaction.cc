@@ -11,7 +11,7 @@
 namespace torrent {
 
 DhtSearch::DhtSearch(const HashString* target, const DhtBucket& contacts)
-  : base_type(get_dht_compare_closer(*target))
+  : base_type(dht_compare_closer(target))
   , m_next(end())
   , m_target(target) {
 
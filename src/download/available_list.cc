@@ -6,62 +6,197 @@
 
 #include "download/available_list.h"
 #include "torrent/exceptions.h"
+#include "torrent/peer/peer_info.h"
 #include "torrent/utils/random.h"
 
 namespace torrent {
 
+void
+AvailableList::clear() {
+  base_type::clear();
+  m_scores.clear();
+  m_index.clear();
+}
+
+void
+AvailableList::reserve(size_type s) {
+  base_type::reserve(s);
+  m_scores.reserve(s);
+  m_index.reserve(s);
+}
+
 AvailableList::value_type
-AvailableList::pop_random() {
+AvailableList::pop_best() {
   if (empty())
     throw internal_error(
-      "AvailableList::pop_random() called on an empty container");
+      "AvailableList::pop_best() called on an empty container");
 
-  size_type idx = random_uniform_size(0, size() - 1);
+  value_type tmp = front();
 
-  value_type tmp   = *(begin() + idx);
-  *(begin() + idx) = back();
+  erase(begin());
+  return tmp;
+}
 
-  pop_back();
+bool
+AvailableList::push_back(const utils::socket_address* sa, score_type value) {
+  if (!socket_address_key::is_comparable_sockaddr(sa->c_sockaddr()))
+    return false;
 
-  return tmp;
+  if (!m_index.emplace(*sa, size()).second)
+    return false;
+
+  base_type::push_back(*sa);
+  m_scores.push_back(value);
+
+  sift_up(size() - 1);
+  return true;
+}
+
+AvailableList::size_type
+AvailableList::insert(const AddressList* l, int source) {
+  if (!want_more())
+    return 0;
+
+  if (size() + l->size() > capacity())
+    reserve(size() + l->size());
+
+  size_type inserted = 0;
+
+  for (const auto& sa : *l)
+    inserted += push_back(&sa, score(nullptr, source));
+
+  return inserted;
 }
 
 void
-AvailableList::push_back(const utils::socket_address* sa) {
-  if (std::find(begin(), end(), *sa) != end())
+AvailableList::update(const utils::socket_address& sa, score_type value) {
+  auto itr = m_index.find(sa);
+
+  if (itr == m_index.end())
     return;
 
-  base_type::push_back(*sa);
+  m_scores[itr->second] = value;
+  sift_down(sift_up(itr->second));
 }
 
 void
-AvailableList::insert(AddressList* l) {
-  if (!want_more())
-    return;
+AvailableList::erase(const utils::socket_address& sa) {
+  auto itr = m_index.find(sa);
+
+  if (itr != m_index.end())
+    erase(begin() + itr->second);
+}
+
+void
+AvailableList::erase(iterator itr) {
+  auto index_itr = m_index.find(*itr);
+
+  if (index_itr == m_index.end())
+    throw internal_error("AvailableList::erase(...) address not indexed.");
 
-  std::sort(begin(), end());
+  m_index.erase(index_itr);
 
-  // Can i use use the std::remove* semantics for this, and just copy
-  // to 'l'?.
-  //
-  // 'l' is guaranteed to be sorted, so we can just do
-  // std::set_difference.
-  AddressList difference;
-  std::set_difference(
-    l->begin(), l->end(), begin(), end(), std::back_inserter(difference));
+  size_type pos = std::distance(begin(), itr);
 
-  std::copy(difference.begin(),
-            difference.end(),
-            std::back_inserter(*static_cast<base_type*>(this)));
+  if (pos != size() - 1) {
+    *itr             = back();
+    m_scores[pos]    = m_scores.back();
+    m_index.at(*itr) = pos;
+  }
+
+  base_type::pop_back();
+  m_scores.pop_back();
+
+  if (pos < size())
+    sift_down(sift_up(pos));
+}
+
+AvailableList::score_type
+AvailableList::score(const PeerInfo* peerInfo, int source, uint32_t now) {
+  int tier = 1 << 13;
+
+  switch (source) {
+  case source_pex:
+    tier += 256;
+    break;
+  case source_tracker:
+  case source_reconnect:
+    tier += 128;
+    break;
+  case source_resume:
+    tier += 64;
+    break;
+  default:
+    break;
+  }
+
+  if (peerInfo != nullptr) {
+    // Peers we've had a connection with are known to be reachable,
+    // and those that sent us data rank by log2 of 16 KiB blocks.
+    if (peerInfo->last_connection() != 0)
+      tier += 512;
+
+    for (uint64_t blocks = peerInfo->downloaded() >> 14; blocks != 0;
+         blocks >>= 1)
+      tier += 32;
+
+    tier -= 256 * int(std::min<uint32_t>(peerInfo->failed_counter(), 8));
+
+    uint32_t failures = std::min<uint32_t>(peerInfo->failed_handshakes(), 8);
+
+    tier -= 512 * int(failures);
+
+    if (failures != 0 && now < peerInfo->last_handshake() + (30u << failures))
+      tier -= 1024;
+  }
+
+  tier = std::clamp(tier, 1, 0xffff);
+
+  return (score_type(tier) << 16) | random_uniform_uint16(0, 0xffff);
 }
 
 void
-AvailableList::erase(const utils::socket_address& sa) {
-  auto itr = std::find(begin(), end(), sa);
+AvailableList::swap_positions(size_type a, size_type b) {
+  std::swap((*this)[a], (*this)[b]);
+  std::swap(m_scores[a], m_scores[b]);
+
+  m_index.at((*this)[a]) = a;
+  m_index.at((*this)[b]) = b;
+}
+
+AvailableList::size_type
+AvailableList::sift_up(size_type pos) {
+  while (pos != 0) {
+    size_type parent = (pos - 1) / 2;
+
+    if (m_scores[parent] >= m_scores[pos])
+      break;
+
+    swap_positions(parent, pos);
+    pos = parent;
+  }
+
+  return pos;
+}
+
+void
+AvailableList::sift_down(size_type pos) {
+  while (true) {
+    size_type largest = pos;
+    size_type left    = 2 * pos + 1;
+    size_type right   = 2 * pos + 2;
+
+    if (left < size() && m_scores[left] > m_scores[largest])
+      largest = left;
+
+    if (right < size() && m_scores[right] > m_scores[largest])
+      largest = right;
+
+    if (largest == pos)
+      return;
 
-  if (itr != end()) {
-    *itr = back();
-    pop_back();
+    swap_positions(pos, largest);
+    pos = largest;
   }
 }
 
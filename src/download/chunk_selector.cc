@@ -5,6 +5,7 @@
 
 #include "download/chunk_selector.h"
 #include "download/chunk_statistics.h"
+#include "globals.h"
 #include "protocol/peer_chunks.h"
 #include "torrent/exceptions.h"
 #include "torrent/utils/random.h"
@@ -64,6 +65,15 @@ ChunkSelector::find(PeerChunks* pc, bool) {
   if (m_position == invalid_chunk)
     return invalid_chunk;
 
+  // Chunks the peer suggested are likely in its page cache.
+  while (!pc->suggested()->empty()) {
+    uint32_t index = pc->suggested()->back();
+    pc->suggested()->pop_back();
+
+    if (pc->bitfield()->get(index) && is_wanted(index))
+      return index;
+  }
+
   // When we're a seeder, 'm_sharedQueue' is used. Since the peer's
   // bitfield is guaranteed to be filled we can use the same code as
   // for non-seeders. This generalization does incur a slight
@@ -133,6 +143,65 @@ ChunkSelector::find(PeerChunks* pc, bool) {
   return pos;
 }
 
+void
+ChunkSelector::set_deadline(uint32_t playhead,
+                            uint32_t window,
+                            uint32_t interval_ms) {
+  // Chunks the playhead moved past that were due but never completed
+  // are counted as missed.
+  uint32_t last = std::min(playhead, m_deadlinePlayhead + m_deadlineWindow);
+
+  for (uint32_t index = m_deadlinePlayhead; index < last && index < size();
+       index++)
+    if (!m_data->completed_bitfield()->get(index) &&
+        deadline(index) <= cachedTime)
+      m_deadlineMisses++;
+
+  m_deadlinePlayhead = playhead;
+  m_deadlineWindow   = window;
+  m_deadlineStart    = cachedTime;
+  m_deadlineInterval = utils::timer::from_milliseconds(interval_ms);
+}
+
+utils::timer
+ChunkSelector::deadline(uint32_t index) const {
+  if (index < m_deadlinePlayhead ||
+      index - m_deadlinePlayhead >= m_deadlineWindow)
+    return utils::timer();
+
+  return m_deadlineStart + m_deadlineInterval * (index - m_deadlinePlayhead);
+}
+
+uint32_t
+ChunkSelector::find_deadline(PeerChunks* pc) const {
+  uint32_t last = std::min<uint64_t>(
+    size(), uint64_t(m_deadlinePlayhead) + m_deadlineWindow);
+
+  for (uint32_t index = m_deadlinePlayhead; index < last; index++)
+    if (pc->bitfield()->get(index) && is_wanted(index))
+      return index;
+
+  return invalid_chunk;
+}
+
+void
+ChunkSelector::received_deadline_chunk(uint32_t index) {
+  utils::timer due = deadline(index);
+
+  if (due == utils::timer() || cachedTime <= due)
+    return;
+
+  m_deadlineMisses++;
+
+  // Overlapping stalls are only counted once.
+  utils::timer stall_start = std::max(due, m_deadlineStalledTo);
+
+  if (cachedTime > stall_start)
+    m_deadlineStall += (cachedTime - stall_start).usec();
+
+  m_deadlineStalledTo = std::max(m_deadlineStalledTo, cachedTime);
+}
+
 bool
 ChunkSelector::is_wanted(uint32_t index) const {
   return m_data->untouched_bitfield()->get(index) &&
@@ -0,0 +1,96 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2005-2011, Jari Sundell <jaris@ifi.uio.no>
+
+#include "download/connection_index.h"
+#include "torrent/exceptions.h"
+#include "torrent/utils/socket_address.h"
+
+namespace torrent {
+
+template <typename Map, typename Key>
+static void
+erase_value(Map& map, const Key& key, Peer* peer) {
+  auto range = map.equal_range(key);
+
+  for (auto itr = range.first; itr != range.second; itr++)
+    if (itr->second == peer) {
+      map.erase(itr);
+      return;
+    }
+}
+
+void
+ConnectionIndex::insert(Peer*             peer,
+                        const HashString& id,
+                        const sockaddr*   sa,
+                        size_type         position) {
+  auto key = socket_address_key::from_sockaddr(sa);
+
+  if (!m_entries.emplace(peer, entry_type{ position, id, key, sa }).second)
+    throw internal_error("ConnectionIndex::insert(...) peer already indexed.");
+
+  m_ids.emplace(id, peer);
+  m_addresses.emplace(key, peer);
+}
+
+void
+ConnectionIndex::erase(Peer* peer) {
+  auto itr = m_entries.find(peer);
+
+  if (itr == m_entries.end())
+    throw internal_error("ConnectionIndex::erase(...) peer not indexed.");
+
+  erase_value(m_ids, itr->second.id, peer);
+  erase_value(m_addresses, itr->second.key, peer);
+  m_entries.erase(itr);
+}
+
+void
+ConnectionIndex::clear() {
+  m_entries.clear();
+  m_ids.clear();
+  m_addresses.clear();
+}
+
+Peer*
+ConnectionIndex::find(const HashString& id) const {
+  auto itr = m_ids.find(id);
+
+  return itr != m_ids.end() ? itr->second : nullptr;
+}
+
+Peer*
+ConnectionIndex::find(const sockaddr* sa) const {
+  if (!socket_address_key::is_comparable_sockaddr(sa))
+    return nullptr;
+
+  auto range = m_addresses.equal_range(socket_address_key::from_sockaddr(sa));
+
+  for (auto itr = range.first; itr != range.second; itr++)
+    if (*utils::socket_address::cast_from(sa) ==
+        *utils::socket_address::cast_from(
+          m_entries.find(itr->second)->second.address))
+      return itr->second;
+
+  return nullptr;
+}
+
+ConnectionIndex::size_type
+ConnectionIndex::position(Peer* peer) const {
+  auto itr = m_entries.find(peer);
+
+  return itr != m_entries.end() ? itr->second.position : npos;
+}
+
+void
+ConnectionIndex::set_position(Peer* peer, size_type position) {
+  auto itr = m_entries.find(peer);
+
+  if (itr == m_entries.end())
+    throw internal_error(
+      "ConnectionIndex::set_position(...) peer not indexed.");
+
+  itr->second.position = position;
+}
+
+} // namespace torrent
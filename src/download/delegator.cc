@@ -7,6 +7,7 @@
 #include <cinttypes>
 
 #include "download/delegator.h"
+#include "globals.h"
 #include "protocol/peer_chunks.h"
 #include "torrent/bitfield.h"
 #include "torrent/data/block.h"
@@ -16,9 +17,10 @@
 
 namespace torrent {
 
-#define DelegatorCheckPriority(THIS, TARGET, PRIORITY, CHUNKS)                 \
-  [THIS, &TARGET, CHUNKS](BlockList* d) {                                      \
+#define DelegatorCheckPriority(THIS, TARGET, PRIORITY, CHUNKS, SLOW)           \
+  [THIS, &TARGET, CHUNKS, SLOW](BlockList* d) {                                \
     return PRIORITY == d->priority() && CHUNKS->bitfield()->get(d->index()) && \
+           !(SLOW && is_deadline(d)) &&                                        \
            (TARGET = delegate_piece(d, CHUNKS->peer_info())) != nullptr;       \
   }
 
@@ -28,6 +30,16 @@ Delegator::delegate(PeerChunks* peerChunks, int affinity) {
   // when it timeout cancels them.
   Block* target = nullptr;
 
+  // Pieces with a deadline go to peers fast enough to meet it.
+  bool slow = false;
+
+  if (m_deadline) {
+    slow = m_slot_peer_fast && !m_slot_peer_fast(peerChunks);
+
+    if (!slow && (target = delegate_deadline(peerChunks)) != nullptr)
+      return target->insert(peerChunks->peer_info());
+  }
+
   // Find piece with same index as affinity. This affinity should ensure that we
   // never start another piece while the chunk this peer used to download is
   // still in progress.
@@ -38,16 +50,18 @@ Delegator::delegate(PeerChunks* peerChunks, int affinity) {
                   m_transfers.end(),
                   [this,
                    &target,
+                   slow,
                    affinity = static_cast<unsigned int>(affinity),
                    peerInfo = peerChunks->peer_info()](BlockList* d) {
                     return affinity == d->index() &&
+                           !(slow && is_deadline(d)) &&
                            (target = delegate_piece(d, peerInfo)) != nullptr;
                   })) {
     return target->insert(peerChunks->peer_info());
   }
 
   if (peerChunks->is_seeder() &&
-      (target = delegate_seeder(peerChunks)) != nullptr) {
+      (target = delegate_seeder(peerChunks, slow)) != nullptr) {
     return target->insert(peerChunks->peer_info());
   }
 
@@ -55,12 +69,13 @@ Delegator::delegate(PeerChunks* peerChunks, int affinity) {
   if (std::any_of(
         m_transfers.begin(),
         m_transfers.end(),
-        DelegatorCheckPriority(this, target, PRIORITY_HIGH, peerChunks))) {
+        DelegatorCheckPriority(
+          this, target, PRIORITY_HIGH, peerChunks, slow))) {
     return target->insert(peerChunks->peer_info());
   }
 
   // Find normal priority pieces.
-  if ((target = new_chunk(peerChunks, true))) {
+  if ((target = new_chunk(peerChunks, true, slow))) {
     return target->insert(peerChunks->peer_info());
   }
 
@@ -68,11 +83,12 @@ Delegator::delegate(PeerChunks* peerChunks, int affinity) {
   if (std::any_of(
         m_transfers.begin(),
         m_transfers.end(),
-        DelegatorCheckPriority(this, target, PRIORITY_NORMAL, peerChunks))) {
+        DelegatorCheckPriority(
+          this, target, PRIORITY_NORMAL, peerChunks, slow))) {
     return target->insert(peerChunks->peer_info());
   }
 
-  if ((target = new_chunk(peerChunks, false))) {
+  if ((target = new_chunk(peerChunks, false, slow))) {
     return target->insert(peerChunks->peer_info());
   }
 
@@ -104,35 +120,46 @@ Delegator::delegate(PeerChunks* peerChunks, int affinity) {
 }
 
 Block*
-Delegator::delegate_seeder(PeerChunks* peerChunks) {
+Delegator::delegate_seeder(PeerChunks* peerChunks, bool slow) {
   Block* target = nullptr;
 
   if (std::any_of(
         m_transfers.begin(),
         m_transfers.end(),
-        [this, &target, peerInfo = peerChunks->peer_info()](BlockList* d) {
-          return d->by_seeder() &&
+        [this, &target, slow, peerInfo = peerChunks->peer_info()](
+          BlockList* d) {
+          return d->by_seeder() && !(slow && is_deadline(d)) &&
                  (target = delegate_piece(d, peerInfo)) != nullptr;
         })) {
     return target;
   }
 
-  if ((target = new_chunk(peerChunks, true)))
+  if ((target = new_chunk(peerChunks, true, slow)))
     return target;
 
-  if ((target = new_chunk(peerChunks, false)))
+  if ((target = new_chunk(peerChunks, false, slow)))
     return target;
 
   return nullptr;
 }
 
 Block*
-Delegator::new_chunk(PeerChunks* pc, bool highPriority) {
+Delegator::new_chunk(PeerChunks* pc, bool highPriority, bool slow) {
   uint32_t index = m_slot_chunk_find(pc, highPriority);
 
   if (index == ~(uint32_t)0)
     return nullptr;
 
+  // The index has already been taken off the peer's cache, so a fast
+  // peer will find it through the deadline search instead.
+  if (slow && m_slot_chunk_deadline(index) != utils::timer())
+    return nullptr;
+
+  return insert_chunk(pc, index, highPriority);
+}
+
+Block*
+Delegator::insert_chunk(PeerChunks* pc, uint32_t index, bool highPriority) {
   auto itr =
     m_transfers.insert(Piece(index, 0, m_slot_chunk_size(index)), block_size);
 
@@ -146,6 +173,68 @@ Delegator::new_chunk(PeerChunks* pc, bool highPriority) {
   return &*(*itr)->begin();
 }
 
+bool
+Delegator::is_deadline(const BlockList* blockList) const {
+  return m_deadline &&
+         m_slot_chunk_deadline(blockList->index()) != utils::timer();
+}
+
+// Serve pieces in deadline order, starting a new piece once the
+// in-progress ones have nothing earlier left to request. Blocks that
+// got no response in time are requested again ahead of endgame.
+Block*
+Delegator::delegate_deadline(PeerChunks* peerChunks) {
+  uint32_t     index = m_slot_chunk_find_deadline(peerChunks);
+  utils::timer index_deadline =
+    index != ~(uint32_t)0 ? m_slot_chunk_deadline(index) : utils::timer::max();
+
+  update_deadline_order();
+
+  for (const auto& [deadline, blockList] : m_deadlineOrder) {
+    if (index_deadline < deadline)
+      break;
+
+    if (blockList->priority() == PRIORITY_OFF ||
+        !peerChunks->bitfield()->get(blockList->index()))
+      continue;
+
+    Block* target;
+
+    if ((target = delegate_piece(blockList, peerChunks->peer_info())) !=
+          nullptr ||
+        (target = delegate_timed_out(blockList, peerChunks->peer_info())) !=
+          nullptr)
+      return target;
+  }
+
+  if (index == ~(uint32_t)0)
+    return nullptr;
+
+  return insert_chunk(peerChunks, index, true);
+}
+
+void
+Delegator::update_deadline_order() {
+  if (m_deadlineValid && m_deadlineVersion == m_transfers.version())
+    return;
+
+  m_deadlineOrder.clear();
+
+  for (auto blockList : m_transfers) {
+    utils::timer deadline = m_slot_chunk_deadline(blockList->index());
+
+    if (deadline != utils::timer())
+      m_deadlineOrder.emplace_back(deadline, blockList);
+  }
+
+  std::sort(m_deadlineOrder.begin(),
+            m_deadlineOrder.end(),
+            [](const auto& a, const auto& b) { return a.first < b.first; });
+
+  m_deadlineValid   = true;
+  m_deadlineVersion = m_transfers.version();
+}
+
 Block*
 Delegator::delegate_piece(BlockList* blockList, const PeerInfo* peerInfo) {
   Block* p = nullptr;
@@ -185,4 +274,27 @@ Delegator::delegate_aggressive(BlockList*      c,
   return p;
 }
 
+Block*
+Delegator::delegate_timed_out(BlockList* c, const PeerInfo* peerInfo) {
+  int32_t timeout = cachedTime.seconds() - deadline_timeout;
+
+  auto is_recent = [timeout](const BlockTransfer* transfer) {
+    return transfer->request_time() > timeout;
+  };
+
+  for (auto& block : *c) {
+    if (block.is_finished() || block.size_all() >= deadline_max_requests ||
+        block.find(peerInfo) != nullptr)
+      continue;
+
+    if (std::none_of(
+          block.queued()->begin(), block.queued()->end(), is_recent) &&
+        std::none_of(
+          block.transfers()->begin(), block.transfers()->end(), is_recent))
+      return &block;
+  }
+
+  return nullptr;
+}
+
 } // namespace torrent
@@ -95,6 +95,26 @@ DownloadMain::DownloadMain()
     return file_list()->chunk_index_size(index);
   };
 
+  m_delegator.slot_chunk_find_deadline() = [this](PeerChunks* pc) {
+    return m_chunkSelector->find_deadline(pc);
+  };
+
+  m_delegator.slot_chunk_deadline() = [this](uint32_t index) {
+    return m_chunkSelector->deadline(index);
+  };
+
+  // Peers downloading at least half the average rate per connection
+  // are considered fast enough for pieces with a deadline.
+  m_delegator.slot_peer_fast() = [this](PeerChunks* pc) {
+    PeerConnectionBase* connection = pc->peer_info()->connection();
+
+    if (connection == nullptr || m_connectionList->empty())
+      return true;
+
+    return connection->down_rate()->rate() * 2 * m_connectionList->size() >=
+           info()->down_rate()->rate();
+  };
+
   m_delegator.transfer_list()->slot_canceled() = [this](uint32_t index) {
     m_chunkSelector->not_using_index(index);
   };
@@ -155,6 +175,18 @@ DownloadMain::~DownloadMain() {
 
   m_ut_pex_delta.clear();
   m_ut_pex_initial.clear();
+  m_ut_metadata_pieces.clear();
+}
+
+const Bitfield*
+DownloadMain::seed_bitfield() {
+  if (m_seedBitfield.empty()) {
+    m_seedBitfield.set_size_bits(file_list()->bitfield()->size_bits());
+    m_seedBitfield.allocate();
+    m_seedBitfield.set_all();
+  }
+
+  return &m_seedBitfield;
 }
 
 std::pair<ThrottleList*, ThrottleList*>
@@ -206,6 +238,7 @@ DownloadMain::close() {
   m_chunkStatistics->clear();
   m_chunkList->clear();
   m_chunkSelector->cleanup();
+  m_seedBitfield.clear();
 }
 
 void
@@ -344,17 +377,17 @@ DownloadMain::receive_connect_peers() {
   AddressList* alist = peer_list()->available_list()->buffer();
 
   if (!alist->empty()) {
-    alist->sort();
     peer_list()->insert_available(alist);
     alist->clear();
   }
 
   while (!peer_list()->available_list()->empty() &&
          manager->connection_manager()->can_connect() &&
+         manager->handshake_manager()->can_admit() &&
          connection_list()->size() < connection_list()->min_size() &&
          connection_list()->size() + m_slotCountHandshakes(this) <
            connection_list()->max_size()) {
-    utils::socket_address sa = peer_list()->available_list()->pop_random();
+    utils::socket_address sa = peer_list()->available_list()->pop_best();
 
     if (connection_list()->find(sa.c_sockaddr()) == connection_list()->end())
       m_slotStartHandshake(sa, this);
@@ -454,16 +487,8 @@ DownloadMain::do_peer_exchange() {
       continue;
     }
 
-    // Still using the old buffer? Make a copy in this rare case.
-    DataBuffer* message = pcb->extension_message();
-
-    if (!message->empty() && (message->data() == m_ut_pex_initial.data() ||
-                              message->data() == m_ut_pex_delta.data())) {
-      char* buffer = new char[message->length()];
-      memcpy(buffer, message->data(), message->length());
-      message->set(buffer, buffer + message->length(), true);
-    }
-
+    // Peers still writing the old message hold their own reference
+    // to it, so the buffers below can be replaced without copying.
     pcb->do_peer_exchange();
   }
 
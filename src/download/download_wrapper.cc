@@ -224,6 +224,7 @@ DownloadWrapper::receive_hash_done(ChunkHandle handle, const char* hash) {
       bool was_partial = data()->wanted_chunks() != 0;
 
       m_main->file_list()->mark_completed(handle.index());
+      m_main->chunk_selector()->received_deadline_chunk(handle.index());
       m_main->delegator()->transfer_list()->hash_succeeded(handle.index(),
                                                            handle.chunk());
       m_main->update_endgame();
@@ -239,15 +240,7 @@ DownloadWrapper::receive_hash_done(ChunkHandle handle, const char* hash) {
           &taskScheduler, &m_main->delay_partially_done(), cachedTime);
       }
 
-      if (!m_main->have_queue()->empty() &&
-          m_main->have_queue()->front().first >= cachedTime)
-        m_main->have_queue()->push_front(
-          DownloadMain::have_queue_type::value_type(
-            m_main->have_queue()->front().first + 1, handle.index()));
-      else
-        m_main->have_queue()->push_front(
-          DownloadMain::have_queue_type::value_type(cachedTime,
-                                                    handle.index()));
+      m_main->have_queue()->push_back(cachedTime, handle.index());
 
     } else {
       // This needs to ensure the chunk is still valid.
@@ -286,7 +279,8 @@ DownloadWrapper::receive_storage_error(const std::string& str) {
 
 uint32_t
 DownloadWrapper::receive_tracker_success(AddressList* l) {
-  uint32_t inserted = m_main->peer_list()->insert_available(l);
+  uint32_t inserted =
+    m_main->peer_list()->insert_available(l, AvailableList::source_tracker);
   m_main->receive_connect_peers();
   m_main->receive_tracker_success();
 
@@ -312,6 +306,9 @@ DownloadWrapper::receive_tick(uint32_t ticks) {
   if (!info()->is_open())
     return;
 
+  for (auto& peer : *m_main->connection_list())
+    peer->m_ptr()->sample_tcp_stats();
+
   // Every 2 minutes.
   if (ticks % 4 == 0) {
     if (info()->is_active()) {
@@ -336,16 +333,7 @@ DownloadWrapper::receive_tick(uint32_t ticks) {
         itr++;
   }
 
-  DownloadMain::have_queue_type* haveQueue = m_main->have_queue();
-  haveQueue->erase(
-    std::find_if(haveQueue->rbegin(),
-                 haveQueue->rend(),
-                 [](DownloadMain::have_queue_type::value_type& p) {
-                   return (cachedTime - utils::timer::from_seconds(600)) <
-                          p.first;
-                 })
-      .base(),
-    haveQueue->end());
+  m_main->have_queue()->prune(cachedTime - utils::timer::from_seconds(600));
 
   m_main->receive_connect_peers();
 }
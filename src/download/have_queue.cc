@@ -0,0 +1,68 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2005-2011, Jari Sundell <jaris@ifi.uio.no>
+
+#include <algorithm>
+
+#include "download/have_queue.h"
+#include "protocol/protocol_base.h"
+
+namespace torrent {
+
+static_assert(HaveQueue::message_size == ProtocolBase::sizeof_have,
+              "HaveQueue messages must match the wire format.");
+
+HaveQueue::size_type
+HaveQueue::find(utils::timer t) const {
+  return std::lower_bound(m_times.begin() + m_begin, m_times.end(), t) -
+         m_times.begin() - m_begin;
+}
+
+void
+HaveQueue::push_back(utils::timer t, uint32_t index) {
+  if (!empty() && m_times.back() >= t)
+    t = m_times.back() + 1;
+
+  m_times.push_back(t);
+
+  char message[message_size] = { 0,
+                                 0,
+                                 0,
+                                 5,
+                                 4,
+                                 char(index >> 24),
+                                 char(index >> 16),
+                                 char(index >> 8),
+                                 char(index) };
+
+  m_messages.insert(m_messages.end(), message, message + message_size);
+}
+
+void
+HaveQueue::prune(utils::timer t) {
+  m_begin = std::upper_bound(m_times.begin() + m_begin, m_times.end(), t) -
+            m_times.begin();
+
+  if (empty()) {
+    clear();
+    return;
+  }
+
+  // Compact once the pruned head dominates the storage, keeping prune
+  // amortized O(1) per message.
+  if (m_begin < m_times.size() / 2)
+    return;
+
+  m_times.erase(m_times.begin(), m_times.begin() + m_begin);
+  m_messages.erase(m_messages.begin(),
+                   m_messages.begin() + m_begin * message_size);
+  m_begin = 0;
+}
+
+void
+HaveQueue::clear() {
+  m_begin = 0;
+  m_times.clear();
+  m_messages.clear();
+}
+
+} // namespace torrent
@@ -1,9 +1,13 @@
 #include "data/chunk_list.h"
 #include "data/hash_queue.h"
+#include "data/hash_scheduler.h"
 #include "data/hash_torrent.h"
 #include "download/download_main.h"
 #include "download/download_wrapper.h"
 #include "net/listen.h"
+#include "net/utp_context.h"
+#include "net/resolver.h"
+#include "protocol/handshake.h"
 #include "protocol/handshake_manager.h"
 #include "torrent/chunk_manager.h"
 #include "torrent/connection_manager.h"
@@ -16,6 +20,7 @@
 #include "torrent/exceptions.h"
 #include "torrent/peer/client_list.h"
 #include "torrent/throttle.h"
+#include "utils/diffie_hellman.h"
 #include "utils/instrumentation.h"
 
 #include "manager.h"
@@ -28,6 +33,7 @@ Manager::Manager()
   : m_downloadManager(new DownloadManager)
   , m_fileManager(new FileManager)
   , m_handshakeManager(new HandshakeManager)
+  , m_hashScheduler(new HashScheduler)
   , m_resourceManager(new ResourceManager)
   ,
 
@@ -50,11 +56,48 @@ Manager::Manager()
       m_main_thread_main.send_event_signal(signal, do_interrupt);
     };
 
+  DiffieHellmanPool* dh_pool = m_main_thread_disk.dh_pool();
+
+  dh_pool->slot_generate_key() = []() {
+    return std::make_unique<DiffieHellman>(
+      HandshakeEncryption::dh_prime,
+      HandshakeEncryption::dh_prime_length,
+      HandshakeEncryption::dh_generator,
+      HandshakeEncryption::dh_generator_length);
+  };
+  dh_pool->slot_need_work() = [this]() { m_main_thread_disk.interrupt(); };
+  dh_pool->slot_has_work() =
+    [this,
+     signal = m_main_thread_main.signal_bitfield()->add_signal(
+       [dh_pool]() { dh_pool->work(); })]() {
+      m_main_thread_main.send_event_signal(signal);
+    };
+  dh_pool->slot_done() = [](DiffieHellmanPool::id_type    id,
+                            DiffieHellmanPool::key_ptr key,
+                            bool                       result) {
+    static_cast<Handshake*>(const_cast<void*>(id))
+      ->receive_secret(std::move(key), result);
+  };
+
+  Resolver* resolver = m_connectionManager->default_resolver();
+
+  resolver->slot_has_work() =
+    [this,
+     signal = m_main_thread_main.signal_bitfield()->add_signal(
+       [resolver]() { resolver->work(); })]() {
+      m_main_thread_main.send_event_signal(signal);
+    };
+
   m_taskTick.slot() = [this]() { receive_tick(); };
 
   priority_queue_insert(
     &taskScheduler, &m_taskTick, cachedTime.round_seconds());
 
+  m_taskMemoryGovernor.slot() = [this]() { receive_memory_governor(); };
+
+  priority_queue_insert(
+    &taskScheduler, &m_taskMemoryGovernor, cachedTime.round_seconds());
+
   m_handshakeManager->slot_download_id() = [this](const char* hash) {
     return m_downloadManager->find_main(hash);
   };
@@ -68,6 +111,15 @@ Manager::Manager()
       m_handshakeManager->add_incoming(fd, sa);
     };
 
+  m_connectionManager->utp()->slot_accepted() =
+    [this](SocketFd fd, const utils::socket_address& sa) {
+      m_handshakeManager->add_incoming_utp(fd, sa);
+    };
+
+  m_connectionManager->utp()->slot_can_accept() = [this]() {
+    return m_handshakeManager->can_admit();
+  };
+
   m_resourceManager->push_group("default");
   m_resourceManager->group_back()->up_queue()->set_heuristics(
     choke_queue::HEURISTICS_UPLOAD_LEECH);
@@ -77,6 +129,7 @@ Manager::Manager()
 
 Manager::~Manager() {
   priority_queue_erase(&taskScheduler, &m_taskTick);
+  priority_queue_erase(&taskScheduler, &m_taskMemoryGovernor);
 
   m_handshakeManager->clear();
   m_downloadManager->clear();
@@ -85,6 +138,7 @@ Manager::~Manager() {
   delete m_fileManager;
   delete m_handshakeManager;
   delete m_hashQueue;
+  delete m_hashScheduler;
 
   delete m_resourceManager;
   delete m_dhtManager;
@@ -169,4 +223,16 @@ Manager::receive_tick() {
     (cachedTime + utils::timer::from_seconds(30)).round_seconds());
 }
 
+// PSI averages react within ten seconds, so sample more often than
+// the regular tick.
+void
+Manager::receive_memory_governor() {
+  m_chunkManager->update_memory_governor();
+
+  priority_queue_insert(
+    &taskScheduler,
+    &m_taskMemoryGovernor,
+    (cachedTime + utils::timer::from_seconds(5)).round_seconds());
+}
+
 } // namespace torrent
@@ -0,0 +1,200 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2005-2011, Jari Sundell <jaris@ifi.uio.no>
+
+#include <chrono>
+#include <thread>
+
+#include "globals.h"
+#include "net/resolver.h"
+#include "torrent/exceptions.h"
+#include "torrent/utils/address_info.h"
+
+namespace torrent {
+
+// Idle workers exit after this long without requests.
+static constexpr std::chrono::seconds idle_timeout(60);
+
+static int
+lookup_address_info(const char*            host,
+                    int                    family,
+                    int                    socktype,
+                    utils::socket_address* sa) {
+  utils::address_info* ai;
+  int                  err;
+
+  if ((err = utils::address_info::get_address_info(
+         host, family, socktype, &ai)) != 0)
+    return err;
+
+  sa->copy(*ai->address(), ai->length());
+  utils::address_info::free_address_info(ai);
+  return 0;
+}
+
+Resolver::Resolver()
+  : m_shared(std::make_shared<shared_type>()) {
+  m_shared->lookup = &lookup_address_info;
+}
+
+Resolver::~Resolver() {
+  std::lock_guard lk(m_shared->lock);
+
+  m_shared->shutdown = true;
+  m_shared->pending.clear();
+  m_shared->done.clear();
+  m_shared->has_work = slot_void();
+  m_shared->cond.notify_all();
+}
+
+Resolver::result_slot*
+Resolver::resolve(const char*        host,
+                  int                family,
+                  int                socktype,
+                  const result_slot& slot) {
+  key_type key(host, family, socktype);
+
+  auto cache_itr = m_cache.find(key);
+
+  if (cache_itr != m_cache.end()) {
+    if (cache_itr->second.expires > cachedTime) {
+      if (cache_itr->second.error != 0)
+        slot(nullptr, cache_itr->second.error);
+      else
+        slot(cache_itr->second.address.c_sockaddr(), 0);
+
+      return nullptr;
+    }
+
+    m_cache.erase(cache_itr);
+  }
+
+  auto [itr, inserted] = m_requests.try_emplace(key);
+  itr->second.slots.push_back(slot);
+
+  if (!inserted)
+    return &itr->second.slots.back();
+
+  if (!m_shared->has_work)
+    throw internal_error("Resolver::resolve() slot_has_work not set.");
+
+  std::lock_guard lk(m_shared->lock);
+
+  m_shared->pending.push_back(job{ key, {}, 0 });
+  m_shared->cond.notify_one();
+  m_lookups++;
+
+  if (m_shared->idle < m_shared->pending.size() &&
+      m_shared->workers < m_maxWorkers) {
+    m_shared->workers++;
+    std::thread(&Resolver::perform, m_shared).detach();
+  }
+
+  return &itr->second.slots.back();
+}
+
+void
+Resolver::clear_cache() {
+  m_cache.clear();
+}
+
+void
+Resolver::work() {
+  std::deque<job> done;
+
+  {
+    std::lock_guard lk(m_shared->lock);
+    done.swap(m_shared->done);
+  }
+
+  for (auto& result : done) {
+    auto itr = m_requests.find(result.key);
+
+    if (itr == m_requests.end())
+      throw internal_error("Resolver::work() could not find request.");
+
+    insert_cache(result.key, result);
+
+    // Keep the slots alive until all have been called, as a callback
+    // may clear any slot of the request, including its own.
+    request current = std::move(itr->second);
+    m_requests.erase(itr);
+
+    for (auto& slot : current.slots) {
+      if (!slot)
+        continue;
+
+      result_slot call = std::move(slot);
+      slot             = result_slot();
+
+      if (result.error != 0)
+        call(nullptr, result.error);
+      else
+        call(result.address.c_sockaddr(), 0);
+    }
+  }
+}
+
+void
+Resolver::insert_cache(const key_type& key, const job& result) {
+  unsigned int ttl = result.error != 0 ? m_negativeTtl : m_ttl;
+
+  if (ttl == 0)
+    return;
+
+  if (m_cache.size() >= max_cache_size) {
+    for (auto itr = m_cache.begin(); itr != m_cache.end();)
+      if (itr->second.expires <= cachedTime)
+        itr = m_cache.erase(itr);
+      else
+        itr++;
+  }
+
+  if (m_cache.size() >= max_cache_size)
+    m_cache.erase(std::min_element(
+      m_cache.begin(), m_cache.end(), [](const auto& a, const auto& b) {
+        return a.second.expires < b.second.expires;
+      }));
+
+  m_cache[key] = cache_entry{ result.address,
+                              result.error,
+                              cachedTime + utils::timer::from_seconds(ttl) };
+}
+
+void
+Resolver::perform(std::shared_ptr<shared_type> shared) {
+  std::unique_lock lk(shared->lock);
+
+  while (!shared->shutdown) {
+    if (shared->pending.empty()) {
+      shared->idle++;
+      auto status = shared->cond.wait_for(lk, idle_timeout);
+      shared->idle--;
+
+      if (status == std::cv_status::timeout && shared->pending.empty())
+        break;
+
+      continue;
+    }
+
+    job current = std::move(shared->pending.front());
+    shared->pending.pop_front();
+
+    lk.unlock();
+    current.address.clear();
+    current.error = shared->lookup(std::get<0>(current.key).c_str(),
+                                   std::get<1>(current.key),
+                                   std::get<2>(current.key),
+                                   &current.address);
+    lk.lock();
+
+    if (shared->shutdown)
+      break;
+
+    shared->done.push_back(std::move(current));
+    shared->has_work();
+  }
+
+  shared->workers--;
+}
+
+} // namespace torrent
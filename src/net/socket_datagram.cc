@@ -1,8 +1,11 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 // Copyright (C) 2005-2011, Jari Sundell <jaris@ifi.uio.no>
 
+#include "torrent/buildinfo.h"
+
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 
 #include "net/socket_datagram.h"
 #include "torrent/exceptions.h"
@@ -60,4 +63,109 @@ SocketDatagram::write_datagram(const void*            buffer,
   return r;
 }
 
+int
+SocketDatagram::read_datagrams(read_entry* entries, unsigned int count) {
+  if (count == 0 || count > max_batch)
+    throw internal_error("SocketDatagram::read_datagrams invalid count.");
+
+#ifdef LT_HAVE_RECVMMSG
+  mmsghdr msgs[max_batch] = {};
+  iovec   iovs[max_batch];
+
+  for (unsigned int i = 0; i < count; i++) {
+    if (entries[i].length == 0)
+      throw internal_error("Tried to receive buffer length 0");
+
+    iovs[i].iov_base = entries[i].buffer;
+    iovs[i].iov_len  = entries[i].length;
+
+    msgs[i].msg_hdr.msg_name    = entries[i].address.c_sockaddr();
+    msgs[i].msg_hdr.msg_namelen = sizeof(utils::socket_address);
+    msgs[i].msg_hdr.msg_iov     = &iovs[i];
+    msgs[i].msg_hdr.msg_iovlen  = 1;
+  }
+
+  int r = ::recvmmsg(m_fileDesc, msgs, count, MSG_DONTWAIT, nullptr);
+
+  for (int i = 0; i < r; i++)
+    entries[i].read = msgs[i].msg_len;
+
+  return r;
+
+#else
+  unsigned int r = 0;
+
+  for (; r < count; r++) {
+    entries[r].read = read_datagram(
+      entries[r].buffer, entries[r].length, &entries[r].address);
+
+    if (entries[r].read < 0)
+      break;
+  }
+
+  return r != 0 ? r : -1;
+#endif
+}
+
+void
+SocketDatagram::write_datagrams(write_entry* entries, unsigned int count) {
+  if (count > max_batch)
+    throw internal_error("SocketDatagram::write_datagrams invalid count.");
+
+#ifdef LT_HAVE_RECVMMSG
+  mmsghdr                     msgs[max_batch] = {};
+  iovec                       iovs[max_batch];
+  utils::socket_address_inet6 mapped[max_batch];
+
+  for (unsigned int i = 0; i < count; i++) {
+    const utils::socket_address* sa = entries[i].address;
+
+    if (entries[i].length == 0)
+      throw internal_error("Tried to send buffer length 0");
+
+    iovs[i].iov_base = const_cast<void*>(entries[i].buffer);
+    iovs[i].iov_len  = entries[i].length;
+
+    msgs[i].msg_hdr.msg_iov    = &iovs[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+
+    if (sa == nullptr)
+      continue;
+
+    if (m_ipv6_socket && sa->family() == utils::socket_address::pf_inet) {
+      mapped[i] = sa->sa_inet()->to_mapped_address();
+
+      msgs[i].msg_hdr.msg_name    = mapped[i].c_sockaddr();
+      msgs[i].msg_hdr.msg_namelen = sizeof(utils::socket_address_inet6);
+    } else {
+      msgs[i].msg_hdr.msg_name    = const_cast<sockaddr*>(sa->c_sockaddr());
+      msgs[i].msg_hdr.msg_namelen = sa->length();
+    }
+  }
+
+  // sendmmsg stops at the first datagram that fails, so skip past it
+  // and continue with the rest.
+  unsigned int offset = 0;
+
+  while (offset < count) {
+    int r = ::sendmmsg(m_fileDesc, msgs + offset, count - offset, 0);
+
+    if (r <= 0) {
+      entries[offset++].written = -1;
+      continue;
+    }
+
+    for (int i = 0; i < r; i++, offset++)
+      entries[offset].written = msgs[offset].msg_len;
+  }
+
+#else
+  for (unsigned int i = 0; i < count; i++)
+    entries[i].written =
+      write_datagram(entries[i].buffer,
+                     entries[i].length,
+                     const_cast<utils::socket_address*>(entries[i].address));
+#endif
+}
+
 } // namespace torrent
@@ -1,17 +1,21 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 // Copyright (C) 2005-2011, Jari Sundell <jaris@ifi.uio.no>
 
+#include "torrent/buildinfo.h"
+
 #include <arpa/inet.h>
 #include <fcntl.h>
 #include <netinet/in.h>
 #include <netinet/in_systm.h>
 #include <netinet/ip.h>
+#include <netinet/tcp.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 
 #include "net/socket_fd.h"
 #include "torrent/exceptions.h"
+#include "torrent/net/tcp_stats.h"
 #include "torrent/utils/socket_address.h"
 
 namespace torrent {
@@ -75,6 +79,42 @@ SocketFd::set_receive_buffer_size(uint32_t s) {
   return setsockopt(m_fd, SOL_SOCKET, SO_RCVBUF, &opt, sizeof(opt)) == 0;
 }
 
+bool
+SocketFd::set_notsent_lowat(uint32_t s) {
+  check_valid();
+
+#ifdef LT_HAVE_TCP_NOTSENT_LOWAT
+  int opt = s;
+
+  return setsockopt(
+           m_fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &opt, sizeof(opt)) == 0;
+#else
+  return false;
+#endif
+}
+
+bool
+SocketFd::get_tcp_stats(tcp_stats* stats) const {
+  check_valid();
+
+#ifdef LT_HAVE_TCP_INFO
+  tcp_info  info{};
+  socklen_t length = sizeof(info);
+
+  if (getsockopt(m_fd, IPPROTO_TCP, TCP_INFO, &info, &length) != 0)
+    return false;
+
+  stats->rtt_usec     = info.tcpi_rtt;
+  stats->rtt_var_usec = info.tcpi_rttvar;
+  stats->cwnd         = info.tcpi_snd_cwnd;
+  stats->mss          = info.tcpi_snd_mss;
+  stats->retransmits  = info.tcpi_total_retrans;
+  return true;
+#else
+  return false;
+#endif
+}
+
 int
 SocketFd::get_error() const {
   check_valid();
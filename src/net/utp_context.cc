@@ -0,0 +1,602 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2005-2011, Jari Sundell <jaris@ifi.uio.no>
+
+#include "torrent/buildinfo.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <sys/socket.h>
+
+#include "globals.h"
+#include "manager.h"
+#include "net/utp_context.h"
+#include "net/utp_socket.h"
+#include "torrent/connection_manager.h"
+#include "torrent/exceptions.h"
+#include "torrent/poll.h"
+#include "torrent/utils/log.h"
+#include "torrent/utils/random.h"
+#include "torrent/utils/timer.h"
+
+#define LT_LOG_SA(sa, log_fmt, ...)                                            \
+  lt_log_print(LOG_CONNECTION,                                                 \
+               "utp->%s: " log_fmt,                                            \
+               (sa)->pretty_address_str().c_str(),                             \
+               __VA_ARGS__);
+
+namespace torrent {
+
+// Relays between a uTP socket and the local end of a socket pair,
+// whose other end is used as the peer's connection.
+class UtpStream : public SocketBase {
+public:
+  static constexpr unsigned int relay_chunk_size = 16 << 10;
+
+  UtpStream(UtpContext* context, const utils::socket_address& sa);
+  ~UtpStream() override;
+
+  UtpSocket* socket() {
+    return &m_socket;
+  }
+  const utils::socket_address& address() const {
+    return m_address;
+  }
+
+  UtpContext::slot_connect_result& slot_connected() {
+    return m_slotConnected;
+  }
+
+  // Returns the peer's end of the socket pair, or an invalid fd.
+  SocketFd open_relay();
+  void     close_relay();
+
+  // Brings the relay up to date after the uTP socket changed.
+  void update();
+
+  void event_read() override;
+  void event_write() override;
+  void event_error() override;
+
+private:
+  UtpContext*           m_context;
+  utils::socket_address m_address;
+  UtpSocket             m_socket;
+
+  UtpContext::slot_connect_result m_slotConnected;
+
+  bool m_finished{ false };
+  bool m_localEof{ false };
+  bool m_shutdown{ false };
+};
+
+namespace {
+
+inline uint64_t
+utp_now() {
+  return utils::timer::current_usec();
+}
+
+} // namespace
+
+UtpStream::UtpStream(UtpContext* context, const utils::socket_address& sa)
+  : m_context(context)
+  , m_address(sa) {
+  m_socket.slot_send_packet() = [this](const char* data, unsigned int length) {
+    m_context->send_packet(m_address, data, length);
+  };
+}
+
+UtpStream::~UtpStream() {
+  close_relay();
+}
+
+SocketFd
+UtpStream::open_relay() {
+  int local;
+  int remote;
+
+  if (!SocketFd::open_socket_pair(local, remote))
+    return SocketFd();
+
+  set_fd(SocketFd(local));
+
+  SocketFd fd(remote);
+
+  if (!get_fd().set_nonblock() || !fd.set_nonblock()) {
+    get_fd().close();
+    get_fd().clear();
+    fd.close();
+
+    return SocketFd();
+  }
+
+  manager->connection_manager()->inc_socket_count();
+
+  manager->poll()->open(this);
+  manager->poll()->insert_read(this);
+  manager->poll()->insert_error(this);
+
+  return fd;
+}
+
+void
+UtpStream::close_relay() {
+  if (!get_fd().is_valid())
+    return;
+
+  manager->poll()->remove_read(this);
+  manager->poll()->remove_write(this);
+  manager->poll()->remove_error(this);
+  manager->poll()->close(this);
+
+  manager->connection_manager()->dec_socket_count();
+
+  get_fd().close();
+  get_fd().clear();
+}
+
+void
+UtpStream::update() {
+  if (m_finished)
+    return;
+
+  if (m_slotConnected) {
+    if (m_socket.is_connected()) {
+      auto     slot = std::move(m_slotConnected);
+      SocketFd fd   = open_relay();
+
+      m_slotConnected = nullptr;
+
+      if (!fd.is_valid()) {
+        m_socket.reset(utp_now());
+        slot(SocketFd(), EMFILE);
+      } else {
+        slot(fd, 0);
+      }
+
+    } else if (m_socket.is_closed()) {
+      auto slot = std::move(m_slotConnected);
+
+      m_slotConnected = nullptr;
+      slot(SocketFd(), m_socket.error());
+    }
+  }
+
+  if (get_fd().is_valid()) {
+    if (m_socket.read_size() != 0) {
+      if (!manager->poll()->in_write(this))
+        manager->poll()->insert_write(this);
+
+    } else if (m_socket.is_eof() && !m_shutdown) {
+      ::shutdown(get_fd().get_fd(), SHUT_WR);
+      m_shutdown = true;
+    }
+
+    if (!m_localEof && m_socket.write_space() != 0 &&
+        !manager->poll()->in_read(this))
+      manager->poll()->insert_read(this);
+  }
+
+  // Data received before a reset is dropped along with the relay.
+  if (m_socket.is_closed() &&
+      (m_socket.read_size() == 0 || m_socket.error() != 0) &&
+      !m_slotConnected) {
+    m_finished = true;
+    close_relay();
+    m_context->finished(this);
+  }
+}
+
+void
+UtpStream::event_read() {
+  char buffer[relay_chunk_size];
+
+  while (m_socket.write_space() != 0) {
+    int length = std::min<uint32_t>(sizeof(buffer), m_socket.write_space());
+    int result = ::recv(get_fd().get_fd(), buffer, length, 0);
+
+    if (result > 0) {
+      m_socket.write(buffer, result);
+      continue;
+    }
+
+    if (result == 0) {
+      m_localEof = true;
+      m_socket.close();
+
+    } else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+      m_socket.reset(utp_now());
+    }
+
+    break;
+  }
+
+  // Wait for acks to free up buffer space.
+  if (m_localEof || m_socket.write_space() == 0)
+    manager->poll()->remove_read(this);
+
+  m_socket.flush(utp_now());
+  update();
+
+  m_context->flush_output();
+}
+
+void
+UtpStream::event_write() {
+  while (m_socket.read_size() != 0) {
+    int result = ::send(get_fd().get_fd(),
+                        m_socket.read_data(),
+                        m_socket.read_size(),
+                        MSG_NOSIGNAL);
+
+    if (result > 0) {
+      m_socket.consume(result);
+      continue;
+    }
+
+    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+      m_socket.reset(utp_now());
+
+    break;
+  }
+
+  if (m_socket.read_size() == 0)
+    manager->poll()->remove_write(this);
+
+  // Consuming may have reopened the receive window.
+  m_socket.flush(utp_now());
+  update();
+
+  m_context->flush_output();
+}
+
+void
+UtpStream::event_error() {
+  m_socket.reset(utp_now());
+  update();
+
+  m_context->flush_output();
+}
+
+UtpContext::UtpContext()
+  : m_readBuffer(read_buffer_size * max_batch) {
+  m_taskTick.slot() = [this]() { receive_tick(); };
+}
+
+UtpContext::~UtpContext() {
+  close();
+}
+
+bool
+UtpContext::open(const utils::socket_address* bindAddress, uint16_t port) {
+  close();
+
+  if (!get_fd().open_datagram() || !get_fd().set_nonblock())
+    throw resource_error("Could not allocate datagram socket for uTP.");
+
+  utils::socket_address sa;
+
+  if (bindAddress->family() == 0) {
+    if (m_ipv6_socket)
+      sa.sa_inet6()->clear();
+    else
+      sa.sa_inet()->clear();
+  } else {
+    sa.copy(*bindAddress, bindAddress->length());
+  }
+
+  sa.set_port(port);
+
+  if (!get_fd().bind(sa)) {
+    get_fd().close();
+    get_fd().clear();
+
+    LT_LOG_SA(&sa, "failed to bind datagram socket", 0);
+    return false;
+  }
+
+  manager->connection_manager()->inc_socket_count();
+
+  manager->poll()->open(this);
+  manager->poll()->insert_read(this);
+  manager->poll()->insert_error(this);
+
+  LT_LOG_SA(&sa, "opened", 0);
+  return true;
+}
+
+void
+UtpContext::close() {
+  if (!get_fd().is_valid())
+    return;
+
+  std::vector<slot_connect_result> pending;
+
+  for (auto& [key, stream] : m_streams) {
+    stream->socket()->reset(utp_now());
+
+    if (stream->slot_connected())
+      pending.push_back(std::move(stream->slot_connected()));
+
+    stream->slot_connected() = nullptr;
+  }
+
+  flush_output();
+
+  m_streams.clear();
+  m_finished.clear();
+
+  priority_queue_erase(&taskScheduler, &m_taskTick);
+
+  manager->poll()->remove_read(this);
+  manager->poll()->remove_error(this);
+  manager->poll()->close(this);
+
+  manager->connection_manager()->dec_socket_count();
+
+  get_fd().close();
+  get_fd().clear();
+
+  // Outstanding connection attempts fail once the context is gone.
+  for (auto& slot : pending)
+    slot(SocketFd(), ECONNABORTED);
+}
+
+UtpContext::stream_key
+UtpContext::make_key(const utils::socket_address& sa, uint16_t id) {
+  return stream_key(
+    socket_address_key::from_sockaddr(sa.c_sockaddr()), sa.port(), id);
+}
+
+UtpStream*
+UtpContext::connect(const utils::socket_address& sa,
+                    slot_connect_result          slot) {
+  if (!is_open())
+    throw internal_error("UtpContext::connect() called on a closed context.");
+
+  uint16_t id;
+
+  // Both our id and the one the peer uses for us must be unused.
+  do {
+    id = random_uint32();
+  } while (m_streams.find(make_key(sa, id)) != m_streams.end() ||
+           m_streams.find(make_key(sa, id + 1)) != m_streams.end());
+
+  auto stream = new UtpStream(this, sa);
+  m_streams.emplace(make_key(sa, id), stream);
+
+  stream->slot_connected() = std::move(slot);
+  stream->socket()->connect(id, utp_now());
+
+  flush_output();
+  start_tick();
+
+  return stream;
+}
+
+void
+UtpContext::cancel(UtpStream* stream) {
+  stream->slot_connected() = nullptr;
+  stream->socket()->reset(utp_now());
+  stream->update();
+
+  flush_output();
+}
+
+void
+UtpContext::event_read() {
+  read_entry entries[max_batch];
+
+  for (unsigned int i = 0; i < max_batch; i++) {
+    entries[i].buffer = m_readBuffer.data() + i * read_buffer_size;
+    entries[i].length = read_buffer_size;
+  }
+
+  while (true) {
+    int count = read_datagrams(entries, max_batch);
+
+    for (int i = 0; i < count; i++) {
+      utils::socket_address& sa = entries[i].address;
+
+      if (sa.family() == utils::socket_address::af_inet6)
+        sa = sa.sa_inet6()->normalize_address();
+
+      process_packet(
+        static_cast<char*>(entries[i].buffer), entries[i].read, sa);
+    }
+
+    if (count < static_cast<int>(max_batch))
+      break;
+  }
+
+  flush_output();
+}
+
+void
+UtpContext::event_write() {
+  throw internal_error("UtpContext does not poll for write.");
+}
+
+void
+UtpContext::event_error() {}
+
+void
+UtpContext::send_packet(const utils::socket_address& sa,
+                        const char*                  data,
+                        unsigned int                 length) {
+  // Dropped packets are resent by the uTP socket.
+  if (m_output.size() >= max_output_queue)
+    return;
+
+  m_output.emplace_back(sa, std::string(data, length));
+}
+
+void
+UtpContext::flush_output() {
+  write_entry entries[max_batch];
+
+  // Datagrams the socket has no room for are dropped like any other
+  // lost packet, and the uTP sockets back off and resend them.
+  while (!m_output.empty()) {
+    unsigned int count = std::min<size_t>(m_output.size(), max_batch);
+
+    for (unsigned int i = 0; i < count; i++)
+      entries[i] = { m_output[i].second.data(),
+                     static_cast<unsigned int>(m_output[i].second.size()),
+                     &m_output[i].first,
+                     0 };
+
+    write_datagrams(entries, count);
+
+    m_output.erase(m_output.begin(), m_output.begin() + count);
+  }
+}
+
+void
+UtpContext::finished(UtpStream* stream) {
+  auto itr =
+    std::find_if(m_streams.begin(), m_streams.end(), [stream](auto& v) {
+      return v.second.get() == stream;
+    });
+
+  if (itr == m_streams.end())
+    throw internal_error("UtpContext::finished() stream not found.");
+
+  // Streams are deleted from the timer, as this is usually called
+  // from within one of the stream's own event handlers.
+  m_finished.push_back(std::move(itr->second));
+  m_streams.erase(itr);
+
+  start_tick();
+}
+
+void
+UtpContext::process_packet(const char*                  data,
+                           unsigned int                 length,
+                           const utils::socket_address& sa) {
+  UtpSocket::header h;
+  unsigned int      offset = UtpSocket::read_header(data, length, &h);
+
+  if (offset == 0)
+    return;
+
+  auto itr = find_stream(sa, h.type, h.connection_id);
+
+  if (itr != m_streams.end()) {
+    UtpStream* stream = itr->second.get();
+
+    stream->socket()->receive(h, data + offset, length - offset, utp_now());
+    stream->update();
+    return;
+  }
+
+  if (h.type == UtpSocket::st_syn) {
+    accept_stream(data, length, sa);
+    return;
+  }
+
+  if (h.type == UtpSocket::st_reset)
+    return;
+
+  char              buffer[UtpSocket::header_size];
+  UtpSocket::header reset{ UtpSocket::st_reset,
+                           h.connection_id,
+                           static_cast<uint32_t>(utp_now()),
+                           0,
+                           0,
+                           0,
+                           h.seq_nr };
+
+  UtpSocket::write_header(buffer, reset);
+  send_packet(sa, buffer, sizeof(buffer));
+}
+
+void
+UtpContext::accept_stream(const char*                  data,
+                          unsigned int                 length,
+                          const utils::socket_address& sa) {
+  UtpSocket::header h;
+  UtpSocket::read_header(data, length, &h);
+
+  if (!manager->connection_manager()->can_connect() ||
+      !manager->connection_manager()->filter(sa.c_sockaddr()) ||
+      !m_slot_accepted || (m_slot_can_accept && !m_slot_can_accept()))
+    return;
+
+  auto     stream = std::make_unique<UtpStream>(this, sa);
+  SocketFd fd     = stream->open_relay();
+
+  if (!fd.is_valid())
+    return;
+
+  LT_LOG_SA(&sa, "accepted connection: id:%" PRIu16, h.connection_id);
+
+  stream->socket()->accept(h, utp_now());
+
+  UtpStream* s = stream.get();
+  m_streams.emplace(make_key(sa, s->socket()->recv_id()), std::move(stream));
+
+  start_tick();
+
+  m_slot_accepted(fd, sa);
+  s->update();
+}
+
+UtpContext::stream_map::iterator
+UtpContext::find_stream(const utils::socket_address& sa,
+                        uint8_t                      type,
+                        uint16_t                     id) {
+  // A SYN carries the id the initiator receives on, and we receive
+  // on the one after.
+  if (type == UtpSocket::st_syn)
+    return m_streams.find(make_key(sa, id + 1));
+
+  auto itr = m_streams.find(make_key(sa, id));
+
+  if (itr != m_streams.end() || type != UtpSocket::st_reset)
+    return itr;
+
+  // Implementations differ in which id a reset is sent with.
+  for (uint16_t other : { uint16_t(id + 1), uint16_t(id - 1) }) {
+    itr = m_streams.find(make_key(sa, other));
+
+    if (itr != m_streams.end() && itr->second->socket()->send_id() == id)
+      return itr;
+  }
+
+  return m_streams.end();
+}
+
+void
+UtpContext::start_tick() {
+  if (!m_taskTick.is_queued())
+    priority_queue_insert(
+      &taskScheduler,
+      &m_taskTick,
+      cachedTime + utils::timer(tick_interval));
+}
+
+void
+UtpContext::receive_tick() {
+  uint64_t now = utp_now();
+
+  std::vector<UtpStream*> streams;
+  streams.reserve(m_streams.size());
+
+  for (auto& [key, stream] : m_streams)
+    streams.push_back(stream.get());
+
+  for (auto stream : streams) {
+    stream->socket()->tick(now);
+    stream->update();
+  }
+
+  flush_output();
+  m_finished.clear();
+
+  if (!m_streams.empty())
+    start_tick();
+}
+
+} // namespace torrent
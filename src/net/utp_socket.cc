@@ -0,0 +1,593 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2005-2011, Jari Sundell <jaris@ifi.uio.no>
+
+#include "torrent/buildinfo.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include "net/utp_socket.h"
+#include "torrent/exceptions.h"
+#include "torrent/utils/random.h"
+
+namespace torrent {
+
+namespace {
+
+inline bool
+seq_less(uint16_t lhs, uint16_t rhs) {
+  return static_cast<int16_t>(lhs - rhs) < 0;
+}
+
+inline bool
+delay_less(uint32_t lhs, uint32_t rhs) {
+  return static_cast<int32_t>(lhs - rhs) < 0;
+}
+
+inline uint16_t
+read_16(const char* data) {
+  auto d = reinterpret_cast<const uint8_t*>(data);
+  return (d[0] << 8) | d[1];
+}
+
+inline uint32_t
+read_32(const char* data) {
+  auto d = reinterpret_cast<const uint8_t*>(data);
+  return (uint32_t(d[0]) << 24) | (d[1] << 16) | (d[2] << 8) | d[3];
+}
+
+inline void
+write_16(char* data, uint16_t v) {
+  data[0] = v >> 8;
+  data[1] = v;
+}
+
+inline void
+write_32(char* data, uint32_t v) {
+  data[0] = v >> 24;
+  data[1] = v >> 16;
+  data[2] = v >> 8;
+  data[3] = v;
+}
+
+} // namespace
+
+unsigned int
+UtpSocket::read_header(const char* data, unsigned int length, header* h) {
+  if (length < header_size)
+    return 0;
+
+  auto type = static_cast<uint8_t>(data[0]) >> 4;
+
+  if ((data[0] & 0x0f) != version || type > st_syn)
+    return 0;
+
+  h->type                 = type;
+  h->connection_id        = read_16(data + 2);
+  h->timestamp            = read_32(data + 4);
+  h->timestamp_difference = read_32(data + 8);
+  h->wnd_size             = read_32(data + 12);
+  h->seq_nr               = read_16(data + 16);
+  h->ack_nr               = read_16(data + 18);
+
+  unsigned int offset    = header_size;
+  uint8_t      extension = data[1];
+
+  while (extension != 0) {
+    if (offset + 2 > length)
+      return 0;
+
+    extension = data[offset];
+    offset += 2 + static_cast<uint8_t>(data[offset + 1]);
+
+    if (offset > length)
+      return 0;
+  }
+
+  return offset;
+}
+
+void
+UtpSocket::write_header(char* data, const header& h) {
+  data[0] = (h.type << 4) | version;
+  data[1] = 0;
+  write_16(data + 2, h.connection_id);
+  write_32(data + 4, h.timestamp);
+  write_32(data + 8, h.timestamp_difference);
+  write_32(data + 12, h.wnd_size);
+  write_16(data + 16, h.seq_nr);
+  write_16(data + 18, h.ack_nr);
+}
+
+void
+UtpSocket::connect(uint16_t recv_id, uint64_t now) {
+  if (m_state != state_idle)
+    throw internal_error("UtpSocket::connect() called on a used socket.");
+
+  m_state   = state_syn_sent;
+  m_recvId  = recv_id;
+  m_sendId  = recv_id + 1;
+  m_seqNr   = 1;
+  m_lastAck = 0;
+  m_timeout = syn_timeout;
+
+  m_outstanding.push_back(packet{ st_syn, m_seqNr++, std::string() });
+  flush(now);
+}
+
+void
+UtpSocket::accept(const header& syn, uint64_t now) {
+  if (m_state != state_idle)
+    throw internal_error("UtpSocket::accept() called on a used socket.");
+
+  m_state      = state_connected;
+  m_recvId     = syn.connection_id + 1;
+  m_sendId     = syn.connection_id;
+  m_seqNr      = random_uint32();
+  m_lastAck    = m_seqNr - 1;
+  m_ackNr      = syn.seq_nr;
+  m_peerWindow = syn.wnd_size;
+  m_replyMicro = static_cast<uint32_t>(now) - syn.timestamp;
+
+  m_needAck = true;
+  flush(now);
+}
+
+void
+UtpSocket::receive(const header& h,
+                   const char*   payload,
+                   unsigned int  length,
+                   uint64_t      now) {
+  if (m_state == state_idle || m_state == state_closed)
+    return;
+
+  if (h.type == st_reset) {
+    close_with(ECONNRESET);
+    return;
+  }
+
+  if (h.type == st_syn) {
+    // Our reply to the SYN was lost.
+    m_needAck = true;
+    flush(now);
+    return;
+  }
+
+  if (h.timestamp != 0)
+    m_replyMicro = static_cast<uint32_t>(now) - h.timestamp;
+
+  m_peerWindow = h.wnd_size;
+
+  if (m_state == state_syn_sent) {
+    // The first packet from the acceptor carries the sequence number
+    // following the one it considers acked by our SYN.
+    m_state = state_connected;
+    m_ackNr = h.seq_nr - 1;
+  }
+
+  receive_ack(h, now);
+
+  if (h.type == st_data || h.type == st_fin)
+    receive_payload(h, payload, length);
+
+  flush(now);
+  check_finished();
+}
+
+unsigned int
+UtpSocket::write(const char* data, unsigned int length) {
+  if (m_finPending || m_state == state_closed)
+    return 0;
+
+  length = std::min(length, write_space());
+
+  if (m_sendOffset != 0 && m_sendOffset >= m_sendBuffer.size() / 2) {
+    m_sendBuffer.erase(0, m_sendOffset);
+    m_sendOffset = 0;
+  }
+
+  m_sendBuffer.append(data, length);
+  return length;
+}
+
+uint32_t
+UtpSocket::write_space() const {
+  uint32_t used = m_sendBuffer.size() - m_sendOffset + m_outstandingSize;
+
+  return used < buffer_size ? buffer_size - used : 0;
+}
+
+void
+UtpSocket::consume(uint32_t length) {
+  if (length > read_size())
+    throw internal_error("UtpSocket::consume() length out of range.");
+
+  // Tell the peer once a closed receive window opens again.
+  if (receive_window() < packet_size)
+    m_needAck = true;
+
+  m_readOffset += length;
+
+  if (m_readOffset == m_readBuffer.size()) {
+    m_readBuffer.clear();
+    m_readOffset = 0;
+
+  } else if (m_readOffset >= m_readBuffer.size() / 2) {
+    m_readBuffer.erase(0, m_readOffset);
+    m_readOffset = 0;
+  }
+
+  check_finished();
+}
+
+void
+UtpSocket::close() {
+  m_finPending = true;
+}
+
+void
+UtpSocket::reset(uint64_t now) {
+  if (m_state == state_idle || m_state == state_closed)
+    return;
+
+  char   buffer[header_size];
+  header h{ st_reset,
+            m_sendId,
+            static_cast<uint32_t>(now),
+            m_replyMicro,
+            receive_window(),
+            m_seqNr,
+            m_ackNr };
+
+  write_header(buffer, h);
+  m_slotSend(buffer, header_size);
+
+  close_with(ECONNABORTED);
+}
+
+void
+UtpSocket::flush(uint64_t now) {
+  if (m_state == state_syn_sent) {
+    auto& syn = m_outstanding.front();
+
+    if (syn.pending)
+      transmit(syn, now);
+
+    return;
+  }
+
+  if (m_state != state_connected)
+    return;
+
+  uint32_t window = std::min(m_cwnd, m_peerWindow);
+
+  auto allowed = [&](uint32_t size) {
+    return m_inFlight == 0 || m_inFlight + size <= window;
+  };
+
+  for (auto& p : m_outstanding) {
+    if (!p.pending)
+      continue;
+
+    if (!allowed(p.payload.size()))
+      break;
+
+    transmit(p, now);
+  }
+
+  while (m_sendOffset < m_sendBuffer.size()) {
+    uint32_t size =
+      std::min<uint32_t>(payload_size, m_sendBuffer.size() - m_sendOffset);
+
+    if (!allowed(size))
+      break;
+
+    m_outstanding.push_back(
+      packet{ st_data, m_seqNr++, m_sendBuffer.substr(m_sendOffset, size) });
+    m_outstandingSize += size;
+    m_sendOffset += size;
+
+    transmit(m_outstanding.back(), now);
+  }
+
+  if (m_sendOffset == m_sendBuffer.size()) {
+    m_sendBuffer.clear();
+    m_sendOffset = 0;
+  }
+
+  if (m_finPending && !m_finSent && m_sendBuffer.empty()) {
+    m_finSent = true;
+    m_outstanding.push_back(packet{ st_fin, m_seqNr++, std::string() });
+    transmit(m_outstanding.back(), now);
+  }
+
+  if (m_needAck)
+    send_state(now);
+}
+
+void
+UtpSocket::tick(uint64_t now) {
+  if (m_state == state_idle || m_state == state_closed)
+    return;
+
+  if (m_outstanding.empty() || m_timeoutAt == 0 || now < m_timeoutAt)
+    return;
+
+  unsigned int limit =
+    m_state == state_syn_sent ? max_syn_retries : max_retries;
+
+  if (++m_timeouts > limit) {
+    close_with(ETIMEDOUT);
+    return;
+  }
+
+  // Everything sent is presumed lost, and resent starting from a
+  // single packet.
+  m_timeout   = std::min(m_timeout * 2, max_timeout);
+  m_timeoutAt = 0;
+  m_cwnd      = min_window;
+  m_slowStart = false;
+  m_recovery  = false;
+  m_dupAcks   = 0;
+  m_inFlight  = 0;
+
+  for (auto& p : m_outstanding)
+    p.pending = true;
+
+  flush(now);
+}
+
+uint32_t
+UtpSocket::receive_window() const {
+  uint32_t used = read_size() + m_reorderSize;
+
+  return used < buffer_size ? buffer_size - used : 0;
+}
+
+void
+UtpSocket::transmit(packet& p, uint64_t now) {
+  char   buffer[packet_size];
+  header h{ p.type,
+            p.type == st_syn ? m_recvId : m_sendId,
+            static_cast<uint32_t>(now),
+            m_replyMicro,
+            receive_window(),
+            p.seq_nr,
+            m_ackNr };
+
+  write_header(buffer, h);
+  std::memcpy(buffer + header_size, p.payload.data(), p.payload.size());
+
+  if (p.transmissions++ != 0)
+    m_retransmits++;
+
+  if (p.pending) {
+    p.pending = false;
+    m_inFlight += p.payload.size();
+  }
+
+  p.sent    = now;
+  m_needAck = false;
+
+  if (m_timeoutAt == 0)
+    m_timeoutAt = now + m_timeout;
+
+  m_slotSend(buffer, header_size + p.payload.size());
+}
+
+void
+UtpSocket::send_state(uint64_t now) {
+  char   buffer[header_size];
+  header h{ st_state,
+            m_sendId,
+            static_cast<uint32_t>(now),
+            m_replyMicro,
+            receive_window(),
+            m_seqNr,
+            m_ackNr };
+
+  write_header(buffer, h);
+  m_needAck = false;
+
+  m_slotSend(buffer, header_size);
+}
+
+void
+UtpSocket::close_with(int error) {
+  m_state = state_closed;
+  m_error = error;
+
+  m_outstanding.clear();
+  m_outstandingSize = 0;
+  m_inFlight        = 0;
+  m_timeoutAt       = 0;
+}
+
+void
+UtpSocket::receive_ack(const header& h, uint64_t now) {
+  uint32_t flight = m_inFlight;
+  uint32_t acked  = 0;
+  bool     any    = false;
+
+  while (!m_outstanding.empty() &&
+         !seq_less(h.ack_nr, m_outstanding.front().seq_nr)) {
+    auto& p = m_outstanding.front();
+
+    // Karn's algorithm, resent packets give ambiguous samples.
+    if (p.transmissions == 1)
+      update_rtt(now - p.sent);
+
+    if (!p.pending)
+      m_inFlight -= p.payload.size();
+
+    m_outstandingSize -= p.payload.size();
+    acked += p.payload.size();
+    any = true;
+
+    m_outstanding.pop_front();
+  }
+
+  if (!any) {
+    // Only pure acks count as duplicates, data packets repeat the
+    // ack number whenever the peer has something to send.
+    if (h.type != st_state || h.ack_nr != m_lastAck || m_outstanding.empty())
+      return;
+
+    if (++m_dupAcks != 3 || m_recovery)
+      return;
+
+    m_cwnd        = std::max(m_cwnd / 2, min_window);
+    m_slowStart   = false;
+    m_recovery    = true;
+    m_recoverySeq = m_seqNr - 1;
+
+    transmit(m_outstanding.front(), now);
+    return;
+  }
+
+  m_lastAck   = h.ack_nr;
+  m_dupAcks   = 0;
+  m_timeouts  = 0;
+  m_timeoutAt = m_outstanding.empty() ? 0 : now + m_timeout;
+
+  if (h.timestamp_difference != 0)
+    update_delay_base(h.timestamp_difference, now);
+
+  update_window(acked, flight * 2 >= m_cwnd);
+
+  if (m_recovery) {
+    // A partial ack means the next packet was lost as well.
+    if (seq_less(h.ack_nr, m_recoverySeq) && !m_outstanding.empty())
+      transmit(m_outstanding.front(), now);
+    else
+      m_recovery = false;
+  }
+}
+
+void
+UtpSocket::receive_payload(const header& h,
+                           const char*   payload,
+                           unsigned int  length) {
+  m_needAck = true;
+
+  if (m_remoteFinSeen && seq_less(m_remoteFinSeq, h.seq_nr))
+    return;
+
+  if (h.type == st_fin) {
+    m_remoteFinSeen = true;
+    m_remoteFinSeq  = h.seq_nr;
+  }
+
+  if (!seq_less(m_ackNr, h.seq_nr) || length > receive_window())
+    return;
+
+  if (h.seq_nr != uint16_t(m_ackNr + 1)) {
+    if (m_reorder.emplace(h.seq_nr, std::string(payload, length)).second)
+      m_reorderSize += length;
+
+    return;
+  }
+
+  m_readBuffer.append(payload, length);
+  m_ackNr = h.seq_nr;
+
+  while (true) {
+    if (m_remoteFinSeen && m_ackNr == m_remoteFinSeq) {
+      m_remoteFin = true;
+      m_reorder.clear();
+      m_reorderSize = 0;
+      return;
+    }
+
+    auto itr = m_reorder.find(m_ackNr + 1);
+
+    if (itr == m_reorder.end())
+      return;
+
+    m_readBuffer.append(itr->second);
+    m_reorderSize -= itr->second.size();
+    m_ackNr = itr->first;
+
+    m_reorder.erase(itr);
+  }
+}
+
+void
+UtpSocket::check_finished() {
+  if (m_state == state_connected && m_finSent && m_outstanding.empty() &&
+      is_eof())
+    close_with(0);
+}
+
+void
+UtpSocket::update_rtt(uint32_t sample) {
+  if (m_rtt == 0) {
+    m_rtt    = sample;
+    m_rttVar = sample / 2;
+  } else {
+    int32_t delta = static_cast<int32_t>(m_rtt - sample);
+
+    m_rttVar += (static_cast<int32_t>(std::abs(delta)) -
+                 static_cast<int32_t>(m_rttVar)) /
+                4;
+    m_rtt += (static_cast<int32_t>(sample) - static_cast<int32_t>(m_rtt)) / 8;
+  }
+
+  m_timeout = std::max(m_rtt + 4 * m_rttVar, min_timeout);
+}
+
+void
+UtpSocket::update_delay_base(uint32_t delay, uint64_t now) {
+  if (!m_hasDelayBase) {
+    m_hasDelayBase      = true;
+    m_delayBaseCurrent  = delay;
+    m_delayBasePrevious = delay;
+    m_delayBaseStart    = now;
+
+  } else if (now - m_delayBaseStart >= delay_base_interval) {
+    m_delayBasePrevious = m_delayBaseCurrent;
+    m_delayBaseCurrent  = delay;
+    m_delayBaseStart    = now;
+
+  } else if (delay_less(delay, m_delayBaseCurrent)) {
+    m_delayBaseCurrent = delay;
+  }
+
+  m_delayBase = delay_less(m_delayBaseCurrent, m_delayBasePrevious)
+                  ? m_delayBaseCurrent
+                  : m_delayBasePrevious;
+
+  // The peer's clock may drift below the base, which only means
+  // there is no queue.
+  m_queueDelay = delay_less(delay, m_delayBase) ? 0 : delay - m_delayBase;
+}
+
+void
+UtpSocket::update_window(uint32_t acked, bool limited) {
+  if (m_slowStart) {
+    if (m_queueDelay > target_delay / 2) {
+      m_slowStart = false;
+    } else {
+      if (limited)
+        m_cwnd = std::min(m_cwnd + acked, buffer_size);
+
+      return;
+    }
+  }
+
+  int64_t off_target = int64_t(target_delay) - m_queueDelay;
+  int64_t gain = int64_t(max_cwnd_increase) * off_target * acked /
+                 (int64_t(target_delay) * m_cwnd);
+
+  // Grow only while the window is what limits the transfer.
+  if (gain > 0 && !limited)
+    return;
+
+  int64_t cwnd = int64_t(m_cwnd) + gain;
+
+  m_cwnd = std::clamp<int64_t>(cwnd, min_window, buffer_size);
+}
+
+} // namespace torrent
@@ -337,13 +337,10 @@ ProtocolExtension::parse_ut_pex() {
   if (peers.empty())
     return true;
 
-  // TODO: Sort the list before adding it.
   AddressList l;
   l.parse_address_compact(peers);
-  l.sort();
-  l.erase(std::unique(l.begin(), l.end()), l.end());
 
-  m_download->peer_list()->insert_available(&l);
+  m_download->peer_list()->insert_available(&l, AvailableList::source_pex);
 
   return true;
 }
@@ -399,8 +396,20 @@ ProtocolExtension::send_metadata_piece(size_t piece) {
     return;
   }
 
-  // These messages will be rare, so we'll just build the
-  // metadata here instead of caching it uselessly.
+  // Encode each piece message once and share it between all peers
+  // requesting it.
+  std::vector<DataBuffer>* cache = m_download->ut_metadata_pieces();
+
+  if (cache->size() != pieceEnd)
+    cache->assign(pieceEnd, DataBuffer());
+
+  m_pendingType = UT_METADATA;
+
+  if (!(*cache)[piece].empty()) {
+    m_pending = (*cache)[piece].clone();
+    return;
+  }
+
   char* buffer = new char[metadataSize];
   object_write_bencode_c(
     object_write_to_buffer,
@@ -415,15 +424,16 @@ ProtocolExtension::send_metadata_piece(size_t piece) {
   size_t length = piece == pieceEnd - 1
                     ? m_download->info()->metadata_size() % metadata_piece_size
                     : metadata_piece_size;
-  m_pendingType = UT_METADATA;
   m_pending     = build_bencode((2 * sizeof(size_t)) + length + 120,
                             "d8:msg_typei1e5:piecei%zue10:total_sizei%zuee",
                             piece,
                             metadataSize);
 
   memcpy(m_pending.end(), buffer + (piece << metadata_piece_shift), length);
-  m_pending.set(m_pending.data(), m_pending.end() + length, m_pending.owned());
+  m_pending.set_end(m_pending.end() + length);
   delete[] buffer;
+
+  (*cache)[piece] = m_pending.clone();
 }
 
 bool
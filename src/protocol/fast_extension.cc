@@ -0,0 +1,66 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2005-2011, Jari Sundell <jaris@ifi.uio.no>
+
+#include <algorithm>
+#include <cstring>
+
+#include <netinet/in.h>
+
+#include "protocol/fast_extension.h"
+#include "torrent/net/socket_address.h"
+#include "utils/sha1.h"
+
+namespace torrent {
+
+std::vector<uint32_t>
+allowed_fast_set(const sockaddr* sa,
+                 const char*     hash,
+                 uint32_t        size_chunks,
+                 uint32_t        count) {
+  std::vector<uint32_t> result;
+  char                  buffer[20];
+
+  if (sa_is_inet(sa)) {
+    auto sin = reinterpret_cast<const sockaddr_in*>(sa);
+    std::memcpy(buffer, &sin->sin_addr.s_addr, 4);
+
+  } else if (sa_is_v4mapped(sa)) {
+    auto sin6 = reinterpret_cast<const sockaddr_in6*>(sa);
+    std::memcpy(buffer, sin6->sin6_addr.s6_addr + 12, 4);
+
+  } else {
+    return result;
+  }
+
+  count = std::min(count, size_chunks);
+  result.reserve(count);
+
+  buffer[3] = 0;
+
+  Sha1 sha1;
+  sha1.init();
+  sha1.update(buffer, 4);
+  sha1.update(hash, 20);
+  sha1.final_c(buffer);
+
+  while (true) {
+    for (unsigned int i = 0; i < 20; i += 4) {
+      if (result.size() == count)
+        return result;
+
+      auto value = static_cast<uint32_t>(
+        (uint8_t)buffer[i] << 24 | (uint8_t)buffer[i + 1] << 16 |
+        (uint8_t)buffer[i + 2] << 8 | (uint8_t)buffer[i + 3]);
+      uint32_t index = value % size_chunks;
+
+      if (std::find(result.begin(), result.end(), index) == result.end())
+        result.push_back(index);
+    }
+
+    sha1.init();
+    sha1.update(buffer, 20);
+    sha1.final_c(buffer);
+  }
+}
+
+} // namespace torrent
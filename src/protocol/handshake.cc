@@ -155,6 +155,9 @@ Handshake::deactivate_connection() {
     throw internal_error(
       "Handshake::deactivate_connection called but m_fd is not open.");
 
+  if (m_state == READ_ENC_SECRET)
+    manager->main_thread_disk()->dh_pool()->cancel(this);
+
   m_state = INACTIVE;
 
   priority_queue_erase(&taskScheduler, &m_taskTimeout);
@@ -299,11 +302,32 @@ Handshake::read_encryption_key() {
   if (m_incoming)
     prepare_key_plus_pad();
 
+  // Let the worker thread do the modexp when it is running, reading
+  // resumes once receive_secret() is called.
+  if (manager->main_thread_disk()->is_active()) {
+    manager->main_thread_disk()->dh_pool()->compute_secret(
+      this,
+      DiffieHellmanPool::key_ptr(m_encryption.release_key()),
+      m_readBuffer.position(),
+      96);
+    m_readBuffer.consume(96);
+
+    m_state = READ_ENC_SECRET;
+    manager->poll()->remove_read(this);
+    return false;
+  }
+
   if (!m_encryption.key()->compute_secret(m_readBuffer.position(), 96))
     throw handshake_error(ConnectionManager::handshake_failed,
                           e_handshake_invalid_encryption);
   m_readBuffer.consume(96);
 
+  prepare_encryption_sync();
+  return true;
+}
+
+void
+Handshake::prepare_encryption_sync() {
   // Determine the synchronisation string.
   if (m_incoming)
     m_encryption.hash_req1_to_sync();
@@ -315,7 +339,28 @@ Handshake::read_encryption_key() {
     prepare_enc_negotiation();
 
   m_state = READ_ENC_SYNC;
-  return true;
+}
+
+void
+Handshake::receive_secret(DiffieHellmanPool::key_ptr key, bool result) {
+  if (m_state != READ_ENC_SECRET)
+    throw internal_error(
+      "Handshake::receive_secret() called in invalid state.");
+
+  m_encryption.set_key(key.release());
+
+  if (!result) {
+    m_manager->receive_failed(this,
+                              ConnectionManager::handshake_failed,
+                              e_handshake_invalid_encryption);
+    return;
+  }
+
+  prepare_encryption_sync();
+
+  // The rest of the pad and sync string may already be buffered.
+  manager->poll()->insert_read(this);
+  event_read();
 }
 
 // Handshake::read_encryption_sync()
@@ -374,6 +419,7 @@ Handshake::read_encryption_skey() {
   m_encryption.deobfuscate_hash((char*)m_readBuffer.position());
   m_download =
     m_manager->download_info_obfuscated((char*)m_readBuffer.position());
+  m_manager->update_download(this, nullptr);
   m_readBuffer.consume(20);
 
   validate_download();
@@ -546,6 +592,7 @@ Handshake::read_info() {
 
     } else {
       m_download = m_manager->download_info((char*)m_readBuffer.position());
+      m_manager->update_download(this, nullptr);
     }
 
     validate_download();
@@ -585,15 +632,26 @@ Handshake::read_peer() {
   // we're sending it (if it can't be sent in one write() call).
   m_initializedTime = cachedTime;
 
+  const Bitfield* bitfield = m_download->file_list()->bitfield();
+
   // The download is just starting so we're not sending any
   // bitfield. Pretend we wrote it already.
-  if (m_download->file_list()->bitfield()->is_all_unset() ||
-      m_download->initial_seeding() != nullptr) {
-    m_writePos = m_download->file_list()->bitfield()->size_bytes();
-    m_writeBuffer.write_32(0);
+  if (bitfield->is_all_unset() || m_download->initial_seeding() != nullptr) {
+    m_writePos = bitfield->size_bytes();
+
+    if (m_peerInfo->supports_fast()) {
+      prepare_have_all(false);
+
+    } else {
+      m_writeBuffer.write_32(0);
+
+      if (m_encryption.info()->is_encrypted())
+        m_encryption.info()->encrypt(m_writeBuffer.end() - 4, 4);
+    }
 
-    if (m_encryption.info()->is_encrypted())
-      m_encryption.info()->encrypt(m_writeBuffer.end() - 4, 4);
+  } else if (m_peerInfo->supports_fast() && bitfield->is_all_set()) {
+    m_writePos = bitfield->size_bytes();
+    prepare_have_all(true);
 
   } else {
     prepare_bitfield();
@@ -720,7 +778,7 @@ Handshake::read_done() {
     m_bitfield.allocate();
     m_bitfield.unset_all();
 
-  } else {
+  } else if (!m_bitfield.is_shared()) {
     m_bitfield.update();
   }
 
@@ -755,6 +813,9 @@ Handshake::event_read() {
         if (!read_encryption_key())
           break;
 
+        if (m_state == READ_ENC_SECRET)
+          break;
+
         if (m_state != READ_ENC_SYNC)
           goto restart;
 
@@ -885,6 +946,32 @@ Handshake::event_read() {
 
           m_state = READ_BITFIELD;
 
+        } else if ((m_readBuffer.peek_8_at(4) == protocol_have_all ||
+                    m_readBuffer.peek_8_at(4) == protocol_have_none) &&
+                   m_peerInfo->supports_fast()) {
+          if (!m_bitfield.empty() || m_readBuffer.read_32() != 1)
+            throw handshake_error(ConnectionManager::handshake_failed,
+                                  e_handshake_invalid_value);
+
+          // Seeders all refer to the download's shared bitfield.
+          if (m_readBuffer.read_8() == protocol_have_all) {
+            m_bitfield.share(*m_download->seed_bitfield());
+
+          } else {
+            m_bitfield.set_size_bits(
+              m_download->file_list()->bitfield()->size_bits());
+            m_bitfield.allocate();
+            m_bitfield.unset_all();
+          }
+
+          if (!m_peerInfo->supports_extensions() ||
+              !m_extensions->is_initial_handshake()) {
+            read_done();
+            break;
+          }
+
+          goto restart;
+
         } else if (m_readBuffer.peek_8_at(4) == protocol_extension &&
                    m_extensions->is_initial_handshake()) {
           m_readPos = 0;
@@ -1163,6 +1250,7 @@ Handshake::prepare_handshake() {
 
   std::memset(m_writeBuffer.end(), 0, 8);
   *(m_writeBuffer.end() + 5) |= 0x10; // support extension protocol
+  *(m_writeBuffer.end() + 7) |= 0x04; // support fast extension
   if (manager->dht_manager()->is_active())
     *(m_writeBuffer.end() + 7) |= 0x01; // DHT support, enable PORT message
   m_writeBuffer.move_end(8);
@@ -1230,6 +1318,17 @@ Handshake::prepare_bitfield() {
   m_writePos = 0;
 }
 
+// Fast extension peers are sent HAVE_ALL or HAVE_NONE in place of the
+// bitfield when it is trivial.
+void
+Handshake::prepare_have_all(bool s) {
+  m_writeBuffer.write_32(1);
+  m_writeBuffer.write_8(s ? protocol_have_all : protocol_have_none);
+
+  if (m_encryption.info()->is_encrypted())
+    m_encryption.info()->encrypt(m_writeBuffer.end() - 5, 5);
+}
+
 void
 Handshake::prepare_post_handshake(bool must_write) {
   if (m_writePos != m_download->file_list()->bitfield()->size_bytes())
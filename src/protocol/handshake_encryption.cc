@@ -6,6 +6,7 @@
 #include <algorithm>
 #include <functional>
 
+#include "manager.h"
 #include "protocol/handshake_encryption.h"
 #include "torrent/connection_manager.h"
 #include "torrent/exceptions.h"
@@ -36,8 +37,7 @@ HandshakeEncryption::should_retry() const {
 
 bool
 HandshakeEncryption::initialize() {
-  m_key = new DiffieHellman(
-    dh_prime, dh_prime_length, dh_generator, dh_generator_length);
+  m_key = manager->main_thread_disk()->dh_pool()->acquire().release();
 
   return m_key->is_valid();
 }
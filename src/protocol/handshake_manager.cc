@@ -1,5 +1,7 @@
 #include "download/download_main.h"
+#include "globals.h"
 #include "manager.h"
+#include "net/utp_context.h"
 #include "protocol/handshake.h"
 #include "protocol/peer_connection_base.h"
 #include "torrent/connection_manager.h"
@@ -41,58 +43,151 @@ handshake_manager_delete_handshake(Handshake* h) {
 
 HandshakeManager::size_type
 HandshakeManager::size_info(DownloadMain* info) const {
-  return std::count_if(base_type::begin(),
-                       base_type::end(),
-                       [info](Handshake* h) { return info == h->download(); });
+  auto itr     = m_downloads.find(info);
+  auto utp_itr = m_utpDownloads.find(info);
+
+  return (itr != m_downloads.end() ? itr->second.size() : 0) +
+         (utp_itr != m_utpDownloads.end() ? utp_itr->second : 0);
 }
 
 void
 HandshakeManager::clear() {
+  while (!m_utpPending.empty())
+    cancel_utp(m_utpPending.begin());
+
   for (const auto& handshake : *this) {
     handshake_manager_delete_handshake(handshake);
   }
 
   base_type::clear();
+  m_addresses.clear();
+  m_downloads.clear();
 }
 
 void
-HandshakeManager::erase(Handshake* handshake) {
-  auto itr = std::find(base_type::begin(), base_type::end(), handshake);
+HandshakeManager::insert(Handshake* handshake) {
+  if (!base_type::insert(handshake).second)
+    throw internal_error(
+      "HandshakeManager::insert(...) handshake already inserted.");
+
+  m_addresses.emplace(
+    socket_address_key::from_sockaddr(handshake->socket_address()->c_sockaddr()),
+    handshake);
+
+  if (handshake->download() != nullptr)
+    m_downloads[handshake->download()].insert(handshake);
+}
 
-  if (itr == base_type::end())
+void
+HandshakeManager::erase(Handshake* handshake) {
+  if (base_type::erase(handshake) == 0)
     throw internal_error(
       "HandshakeManager::erase(...) could not find handshake.");
 
-  base_type::erase(itr);
+  auto range = m_addresses.equal_range(socket_address_key::from_sockaddr(
+    handshake->socket_address()->c_sockaddr()));
+
+  for (auto itr = range.first; itr != range.second; ++itr) {
+    if (itr->second == handshake) {
+      m_addresses.erase(itr);
+      break;
+    }
+  }
+
+  auto download_itr = m_downloads.find(handshake->download());
+
+  if (download_itr != m_downloads.end()) {
+    download_itr->second.erase(handshake);
+
+    if (download_itr->second.empty())
+      m_downloads.erase(download_itr);
+  }
 }
 
 bool
 HandshakeManager::find(const utils::socket_address& sa) {
-  return std::any_of(base_type::begin(), base_type::end(), [sa](Handshake* h) {
-    return h->peer_info() != nullptr &&
-           sa == *utils::socket_address::cast_from(
-                   h->peer_info()->socket_address());
-  });
+  auto range =
+    m_addresses.equal_range(socket_address_key::from_sockaddr(sa.c_sockaddr()));
+
+  if (std::any_of(range.first, range.second, [sa](const auto& entry) {
+        Handshake* h = entry.second;
+
+        return h->peer_info() != nullptr &&
+               sa == *utils::socket_address::cast_from(
+                       h->peer_info()->socket_address());
+      }))
+    return true;
+
+  return std::any_of(
+    m_utpPending.begin(), m_utpPending.end(), [sa](const auto& entry) {
+      return entry.second.address == sa;
+    });
 }
 
 void
 HandshakeManager::erase_download(DownloadMain* info) {
-  auto split =
-    std::partition(base_type::begin(), base_type::end(), [info](Handshake* h) {
-      return info != h->download();
-    });
+  for (auto itr = m_utpPending.begin(); itr != m_utpPending.end();) {
+    if (itr->second.download == info)
+      cancel_utp(itr++);
+    else
+      ++itr;
+  }
+
+  auto download_itr = m_downloads.find(info);
+
+  if (download_itr == m_downloads.end())
+    return;
+
+  // Take the set out of the index first, erase() updates it.
+  auto handshakes = std::move(download_itr->second);
+  m_downloads.erase(download_itr);
 
-  std::for_each(split, base_type::end(), [](Handshake* h) {
-    return handshake_manager_delete_handshake(h);
-  });
-  base_type::erase(split, base_type::end());
+  for (auto h : handshakes) {
+    erase(h);
+    handshake_manager_delete_handshake(h);
+  }
+}
+
+void
+HandshakeManager::update_download(Handshake* h, DownloadMain* old_download) {
+  if (old_download == h->download())
+    return;
+
+  auto download_itr = m_downloads.find(old_download);
+
+  if (download_itr != m_downloads.end()) {
+    download_itr->second.erase(h);
+
+    if (download_itr->second.empty())
+      m_downloads.erase(download_itr);
+  }
+
+  if (h->download() != nullptr)
+    m_downloads[h->download()].insert(h);
+}
+
+bool
+HandshakeManager::can_admit() {
+  ConnectionManager* cm = manager->connection_manager();
+
+  if (cm->handshake_rate() != m_admission.rate() ||
+      std::max<uint32_t>(cm->handshake_burst(), 1) != m_admission.burst())
+    m_admission.set_rate(
+      cm->handshake_rate(), cm->handshake_burst(), cachedTime);
+
+  return m_admission.can_consume(cachedTime);
+}
+
+bool
+HandshakeManager::admit() {
+  return can_admit() && m_admission.try_consume(cachedTime);
 }
 
 void
 HandshakeManager::add_incoming(SocketFd fd, const utils::socket_address& sa) {
   if (!manager->connection_manager()->can_connect() ||
       !manager->connection_manager()->filter(sa.c_sockaddr()) ||
-      !setup_socket(fd)) {
+      !admit() || !setup_socket(fd)) {
     fd.close();
     return;
   }
@@ -105,14 +200,33 @@ HandshakeManager::add_incoming(SocketFd fd, const utils::socket_address& sa) {
     fd, this, manager->connection_manager()->encryption_options());
   h->initialize_incoming(sa);
 
-  base_type::push_back(h);
+  insert(h);
+}
+
+void
+HandshakeManager::add_incoming_utp(SocketFd                     fd,
+                                   const utils::socket_address& sa) {
+  if (!manager->connection_manager()->can_connect() || !admit()) {
+    fd.close();
+    return;
+  }
+
+  LT_LOG_SA(&sa, "Adding incoming uTP connection: fd:%i.", fd.get_fd());
+
+  manager->connection_manager()->inc_socket_count();
+
+  auto h = new Handshake(
+    fd, this, manager->connection_manager()->encryption_options());
+  h->initialize_incoming(sa);
+
+  insert(h);
 }
 
 void
 HandshakeManager::add_outgoing(const utils::socket_address& sa,
                                DownloadMain*                download) {
   if (!manager->connection_manager()->can_connect() ||
-      !manager->connection_manager()->filter(sa.c_sockaddr()))
+      !manager->connection_manager()->filter(sa.c_sockaddr()) || !admit())
     return;
 
   create_outgoing(
@@ -134,6 +248,20 @@ HandshakeManager::create_outgoing(const utils::socket_address& sa,
   if (peerInfo == nullptr || peerInfo->failed_counter() > max_failed)
     return;
 
+  ConnectionManager* cm = manager->connection_manager();
+
+  if (cm->utp()->is_open() &&
+      !utils::socket_address::cast_from(cm->proxy_address())->is_valid())
+    connect_utp(sa, download, peerInfo, encryptionOptions);
+  else
+    connect_tcp(sa, download, peerInfo, encryptionOptions);
+}
+
+void
+HandshakeManager::connect_tcp(const utils::socket_address& sa,
+                              DownloadMain*                download,
+                              PeerInfo*                    peerInfo,
+                              int                          encryptionOptions) {
   SocketFd                     fd;
   const utils::socket_address* bindAddress = utils::socket_address::cast_from(
     manager->connection_manager()->bind_address());
@@ -158,6 +286,36 @@ HandshakeManager::create_outgoing(const utils::socket_address& sa,
     return;
   }
 
+  start_outgoing(fd, sa, download, peerInfo, encryptionOptions);
+}
+
+void
+HandshakeManager::connect_utp(const utils::socket_address& sa,
+                              DownloadMain*                download,
+                              PeerInfo*                    peerInfo,
+                              int                          encryptionOptions) {
+  uint32_t id = m_utpNextId++;
+
+  UtpStream* stream = manager->connection_manager()->utp()->connect(
+    sa, [this, id](SocketFd fd, int error) {
+      receive_utp_connected(id, fd, error);
+    });
+
+  LT_LOG_SA(&sa, "Connecting over uTP.", 0);
+
+  manager->connection_manager()->inc_socket_count();
+
+  m_utpPending.emplace(
+    id, utp_pending{ stream, download, peerInfo, sa, encryptionOptions });
+  m_utpDownloads[download]++;
+}
+
+void
+HandshakeManager::start_outgoing(SocketFd                     fd,
+                                 const utils::socket_address& sa,
+                                 DownloadMain*                download,
+                                 PeerInfo*                    peerInfo,
+                                 int encryptionOptions) {
   int message;
 
   if (encryptionOptions & ConnectionManager::encryption_use_proxy)
@@ -177,7 +335,66 @@ HandshakeManager::create_outgoing(const utils::socket_address& sa,
   auto handshake = new Handshake(fd, this, encryptionOptions);
   handshake->initialize_outgoing(sa, download, peerInfo);
 
-  base_type::push_back(handshake);
+  insert(handshake);
+}
+
+void
+HandshakeManager::receive_utp_connected(uint32_t id, SocketFd fd, int error) {
+  auto itr = m_utpPending.find(id);
+
+  if (itr == m_utpPending.end())
+    throw internal_error(
+      "HandshakeManager::receive_utp_connected(...) unknown connection.");
+
+  utp_pending pending = erase_utp(itr);
+
+  if (fd.is_valid()) {
+    start_outgoing(fd,
+                   pending.address,
+                   pending.download,
+                   pending.peer_info,
+                   pending.encryption_options);
+    return;
+  }
+
+  // The peer may not support uTP, so retry over TCP.
+  LT_LOG_SA(&pending.address,
+            "uTP connect failed, falling back to TCP: %s.",
+            strerror(error));
+
+  connect_tcp(pending.address,
+              pending.download,
+              pending.peer_info,
+              pending.encryption_options);
+}
+
+void
+HandshakeManager::cancel_utp(utp_pending_map::iterator itr) {
+  utp_pending pending = erase_utp(itr);
+
+  manager->connection_manager()->utp()->cancel(pending.stream);
+  pending.download->peer_list()->disconnected(pending.peer_info, 0);
+}
+
+// Releases the reserved socket, which start_outgoing or connect_tcp
+// take again if the connection goes ahead.
+HandshakeManager::utp_pending
+HandshakeManager::erase_utp(utp_pending_map::iterator itr) {
+  utp_pending pending = itr->second;
+  m_utpPending.erase(itr);
+
+  auto download_itr = m_utpDownloads.find(pending.download);
+
+  if (download_itr == m_utpDownloads.end())
+    throw internal_error(
+      "HandshakeManager::erase_utp(...) download not found.");
+
+  if (--download_itr->second == 0)
+    m_utpDownloads.erase(download_itr);
+
+  manager->connection_manager()->dec_socket_count();
+
+  return pending;
 }
 
 void
@@ -302,6 +519,9 @@ HandshakeManager::setup_socket(SocketFd fd) {
       !fd.set_receive_buffer_size(m->receive_buffer_size()))
     return false;
 
+  if (m->send_lowat() != 0 && !fd.set_notsent_lowat(m->send_lowat()))
+    return false;
+
   return true;
 }
 
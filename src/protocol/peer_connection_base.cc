@@ -12,6 +12,7 @@
 #include "manager.h"
 #include "net/socket_base.h"
 #include "protocol/extensions.h"
+#include "protocol/fast_extension.h"
 #include "protocol/peer_connection_base.h"
 #include "torrent/chunk_manager.h"
 #include "torrent/connection_manager.h"
@@ -158,6 +159,11 @@ PeerConnectionBase::initialize(DownloadMain*      download,
 
   m_timeLastRead = cachedTime;
 
+  // Sample right away, the handshake has given the kernel a round
+  // trip estimate the request pipeline can start from.
+  m_peerInfo->mutable_tcp() = tcp_stats();
+  sample_tcp_stats();
+
   m_download->chunk_statistics()->received_connect(&m_peerChunks);
 
   // Hmm... cleanup?
@@ -165,6 +171,9 @@ PeerConnectionBase::initialize(DownloadMain*      download,
 
   m_peerChunks.download_cache()->clear();
 
+  if (m_peerInfo->supports_fast() && !m_download->info()->is_meta_download())
+    prepare_allowed_fast();
+
   if (!m_download->file_list()->is_done()) {
     m_sendInterested = true;
     m_downInterested = true;
@@ -217,6 +226,16 @@ PeerConnectionBase::cleanup() {
   m_download = nullptr;
 }
 
+void
+PeerConnectionBase::sample_tcp_stats() {
+  tcp_stats& stats = m_peerInfo->mutable_tcp();
+
+  if (!get_fd().is_valid() || !get_fd().get_tcp_stats(&stats))
+    return;
+
+  stats.sampled = cachedTime.seconds();
+}
+
 void
 PeerConnectionBase::set_upload_snubbed(bool v) {
   if (v)
@@ -870,6 +889,8 @@ PeerConnectionBase::up_chunk() {
 bool
 PeerConnectionBase::up_extension() {
   if (m_extensionOffset == extension_must_encrypt) {
+    // Shared broadcast buffers are never modified, the encrypted
+    // stream is written to a private copy instead.
     if (m_extensionMessage.owned()) {
       m_encryption.encrypt(m_extensionMessage.data(),
                            m_extensionMessage.length());
@@ -879,8 +900,8 @@ PeerConnectionBase::up_extension() {
 
       m_encryption.encrypt(
         m_extensionMessage.data(), buffer, m_extensionMessage.length());
-      m_extensionMessage.set(
-        buffer, buffer + m_extensionMessage.length(), true);
+      m_extensionMessage =
+        DataBuffer(buffer, buffer + m_extensionMessage.length());
     }
 
     m_extensionOffset = 0;
@@ -931,16 +952,32 @@ PeerConnectionBase::read_request_piece(const Piece& p) {
                        m_peerChunks.upload_queue()->end(),
                        p);
 
-  if (m_upChoke.choked() || itr != m_peerChunks.upload_queue()->end() ||
+  bool allowed =
+    !m_upChoke.choked() || m_peerChunks.is_allowed_fast(p.index());
+
+  if (!allowed || itr != m_peerChunks.upload_queue()->end() ||
       p.length() > (1 << 17)) {
     LT_LOG_PIECE_EVENTS("(up)   request_ignored  %" PRIu32 " %" PRIu32
                         " %" PRIu32,
                         p.index(),
                         p.offset(),
                         p.length());
+
+    // Fast extension peers expect an answer to every request.
+    if (m_peerInfo->supports_fast() &&
+        itr == m_peerChunks.upload_queue()->end()) {
+      m_peerChunks.reject_queue()->push_back(p);
+      write_insert_poll_safe();
+    }
+
     return;
   }
 
+  // Allowed fast pieces are uploaded while choked, which needs the
+  // throttle the unchoke would otherwise have added us to.
+  if (m_upChoke.choked())
+    m_up->throttle()->insert(m_peerChunks.upload_throttle());
+
   m_peerChunks.upload_queue()->push_back(p);
   write_insert_poll_safe();
 
@@ -1023,6 +1060,49 @@ PeerConnectionBase::write_prepare_extension(int               type,
     m_extensionOffset = extension_must_encrypt;
 }
 
+// New peers get a few chunks they may request while still choked, so
+// they have something to trade sooner.
+void
+PeerConnectionBase::prepare_allowed_fast() {
+  const Bitfield* bitfield = m_download->file_list()->bitfield();
+
+  if (bitfield->is_all_unset() || m_download->initial_seeding() != nullptr ||
+      m_peerChunks.bitfield()->size_set() >= allowed_fast_count)
+    return;
+
+  auto indices = allowed_fast_set(m_peerInfo->socket_address(),
+                                  m_download->info()->hash().c_str(),
+                                  bitfield->size_bits(),
+                                  allowed_fast_count);
+
+  for (auto index : indices) {
+    if (!bitfield->get(index) || m_peerChunks.bitfield()->get(index))
+      continue;
+
+    m_peerChunks.allowed_fast()->push_back(index);
+    m_peerChunks.allowed_fast_queue()->push_back(index);
+  }
+}
+
+// Suggest chunks the peer lacks that are already in the page cache, as
+// uploading those costs no disk reads.
+void
+PeerConnectionBase::prepare_suggest() {
+  const Bitfield* bitfield = m_download->file_list()->bitfield();
+
+  for (auto& node : *m_download->chunk_list()) {
+    if (m_peerChunks.suggest_queue()->size() >= max_suggest)
+      break;
+
+    if (!node.is_valid() || !bitfield->get(node.index()) ||
+        m_peerChunks.bitfield()->get(node.index()))
+      continue;
+
+    if (node.chunk()->is_incore(0))
+      m_peerChunks.suggest_queue()->push_back(node.index());
+  }
+}
+
 // High stall count peers should request if we're *not* in endgame, or
 // if we're in endgame and the download is too slow. Prefere not to request
 // from high stall counts when we are doing decent speeds.
@@ -19,6 +19,7 @@
 #include "torrent/peer/peer_info.h"
 #include "torrent/utils/log.h"
 #include "torrent/utils/string_manip.h"
+#include "utils/instrumentation.h"
 
 #define LT_LOG_NETWORK_ERRORS(log_fmt, ...)                                    \
   lt_log_print_info(LOG_PROTOCOL_NETWORK_ERRORS,                               \
@@ -246,14 +247,7 @@ PeerConnection<type>::read_message() {
       if (!m_down->can_read_request_body())
         break;
 
-      if (!m_upChoke.choked()) {
-        write_insert_poll_safe();
-        read_request_piece(m_down->read_request());
-
-      } else {
-        m_down->read_request();
-      }
-
+      read_request_piece(m_down->read_request());
       return true;
 
     case ProtocolBase::PIECE:
@@ -307,6 +301,43 @@ PeerConnection<type>::read_message() {
                                        m_down->buffer()->read_16());
       return true;
 
+    case ProtocolBase::SUGGEST:
+      if (!m_down->can_read_suggest_body())
+        break;
+
+      read_suggest_chunk(buf->read_32());
+      return true;
+
+    case ProtocolBase::HAVE_ALL:
+    case ProtocolBase::HAVE_NONE:
+      // Only valid in place of the bitfield, which the handshake reads.
+      throw communication_error(
+        "Received HAVE_ALL or HAVE_NONE after the first message.");
+
+    case ProtocolBase::REJECT:
+      if (!m_down->can_read_reject_body())
+        break;
+
+      if (!m_peerInfo->supports_fast())
+        throw communication_error(
+          "Received REJECT without fast extension support.");
+
+      if (type == Download::CONNECTION_LEECH)
+        request_list()->rejected(m_down->read_request());
+      else
+        m_down->read_request();
+
+      return true;
+
+    case ProtocolBase::ALLOWED_FAST:
+      if (!m_down->can_read_allowed_fast_body())
+        break;
+
+      // We only request from peers that unchoked us, so the chunks we
+      // may request while choked are of no use.
+      buf->read_32();
+      return true;
+
     case ProtocolBase::EXTENSION_PROTOCOL:
       if (!m_down->can_read_extension_body())
         break;
@@ -496,7 +527,16 @@ PeerConnection<type>::fill_write_buffer() {
     if (m_upChoke.choked()) {
       m_up->throttle()->erase(m_peerChunks.upload_throttle());
       up_chunk_release();
-      m_peerChunks.upload_queue()->clear();
+
+      // Choking no longer implies dropping the requests of fast
+      // extension peers, so reject each of them.
+      if (m_peerInfo->supports_fast())
+        m_peerChunks.reject_queue()->splice(
+          m_peerChunks.reject_queue()->end(), *m_peerChunks.upload_queue());
+      else
+        m_peerChunks.upload_queue()->clear();
+
+      m_peerChunks.suggest_queue()->clear();
 
       if (m_encryptBuffer != nullptr) {
         if (m_encryptBuffer->remaining())
@@ -509,6 +549,9 @@ PeerConnection<type>::fill_write_buffer() {
 
     } else {
       m_up->throttle()->insert(m_peerChunks.upload_throttle());
+
+      if (m_peerInfo->supports_fast())
+        prepare_suggest();
     }
   }
 
@@ -538,20 +581,22 @@ PeerConnection<type>::fill_write_buffer() {
   DownloadMain::have_queue_type* haveQueue = m_download->have_queue();
 
   if (type == Download::CONNECTION_LEECH && !haveQueue->empty() &&
-      m_peerChunks.have_timer() <= haveQueue->front().first &&
+      m_peerChunks.have_timer() <= haveQueue->back_time() &&
       m_up->can_write_have()) {
-    auto last =
-      std::find_if(haveQueue->begin(),
-                   haveQueue->end(),
-                   [this](DownloadMain::have_queue_type::value_type v) {
-                     return m_peerChunks.have_timer() > v.first;
-                   });
-
-    do {
-      m_up->write_have((--last)->second);
-    } while (last != haveQueue->begin() && m_up->can_write_have());
-
-    m_peerChunks.set_have_timer(last->first + 1);
+    // Append as many of the unsent pre-encoded HAVE messages as fit in
+    // the write buffer in one go, oldest first.
+    uint32_t first = haveQueue->find(m_peerChunks.have_timer());
+    uint32_t count =
+      std::min<uint32_t>(haveQueue->size() - first,
+                         m_up->buffer()->reserved_left() /
+                           ProtocolBase::sizeof_have);
+
+    m_up->write_have_messages(haveQueue->message_at(first), count);
+    m_peerChunks.set_have_timer(haveQueue->time_at(first + count - 1) + 1);
+
+    instrumentation_update(INSTRUMENTATION_TRANSFER_HAVE_MESSAGES, count);
+    instrumentation_update(INSTRUMENTATION_TRANSFER_HAVE_BYTES,
+                           count * ProtocolBase::sizeof_have);
   }
 
   if (type == Download::CONNECTION_INITIAL_SEED && m_up->can_write_have())
@@ -563,6 +608,29 @@ PeerConnection<type>::fill_write_buffer() {
     m_peerChunks.cancel_queue()->pop_front();
   }
 
+  while (!m_peerChunks.reject_queue()->empty() && m_up->can_write_reject()) {
+    m_up->write_reject(m_peerChunks.reject_queue()->front());
+    m_peerChunks.reject_queue()->pop_front();
+  }
+
+  while (!m_peerChunks.allowed_fast_queue()->empty() &&
+         m_up->can_write_allowed_fast()) {
+    m_up->write_allowed_fast(m_peerChunks.allowed_fast_queue()->back());
+    m_peerChunks.allowed_fast_queue()->pop_back();
+  }
+
+  while (!m_peerChunks.suggest_queue()->empty() && m_up->can_write_suggest()) {
+    m_up->write_suggest(m_peerChunks.suggest_queue()->back());
+    m_peerChunks.suggest_queue()->pop_back();
+  }
+
+  // Done uploading allowed fast pieces to a choked peer.
+  if (m_upChoke.choked() && m_peerChunks.upload_queue()->empty() &&
+      m_up->throttle()->is_throttled(m_peerChunks.upload_throttle())) {
+    m_up->throttle()->erase(m_peerChunks.upload_throttle());
+    up_chunk_release();
+  }
+
   if (m_sendPEXMask && m_up->can_write_extension() && send_pex_message()) {
     // Don't do anything else if send_pex_message() succeeded.
 
@@ -570,7 +638,9 @@ PeerConnection<type>::fill_write_buffer() {
              m_up->can_write_extension() && send_ext_message()) {
     // Same.
 
-  } else if (!m_upChoke.choked() && !m_peerChunks.upload_queue()->empty() &&
+    // The queue of a choked peer only holds allowed fast pieces, as the
+    // choke emptied it.
+  } else if (!m_peerChunks.upload_queue()->empty() &&
              m_up->can_write_piece() &&
              (type != Download::CONNECTION_INITIAL_SEED || should_upload())) {
     write_prepare_piece();
@@ -735,6 +805,33 @@ PeerConnection<type>::read_have_chunk(uint32_t index) {
   }
 }
 
+// Suggested chunks are tried before the chunk selector's own picks,
+// as the peer likely has them in its page cache.
+template<Download::ConnectionType type>
+void
+PeerConnection<type>::read_suggest_chunk(uint32_t index) {
+  if (!m_peerInfo->supports_fast())
+    throw communication_error(
+      "Received SUGGEST without fast extension support.");
+
+  if (index >= m_peerChunks.bitfield()->size_bits())
+    throw communication_error(
+      "Peer sent SUGGEST message with out-of-range index.");
+
+  if (type != Download::CONNECTION_LEECH ||
+      m_download->file_list()->is_done() ||
+      !m_peerChunks.bitfield()->get(index) ||
+      m_download->file_list()->bitfield()->get(index))
+    return;
+
+  PeerChunks::index_list_type* suggested = m_peerChunks.suggested();
+
+  if (suggested->size() >= max_suggested)
+    suggested->erase(suggested->begin());
+
+  suggested->push_back(index);
+}
+
 template<>
 void
 PeerConnection<Download::CONNECTION_INITIAL_SEED>::offer_chunk() {
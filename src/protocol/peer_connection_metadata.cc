@@ -129,6 +129,25 @@ PeerConnectionMetadata::read_message() {
       m_down->read_request();
       return true;
 
+    case ProtocolBase::SUGGEST:
+    case ProtocolBase::ALLOWED_FAST:
+      if (!m_down->can_read_suggest_body())
+        break;
+
+      buf->read_32();
+      return true;
+
+    case ProtocolBase::HAVE_ALL:
+    case ProtocolBase::HAVE_NONE:
+      return true;
+
+    case ProtocolBase::REJECT:
+      if (!m_down->can_read_reject_body())
+        break;
+
+      m_down->read_request();
+      return true;
+
     case ProtocolBase::PORT:
       if (!m_down->can_read_port_body())
         break;
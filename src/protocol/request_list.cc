@@ -8,6 +8,7 @@
 #include "torrent/data/block.h"
 #include "torrent/data/block_list.h"
 #include "torrent/exceptions.h"
+#include "torrent/peer/peer_info.h"
 #include "utils/instrumentation.h"
 
 namespace torrent {
@@ -102,11 +103,28 @@ RequestList::delegate() {
   m_affinity = transfer->index();
   m_queues.push_back(bucket_queued, transfer);
 
+  // Only requests with nothing queued ahead of them are timed, so the
+  // sample is not inflated by the pieces sent before the reply. Uses
+  // the current time rather than cachedTime, which is only updated
+  // before polling.
+  utils::timer now = utils::timer::current();
+
+  utils::timer expires =
+    m_rtt_probe_time + utils::timer::from_seconds(timeout_rtt_probe);
+
+  if (queued_size() == 1 &&
+      (m_rtt_probe_time == utils::timer() || expires < now)) {
+    m_rtt_probe      = transfer->piece();
+    m_rtt_probe_time = now;
+  }
+
   return &transfer->piece();
 }
 
 void
 RequestList::stall_initial() {
+  m_rtt_probe_time = utils::timer();
+
   queue_bucket_for_all_in_queue(
     m_queues, bucket_queued, [](BlockTransfer* transfer) {
       return Block::stalled(transfer);
@@ -143,7 +161,8 @@ RequestList::choked() {
   // Check if we want to update the choke timer; if non-zero and
   // updated within a short timespan?
 
-  m_last_choke = cachedTime;
+  m_last_choke     = cachedTime;
+  m_rtt_probe_time = utils::timer();
 
   if (m_queues.queue_empty(bucket_queued) &&
       m_queues.queue_empty(bucket_unordered))
@@ -181,6 +200,30 @@ RequestList::unchoked() {
   }
 }
 
+// Fast extension peers tell us when they drop a request, so the block
+// can be handed to other peers at once instead of waiting for the
+// request to stall or the choked queue to time out.
+void
+RequestList::rejected(const Piece& piece) {
+  std::pair<int, queues_type::iterator> itr =
+    queue_bucket_find_if_in_any(m_queues, request_list_same_piece(piece));
+
+  if (itr.first == request_list_constants::bucket_count)
+    return;
+
+  if (m_rtt_probe_time != utils::timer() && piece == m_rtt_probe)
+    m_rtt_probe_time = utils::timer();
+
+  if (itr.first == bucket_unordered &&
+      (size_t)std::distance(m_queues.begin(itr.first), itr.second) <
+        m_last_unordered_position)
+    m_last_unordered_position--;
+
+  m_queues.destroy(itr.first, itr.second, itr.second + 1);
+
+  instrumentation_update(INSTRUMENTATION_TRANSFER_REQUESTS_REJECTED, 1);
+}
+
 void
 RequestList::delay_remove_choked() {
   m_queues.clear(bucket_choked);
@@ -231,6 +274,8 @@ RequestList::clear() {
   if (is_downloading())
     skipped();
 
+  m_rtt_probe_time = utils::timer();
+
   m_queues.clear(bucket_queued);
   m_queues.clear(bucket_unordered);
   m_queues.clear(bucket_stalled);
@@ -245,6 +290,11 @@ RequestList::downloading(const Piece& piece) {
 
   instrumentation_update(INSTRUMENTATION_TRANSFER_REQUESTS_DOWNLOADING, 1);
 
+  if (m_rtt_probe_time != utils::timer() && piece == m_rtt_probe)
+    sample_rtt();
+
+  sample_delivery_rate(piece.length());
+
   std::pair<int, queues_type::iterator> itr =
     queue_bucket_find_if_in_any(m_queues, request_list_same_piece(piece));
 
@@ -386,8 +436,90 @@ RequestList::is_interested_in_active() const {
   return false;
 }
 
+void
+RequestList::sample_rtt() {
+  utils::timer now     = utils::timer::current();
+  int64_t      elapsed = (now - m_rtt_probe_time).usec();
+
+  m_rtt_probe_time = utils::timer();
+  m_rtt_sampled    = now;
+
+  if (elapsed <= 0)
+    return;
+
+  elapsed = std::min<int64_t>(elapsed, UINT32_MAX);
+
+  if (m_rtt_usec == 0)
+    m_rtt_usec = elapsed;
+  else
+    m_rtt_usec = (7 * int64_t(m_rtt_usec) + elapsed) / 8;
+}
+
+// The throttle rate is averaged over a long span and lags far behind
+// a connection that is speeding up, so measure the rate pieces arrive
+// at over windows of a few round trips. Increases are taken at once.
+void
+RequestList::sample_delivery_rate(uint32_t length) {
+  utils::timer now = utils::timer::current();
+
+  m_delivered += length;
+
+  if (m_delivery_start == utils::timer()) {
+    m_delivery_start     = now;
+    m_delivery_start_pos = m_delivered;
+    return;
+  }
+
+  int64_t elapsed = (now - m_delivery_start).usec();
+  int64_t window =
+    std::max<int64_t>(2 * int64_t(m_rtt_usec), delivery_window_usec);
+
+  if (elapsed < window)
+    return;
+
+  uint64_t rate = std::min<uint64_t>(
+    (m_delivered - m_delivery_start_pos) * 1000000 / elapsed, UINT32_MAX);
+
+  if (rate > m_delivery_rate)
+    m_delivery_rate = rate;
+  else
+    m_delivery_rate = (3 * uint64_t(m_delivery_rate) + rate) / 4;
+
+  m_delivery_start     = now;
+  m_delivery_start_pos = m_delivered;
+}
+
+// Once the round trip is known, keep four times the bandwidth-delay
+// product in flight, which grows the pipe each window while the peer
+// keeps up and leaves room for the refill hysteresis in
+// PeerConnectionBase::try_request_pieces. Queued requests would
+// inflate the samples, so the pipe is drained to a single request when
+// the estimate gets old. Endgame keeps the small rate-based queues to
+// limit duplicate requests.
 uint32_t
 RequestList::calculate_pipe_size(uint32_t rate) {
+  // Until a request has been timed, start from the kernel's estimate
+  // of the connection's round trip.
+  uint32_t rtt = m_rtt_usec;
+
+  if (rtt == 0 && m_peerChunks != nullptr &&
+      m_peerChunks->peer_info() != nullptr)
+    rtt = m_peerChunks->peer_info()->tcp().rtt_usec;
+
+  if (!m_delegator->get_aggressive() && m_delegator->pipe_max() != 0 &&
+      rtt != 0) {
+    if (m_rtt_usec != 0 &&
+        m_rtt_sampled + utils::timer::from_seconds(timeout_rtt_refresh) <
+          utils::timer::current())
+      return 1;
+
+    uint64_t bdp = uint64_t(std::max(rate, m_delivery_rate)) * rtt / 1000000;
+    uint64_t size = 4 * bdp / Delegator::block_size + 2;
+
+    return std::clamp<uint64_t>(
+      size, m_delegator->pipe_min(), m_delegator->pipe_max());
+  }
+
   // Change into KB.
   rate /= 1024;
 
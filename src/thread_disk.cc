@@ -37,6 +37,7 @@ thread_disk::call_events() {
     throw shutdown_exception();
   }
 
+  m_dh_pool.perform();
   m_hash_queue.perform();
 }
 
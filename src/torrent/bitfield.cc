@@ -43,6 +43,12 @@ Bitfield::unallocate() {
   if (m_data == nullptr)
     return;
 
+  if (m_shared) {
+    m_data   = nullptr;
+    m_shared = false;
+    return;
+  }
+
   delete[] m_data;
   m_data = nullptr;
 
@@ -90,6 +96,17 @@ Bitfield::swap(Bitfield& bf) {
   std::swap(m_size, bf.m_size);
   std::swap(m_set, bf.m_set);
   std::swap(m_data, bf.m_data);
+  std::swap(m_shared, bf.m_shared);
+}
+
+void
+Bitfield::share(const Bitfield& bf) {
+  unallocate();
+
+  m_size   = bf.m_size;
+  m_set    = bf.m_set;
+  m_data   = bf.m_data;
+  m_shared = m_data != nullptr;
 }
 
 void
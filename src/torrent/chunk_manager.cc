@@ -3,25 +3,39 @@
 
 #include "torrent/buildinfo.h"
 
+#include <algorithm>
 #include <sys/resource.h>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <unistd.h>
 
 #include "data/chunk_list.h"
+#include "data/memory_governor.h"
 #include "globals.h"
 #include "torrent/chunk_manager.h"
 #include "torrent/exceptions.h"
+#include "torrent/utils/log.h"
 #include "utils/instrumentation.h"
 
+#define LT_LOG_GOVERNOR(log_fmt, ...)                                          \
+  lt_log_print(LOG_STORAGE_INFO, "chunk_manager: " log_fmt, __VA_ARGS__);
+
 namespace torrent {
 
-ChunkManager::ChunkManager() {
+ChunkManager::ChunkManager()
+  : m_memoryGovernor(new MemoryGovernor) {
 
   // 2/5 of the available memory should be enough for the client. If
   // the client really requires a lot more memory it should call this
-  // itself.
-  m_maxMemoryUsage = (estimate_max_memory_usage() * 2) / 5;
+  // itself. The default also stays within memory.max of the cgroup.
+  uint64_t available  = estimate_max_memory_usage();
+  uint64_t cgroup_max = m_memoryGovernor->cgroup_max();
+
+  if (cgroup_max != 0)
+    available = std::min(available, cgroup_max);
+
+  m_maxMemoryUsage      = (available * 2) / 5;
+  m_governedMemoryUsage = m_maxMemoryUsage;
 }
 
 ChunkManager::~ChunkManager() {
@@ -120,12 +134,70 @@ ChunkManager::erase(ChunkList* chunkList) {
   chunkList->set_manager(nullptr);
 }
 
+void
+ChunkManager::set_memory_governor(bool state) {
+  m_memoryGovernorEnabled = state;
+
+  if (!state)
+    m_governedMemoryUsage = m_maxMemoryUsage;
+}
+
+void
+ChunkManager::update_memory_governor() {
+  if (!m_memoryGovernorEnabled)
+    return;
+
+  memory_sample sample = m_memoryGovernor->sample();
+
+  m_governorStats.cgroup_max     = sample.cgroup_max;
+  m_governorStats.cgroup_current = sample.cgroup_current;
+  m_governorStats.pressure_some  = sample.pressure_some;
+  m_governorStats.pressure_full  = sample.pressure_full;
+  m_governorStats.updates++;
+
+  uint64_t limit = MemoryGovernor::next_limit(
+    sample, m_governedMemoryUsage, m_memoryUsage, m_maxMemoryUsage);
+
+  if (limit != m_governedMemoryUsage) {
+    LT_LOG_GOVERNOR("memory limit %" PRIu64 " -> %" PRIu64
+                    " usage:%" PRIu64 " cgroup:%" PRIu64 "/%" PRIu64
+                    " pressure:%" PRIu32,
+                    m_governedMemoryUsage,
+                    limit,
+                    m_memoryUsage,
+                    sample.cgroup_current,
+                    sample.cgroup_max,
+                    sample.pressure_some);
+
+    if (limit < m_governedMemoryUsage)
+      m_governorStats.lowered++;
+    else
+      m_governorStats.raised++;
+
+    m_governedMemoryUsage = limit;
+  }
+
+  // Free down to 3/4 of the new limit without waiting for an
+  // allocation to fail. Syncing is expensive and may free nothing
+  // while chunks are held by the hash queue or peers, so this obeys
+  // the same starvation timer as 'try_free_memory'.
+  if (m_memoryUsage > m_governedMemoryUsage &&
+      m_timerStarved + 10 < cachedTime.seconds()) {
+    uint64_t before = m_memoryUsage;
+
+    try_free_memory(m_memoryUsage - (3 * m_governedMemoryUsage) / 4);
+
+    m_governorStats.reclaims++;
+    m_governorStats.reclaimed += before - std::min(before, m_memoryUsage);
+  }
+}
+
 bool
 ChunkManager::allocate(uint32_t size, int flags) {
-  if (m_memoryUsage + size > (3 * m_maxMemoryUsage) / 4)
-    try_free_memory((1 * m_maxMemoryUsage) / 4);
+  if (m_memoryUsage + size > (3 * m_governedMemoryUsage) / 4)
+    try_free_memory((1 * m_governedMemoryUsage) / 4);
 
-  if (m_memoryUsage + size > m_maxMemoryUsage) {
+  if (m_memoryUsage + size > m_governedMemoryUsage) {
     if (!(flags & allocate_dont_log))
       instrumentation_update(INSTRUMENTATION_MINCORE_ALLOC_FAILED, 1);
 
@@ -187,6 +259,25 @@ ChunkManager::periodic_sync() {
   sync_all(ChunkList::sync_use_timeout, 0);
 }
 
+void
+ChunkManager::receive_sync(dev_t    device,
+                           uint32_t bytes,
+                           uint64_t usec,
+                           bool     success) {
+  auto& stats = m_syncStats[device];
+
+  stats.syncs++;
+  stats.usec += usec;
+  stats.max_usec = std::max(stats.max_usec, usec);
+
+  if (success)
+    stats.bytes += bytes;
+  else
+    stats.failed++;
+}
+
+// Periodic syncs are limited to 'm_syncQueueDepth' chunks per device,
+// so a slow disk doesn't hold up syncing downloads on other devices.
 void
 ChunkManager::sync_all(int flags, uint64_t target) {
   if (empty())
@@ -198,11 +289,26 @@ ChunkManager::sync_all(int flags, uint64_t target) {
 
   auto itr = base_type::begin() + m_lastFreed;
 
+  // Device syncs count at the start of this call.
+  std::map<dev_t, uint64_t> device_syncs;
+
   do {
     if (itr == base_type::end())
       itr = base_type::begin();
 
-    (*itr)->sync_chunks(flags);
+    ChunkList* chunk_list = *itr;
+
+    if (m_syncQueueDepth == 0 || !(flags & ChunkList::sync_use_timeout)) {
+      chunk_list->sync_chunks(flags);
+      continue;
+    }
+
+    dev_t    device = chunk_list->device();
+    uint64_t syncs  = m_syncStats[device].syncs;
+    uint64_t used   = syncs - device_syncs.emplace(device, syncs).first->second;
+
+    if (used < m_syncQueueDepth)
+      chunk_list->sync_chunks(flags, m_syncQueueDepth - used);
 
   } while (++itr != base_type::begin() + m_lastFreed &&
            m_memoryUsage >= target);
@@ -1,53 +1,27 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 // Copyright (C) 2005-2011, Jari Sundell <jaris@ifi.uio.no>
 
+#include "torrent/buildinfo.h"
+
 #include <sys/types.h>
 #include <utility>
 
 #include "manager.h"
 #include "net/listen.h"
+#include "net/resolver.h"
+#include "net/utp_context.h"
 #include "torrent/connection_manager.h"
 #include "torrent/error.h"
 #include "torrent/exceptions.h"
-#include "torrent/utils/address_info.h"
+#include "torrent/net/ip_filter.h"
 #include "torrent/utils/socket_address.h"
 
 namespace torrent {
 
-// Fix TrackerUdp, etc, if this is made async.
-static ConnectionManager::slot_resolver_result_type*
-resolve_host(const char*                                         host,
-             int                                                 family,
-             int                                                 socktype,
-             const ConnectionManager::slot_resolver_result_type& slot) {
-  if (manager->main_thread_main()->is_current())
-    thread_base::release_global_lock();
-
-  utils::address_info* ai;
-  int                  err;
-
-  if ((err = utils::address_info::get_address_info(
-         host, family, socktype, &ai)) != 0) {
-    if (manager->main_thread_main()->is_current())
-      thread_base::acquire_global_lock();
-
-    slot(nullptr, err);
-    return nullptr;
-  }
-
-  utils::socket_address sa;
-  sa.copy(*ai->address(), ai->length());
-  utils::address_info::free_address_info(ai);
-
-  if (manager->main_thread_main()->is_current())
-    thread_base::acquire_global_lock();
-
-  slot(sa.c_sockaddr(), 0);
-  return nullptr;
-}
-
 ConnectionManager::ConnectionManager()
-  : m_listen(new Listen) {
+  : m_listen(new Listen)
+  , m_resolver(new Resolver)
+  , m_utp(new UtpContext) {
   m_bindAddress  = (new utils::socket_address())->c_sockaddr();
   m_localAddress = (new utils::socket_address())->c_sockaddr();
   m_proxyAddress = (new utils::socket_address())->c_sockaddr();
@@ -56,16 +30,18 @@ ConnectionManager::ConnectionManager()
   utils::socket_address::cast_from(m_localAddress)->clear();
   utils::socket_address::cast_from(m_proxyAddress)->clear();
 
-  m_slot_resolver = [](const char*                      host,
-                       int                              family,
-                       int                              socktype,
-                       const slot_resolver_result_type& slot) {
-    return resolve_host(host, family, socktype, slot);
+  m_slot_resolver = [this](const char*                      host,
+                           int                              family,
+                           int                              socktype,
+                           const slot_resolver_result_type& slot) {
+    return m_resolver->resolve(host, family, socktype, slot);
   };
 }
 
 ConnectionManager::~ConnectionManager() {
+  delete m_utp;
   delete m_listen;
+  delete m_resolver;
 
   delete utils::socket_address::cast_from(m_bindAddress);
   delete utils::socket_address::cast_from(m_localAddress);
@@ -87,11 +63,27 @@ ConnectionManager::set_receive_buffer_size(uint32_t s) {
   m_receiveBufferSize = s;
 }
 
+void
+ConnectionManager::set_send_lowat(uint32_t s) {
+#ifndef LT_HAVE_TCP_NOTSENT_LOWAT
+  if (s != 0)
+    throw input_error("TCP_NOTSENT_LOWAT is not supported.");
+#endif
+
+  m_sendLowat = s;
+}
+
 void
 ConnectionManager::set_encryption_options(uint32_t options) {
   m_encryptionOptions = options;
 }
 
+void
+ConnectionManager::set_handshake_rate(uint32_t rate, uint32_t burst) {
+  m_handshakeRate  = rate;
+  m_handshakeBurst = burst != 0 ? burst : rate;
+}
+
 void
 ConnectionManager::set_bind_address(const sockaddr* sa) {
   const utils::socket_address* rsa = utils::socket_address::cast_from(sa);
@@ -127,12 +119,28 @@ ConnectionManager::set_proxy_address(const sockaddr* sa) {
 
 uint32_t
 ConnectionManager::filter(const sockaddr* sa) {
+  uint32_t value = 1;
+
+  if (auto f = std::atomic_load(&m_addressFilter); f != nullptr)
+    if ((value = f->lookup(sa)) == 0)
+      return 0;
+
   if (!m_slot_filter)
-    return 1;
+    return value;
   else
     return m_slot_filter(sa);
 }
 
+std::shared_ptr<const ip_filter>
+ConnectionManager::address_filter() const {
+  return std::atomic_load(&m_addressFilter);
+}
+
+void
+ConnectionManager::set_address_filter(std::shared_ptr<const ip_filter> f) {
+  std::atomic_store(&m_addressFilter, std::move(f));
+}
+
 bool
 ConnectionManager::listen_open(port_type begin, port_type end) {
   if (!m_listen->open(begin,
@@ -143,14 +151,28 @@ ConnectionManager::listen_open(port_type begin, port_type end) {
 
   m_listen_port = m_listen->port();
 
+  // Peers are still reachable over TCP if the UDP port is taken.
+  if (m_utpEnabled)
+    m_utp->open(utils::socket_address::cast_from(m_bindAddress),
+                m_listen_port);
+
   return true;
 }
 
 void
 ConnectionManager::listen_close() {
+  m_utp->close();
   m_listen->close();
 }
 
+void
+ConnectionManager::set_utp_enabled(bool state) {
+  if (m_listen->is_open())
+    throw input_error("uTP must be enabled before listen port is opened");
+
+  m_utpEnabled = state;
+}
+
 void
 ConnectionManager::set_listen_backlog(int v) {
   if (v < 1 || v >= (1 << 16))
@@ -48,6 +48,7 @@ TransferList::clear() {
   }
 
   base_type::clear();
+  m_version++;
 }
 
 TransferList::iterator
@@ -59,6 +60,7 @@ TransferList::insert(const Piece& piece, uint32_t blockSize) {
   auto blockList = new BlockList(piece, blockSize);
 
   m_slot_queued(piece.index());
+  m_version++;
 
   return base_type::insert(end(), blockList);
 }
@@ -72,6 +74,7 @@ TransferList::erase(iterator itr) {
     throw internal_error("TransferList::erase(...) itr == m_chunks.end().");
 
   delete *itr;
+  m_version++;
 
   return base_type::erase(itr);
 }
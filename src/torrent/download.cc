@@ -25,6 +25,7 @@
 #include "torrent/throttle.h"
 #include "torrent/tracker_controller.h"
 #include "torrent/tracker_list.h"
+#include "torrent/utils/file_stat.h"
 #include "torrent/utils/log.h"
 
 #define LT_LOG_THIS(log_level, log_fmt, ...)                                   \
@@ -107,6 +108,11 @@ Download::start(int flags) {
   // flag_queued_create set.
   file_list()->open(flags & ~FileList::open_no_create);
 
+  utils::file_stat fs;
+
+  if (fs.update(m_ptr->main()->file_list()->root_dir()))
+    m_ptr->main()->chunk_list()->set_device(fs.device());
+
   if (m_ptr->connection_type() == CONNECTION_INITIAL_SEED) {
     if (!m_ptr->main()->start_initial_seeding())
       set_connection_type(CONNECTION_SEED);
@@ -184,6 +190,11 @@ Download::hash_check(bool tryQuick) {
 
   m_ptr->main()->file_list()->update_completed();
 
+  utils::file_stat fs;
+
+  if (fs.update(m_ptr->main()->file_list()->root_dir()))
+    m_ptr->hash_checker()->set_device(fs.device());
+
   return m_ptr->hash_checker()->start(tryQuick);
 }
 
@@ -230,6 +241,42 @@ Download::set_sequential_enabled(bool enabled) {
   m_ptr->main()->chunk_selector()->set_sequential_enabled(enabled);
 }
 
+void
+Download::set_deadline(uint32_t playhead,
+                       uint32_t window,
+                       uint32_t interval_ms) {
+  m_ptr->main()->chunk_selector()->set_deadline(playhead, window, interval_ms);
+  m_ptr->main()->delegator()->set_deadline_enabled(window != 0);
+}
+
+uint32_t
+Download::deadline_misses() const {
+  return m_ptr->main()->chunk_selector()->deadline_misses();
+}
+
+uint64_t
+Download::deadline_stall_usec() const {
+  return m_ptr->main()->chunk_selector()->deadline_stall_usec();
+}
+
+void
+Download::set_request_pipeline(uint32_t min, uint32_t max) {
+  if (max != 0 && min > max)
+    throw input_error("Download::set_request_pipeline(...) min > max.");
+
+  m_ptr->main()->delegator()->set_pipe_bounds(min, max);
+}
+
+uint32_t
+Download::request_pipeline_min() const {
+  return m_ptr->main()->delegator()->pipe_min();
+}
+
+uint32_t
+Download::request_pipeline_max() const {
+  return m_ptr->main()->delegator()->pipe_max();
+}
+
 Object*
 Download::bencode() {
   return m_ptr->bencode();
@@ -22,6 +22,18 @@ struct choke_manager_less {
   }
 };
 
+// Moves the 'count' highest weighted connections to the back of the
+// range in linear time, leaving both parts unordered.
+void
+choke_select_highest(choke_queue::iterator first,
+                     choke_queue::iterator last,
+                     uint32_t              count) {
+  if (count == 0 || count >= (uint32_t)std::distance(first, last))
+    return;
+
+  std::nth_element(first, last - count, last, choke_manager_less());
+}
+
 static inline bool
 should_connection_unchoke(choke_queue* cq, PeerConnectionBase* pcb) {
   return pcb->should_connection_unchoke(cq);
@@ -80,17 +92,42 @@ choke_queue::prepare_weights(group_stats gs) {
   // also remember to clear the queue/unchoked thingies.
 
   for (const auto& entries : m_group_container) {
-    m_heuristics_list[m_heuristics].slot_choke_weight(
-      entries->mutable_unchoked()->begin(), entries->mutable_unchoked()->end());
-    std::sort(entries->mutable_unchoked()->begin(),
-              entries->mutable_unchoked()->end(),
-              choke_manager_less());
-
-    m_heuristics_list[m_heuristics].slot_unchoke_weight(
-      entries->mutable_queued()->begin(), entries->mutable_queued()->end());
-    std::sort(entries->mutable_queued()->begin(),
-              entries->mutable_queued()->end(),
-              choke_manager_less());
+    auto unchoked = entries->mutable_unchoked();
+    auto queued   = entries->mutable_queued();
+
+    unsigned int min_slots =
+      std::min(entries->min_slots(), entries->max_slots());
+
+    // Rather than sorting the containers, only rank the connections
+    // retrieve_connections() will look at: the 'min_slots' lowest
+    // weighted unchoked connections stay at the front, and the
+    // queued connections it unchokes or offers as candidates are
+    // moved to the back.
+    m_heuristics_list[m_heuristics].slot_choke_weight(unchoked->begin(),
+                                                      unchoked->end());
+    choke_select_highest(unchoked->begin(),
+                         unchoked->end(),
+                         unchoked->size() -
+                           std::min<uint32_t>(unchoked->size(), min_slots));
+
+    m_heuristics_list[m_heuristics].slot_unchoke_weight(queued->begin(),
+                                                        queued->end());
+
+    uint32_t fill = 0;
+
+    if (unchoked->size() < min_slots)
+      fill = std::min<uint32_t>(queued->size(), min_slots - unchoked->size());
+
+    uint32_t filled     = unchoked->size() + fill;
+    uint32_t candidates = 0;
+
+    if (filled < entries->max_slots())
+      candidates = std::min<uint32_t>(queued->size() - fill,
+                                      entries->max_slots() - filled);
+
+    choke_select_highest(queued->begin(), queued->end(), fill + candidates);
+    choke_select_highest(
+      queued->end() - (fill + candidates), queued->end(), fill);
 
     // Aggregate the statistics... Remember to update them after
     // optimistic/pessimistic unchokes.
@@ -180,19 +217,14 @@ choke_queue::retrieve_connections(group_stats     gs,
   return gs;
 }
 
-void
-choke_queue::rebuild_containers(container_type* queued,
-                                container_type* unchoked) {
-  queued->clear();
-  unchoked->clear();
+uint32_t
+choke_queue::count_unchoked() const {
+  uint32_t count = 0;
 
-  for (const auto& entries : m_group_container) {
-    queued->insert(
-      queued->end(), entries->queued()->begin(), entries->queued()->end());
-    unchoked->insert(unchoked->end(),
-                     entries->unchoked()->begin(),
-                     entries->unchoked()->end());
-  }
+  for (const auto& entries : m_group_container)
+    count += entries->unchoked()->size();
+
+  return count;
 }
 
 void
@@ -256,20 +288,30 @@ choke_queue::balance() {
 
 void
 choke_queue::balance_entry(group_entry* entry) {
-  m_heuristics_list[m_heuristics].slot_choke_weight(
-    entry->mutable_unchoked()->begin(), entry->mutable_unchoked()->end());
-  std::sort(entry->mutable_unchoked()->begin(),
-            entry->mutable_unchoked()->end(),
-            choke_manager_less());
+  auto unchoked = entry->mutable_unchoked();
+  auto queued   = entry->mutable_queued();
+
+  m_heuristics_list[m_heuristics].slot_choke_weight(unchoked->begin(),
+                                                    unchoked->end());
+
+  // Only the connections about to be choked or unchoked need to be
+  // ranked, move them to the back.
+  uint32_t remaining = std::min<uint32_t>(unchoked->size(), entry->max_slots());
+  uint32_t min_slots = std::min(entry->min_slots(), entry->max_slots());
+
+  choke_select_highest(
+    unchoked->begin(), unchoked->end(), unchoked->size() - remaining);
 
-  m_heuristics_list[m_heuristics].slot_unchoke_weight(
-    entry->mutable_queued()->begin(), entry->mutable_queued()->end());
-  std::sort(entry->mutable_queued()->begin(),
-            entry->mutable_queued()->end(),
-            choke_manager_less());
+  m_heuristics_list[m_heuristics].slot_unchoke_weight(queued->begin(),
+                                                      queued->end());
 
-  int          count     = 0;
-  unsigned int min_slots = std::min(entry->min_slots(), entry->max_slots());
+  if (remaining < min_slots)
+    choke_select_highest(
+      queued->begin(),
+      queued->end(),
+      std::min<uint32_t>(queued->size(), min_slots - remaining));
+
+  int count = 0;
 
   while (!entry->unchoked()->empty() &&
          entry->unchoked()->size() > entry->max_slots())
@@ -285,18 +327,12 @@ int
 choke_queue::cycle(uint32_t quota) noexcept(false) {
   // TODO: This should not use the old values, but rather the number
   // of unchoked this round.
-  // HACKKKKKK
   container_type queued;
   container_type unchoked;
 
-  rebuild_containers(&queued, &unchoked);
-
-  int      oldSize   = unchoked.size();
+  int      oldSize   = count_unchoked();
   uint32_t alternate = max_alternate();
 
-  queued.clear();
-  unchoked.clear();
-
   group_stats gs;
   std::memset(&gs, 0, sizeof(group_stats));
 
@@ -335,17 +371,15 @@ choke_queue::cycle(uint32_t quota) noexcept(false) {
   if (unchoked.size() > quota)
     throw internal_error("choke_queue::cycle() unchoked.size() > quota.");
 
-  rebuild_containers(&queued, &unchoked); // Remove...
+  int newSize = count_unchoked();
 
-  lt_log_print(
-    LOG_PEER_DEBUG,
-    "After cycle; queued:%u unchoked:%u unchoked_count:%i old_size:%i.",
-    (unsigned)queued.size(),
-    (unsigned)unchoked.size(),
-    unchoked_count,
-    oldSize);
+  lt_log_print(LOG_PEER_DEBUG,
+               "After cycle; unchoked:%i unchoked_count:%i old_size:%i.",
+               newSize,
+               unchoked_count,
+               oldSize);
 
-  return ((int)unchoked.size() - (int)oldSize); // + gs.changed_unchoke
+  return newSize - oldSize; // + gs.changed_unchoke
 }
 
 void
@@ -500,8 +534,10 @@ choke_manager_allocate_slots(choke_queue::iterator     first,
                              uint32_t                  max,
                              uint32_t*                 weights,
                              choke_queue::target_type* target) {
-  // Sorting the connections from the lowest to highest value.
-  // TODO:  std::sort(first, last, choke_manager_less());
+  // Partition the connections by order, lowest first. The range may
+  // hold candidates from several groups so it is not sorted, and only
+  // the connections picked within each order get ranked by
+  // adjust_choke_range().
 
   // 'weightTotal' only contains the weight of targets that have
   // connections to unchoke. When all connections are in a group are
@@ -514,9 +550,9 @@ choke_manager_allocate_slots(choke_queue::iterator     first,
   for (uint32_t i = 0; i < choke_queue::order_max_size; i++) {
     target[i].first = 0;
     target[i + 1].second =
-      std::find_if(target[i].second, last, [i](choke_queue::value_type& v) {
-        return (i * choke_queue::order_base + (choke_queue::order_base - 1)) <
-               v.weight;
+      std::partition(target[i].second, last, [i](choke_queue::value_type& v) {
+        return v.weight <=
+               (i * choke_queue::order_base + (choke_queue::order_base - 1));
       });
 
     if (std::distance(target[i].second, target[i + 1].second) != 0)
@@ -635,6 +671,8 @@ choke_queue::adjust_choke_range(iterator        first,
     (itr - 1)->first += std::min(skipped, order_remaining);
     skipped -= std::min(skipped, order_remaining);
 
+    choke_select_highest((itr - 1)->second, itr->second, (itr - 1)->first);
+
     auto first_adjust = itr->second - (itr - 1)->first;
     auto last_adjust  = itr->second;
 
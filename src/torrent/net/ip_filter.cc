@@ -0,0 +1,363 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2005-2011, Jari Sundell <jaris@ifi.uio.no>
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <set>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "torrent/exceptions.h"
+#include "torrent/net/ip_filter.h"
+#include "torrent/net/socket_address.h"
+
+namespace torrent {
+
+namespace {
+
+struct header_type {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t index_bits;
+  uint32_t default_value;
+  uint32_t size_v4;
+  uint32_t size_v6;
+  uint32_t checksum;
+  uint64_t reserved;
+};
+
+static_assert(sizeof(header_type) == ip_filter::header_size);
+
+// The IPv6 starts come first to keep them 8-byte aligned.
+size_t
+body_size(uint32_t size_v4, uint32_t size_v6) {
+  return size_v6 * 16 + size_v4 * 8 + ip_filter::index_size * 4 + size_v6 * 4;
+}
+
+uint32_t
+checksum(const char* data, size_t size) {
+  uint32_t hash = 2166136261u;
+
+  for (size_t i = 0; i + 4 <= size; i += 4) {
+    uint32_t word;
+    std::memcpy(&word, data + i, 4);
+    hash = (hash ^ word) * 16777619u;
+  }
+
+  return hash;
+}
+
+// Points one past the end of a range may fall outside the address
+// space, so IPv4 points are kept in 64 bits.
+using point_v4 = uint64_t;
+using point_v6 = std::pair<uint64_t, uint64_t>;
+
+template <typename Key>
+struct event_type {
+  Key      point;
+  bool     insert;
+  uint32_t value;
+};
+
+// Splits the overlapping ranges into disjoint intervals starting at
+// zero, each taking the lowest value of the ranges covering it.
+// Adjacent intervals with the same value are merged.
+template <typename Key>
+std::vector<std::pair<Key, uint32_t>>
+sweep_ranges(std::vector<event_type<Key>>& events, uint32_t default_value) {
+  std::sort(events.begin(), events.end(), [](const auto& a, const auto& b) {
+    return a.point < b.point;
+  });
+
+  std::multiset<uint32_t>               active;
+  std::vector<std::pair<Key, uint32_t>> result{ { Key{}, default_value } };
+
+  for (auto itr = events.begin(); itr != events.end();) {
+    Key point = itr->point;
+
+    for (; itr != events.end() && itr->point == point; itr++)
+      if (itr->insert)
+        active.insert(itr->value);
+      else
+        active.erase(active.find(itr->value));
+
+    uint32_t value = active.empty() ? default_value : *active.begin();
+
+    if (result.back().first == point) {
+      result.back().second = value;
+
+      if (result.size() > 1 && result[result.size() - 2].second == value)
+        result.pop_back();
+
+    } else if (result.back().second != value) {
+      result.emplace_back(point, value);
+    }
+  }
+
+  return result;
+}
+
+point_v6
+make_point_v6(const in6_addr& address) {
+  point_v6 point{ 0, 0 };
+
+  for (int i = 0; i < 8; i++) {
+    point.first  = (point.first << 8) | address.s6_addr[i];
+    point.second = (point.second << 8) | address.s6_addr[i + 8];
+  }
+
+  return point;
+}
+
+template <typename T>
+void
+append(std::string& buffer, const T& value) {
+  buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+} // namespace
+
+bool
+ip_filter::open(const char* data, size_t size) {
+  close();
+
+  header_type header;
+
+  if (size < header_size || reinterpret_cast<uintptr_t>(data) % 8 != 0)
+    return false;
+
+  std::memcpy(&header, data, header_size);
+
+  if (header.magic != magic || header.version != version ||
+      header.index_bits != index_bits || header.size_v4 == 0 ||
+      header.size_v6 == 0 ||
+      size != header_size + body_size(header.size_v4, header.size_v6) ||
+      checksum(data + header_size, size - header_size) != header.checksum)
+    return false;
+
+  const char* body = data + header_size;
+
+  auto starts_v6 = reinterpret_cast<const key_v6*>(body);
+  auto starts_v4 =
+    reinterpret_cast<const uint32_t*>(body + header.size_v6 * 16);
+  auto index_v4  = starts_v4 + header.size_v4;
+  auto values_v4 = index_v4 + index_size;
+  auto values_v6 = values_v4 + header.size_v4;
+
+  // The checksum only catches corruption, make sure lookups stay
+  // within the arrays.
+  if (starts_v4[0] != 0 || starts_v6[0].high != 0 || starts_v6[0].low != 0 ||
+      index_v4[index_size - 1] != header.size_v4)
+    return false;
+
+  for (uint32_t i = 1; i < index_size; i++)
+    if (index_v4[i] < index_v4[i - 1])
+      return false;
+
+  m_data         = data;
+  m_size         = size;
+  m_defaultValue = header.default_value;
+  m_sizeV4       = header.size_v4;
+  m_sizeV6       = header.size_v6;
+  m_startsV4     = starts_v4;
+  m_valuesV4     = values_v4;
+  m_indexV4      = index_v4;
+  m_startsV6     = starts_v6;
+  m_valuesV6     = values_v6;
+  return true;
+}
+
+bool
+ip_filter::open_file(const std::string& path) {
+  close();
+
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+  if (fd == -1)
+    return false;
+
+  struct stat st;
+
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    ::close(fd);
+    return false;
+  }
+
+  void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+
+  if (data == MAP_FAILED)
+    return false;
+
+  if (!open(static_cast<const char*>(data), st.st_size)) {
+    munmap(data, st.st_size);
+    return false;
+  }
+
+  m_mapped = true;
+  return true;
+}
+
+void
+ip_filter::close() {
+  if (m_mapped)
+    munmap(const_cast<char*>(m_data), m_size);
+
+  m_data         = nullptr;
+  m_size         = 0;
+  m_mapped       = false;
+  m_defaultValue = 1;
+  m_sizeV4       = 0;
+  m_sizeV6       = 0;
+  m_startsV4     = nullptr;
+  m_valuesV4     = nullptr;
+  m_indexV4      = nullptr;
+  m_startsV6     = nullptr;
+  m_valuesV6     = nullptr;
+}
+
+uint32_t
+ip_filter::lookup(const sockaddr* sa) const {
+  if (!is_open())
+    return m_defaultValue;
+
+  switch (sa->sa_family) {
+  case AF_INET:
+    return lookup_v4(
+      ntohl(reinterpret_cast<const sockaddr_in*>(sa)->sin_addr.s_addr));
+
+  case AF_INET6: {
+    auto sin6 = reinterpret_cast<const sockaddr_in6*>(sa);
+
+    if (sin6_is_v4mapped(sin6)) {
+      uint32_t address;
+      std::memcpy(&address, sin6->sin6_addr.s6_addr + 12, 4);
+      return lookup_v4(ntohl(address));
+    }
+
+    return lookup_v6(sin6->sin6_addr);
+  }
+  default:
+    return m_defaultValue;
+  }
+}
+
+uint32_t
+ip_filter::lookup_v4(uint32_t address) const {
+  if (!is_open())
+    return m_defaultValue;
+
+  // The interval containing the address is the last one starting at
+  // or before it, which is at most one before the index bucket.
+  uint32_t bucket = address >> (32 - index_bits);
+
+  const uint32_t* first = m_startsV4 + m_indexV4[bucket];
+  const uint32_t* last  = m_startsV4 + m_indexV4[bucket + 1];
+
+  return m_valuesV4[std::upper_bound(first, last, address) - m_startsV4 - 1];
+}
+
+uint32_t
+ip_filter::lookup_v6(const in6_addr& address) const {
+  if (!is_open())
+    return m_defaultValue;
+
+  auto point = make_point_v6(address);
+  auto itr   = std::upper_bound(
+    m_startsV6, m_startsV6 + m_sizeV6, point, [](const auto& p, const auto& s) {
+      return p < std::make_pair(s.high, s.low);
+    });
+
+  return m_valuesV6[itr - m_startsV6 - 1];
+}
+
+std::string
+ip_filter::compile(const std::vector<range_v4>& ranges_v4,
+                   const std::vector<range_v6>& ranges_v6,
+                   uint32_t                     default_value) {
+  std::vector<event_type<point_v4>> events_v4;
+  std::vector<event_type<point_v6>> events_v6;
+
+  events_v4.reserve(ranges_v4.size() * 2);
+  events_v6.reserve(ranges_v6.size() * 2);
+
+  for (const auto& range : ranges_v4) {
+    if (range.first > range.last)
+      throw input_error("ip_filter::compile() range start after end.");
+
+    events_v4.push_back({ range.first, true, range.value });
+    events_v4.push_back({ point_v4(range.last) + 1, false, range.value });
+  }
+
+  for (const auto& range : ranges_v6) {
+    point_v6 first = make_point_v6(range.first);
+    point_v6 last  = make_point_v6(range.last);
+
+    if (first > last)
+      throw input_error("ip_filter::compile() range start after end.");
+
+    events_v6.push_back({ first, true, range.value });
+
+    // Ranges reaching the end of the address space are never removed.
+    if (++last.second == 0 && ++last.first == 0)
+      continue;
+
+    events_v6.push_back({ last, false, range.value });
+  }
+
+  auto intervals_v4 = sweep_ranges(events_v4, default_value);
+  auto intervals_v6 = sweep_ranges(events_v6, default_value);
+
+  // The end of the IPv4 space is a point past the last address.
+  if (intervals_v4.back().first > UINT32_MAX)
+    intervals_v4.pop_back();
+
+  header_type header{};
+  header.magic         = magic;
+  header.version       = version;
+  header.index_bits    = index_bits;
+  header.default_value = default_value;
+  header.size_v4       = intervals_v4.size();
+  header.size_v6       = intervals_v6.size();
+
+  std::string buffer;
+  buffer.reserve(header_size + body_size(header.size_v4, header.size_v6));
+  buffer.append(header_size, '\0');
+
+  for (const auto& interval : intervals_v6) {
+    append(buffer, interval.first.first);
+    append(buffer, interval.first.second);
+  }
+
+  for (const auto& interval : intervals_v4)
+    append(buffer, uint32_t(interval.first));
+
+  // Entry 'i' is the first interval starting at or after bucket 'i'.
+  uint32_t position = 0;
+
+  for (uint64_t bucket = 0; bucket < index_size; bucket++) {
+    uint64_t start = bucket << (32 - index_bits);
+
+    while (position < intervals_v4.size() &&
+           intervals_v4[position].first < start)
+      position++;
+
+    append(buffer, position);
+  }
+
+  for (const auto& interval : intervals_v4)
+    append(buffer, interval.second);
+
+  for (const auto& interval : intervals_v6)
+    append(buffer, interval.second);
+
+  header.checksum =
+    checksum(buffer.data() + header_size, buffer.size() - header_size);
+  std::memcpy(buffer.data(), &header, header_size);
+
+  return buffer;
+}
+
+} // namespace torrent
@@ -3,6 +3,7 @@
 
 #include <algorithm>
 
+#include "download/connection_index.h"
 #include "download/download_main.h"
 #include "net/address_list.h"
 #include "protocol/peer_connection_base.h"
@@ -26,9 +27,14 @@ namespace torrent {
 
 ConnectionList::ConnectionList(DownloadMain* download)
   : m_download(download)
+  , m_index(new ConnectionIndex)
   , m_minSize(50)
   , m_maxSize(100) {}
 
+ConnectionList::~ConnectionList() {
+  delete m_index;
+}
+
 void
 ConnectionList::clear() {
   for (const auto& peer : *this) {
@@ -36,6 +42,7 @@ ConnectionList::clear() {
   }
 
   base_type::clear();
+  m_index->clear();
 
   m_disconnectQueue.clear();
 }
@@ -78,6 +85,8 @@ ConnectionList::insert(PeerInfo*          peerInfo,
   }
 
   base_type::push_back(peerConnection);
+  m_index->insert(
+    peerConnection, peerInfo->id(), peerInfo->socket_address(), size() - 1);
 
   m_download->info()->change_flags(DownloadInfo::flag_accepting_new_peers,
                                    size() < m_maxSize);
@@ -108,9 +117,14 @@ ConnectionList::erase(iterator pos, int flags) {
   // The connection must be erased from the list before the signal is
   // emited otherwise some listeners might do stuff with the
   // assumption that the connection will remain in the list.
+  m_index->erase(*pos);
+
   *pos = base_type::back();
   base_type::pop_back();
 
+  if (pos != end())
+    m_index->set_position(*pos, pos - begin());
+
   m_download->info()->change_flags(DownloadInfo::flag_accepting_new_peers,
                                    size() < m_maxSize);
   utils::slot_list_call(m_signalDisconnected, peerConnection);
@@ -118,6 +132,8 @@ ConnectionList::erase(iterator pos, int flags) {
   // Before of after the signal?
   peerConnection->cleanup();
   peerConnection->mutable_peer_info()->set_connection(nullptr);
+  peerConnection->mutable_peer_info()->add_downloaded(
+    peerConnection->down_rate()->total());
 
   m_download->peer_list()->disconnected(peerConnection->mutable_peer_info(),
                                         PeerList::disconnect_set_time);
@@ -135,12 +151,15 @@ ConnectionList::erase(iterator pos, int flags) {
 
 void
 ConnectionList::erase(Peer* p, int flags) {
-  erase(std::find(begin(), end(), p), flags);
+  erase(find_position(p), flags);
 }
 
 void
 ConnectionList::erase(PeerInfo* peerInfo, int flags) {
-  auto itr = std::find(begin(), end(), peerInfo->connection());
+  if (peerInfo->connection() == nullptr)
+    return;
+
+  auto itr = find_position(peerInfo->connection());
 
   if (itr == end())
     return;
@@ -163,10 +182,11 @@ ConnectionList::erase_remaining(iterator pos, int flags) {
 
 void
 ConnectionList::erase_seeders() {
-  erase_remaining(
-    std::partition(
-      begin(), end(), [](Peer* p) { return p->c_ptr()->is_not_seeder(); }),
-    disconnect_unwanted);
+  auto seeders = std::partition(
+    begin(), end(), [](Peer* p) { return p->c_ptr()->is_not_seeder(); });
+
+  update_positions();
+  erase_remaining(seeders, disconnect_unwanted);
 }
 
 void
@@ -174,7 +194,7 @@ ConnectionList::disconnect_queued() {
   for (auto itr = m_disconnectQueue.begin(), last = m_disconnectQueue.end();
        itr != last;
        itr++) {
-    auto conn_itr = find(m_disconnectQueue.back().c_str());
+    auto conn_itr = find(itr->c_str());
 
     if (conn_itr != end())
       erase(conn_itr, 0);
@@ -203,22 +223,45 @@ struct connection_list_less {
 
 ConnectionList::iterator
 ConnectionList::find(const char* id) {
-  return std::find_if(begin(), end(), [id](Peer* p) {
-    return *HashString::cast_from(id) == p->m_ptr()->peer_info()->id();
-  });
+  Peer* peer = m_index->find(*HashString::cast_from(id));
+
+  return peer != nullptr ? find_position(peer) : end();
 }
 
 ConnectionList::iterator
 ConnectionList::find(const sockaddr* sa) {
-  return std::find_if(begin(), end(), [sa](Peer* p) {
-    return *utils::socket_address::cast_from(sa) ==
-           *p->m_ptr()->peer_info()->socket_address();
-  });
+  Peer* peer = m_index->find(sa);
+
+  return peer != nullptr ? find_position(peer) : end();
+}
+
+// The list is reordered by sorting and by callers swapping elements,
+// so fall back to a scan if the recorded position is stale.
+ConnectionList::iterator
+ConnectionList::find_position(Peer* peer) {
+  auto position = m_index->position(peer);
+
+  if (position < size() && (*this)[position] == peer)
+    return begin() + position;
+
+  auto itr = std::find(begin(), end(), peer);
+
+  if (itr != end())
+    m_index->set_position(peer, itr - begin());
+
+  return itr;
+}
+
+void
+ConnectionList::update_positions() {
+  for (auto itr = begin(); itr != end(); itr++)
+    m_index->set_position(*itr, itr - begin());
 }
 
 void
 ConnectionList::set_difference(AddressList* l) {
   std::sort(begin(), end(), connection_list_less());
+  update_positions();
 
   l->erase(
     std::set_difference(
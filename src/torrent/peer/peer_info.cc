@@ -2,6 +2,7 @@
 // Copyright (C) 2005-2011, Jari Sundell <jaris@ifi.uio.no>
 
 #include <cstring>
+#include <vector>
 
 #include "protocol/extensions.h"
 #include "protocol/peer_connection_base.h"
@@ -12,42 +13,128 @@
 
 namespace torrent {
 
-// Move this to peer_info.cc when these are made into the public API.
-//
-// TODO: Use a safer socket address parameter.
-PeerInfo::PeerInfo(const sockaddr* address)
-  : m_flags(0)
-  ,
+namespace {
+
+// A PeerInfo is kept for every address a download has connected to,
+// which over a long session can be millions, so they are carved out
+// of slabs and recycled through a free list rather than each being a
+// separate heap block. PeerInfo is only created and destroyed by the
+// main thread.
+class peer_info_pool {
+public:
+  static constexpr size_t slab_size = 1024;
+
+  void* allocate();
+  void  deallocate(void* ptr);
+
+  static peer_info_pool* instance();
+
+private:
+  union node {
+    node* next;
+    alignas(PeerInfo) char storage[sizeof(PeerInfo)];
+  };
+
+  std::vector<std::unique_ptr<node[]>> m_slabs;
+
+  node*  m_free{ nullptr };
+  size_t m_used{ 0 };
+};
+
+void*
+peer_info_pool::allocate() {
+  if (m_free == nullptr) {
+    m_slabs.emplace_back(new node[slab_size]);
+
+    node* slab = m_slabs.back().get();
 
-  m_failedCounter(0)
-  , m_transferCounter(0)
-  , m_lastConnection(0)
-  , m_lastHandshake(0)
-  , m_listenPort(0)
-  ,
+    for (size_t i = slab_size; i != 0; i--) {
+      slab[i - 1].next = m_free;
+      m_free           = &slab[i - 1];
+    }
+  }
+
+  node* n = m_free;
+  m_free  = n->next;
+  m_used++;
 
-  m_connection(nullptr) {
-  auto sa = new utils::socket_address();
-  *sa     = *utils::socket_address::cast_from(address);
+  return n->storage;
+}
+
+// The slabs are only released once every PeerInfo is gone, e.g. when
+// all downloads have been closed.
+void
+peer_info_pool::deallocate(void* ptr) {
+  if (m_used == 0)
+    throw internal_error("peer_info_pool::deallocate(...) pool is empty.");
+
+  auto n  = static_cast<node*>(ptr);
+  n->next = m_free;
+  m_free  = n;
+
+  if (--m_used == 0) {
+    m_slabs.clear();
+    m_free = nullptr;
+  }
+}
 
-  m_address = sa->c_sockaddr();
+// Never destroyed, as PeerInfo may outlive other static objects.
+peer_info_pool*
+peer_info_pool::instance() {
+  static auto pool = new peer_info_pool;
+  return pool;
+}
+
+} // namespace
+
+const PeerInfo::connection_details PeerInfo::empty_details{};
+
+// TODO: Use a safer socket address parameter.
+PeerInfo::PeerInfo(const sockaddr* address) {
+  static_assert(sizeof(utils::socket_address) == sizeof(sockaddr_in6));
+
+  *utils::socket_address::cast_from(&m_address) =
+    *utils::socket_address::cast_from(address);
 }
 
 PeerInfo::~PeerInfo() {
   instrumentation_update(INSTRUMENTATION_TRANSFER_PEER_INFO_UNACCOUNTED,
                          m_transferCounter);
 
-  if (is_blocked()) {
+  if (is_blocked())
     destruct_error("PeerInfo::~PeerInfo() peer is blocked.");
+}
+
+void*
+PeerInfo::operator new(size_t size) {
+  if (size != sizeof(PeerInfo))
+    return ::operator new(size);
+
+  return peer_info_pool::instance()->allocate();
+}
+
+void
+PeerInfo::operator delete(void* ptr, size_t size) {
+  if (ptr == nullptr)
     return;
-  }
 
-  delete utils::socket_address::cast_from(m_address);
+  if (size != sizeof(PeerInfo))
+    return ::operator delete(ptr);
+
+  peer_info_pool::instance()->deallocate(ptr);
+}
+
+PeerInfo::connection_details&
+PeerInfo::mutable_details() {
+  if (!m_details)
+    m_details = std::make_unique<connection_details>();
+
+  return *m_details;
 }
 
 void
 PeerInfo::set_port(uint16_t port) {
-  utils::socket_address::cast_from(m_address)->set_port(port);
+  utils::socket_address::cast_from(&m_address)->set_port(port);
 }
 
 } // namespace torrent
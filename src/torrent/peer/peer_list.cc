@@ -2,7 +2,6 @@
 // Copyright (C) 2005-2011, Jari Sundell <jaris@ifi.uio.no>
 
 #include <algorithm>
-#include <functional>
 
 #include "download/available_list.h"
 #include "globals.h"
@@ -51,13 +50,17 @@ socket_address_less(const sockaddr* s1, const sockaddr* s2) {
   }
 }
 
-struct peer_list_equal_port
-  : public std::binary_function<PeerList::reference, uint16_t, bool> {
-  bool operator()(PeerList::reference p, uint16_t port) {
-    return utils::socket_address::cast_from(p.second->socket_address())
-             ->port() == port;
-  }
-};
+// Keep the table at most three quarters full, so probe sequences stay
+// short.
+static PeerList::size_type
+peer_list_capacity(PeerList::size_type size) {
+  PeerList::size_type capacity = 16;
+
+  while (capacity * 3 < size * 4)
+    capacity *= 2;
+
+  return capacity;
+}
 
 //
 // PeerList:
@@ -75,7 +78,8 @@ PeerList::~PeerList() {
     delete peerInfo;
   }
 
-  base_type::clear();
+  m_table.clear();
+  m_size = 0;
 
   m_info = nullptr;
   delete m_available_list;
@@ -99,14 +103,12 @@ PeerList::insert_address(const sockaddr* sa, int flags) {
 
   const utils::socket_address* address = utils::socket_address::cast_from(sa);
 
-  range_type range = base_type::equal_range(sock_key);
-
   // Do some special handling if we got a new port number but the
   // address was present.
   //
   // What we do depends on the flags, but for now just allow one
   // PeerInfo per address key and do nothing.
-  if (range.first != range.second) {
+  if (find(sock_key) != nullptr) {
     LT_LOG_EVENTS("address already exists " LT_LOG_SA_FMT,
                   address->address_str().c_str(),
                   address->port());
@@ -118,10 +120,10 @@ PeerList::insert_address(const sockaddr* sa, int flags) {
 
   manager->client_list()->retrieve_unknown(&peerInfo->mutable_client_info());
 
-  base_type::insert(range.second, value_type(sock_key, peerInfo));
+  insert(sock_key, peerInfo);
 
   if ((flags & address_available) && peerInfo->listen_port() != 0) {
-    m_available_list->push_back(address);
+    m_available_list->push_back(address, AvailableList::score(peerInfo));
     LT_LOG_EVENTS("added available address " LT_LOG_SA_FMT,
                   address->address_str().c_str(),
                   address->port());
@@ -134,14 +136,8 @@ PeerList::insert_address(const sockaddr* sa, int flags) {
   return peerInfo;
 }
 
-inline bool
-socket_address_less_rak(const utils::socket_address& s1,
-                        const utils::socket_address& s2) {
-  return socket_address_less(s1.c_sockaddr(), s2.c_sockaddr());
-}
-
 uint32_t
-PeerList::insert_available(const void* al) {
+PeerList::insert_available(const void* al, int source) {
   auto addressList = static_cast<const AddressList*>(al);
 
   uint32_t inserted = 0;
@@ -154,15 +150,8 @@ PeerList::insert_available(const void* al) {
     m_available_list->reserve(m_available_list->size() + addressList->size() +
                               128);
 
-  // Optimize this so that we don't traverse the tree for every
-  // insert, since we know 'al' is sorted.
-
-  auto itr       = addressList->begin();
-  auto last      = addressList->end();
-  auto availItr  = m_available_list->begin();
-  auto availLast = m_available_list->end();
-
-  for (; itr != last; itr++) {
+  for (auto itr = addressList->begin(), last = addressList->end(); itr != last;
+       itr++) {
     if (!socket_address_key::is_comparable_sockaddr(itr->c_sockaddr()) ||
         itr->port() == 0) {
       invalid++;
@@ -172,13 +161,7 @@ PeerList::insert_available(const void* al) {
       continue;
     }
 
-    availItr = std::find_if(
-      availItr, availLast, [&itr](const utils::socket_address& sa) {
-        return socket_address_less_rak(sa, *itr);
-      });
-
-    if (availItr != availLast &&
-        !socket_address_less(availItr->c_sockaddr(), itr->c_sockaddr())) {
+    if (m_available_list->contains(*itr)) {
       // The address is already in m_available_list, so don't bother
       // going further.
       unneeded++;
@@ -192,13 +175,9 @@ PeerList::insert_available(const void* al) {
     // ever want to connect. Just update the timer for the last
     // availability notice if the peer isn't really ideal, but might
     // be used in an emergency.
-    range_type range = base_type::equal_range(sock_key);
-
-    if (range.first != range.second) {
-      // Add some logic here to select the best PeerInfo, but for now
-      // just assume the first one is the only one that exists.
-      PeerInfo* peerInfo = range.first->second;
+    PeerInfo* peerInfo = find(sock_key);
 
+    if (peerInfo != nullptr) {
       if (peerInfo->listen_port() == 0)
         peerInfo->set_port(itr->port());
 
@@ -219,7 +198,8 @@ PeerList::insert_available(const void* al) {
     // won't happen often enough to be worth it.
 
     inserted++;
-    m_available_list->push_back(&*itr);
+    m_available_list->push_back(
+      &*itr, AvailableList::score(peerInfo, source, cachedTime.seconds()));
 
     LT_LOG_ADDRESS("added available address " LT_LOG_SA_FMT,
                    itr->address_str().c_str(),
@@ -252,16 +232,14 @@ PeerList::connected(const sockaddr* sa, int flags) {
   if (!sock_key.is_valid() || !socket_address_key::is_comparable_sockaddr(sa))
     return nullptr;
 
-  PeerInfo*  peerInfo;
-  range_type range = base_type::equal_range(sock_key);
+  PeerInfo* peerInfo = find(sock_key);
 
-  if (range.first == range.second) {
+  if (peerInfo == nullptr) {
     // Create a new entry.
     peerInfo = new PeerInfo(sa);
-    base_type::insert(range.second, value_type(sock_key, peerInfo));
-  } else if (!range.first->second->is_connected()) {
+    insert(sock_key, peerInfo);
+  } else if (!peerInfo->is_connected()) {
     // Use an old entry.
-    peerInfo = range.first->second;
     peerInfo->set_port(address->port());
   } else {
     // Make sure we don't end up throwing away the port the host is
@@ -270,9 +248,8 @@ PeerList::connected(const sockaddr* sa, int flags) {
     //
     // This also ensure we can connect to peers running on the same
     // host as the tracker.
-    if (flags & connect_keep_handshakes &&
-        range.first->second->is_handshake() &&
-        utils::socket_address::cast_from(range.first->second->socket_address())
+    if (flags & connect_keep_handshakes && peerInfo->is_handshake() &&
+        utils::socket_address::cast_from(peerInfo->socket_address())
             ->port() != address->port())
       m_available_list->buffer()->push_back(*address);
 
@@ -304,57 +281,48 @@ PeerList::disconnected(PeerInfo* p, int flags) {
   socket_address_key sock_key =
     socket_address_key::from_sockaddr(p->socket_address());
 
-  range_type range = base_type::equal_range(sock_key);
-
-  auto itr = std::find_if(
-    range.first, range.second, [p](value_type& v) { return p == v.second; });
-
-  if (itr == range.second) {
-    if (std::find_if(base_type::begin(), base_type::end(), [p](value_type& v) {
+  if (find(sock_key) != p) {
+    if (std::none_of(begin(), end(), [p](reference v) {
           return p == v.second;
-        }) == base_type::end())
+        }))
       throw internal_error(
-        "PeerList::disconnected(...) itr == range.second, doesn't exist.");
+        "PeerList::disconnected(...) peer info doesn't exist.");
     else
       throw internal_error(
-        "PeerList::disconnected(...) itr == range.second, not in the range.");
+        "PeerList::disconnected(...) peer info not under its address.");
   }
 
-  disconnected(itr, flags);
-}
-
-PeerList::iterator
-PeerList::disconnected(iterator itr, int flags) {
-  if (itr == base_type::end())
-    throw internal_error("PeerList::disconnected(...) itr == end().");
-
-  if (!itr->second->is_connected())
-    throw internal_error("PeerList::disconnected(...) !itr->is_connected().");
+  if (!p->is_connected())
+    throw internal_error("PeerList::disconnected(...) !p->is_connected().");
 
-  if (itr->second->transfer_counter() != 0) {
+  if (p->transfer_counter() != 0) {
     // Currently we only log these as it only affects the culling of
     // peers.
     LT_LOG_EVENTS("disconnected with non-zero transfer counter (%" PRIu32
                   ") for peer %40s",
-                  itr->second->transfer_counter(),
-                  itr->second->id_hex());
+                  p->transfer_counter(),
+                  p->id_hex());
   }
 
-  itr->second->unset_flags(PeerInfo::flag_connected);
+  p->unset_flags(PeerInfo::flag_connected);
 
   // Replace the socket address port with the listening port so that
   // future outgoing connections will connect to the right port.
-  itr->second->set_port(0);
+  p->set_port(0);
 
-  if (flags & disconnect_set_time)
-    itr->second->set_last_connection(cachedTime.seconds());
+  // Only connections that made it past the handshake set the time.
+  if (flags & disconnect_set_time) {
+    p->set_last_connection(cachedTime.seconds());
+    p->set_failed_handshakes(0);
+  } else {
+    p->set_failed_handshakes(p->failed_handshakes() + 1);
+  }
 
-  if (flags & disconnect_available && itr->second->listen_port() != 0)
+  if (flags & disconnect_available && p->listen_port() != 0)
     m_available_list->push_back(
-      utils::socket_address::cast_from(itr->second->socket_address()));
-
-  // Do magic to get rid of unneeded entries.
-  return ++itr;
+      utils::socket_address::cast_from(p->socket_address()),
+      AvailableList::score(
+        p, AvailableList::source_reconnect, cachedTime.seconds()));
 }
 
 uint32_t
@@ -367,34 +335,80 @@ PeerList::cull_peers(int flags) {
   else
     timer = 0;
 
-  for (auto itr = base_type::begin(); itr != base_type::end();) {
-    if (itr->second->is_connected() ||
-        itr->second->transfer_counter() !=
-          0 || // !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
-        itr->second->last_connection() >= timer ||
+  // Culled slots are emptied in a single pass and the table is then
+  // rebuilt, rather than erasing entries one at a time.
+  for (auto& slot : m_table) {
+    PeerInfo* peerInfo = slot.second;
+
+    if (peerInfo == nullptr || peerInfo->is_connected() ||
+        peerInfo->transfer_counter() != 0 ||
+        peerInfo->last_connection() >= timer ||
 
         (flags & cull_keep_interesting &&
-         (itr->second->failed_counter() != 0 || itr->second->is_blocked()))) {
-      itr++;
+         (peerInfo->failed_counter() != 0 || peerInfo->is_blocked())))
       continue;
-    }
 
     // ##################### TODO: LOG CULLING OF PEERS ######################
     //   *** AND STATS OF DISCONNECTING PEERS (the peer info...)...
 
-    // The key is a pointer to a member in the value, although the key
-    // shouldn't actually be used in erase (I think), just ot be safe
-    // we delete it after erase.
-    auto      tmp      = itr++;
-    PeerInfo* peerInfo = tmp->second;
-
-    base_type::erase(tmp);
+    slot = value_type();
     delete peerInfo;
 
     counter++;
   }
 
+  if (counter != 0) {
+    m_size -= counter;
+    rehash(peer_list_capacity(m_size));
+  }
+
   return counter;
 }
 
+PeerInfo*
+PeerList::find(const socket_address_key& key) const {
+  if (m_table.empty())
+    return nullptr;
+
+  return m_table[find_slot(key)].second;
+}
+
+void
+PeerList::insert(const socket_address_key& key, PeerInfo* peerInfo) {
+  if (m_table.size() * 3 < (m_size + 1) * 4)
+    rehash(peer_list_capacity(m_size + 1));
+
+  size_type slot = find_slot(key);
+
+  if (m_table[slot].second != nullptr)
+    throw internal_error("PeerList::insert(...) address already exists.");
+
+  m_table[slot] = value_type(key, peerInfo);
+  m_size++;
+}
+
+// Linear probing from the hashed slot, returns either the slot holding
+// 'key' or the empty slot ending the probe sequence.
+PeerList::size_type
+PeerList::find_slot(const socket_address_key& key) const {
+  size_type mask = m_table.size() - 1;
+  size_type slot = socket_address_key_hash()(key) & mask;
+
+  while (m_table[slot].second != nullptr && !(m_table[slot].first == key))
+    slot = (slot + 1) & mask;
+
+  return slot;
+}
+
+void
+PeerList::rehash(size_type capacity) {
+  std::vector<value_type> table(capacity);
+
+  m_table.swap(table);
+
+  for (const auto& entry : table)
+    if (entry.second != nullptr)
+      m_table[find_slot(entry.first)] = entry;
+}
+
 } // namespace torrent
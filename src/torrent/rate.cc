@@ -1,6 +1,9 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 // Copyright (C) 2005-2011, Jari Sundell <jaris@ifi.uio.no>
 
+#include <algorithm>
+#include <iterator>
+
 #include "globals.h"
 #include "torrent/exceptions.h"
 
@@ -8,12 +11,28 @@
 
 namespace torrent {
 
+// Advance the ring to the current bucket, expiring the buckets that
+// fell out of the span.
 inline void
 Rate::discard_old() const {
-  while (!m_container.empty() &&
-         m_container.back().first < cachedTime.seconds() - m_span) {
-    m_current -= m_container.back().second;
-    m_container.pop_back();
+  timer_type epoch  = cachedTime.seconds() / m_width;
+  timer_type size   = window();
+
+  if (epoch == m_epoch)
+    return;
+
+  if (epoch < m_epoch || epoch - m_epoch >= size) {
+    std::fill(std::begin(m_buckets), std::end(m_buckets), 0);
+    m_current = 0;
+    m_epoch   = epoch;
+    return;
+  }
+
+  while (m_epoch != epoch) {
+    rate_type& bucket = m_buckets[++m_epoch % size];
+
+    m_current -= bucket;
+    bucket = 0;
   }
 }
 
@@ -24,6 +43,17 @@ Rate::rate() const {
   return m_current / m_span;
 }
 
+void
+Rate::set_span(timer_type s) {
+  if (s == m_span)
+    return;
+
+  m_span  = s;
+  m_width = width_for_span(s);
+
+  reset_rate();
+}
+
 void
 Rate::insert(rate_type bytes) {
   discard_old();
@@ -31,13 +61,16 @@ Rate::insert(rate_type bytes) {
   if (m_current > ((rate_type)1 << 40) || bytes > ((rate_type)1 << 28))
     throw internal_error("Rate::insert(bytes) received out-of-bounds values..");
 
-  if (m_container.empty() || m_container.front().first != cachedTime.seconds())
-    m_container.push_front(value_type(cachedTime.seconds(), bytes));
-  else
-    m_container.front().second += bytes;
+  m_buckets[m_epoch % window()] += bytes;
 
   m_total += bytes;
   m_current += bytes;
 }
 
+void
+Rate::reset_rate() {
+  std::fill(std::begin(m_buckets), std::end(m_buckets), 0);
+  m_current = 0;
+}
+
 } // namespace torrent
@@ -1,6 +1,7 @@
 #include "torrent/buildinfo.h"
 
 #include "data/hash_queue.h"
+#include "data/hash_scheduler.h"
 #include "data/hash_torrent.h"
 #include "download/download_constructor.h"
 #include "download/download_wrapper.h"
@@ -165,6 +166,21 @@ hash_queue_size() {
   return manager->hash_queue()->size();
 }
 
+uint64_t
+hash_check_max_outstanding() {
+  return manager->hash_scheduler()->max_outstanding();
+}
+
+void
+set_hash_check_max_outstanding(uint64_t bytes) {
+  manager->hash_scheduler()->set_max_outstanding(bytes);
+}
+
+hash_check_progress
+hash_check_status() {
+  return manager->hash_scheduler()->progress();
+}
+
 EncodingList*
 encoding_list() {
   return manager->encoding_list();
@@ -1,6 +1,13 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 // Copyright (C) 2005-2011, Jari Sundell <jaris@ifi.uio.no>
 
+#include <algorithm>
+#include <fcntl.h>
+#include <string_view>
+#include <thread>
+#include <unistd.h>
+
+#include "download/available_list.h"
 #include "globals.h"
 #include "net/address_list.h"
 #include "torrent/bitfield.h"
@@ -50,8 +57,146 @@
 
 namespace torrent {
 
+struct resume_file_stat {
+  std::string      path;
+  bool             exists{ false };
+  utils::file_stat stat{};
+};
+
+using resume_stat_list = std::vector<resume_file_stat>;
+
+static std::string_view
+resume_stat_dirname(const std::string& path) {
+  auto split = path.rfind('/');
+
+  return split == std::string::npos ? std::string_view()
+                                    : std::string_view(path).substr(0, split + 1);
+}
+
+static void
+resume_stat_directory(resume_stat_list&                   list,
+                      std::vector<size_t>::const_iterator first,
+                      std::vector<size_t>::const_iterator last) {
+  std::string dir(resume_stat_dirname(list[*first].path));
+  int         dirfd =
+    ::open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+  for (; first != last; ++first) {
+    auto& entry = list[*first];
+
+    if (dirfd == -1)
+      entry.exists = entry.stat.update(entry.path);
+    else
+      entry.exists =
+        entry.stat.update_at(dirfd, entry.path.c_str() + dir.size());
+  }
+
+  if (dirfd != -1)
+    ::close(dirfd);
+}
+
+// Stat the files grouped by directory, with the directories split
+// between 'workers' threads. Each entry is only touched by one
+// thread.
+static void
+resume_stat_files(resume_stat_list& list, unsigned int workers) {
+  std::vector<size_t> order(list.size());
+
+  for (size_t i = 0; i < order.size(); i++)
+    order[i] = i;
+
+  auto dirname = [&list](size_t index) {
+    return resume_stat_dirname(list[index].path);
+  };
+
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return dirname(a) < dirname(b);
+  });
+
+  std::vector<std::pair<size_t, size_t>> groups;
+
+  for (size_t first = 0, last = 0; first < order.size(); first = last) {
+    while (last < order.size() && dirname(order[last]) == dirname(order[first]))
+      last++;
+
+    groups.emplace_back(first, last);
+  }
+
+  auto work = [&](size_t offset, size_t step) {
+    for (size_t i = offset; i < groups.size(); i += step)
+      resume_stat_directory(list,
+                            order.begin() + groups[i].first,
+                            order.begin() + groups[i].second);
+  };
+
+  workers = std::max<unsigned int>(
+    1, std::min<size_t>(workers, groups.size() / 16));
+
+  std::vector<std::thread> threads;
+
+  for (unsigned int i = 1; i < workers; i++)
+    threads.emplace_back(work, i, workers);
+
+  work(0, workers);
+
+  for (auto& thread : threads)
+    thread.join();
+}
+
+static void
+resume_add_stat_files(Download download, resume_stat_list& list) {
+  FileList* fileList = download.file_list();
+
+  for (const auto& file : *fileList)
+    list.push_back({ fileList->root_dir() + file->path()->as_string() });
+}
+
+static void
+resume_load_progress_stat(Download                         download,
+                          const Object&                    object,
+                          resume_stat_list::const_iterator stats);
+
 void
 resume_load_progress(Download download, const Object& object) {
+  resume_stat_list stats;
+
+  resume_add_stat_files(download, stats);
+  resume_stat_files(stats, 1);
+
+  resume_load_progress_stat(download, object, stats.begin());
+}
+
+void
+resume_load_progress_list(const resume_progress_list& list,
+                          unsigned int                workers) {
+  auto start = utils::timer::current();
+
+  resume_stat_list stats;
+
+  for (const auto& [download, object] : list)
+    resume_add_stat_files(download, stats);
+
+  resume_stat_files(stats, workers);
+
+  auto itr = stats.cbegin();
+
+  for (const auto& [download, object] : list) {
+    resume_load_progress_stat(download, *object, itr);
+    itr += download.file_list()->size_files();
+  }
+
+  lt_log_print(LOG_RESUME_DATA,
+               "resume_load: loaded progress for %u downloads and %u files in "
+               "%" PRIi64 " ms",
+               (unsigned int)list.size(),
+               (unsigned int)stats.size(),
+               (utils::timer::current() - start).usec() / 1000);
+}
+
+static void
+resume_load_progress_stat(Download                         download,
+                          const Object&                    object,
+                          resume_stat_list::const_iterator stats) {
   if (!object.has_key_list("files")) {
     LT_LOG_LOAD("could not find 'files' key", 0);
     return;
@@ -75,10 +220,9 @@ resume_load_progress(Download download, const Object& object) {
   for (auto listItr = fileList->begin(), listLast = fileList->end();
        listItr != listLast;
        ++listItr, ++filesItr) {
-    std::string  file_path  = (*listItr)->path()->as_string();
     unsigned int file_index = std::distance(fileList->begin(), listItr);
 
-    utils::file_stat fs;
+    const utils::file_stat& fs = stats[file_index].stat;
 
     if (!filesItr->has_key_value("mtime")) {
       LT_LOG_LOAD_FILE("no mtime found, file:create|resize range:clear|recheck",
@@ -97,8 +241,7 @@ resume_load_progress(Download download, const Object& object) {
     }
 
     int64_t mtimeValue = filesItr->get_key_value("mtime");
-    bool    fileExists =
-      fs.update(fileList->root_dir() + (*listItr)->path()->as_string());
+    bool    fileExists = stats[file_index].exists;
 
     // The default action when we have 'mtime' is not to create nor
     // resize the file.
@@ -531,6 +674,12 @@ resume_load_addresses(Download download, const Object& object) {
 
     peerInfo->set_failed_counter(peer.get_key_value("failed"));
     peerInfo->set_last_connection(peer.get_key_value("last"));
+
+    // Rank the address now that its history is known.
+    peerList->available_list()->update(
+      socketAddress,
+      AvailableList::score(
+        peerInfo, AvailableList::source_resume, cachedTime.seconds()));
   }
 
   // Tell rTorrent to harvest addresses.
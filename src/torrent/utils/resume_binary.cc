@@ -0,0 +1,656 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2005-2011, Jari Sundell <jaris@ifi.uio.no>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "download/available_list.h"
+#include "globals.h"
+#include "net/address_list.h"
+#include "torrent/download.h"
+#include "torrent/object.h"
+#include "torrent/peer/peer_info.h"
+#include "torrent/peer/peer_list.h"
+#include "torrent/utils/socket_address.h"
+
+#include "torrent/utils/resume_binary.h"
+
+namespace torrent {
+
+namespace {
+
+// All integers are stored big-endian.
+
+struct section_entry {
+  uint16_t type;
+  uint32_t offset;
+  uint32_t length;
+  uint32_t checksum;
+};
+
+constexpr uint32_t file_entry_size    = 14;
+constexpr uint32_t peer_entry_size    = 18;
+constexpr uint8_t  flag_mtime         = 0x1;
+constexpr uint8_t  flag_priority      = 0x2;
+constexpr uint8_t  flag_completed     = 0x4;
+constexpr uint8_t  flag_enabled       = 0x1;
+constexpr uint8_t  flag_extra_tracker = 0x2;
+constexpr uint8_t  flag_group         = 0x4;
+
+class writer {
+public:
+  writer(std::string& buffer)
+    : m_buffer(buffer) {}
+
+  template<typename T>
+  void put(T value) {
+    for (int shift = (sizeof(T) - 1) * 8; shift >= 0; shift -= 8)
+      m_buffer.push_back(static_cast<char>((uint64_t)value >> shift));
+  }
+
+  void put(const std::string& data) {
+    m_buffer.append(data);
+  }
+
+private:
+  std::string& m_buffer;
+};
+
+class reader {
+public:
+  reader(std::string_view data)
+    : m_data(data) {}
+
+  bool is_valid() const {
+    return m_valid;
+  }
+  size_t remaining() const {
+    return m_data.size() - m_position;
+  }
+
+  template<typename T>
+  T get() {
+    if (remaining() < sizeof(T)) {
+      m_valid    = false;
+      m_position = m_data.size();
+      return T();
+    }
+
+    uint64_t value = 0;
+
+    for (size_t i = 0; i < sizeof(T); i++)
+      value = (value << 8) | static_cast<uint8_t>(m_data[m_position++]);
+
+    return static_cast<T>(value);
+  }
+
+  std::string_view get(size_t length) {
+    if (remaining() < length) {
+      m_valid    = false;
+      m_position = m_data.size();
+      return std::string_view();
+    }
+
+    m_position += length;
+    return m_data.substr(m_position - length, length);
+  }
+
+private:
+  std::string_view m_data;
+  size_t           m_position{ 0 };
+  bool             m_valid{ true };
+};
+
+bool
+read_table(const char* data, size_t size, std::vector<section_entry>& table) {
+  reader header(std::string_view(data, size));
+
+  if (header.get<uint32_t>() != resume_binary::magic ||
+      header.get<uint16_t>() != resume_binary::version)
+    return false;
+
+  uint16_t count = header.get<uint16_t>();
+
+  if (!header.is_valid() ||
+      header.remaining() < count * resume_binary::entry_size)
+    return false;
+
+  table.clear();
+
+  for (uint16_t i = 0; i < count; i++) {
+    section_entry entry;
+
+    entry.type = header.get<uint16_t>();
+    header.get<uint16_t>();
+    entry.offset   = header.get<uint32_t>();
+    entry.length   = header.get<uint32_t>();
+    entry.checksum = header.get<uint32_t>();
+
+    if ((uint64_t)entry.offset + entry.length > size)
+      return false;
+
+    table.push_back(entry);
+  }
+
+  return true;
+}
+
+bool
+same_layout(const std::vector<section_entry>& current,
+            const std::vector<section_entry>& next) {
+  if (current.size() != next.size())
+    return false;
+
+  for (size_t i = 0; i < current.size(); i++)
+    if (current[i].type != next[i].type ||
+        current[i].offset != next[i].offset ||
+        current[i].length != next[i].length)
+      return false;
+
+  return true;
+}
+
+bool
+write_at(int fd, const char* data, size_t length, off_t offset) {
+  while (length != 0) {
+    ssize_t result = ::pwrite(fd, data, length, offset);
+
+    if (result == -1 && errno == EINTR)
+      continue;
+
+    if (result <= 0)
+      return false;
+
+    data += result;
+    length -= result;
+    offset += result;
+  }
+
+  return true;
+}
+
+void
+encode_bitfield(const Object& object, std::string& buffer) {
+  writer out(buffer);
+
+  if (object.has_key_string("bitfield")) {
+    out.put<uint8_t>(1);
+    out.put(object.get_key_string("bitfield"));
+  } else {
+    out.put<uint8_t>(0);
+    out.put<int64_t>(object.get_key_value("bitfield"));
+  }
+}
+
+void
+encode_files(const Object& object, std::string& buffer) {
+  writer out(buffer);
+
+  const Object::list_type& files = object.get_key_list("files");
+  out.put<uint32_t>(files.size());
+
+  for (const auto& file : files) {
+    uint8_t flags = 0;
+
+    if (file.is_map()) {
+      flags |= file.has_key_value("mtime") ? flag_mtime : 0;
+      flags |= file.has_key_value("priority") ? flag_priority : 0;
+      flags |= file.has_key_value("completed") ? flag_completed : 0;
+    }
+
+    out.put<uint8_t>(flags);
+    out.put<uint8_t>(flags & flag_priority ? file.get_key_value("priority")
+                                           : 0);
+    out.put<uint32_t>(flags & flag_completed ? file.get_key_value("completed")
+                                             : 0);
+    out.put<int64_t>(flags & flag_mtime ? file.get_key_value("mtime") : 0);
+  }
+}
+
+void
+encode_uncertain(const Object& object, std::string& buffer) {
+  writer out(buffer);
+
+  bool has_timestamp = object.has_key_value("uncertain_pieces.timestamp");
+  bool has_pieces    = object.has_key_string("uncertain_pieces");
+
+  out.put<uint8_t>(has_timestamp);
+  out.put<int64_t>(
+    has_timestamp ? object.get_key_value("uncertain_pieces.timestamp") : 0);
+  out.put<uint8_t>(has_pieces);
+
+  if (has_pieces)
+    out.put(object.get_key_string("uncertain_pieces"));
+}
+
+void
+encode_peers(const Object& object, std::string& buffer) {
+  writer out(buffer);
+
+  std::string peers;
+  writer      peers_out(peers);
+  uint32_t    count = 0;
+
+  for (const auto& peer : object.get_key_list("peers")) {
+    if (!peer.is_map() || !peer.has_key_string("inet") ||
+        peer.get_key_string("inet").size() != sizeof(SocketAddressCompact) ||
+        !peer.has_key_value("failed") || !peer.has_key_value("last"))
+      continue;
+
+    peers_out.put(peer.get_key_string("inet"));
+    peers_out.put<uint32_t>(peer.get_key_value("failed"));
+    peers_out.put<int64_t>(peer.get_key_value("last"));
+    count++;
+  }
+
+  out.put<uint32_t>(count);
+  out.put(peers);
+}
+
+void
+encode_trackers(const Object& object, std::string& buffer) {
+  writer out(buffer);
+
+  const Object::map_type& trackers = object.get_key_map("trackers");
+  out.put<uint32_t>(trackers.size());
+
+  for (const auto& [url, properties] : trackers) {
+    uint8_t flags = 0;
+
+    if (properties.is_map()) {
+      flags |= properties.has_key_value("enabled") ? flag_enabled : 0;
+      flags |= properties.has_key_value("extra_tracker") ? flag_extra_tracker
+                                                         : 0;
+      flags |= properties.has_key_value("group") ? flag_group : 0;
+    }
+
+    out.put<uint32_t>(url.size());
+    out.put(url);
+    out.put<uint8_t>(flags);
+    out.put<int64_t>(flags & flag_enabled ? properties.get_key_value("enabled")
+                                          : 0);
+    out.put<int64_t>(flags & flag_extra_tracker
+                       ? properties.get_key_value("extra_tracker")
+                       : 0);
+    out.put<int64_t>(flags & flag_group ? properties.get_key_value("group")
+                                        : 0);
+  }
+}
+
+bool
+decode_bitfield(std::string_view data, Object& object) {
+  reader in(data);
+
+  if (in.get<uint8_t>() == 1)
+    object.insert_key("bitfield", std::string(in.get(in.remaining())));
+  else
+    object.insert_key("bitfield", in.get<int64_t>());
+
+  return in.is_valid();
+}
+
+bool
+decode_files(std::string_view data, Object& object) {
+  reader   in(data);
+  uint32_t count = in.get<uint32_t>();
+
+  if (in.remaining() != (uint64_t)count * file_entry_size)
+    return false;
+
+  Object::list_type& files =
+    object.insert_key("files", Object::create_list()).as_list();
+
+  for (uint32_t i = 0; i < count; i++) {
+    Object& file = files.emplace_back(Object::create_map());
+
+    auto flags     = in.get<uint8_t>();
+    auto priority  = in.get<uint8_t>();
+    auto completed = in.get<uint32_t>();
+    auto mtime     = in.get<int64_t>();
+
+    if (flags & flag_priority)
+      file.insert_key("priority", (int64_t)priority);
+    if (flags & flag_completed)
+      file.insert_key("completed", (int64_t)completed);
+    if (flags & flag_mtime)
+      file.insert_key("mtime", mtime);
+  }
+
+  return in.is_valid();
+}
+
+bool
+decode_uncertain(std::string_view data, Object& object) {
+  reader in(data);
+
+  auto has_timestamp = in.get<uint8_t>();
+  auto timestamp     = in.get<int64_t>();
+  auto has_pieces    = in.get<uint8_t>();
+
+  if (has_timestamp)
+    object.insert_key("uncertain_pieces.timestamp", timestamp);
+  if (has_pieces)
+    object.insert_key("uncertain_pieces", std::string(in.get(in.remaining())));
+
+  return in.is_valid();
+}
+
+bool
+decode_peers(std::string_view data, Object& object) {
+  reader   in(data);
+  uint32_t count = in.get<uint32_t>();
+
+  if (in.remaining() != (uint64_t)count * peer_entry_size)
+    return false;
+
+  Object::list_type& peers =
+    object.insert_key("peers", Object::create_list()).as_list();
+
+  for (uint32_t i = 0; i < count; i++) {
+    Object& peer = peers.emplace_back(Object::create_map());
+
+    peer.insert_key("inet",
+                    std::string(in.get(sizeof(SocketAddressCompact))));
+    peer.insert_key("failed", (int64_t)in.get<uint32_t>());
+    peer.insert_key("last", in.get<int64_t>());
+  }
+
+  return in.is_valid();
+}
+
+bool
+decode_trackers(std::string_view data, Object& object) {
+  reader   in(data);
+  uint32_t count = in.get<uint32_t>();
+
+  Object& trackers = object.insert_key("trackers", Object::create_map());
+
+  for (uint32_t i = 0; i < count && in.is_valid(); i++) {
+    std::string url(in.get(in.get<uint32_t>()));
+
+    auto flags         = in.get<uint8_t>();
+    auto enabled       = in.get<int64_t>();
+    auto extra_tracker = in.get<int64_t>();
+    auto group         = in.get<int64_t>();
+
+    Object& tracker = trackers.insert_key(url, Object::create_map());
+
+    if (flags & flag_enabled)
+      tracker.insert_key("enabled", enabled);
+    if (flags & flag_extra_tracker)
+      tracker.insert_key("extra_tracker", extra_tracker);
+    if (flags & flag_group)
+      tracker.insert_key("group", group);
+  }
+
+  return in.is_valid() && in.remaining() == 0;
+}
+
+} // namespace
+
+// FNV-1a, only meant to catch torn or truncated writes.
+uint32_t
+resume_binary::checksum(const char* data, size_t size) {
+  uint32_t hash = 2166136261u;
+
+  for (size_t i = 0; i < size; i++)
+    hash = (hash ^ static_cast<uint8_t>(data[i])) * 16777619u;
+
+  return hash;
+}
+
+bool
+resume_binary::open(const char* data, size_t size) {
+  close();
+
+  std::vector<section_entry> table;
+
+  if (!read_table(data, size, table))
+    return false;
+
+  for (const auto& entry : table) {
+    if (entry.type == 0 || entry.type >= section_max ||
+        checksum(data + entry.offset, entry.length) != entry.checksum) {
+      for (auto& section : m_sections)
+        section = std::string_view();
+
+      return false;
+    }
+
+    m_sections[entry.type] = std::string_view(data + entry.offset, entry.length);
+  }
+
+  m_data = data;
+  m_size = size;
+  return true;
+}
+
+bool
+resume_binary::open_file(const std::string& path) {
+  close();
+
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+  if (fd == -1)
+    return false;
+
+  struct stat st;
+
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    ::close(fd);
+    return false;
+  }
+
+  void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+
+  if (data == MAP_FAILED)
+    return false;
+
+  if (!open(static_cast<const char*>(data), st.st_size)) {
+    munmap(data, st.st_size);
+    return false;
+  }
+
+  m_mapped = true;
+  return true;
+}
+
+void
+resume_binary::close() {
+  if (m_mapped)
+    munmap(const_cast<char*>(m_data), m_size);
+
+  m_data   = nullptr;
+  m_size   = 0;
+  m_mapped = false;
+
+  for (auto& section : m_sections)
+    section = std::string_view();
+}
+
+std::string
+resume_binary_encode(const Object& object) {
+  std::string sections[resume_binary::section_max];
+
+  if (object.has_key_string("bitfield") || object.has_key_value("bitfield"))
+    encode_bitfield(object, sections[resume_binary::section_bitfield]);
+
+  if (object.has_key_list("files"))
+    encode_files(object, sections[resume_binary::section_files]);
+
+  if (object.has_key_value("uncertain_pieces.timestamp") ||
+      object.has_key_string("uncertain_pieces"))
+    encode_uncertain(object, sections[resume_binary::section_uncertain]);
+
+  if (object.has_key_list("peers"))
+    encode_peers(object, sections[resume_binary::section_peers]);
+
+  if (object.has_key_map("trackers"))
+    encode_trackers(object, sections[resume_binary::section_trackers]);
+
+  uint16_t count = 0;
+
+  for (const auto& section : sections)
+    count += !section.empty();
+
+  std::string buffer;
+  writer      out(buffer);
+
+  out.put<uint32_t>(resume_binary::magic);
+  out.put<uint16_t>(resume_binary::version);
+  out.put<uint16_t>(count);
+
+  uint32_t offset =
+    resume_binary::header_size + count * resume_binary::entry_size;
+
+  for (uint16_t type = 0; type < resume_binary::section_max; type++) {
+    if (sections[type].empty())
+      continue;
+
+    out.put<uint16_t>(type);
+    out.put<uint16_t>(0);
+    out.put<uint32_t>(offset);
+    out.put<uint32_t>(sections[type].size());
+    out.put<uint32_t>(resume_binary::checksum(sections[type].data(),
+                                              sections[type].size()));
+
+    offset += sections[type].size();
+  }
+
+  for (const auto& section : sections)
+    out.put(section);
+
+  return buffer;
+}
+
+bool
+resume_binary_decode(const resume_binary& binary,
+                     Object&              object,
+                     bool                 with_peers) {
+  if (!binary.is_open())
+    return false;
+
+  if (binary.has_section(resume_binary::section_bitfield) &&
+      !decode_bitfield(binary.section(resume_binary::section_bitfield), object))
+    return false;
+
+  if (binary.has_section(resume_binary::section_files) &&
+      !decode_files(binary.section(resume_binary::section_files), object))
+    return false;
+
+  if (binary.has_section(resume_binary::section_uncertain) &&
+      !decode_uncertain(binary.section(resume_binary::section_uncertain),
+                        object))
+    return false;
+
+  if (with_peers && binary.has_section(resume_binary::section_peers) &&
+      !decode_peers(binary.section(resume_binary::section_peers), object))
+    return false;
+
+  if (binary.has_section(resume_binary::section_trackers) &&
+      !decode_trackers(binary.section(resume_binary::section_trackers), object))
+    return false;
+
+  return true;
+}
+
+// Same as 'resume_load_addresses', reading the packed entries in
+// place.
+void
+resume_binary_load_addresses(Download download, const resume_binary& binary) {
+  reader   in(binary.section(resume_binary::section_peers));
+  uint32_t count = in.get<uint32_t>();
+
+  if (in.remaining() != (uint64_t)count * peer_entry_size)
+    return;
+
+  PeerList* peerList = download.peer_list();
+
+  for (uint32_t i = 0; i < count; i++) {
+    auto inet   = in.get(sizeof(SocketAddressCompact));
+    auto failed = in.get<uint32_t>();
+    auto last   = in.get<int64_t>();
+
+    if (last > cachedTime.seconds())
+      continue;
+
+    int                   flags = 0;
+    utils::socket_address socketAddress =
+      *reinterpret_cast<const SocketAddressCompact*>(inet.data());
+
+    if (socketAddress.port() != 0)
+      flags |= PeerList::address_available;
+
+    PeerInfo* peerInfo =
+      peerList->insert_address(socketAddress.c_sockaddr(), flags);
+
+    if (peerInfo == nullptr)
+      continue;
+
+    peerInfo->set_failed_counter(failed);
+    peerInfo->set_last_connection(last);
+
+    // Rank the address now that its history is known.
+    peerList->available_list()->update(
+      socketAddress,
+      AvailableList::score(
+        peerInfo, AvailableList::source_resume, cachedTime.seconds()));
+  }
+}
+
+int
+resume_binary_write(const std::string& path, const std::string& encoded) {
+  std::vector<section_entry> next;
+
+  if (!read_table(encoded.data(), encoded.size(), next))
+    return -1;
+
+  int changed = next.size();
+
+  // Compare against the existing file, unmapping it before the rename.
+  {
+    resume_binary              existing;
+    std::vector<section_entry> current;
+
+    if (existing.open_file(path) && existing.size() == encoded.size() &&
+        read_table(existing.data(), existing.size(), current) &&
+        same_layout(current, next)) {
+      changed = 0;
+
+      for (size_t i = 0; i < next.size(); i++)
+        if (current[i].checksum != next[i].checksum)
+          changed++;
+
+      if (changed == 0)
+        return 0;
+    }
+  }
+
+  // Always replace the whole file, synced before the rename, so that
+  // a crash leaves either the old or the new file intact.
+  std::string tmp = path + ".new";
+  int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+  if (fd == -1)
+    return -1;
+
+  bool result =
+    write_at(fd, encoded.data(), encoded.size(), 0) && ::fsync(fd) == 0;
+  ::close(fd);
+
+  if (!result || ::rename(tmp.c_str(), path.c_str()) != 0) {
+    ::unlink(tmp.c_str());
+    return -1;
+  }
+
+  return changed;
+}
+
+} // namespace torrent
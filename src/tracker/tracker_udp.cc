@@ -57,17 +57,12 @@ TrackerUdp::TrackerUdp(TrackerList* parent, const std::string& url, int flags)
 }
 
 TrackerUdp::~TrackerUdp() {
-  if (m_slot_resolver != nullptr) {
-    *m_slot_resolver = resolver_type();
-    m_slot_resolver  = nullptr;
-  }
-
   close_directly();
 }
 
 bool
 TrackerUdp::is_busy() const {
-  return get_fd().is_valid();
+  return m_slot_resolver != nullptr || get_fd().is_valid();
 }
 
 void
@@ -82,15 +77,7 @@ TrackerUdp::send_state(int state) {
 
   LT_LOG_TRACKER(DEBUG, "hostname lookup (address:%s)", hostname.data());
 
-  m_sendState = state;
-
-  // Because we can only remember one slot, set any pending resolves blocked
-  // so that if this tracker is deleted, the member function won't be called.
-  if (m_slot_resolver != nullptr) {
-    *m_slot_resolver = resolver_type();
-    m_slot_resolver  = nullptr;
-  }
-
+  m_sendState     = state;
   m_slot_resolver = make_resolver_slot(hostname);
 }
 
@@ -174,7 +161,7 @@ TrackerUdp::start_announce(const sockaddr* sa, int) {
 
 void
 TrackerUdp::close() {
-  if (!get_fd().is_valid())
+  if (!is_busy())
     return;
 
   LT_LOG_TRACKER(DEBUG,
@@ -187,7 +174,7 @@ TrackerUdp::close() {
 
 void
 TrackerUdp::disown() {
-  if (!get_fd().is_valid())
+  if (!is_busy())
     return;
 
   LT_LOG_TRACKER(DEBUG,
@@ -200,6 +187,13 @@ TrackerUdp::disown() {
 
 void
 TrackerUdp::close_directly() {
+  // Block any pending resolve so that the result is not delivered to
+  // a closed or deleted tracker.
+  if (m_slot_resolver != nullptr) {
+    *m_slot_resolver = resolver_type();
+    m_slot_resolver  = nullptr;
+  }
+
   if (!get_fd().is_valid())
     return;
 
@@ -0,0 +1,145 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2005-2011, Jari Sundell <jaris@ifi.uio.no>
+
+#include <algorithm>
+#include <cstring>
+
+#include "torrent/exceptions.h"
+#include "utils/diffie_hellman_pool.h"
+
+namespace torrent {
+
+DiffieHellmanPool::size_type
+DiffieHellmanPool::size() {
+  std::lock_guard lk(m_lock);
+  return m_keys.size();
+}
+
+void
+DiffieHellmanPool::set_target(size_type target) {
+  std::lock_guard lk(m_lock);
+
+  m_target = target;
+
+  if (m_keys.size() > m_target)
+    m_keys.resize(m_target);
+}
+
+DiffieHellmanPool::key_ptr
+DiffieHellmanPool::acquire() {
+  key_ptr key;
+  bool    need_work;
+
+  {
+    std::lock_guard lk(m_lock);
+
+    if (!m_keys.empty()) {
+      key = std::move(m_keys.front());
+      m_keys.pop_front();
+    }
+
+    need_work = m_keys.size() < m_target / 2;
+  }
+
+  if (need_work && m_slot_need_work)
+    m_slot_need_work();
+
+  if (key == nullptr)
+    key = m_slot_generate();
+
+  return key;
+}
+
+void
+DiffieHellmanPool::compute_secret(id_type              id,
+                                  key_ptr              key,
+                                  const unsigned char* pubkey,
+                                  unsigned int         length) {
+  if (id == nullptr || key == nullptr || length > max_pubkey_length)
+    throw internal_error("DiffieHellmanPool::compute_secret() invalid job.");
+
+  {
+    std::lock_guard lk(m_lock);
+
+    m_pending.push_back(secret_job{ id, std::move(key), {}, length, false });
+    std::memcpy(m_pending.back().pubkey, pubkey, length);
+  }
+
+  m_slot_need_work();
+}
+
+void
+DiffieHellmanPool::cancel(id_type id) {
+  std::lock_guard lk(m_lock);
+
+  auto match = [id](const secret_job& job) { return job.id == id; };
+
+  m_pending.erase(std::remove_if(m_pending.begin(), m_pending.end(), match),
+                  m_pending.end());
+  m_done.erase(std::remove_if(m_done.begin(), m_done.end(), match),
+               m_done.end());
+
+  if (m_performing == id)
+    m_performing = nullptr;
+}
+
+void
+DiffieHellmanPool::work() {
+  // Deliver one at a time as the callback may cancel other jobs.
+  while (true) {
+    secret_job job;
+
+    {
+      std::lock_guard lk(m_lock);
+
+      if (m_done.empty())
+        return;
+
+      job = std::move(m_done.front());
+      m_done.pop_front();
+    }
+
+    m_slot_secret_done(job.id, std::move(job.key), job.result);
+  }
+}
+
+void
+DiffieHellmanPool::perform() {
+  std::unique_lock lk(m_lock);
+
+  // Pending secrets have a handshake waiting on them, so they take
+  // priority over refilling the pool.
+  while (true) {
+    if (!m_pending.empty()) {
+      secret_job job = std::move(m_pending.front());
+      m_pending.pop_front();
+      m_performing = job.id;
+
+      lk.unlock();
+      job.result = job.key->compute_secret(job.pubkey, job.length);
+      lk.lock();
+
+      if (m_performing == nullptr)
+        continue;
+
+      m_performing = nullptr;
+      m_done.push_back(std::move(job));
+
+      lk.unlock();
+      m_slot_has_work();
+      lk.lock();
+
+    } else if (m_slot_generate && m_keys.size() < m_target) {
+      lk.unlock();
+      key_ptr key = m_slot_generate();
+      lk.lock();
+
+      m_keys.push_back(std::move(key));
+
+    } else {
+      break;
+    }
+  }
+}
+
+} // namespace torrent
@@ -70,7 +70,8 @@ instrumentation_tick() {
     "%" PRIi64 " %" PRIi64 " %" PRIi64 " %" PRIi64 " %" PRIi64 " %" PRIi64
     " %" PRIi64 " %" PRIi64 " %" PRIi64 " %" PRIi64 " %" PRIi64 " %" PRIi64
     " %" PRIi64 " %" PRIi64 " %" PRIi64 " %" PRIi64 " %" PRIi64 " %" PRIi64
-    " %" PRIi64 " %" PRIi64 " %" PRIi64 " %" PRIi64 " %" PRIi64,
+    " %" PRIi64 " %" PRIi64 " %" PRIi64 " %" PRIi64 " %" PRIi64 " %" PRIi64
+    " %" PRIi64 " %" PRIi64,
 
     instrumentation_fetch_and_clear(
       INSTRUMENTATION_TRANSFER_REQUESTS_DELEGATED),
@@ -114,7 +115,13 @@ instrumentation_tick() {
       INSTRUMENTATION_TRANSFER_REQUESTS_CHOKED_REMOVED),
     instrumentation_values[INSTRUMENTATION_TRANSFER_REQUESTS_CHOKED_TOTAL],
 
-    instrumentation_values[INSTRUMENTATION_TRANSFER_PEER_INFO_UNACCOUNTED]);
+    instrumentation_values[INSTRUMENTATION_TRANSFER_PEER_INFO_UNACCOUNTED],
+
+    instrumentation_fetch_and_clear(INSTRUMENTATION_TRANSFER_HAVE_MESSAGES),
+    instrumentation_fetch_and_clear(INSTRUMENTATION_TRANSFER_HAVE_BYTES),
+
+    instrumentation_fetch_and_clear(
+      INSTRUMENTATION_TRANSFER_REQUESTS_REJECTED));
 }
 
 void
@@ -179,6 +186,11 @@ instrumentation_reset() {
     INSTRUMENTATION_TRANSFER_REQUESTS_CHOKED_MOVED);
   instrumentation_fetch_and_clear(
     INSTRUMENTATION_TRANSFER_REQUESTS_CHOKED_REMOVED);
+
+  instrumentation_fetch_and_clear(INSTRUMENTATION_TRANSFER_HAVE_MESSAGES);
+  instrumentation_fetch_and_clear(INSTRUMENTATION_TRANSFER_HAVE_BYTES);
+
+  instrumentation_fetch_and_clear(INSTRUMENTATION_TRANSFER_REQUESTS_REJECTED);
 }
 #endif
 
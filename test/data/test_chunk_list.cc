@@ -1,3 +1,4 @@
+#include "globals.h"
 #include "torrent/chunk_manager.h"
 #include "torrent/exceptions.h"
 #include "torrent/utils/error_number.h"
@@ -110,3 +111,94 @@ TEST_F(test_chunk_list, test_blocking) {
 
   CLEANUP_CHUNK_LIST();
 }
+
+static void
+queue_writable(torrent::ChunkList* chunk_list, uint32_t count) {
+  for (uint32_t i = count; i-- != 0;) {
+    torrent::ChunkHandle handle =
+      chunk_list->get(i, torrent::ChunkList::get_writable);
+
+    handle.object()->set_time_modified(torrent::utils::timer(1));
+    chunk_list->release(&handle);
+  }
+}
+
+TEST_F(test_chunk_list, test_sync_max_chunks) {
+  SETUP_CHUNK_LIST();
+
+  chunk_list->set_device(7);
+  queue_writable(chunk_list, 10);
+  ASSERT_EQ(chunk_list->queue_size(), 10);
+
+  ASSERT_EQ(chunk_list->sync_chunks(torrent::ChunkList::sync_all |
+                                      torrent::ChunkList::sync_force,
+                                    4),
+            0);
+  ASSERT_EQ(chunk_list->queue_size(), 6);
+
+  // The lowest indices get synced first.
+  for (unsigned int i = 0; i < 10; i++)
+    ASSERT_EQ((*chunk_list)[i].is_valid(), i >= 4);
+
+  auto& stats = chunk_manager->sync_stats().at(7);
+
+  ASSERT_EQ(stats.syncs, 4);
+  ASSERT_EQ(stats.failed, 0);
+  ASSERT_EQ(stats.bytes, 4 << 16);
+  ASSERT_LE(stats.average_usec(), stats.max_usec);
+
+  chunk_list->sync_chunks(torrent::ChunkList::sync_all |
+                          torrent::ChunkList::sync_force);
+  ASSERT_EQ(chunk_list->queue_size(), 0);
+  ASSERT_EQ(chunk_manager->sync_stats().at(7).syncs, 10);
+
+  CLEANUP_CHUNK_LIST();
+}
+
+TEST_F(test_chunk_list, test_sync_queue_depth) {
+  torrent::ChunkManager chunk_manager;
+  torrent::ChunkList    chunk_lists[3];
+  dev_t                 devices[3] = { 1, 1, 2 };
+
+  torrent::cachedTime = torrent::utils::timer::from_seconds(1000);
+
+  chunk_manager.set_timeout_sync(0);
+  chunk_manager.set_sync_queue_depth(3);
+
+  for (int i = 0; i < 3; i++) {
+    auto chunk_list = &chunk_lists[i];
+
+    chunk_manager.insert(chunk_list);
+
+    chunk_list->slot_create_chunk() = std::bind(
+      &func_create_chunk, std::placeholders::_1, std::placeholders::_2);
+    chunk_list->slot_free_diskspace() =
+      std::bind(&func_free_diskspace, chunk_list);
+    chunk_list->slot_storage_error() =
+      std::bind(&func_storage_error, chunk_list, std::placeholders::_1);
+    chunk_list->set_chunk_size(1 << 16);
+    chunk_list->set_device(devices[i]);
+    chunk_list->resize(32);
+
+    queue_writable(chunk_list, 5);
+  }
+
+  // Both downloads on device 1 share its budget.
+  chunk_manager.periodic_sync();
+
+  ASSERT_EQ(chunk_manager.sync_stats().at(1).syncs, 3);
+  ASSERT_EQ(chunk_manager.sync_stats().at(2).syncs, 3);
+
+  chunk_manager.set_sync_queue_depth(0);
+  chunk_manager.periodic_sync();
+
+  ASSERT_EQ(chunk_manager.sync_stats().at(1).syncs, 13);
+  ASSERT_EQ(chunk_manager.sync_stats().at(2).syncs, 8);
+
+  for (auto& chunk_list : chunk_lists) {
+    chunk_list.sync_chunks(torrent::ChunkList::sync_all |
+                           torrent::ChunkList::sync_force);
+    chunk_manager.erase(&chunk_list);
+    chunk_list.clear();
+  }
+}
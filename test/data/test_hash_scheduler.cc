@@ -0,0 +1,92 @@
+#include "data/hash_scheduler.h"
+#include "data/hash_torrent.h"
+#include "globals.h"
+
+#include "test/helpers/fixture.h"
+
+class test_hash_scheduler : public test_fixture {};
+
+// The downloads are not checking, so being woken up does nothing.
+
+TEST_F(test_hash_scheduler, test_device_budget) {
+  torrent::HashScheduler scheduler;
+  torrent::HashTorrent   first(nullptr);
+  torrent::HashTorrent   second(nullptr);
+  torrent::HashTorrent   other(nullptr);
+
+  scheduler.set_max_outstanding(100);
+
+  scheduler.insert(&first, 1);
+  scheduler.insert(&second, 1);
+  scheduler.insert(&other, 2);
+
+  // An idle device accepts a chunk larger than the budget.
+  ASSERT_TRUE(scheduler.is_available(&first, 200));
+
+  ASSERT_TRUE(scheduler.is_available(&first, 60));
+  scheduler.acquire(&first, 60);
+
+  ASSERT_FALSE(scheduler.is_available(&second, 60));
+  ASSERT_TRUE(scheduler.is_waiting(&second));
+  ASSERT_EQ(scheduler.progress().waiting, 1);
+
+  // Other devices have their own budget.
+  ASSERT_TRUE(scheduler.is_available(&other, 60));
+
+  scheduler.release(&first, 60);
+  ASSERT_FALSE(scheduler.is_waiting(&second));
+  ASSERT_EQ(scheduler.progress().bytes_checked, 60);
+
+  scheduler.erase(&first);
+  scheduler.erase(&second);
+  scheduler.erase(&other);
+
+  ASSERT_FALSE(scheduler.has(&first));
+  ASSERT_EQ(scheduler.progress().downloads, 0);
+}
+
+TEST_F(test_hash_scheduler, test_erase_releases) {
+  torrent::HashScheduler scheduler;
+  torrent::HashTorrent   first(nullptr);
+  torrent::HashTorrent   second(nullptr);
+
+  scheduler.set_max_outstanding(100);
+
+  scheduler.insert(&first, 1);
+  scheduler.insert(&second, 1);
+
+  scheduler.acquire(&first, 100);
+  ASSERT_FALSE(scheduler.is_available(&second, 10));
+
+  // A stopped download gives back its share of the budget.
+  scheduler.erase(&first);
+  ASSERT_FALSE(scheduler.is_waiting(&second));
+  ASSERT_TRUE(scheduler.is_available(&second, 100));
+
+  ASSERT_THROW(scheduler.release(&second, 10), torrent::internal_error);
+
+  scheduler.erase(&second);
+}
+
+TEST_F(test_hash_scheduler, test_progress_eta) {
+  torrent::HashScheduler scheduler;
+  torrent::HashTorrent   first(nullptr);
+
+  torrent::cachedTime = torrent::utils::timer::from_seconds(1000);
+
+  scheduler.insert(&first, 1);
+  ASSERT_EQ(scheduler.progress().eta, -1);
+
+  scheduler.acquire(&first, 1000);
+
+  torrent::cachedTime += torrent::utils::timer::from_seconds(10);
+  scheduler.release(&first, 1000);
+
+  auto progress = scheduler.progress();
+
+  ASSERT_EQ(progress.downloads, 1);
+  ASSERT_EQ(progress.bytes_checked, 1000);
+  ASSERT_EQ(progress.eta, 0);
+
+  scheduler.erase(&first);
+}
@@ -0,0 +1,191 @@
+#include <fstream>
+#include <ftw.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "data/memory_governor.h"
+
+#include "test/helpers/fixture.h"
+
+class test_memory_governor : public test_fixture {};
+
+static const uint64_t mib = 1 << 20;
+
+static void
+write_file(const std::string& path, const std::string& content) {
+  std::ofstream file(path);
+  file << content;
+}
+
+static int
+remove_entry(const char* path, const struct stat*, int, FTW*) {
+  return remove(path);
+}
+
+TEST_F(test_memory_governor, test_parse_cgroup_path) {
+  std::string path;
+
+  ASSERT_TRUE(torrent::MemoryGovernor::parse_cgroup_path(
+    "0::/system.slice/rtorrent.service\n", &path));
+  ASSERT_EQ(path, "/system.slice/rtorrent.service");
+
+  ASSERT_TRUE(torrent::MemoryGovernor::parse_cgroup_path(
+    "12:memory:/user\n1:name=systemd:/user\n0::/user/\n", &path));
+  ASSERT_EQ(path, "/user");
+
+  ASSERT_TRUE(torrent::MemoryGovernor::parse_cgroup_path("0::/\n", &path));
+  ASSERT_EQ(path, "");
+
+  ASSERT_FALSE(
+    torrent::MemoryGovernor::parse_cgroup_path("4:memory:/user\n", &path));
+}
+
+TEST_F(test_memory_governor, test_parse_memory_value) {
+  ASSERT_EQ(torrent::MemoryGovernor::parse_memory_value("1073741824\n"),
+            1073741824);
+  ASSERT_EQ(torrent::MemoryGovernor::parse_memory_value("4096"), 4096);
+  ASSERT_EQ(torrent::MemoryGovernor::parse_memory_value("max\n"), 0);
+  ASSERT_EQ(torrent::MemoryGovernor::parse_memory_value(""), 0);
+}
+
+TEST_F(test_memory_governor, test_parse_memory_stat) {
+  const std::string stat = "anon 1048576\n"
+                           "file 8388608\n"
+                           "active_file 2097152\n"
+                           "inactive_file 4194304\n";
+
+  ASSERT_EQ(torrent::MemoryGovernor::parse_memory_stat(stat, "file"),
+            8388608);
+  ASSERT_EQ(torrent::MemoryGovernor::parse_memory_stat(stat, "active_file"),
+            2097152);
+  ASSERT_EQ(
+    torrent::MemoryGovernor::parse_memory_stat(stat, "inactive_file"),
+    4194304);
+  ASSERT_EQ(torrent::MemoryGovernor::parse_memory_stat(stat, "shmem"), 0);
+}
+
+TEST_F(test_memory_governor, test_parse_pressure) {
+  uint32_t some = 0;
+  uint32_t full = 0;
+
+  ASSERT_TRUE(torrent::MemoryGovernor::parse_pressure(
+    "some avg10=12.34 avg60=5.00 avg300=1.00 total=123456\n"
+    "full avg10=0.50 avg60=0.10 avg300=0.00 total=2345\n",
+    &some,
+    &full));
+  ASSERT_EQ(some, 1234);
+  ASSERT_EQ(full, 50);
+
+  ASSERT_FALSE(
+    torrent::MemoryGovernor::parse_pressure("garbage\n", &some, &full));
+}
+
+TEST_F(test_memory_governor, test_next_limit) {
+  torrent::memory_sample sample;
+  const uint64_t         max = 1024 * mib;
+
+  // Nothing known, use the configured max.
+  ASSERT_EQ(
+    torrent::MemoryGovernor::next_limit(sample, 256 * mib, 100 * mib, max),
+    max);
+
+  // Leave a tenth of memory.max for the rest of the process.
+  sample.cgroup_max     = 1000 * mib;
+  sample.cgroup_current = 700 * mib;
+  ASSERT_EQ(
+    torrent::MemoryGovernor::next_limit(sample, max, 100 * mib, max),
+    300 * mib);
+
+  // Already over the reserve, never go below an eighth of max.
+  sample.cgroup_current = 990 * mib;
+  ASSERT_EQ(torrent::MemoryGovernor::next_limit(sample, max, 0, max),
+            max / 8);
+
+  // A cgroup filled up with page cache still has room for chunks.
+  sample.cgroup_file = 900 * mib;
+  ASSERT_EQ(
+    torrent::MemoryGovernor::next_limit(sample, max, 400 * mib, max),
+    810 * mib);
+
+  // Only what can't be reclaimed takes from the headroom.
+  sample.cgroup_file = 490 * mib;
+  ASSERT_EQ(
+    torrent::MemoryGovernor::next_limit(sample, max, 400 * mib, max),
+    400 * mib);
+
+  sample               = torrent::memory_sample();
+  sample.has_pressure  = true;
+  sample.pressure_some = torrent::MemoryGovernor::pressure_high;
+  ASSERT_EQ(
+    torrent::MemoryGovernor::next_limit(sample, 800 * mib, 400 * mib, max),
+    300 * mib);
+
+  sample.pressure_some = torrent::MemoryGovernor::pressure_low;
+  ASSERT_EQ(
+    torrent::MemoryGovernor::next_limit(sample, 300 * mib, 300 * mib, max),
+    300 * mib);
+
+  sample.pressure_some = 0;
+  ASSERT_EQ(
+    torrent::MemoryGovernor::next_limit(sample, 300 * mib, 300 * mib, max),
+    300 * mib + max / 16);
+  ASSERT_EQ(torrent::MemoryGovernor::next_limit(sample, max, 0, max), max);
+}
+
+TEST_F(test_memory_governor, test_sample) {
+  char path[] = "/tmp/libtorrent_memory_governor_XXXXXX";
+  ASSERT_NE(mkdtemp(path), nullptr);
+
+  std::string root = path;
+
+  for (auto dir : { "/proc", "/proc/self", "/cgroup", "/cgroup/a",
+                    "/cgroup/a/b" })
+    ASSERT_EQ(mkdir((root + dir).c_str(), 0700), 0);
+
+  torrent::MemoryGovernor governor(root + "/cgroup", root + "/proc");
+
+  // Without /proc/self/cgroup or pressure files nothing is known.
+  torrent::memory_sample sample = governor.sample();
+  ASSERT_EQ(sample.cgroup_max, 0);
+  ASSERT_FALSE(sample.has_pressure);
+
+  write_file(root + "/proc/self/cgroup", "0::/a/b\n");
+  write_file(root + "/cgroup/memory.max", "max\n");
+  write_file(root + "/cgroup/a/memory.max", "1073741824\n");
+  write_file(root + "/cgroup/a/memory.current", "805306368\n");
+  write_file(root + "/cgroup/a/memory.stat",
+             "anon 4096\nactive_file 8192\ninactive_file 16384\n");
+  write_file(root + "/cgroup/a/b/memory.max", "max\n");
+  write_file(root + "/cgroup/a/b/memory.current", "536870912\n");
+  write_file(root + "/cgroup/a/b/memory.pressure",
+             "some avg10=2.00 avg60=0.00 avg300=0.00 total=0\n"
+             "full avg10=1.00 avg60=0.00 avg300=0.00 total=0\n");
+
+  sample = governor.sample();
+  ASSERT_EQ(sample.cgroup_max, 1073741824);
+  // The usage of the cgroup that sets the limit, not of the leaf.
+  ASSERT_EQ(sample.cgroup_current, 805306368);
+  ASSERT_EQ(sample.cgroup_file, 24576);
+  ASSERT_TRUE(sample.has_pressure);
+  ASSERT_EQ(sample.pressure_some, 200);
+  ASSERT_EQ(sample.pressure_full, 100);
+
+  // Without any limit the usage of the leaf is used.
+  write_file(root + "/cgroup/a/memory.max", "max\n");
+
+  sample = governor.sample();
+  ASSERT_EQ(sample.cgroup_max, 0);
+  ASSERT_EQ(sample.cgroup_current, 536870912);
+
+  // Fall back to the system wide pressure.
+  unlink((root + "/cgroup/a/b/memory.pressure").c_str());
+  ASSERT_EQ(mkdir((root + "/proc/pressure").c_str(), 0700), 0);
+  write_file(root + "/proc/pressure/memory",
+             "some avg10=30.00 avg60=0.00 avg300=0.00 total=0\n");
+
+  sample = governor.sample();
+  ASSERT_EQ(sample.pressure_some, 3000);
+
+  nftw(path, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
@@ -0,0 +1,89 @@
+#include "dht/dht_distance.h"
+#include "torrent/utils/random.h"
+
+#include "test/helpers/fixture.h"
+
+class test_dht_distance : public test_fixture {};
+
+static torrent::HashString
+random_id() {
+  torrent::HashString id;
+
+  for (auto& c : id)
+    c = static_cast<char>(torrent::random_uniform_uint32(0, 255));
+
+  return id;
+}
+
+// Byte by byte reference versions of the helpers.
+
+static unsigned int
+reference_common_prefix(const torrent::HashString& one,
+                        const torrent::HashString& two) {
+  for (unsigned int i = 0; i < 160; i++) {
+    int bit = 0x80 >> (i % 8);
+
+    if ((one[i / 8] & bit) != (two[i / 8] & bit))
+      return i;
+  }
+
+  return 160;
+}
+
+static bool
+reference_is_closer(const torrent::HashString& target,
+                    const torrent::HashString& one,
+                    const torrent::HashString& two) {
+  for (unsigned int i = 0; i < one.size(); i++) {
+    if (one[i] != two[i])
+      return (uint8_t)(one[i] ^ target[i]) < (uint8_t)(two[i] ^ target[i]);
+  }
+
+  return false;
+}
+
+TEST_F(test_dht_distance, test_common_prefix) {
+  torrent::HashString id = random_id();
+
+  ASSERT_EQ(torrent::dht_common_prefix(id, id), 160);
+
+  for (unsigned int bit = 0; bit < 160; bit++) {
+    torrent::HashString other = id;
+    other[bit / 8] ^= 0x80 >> (bit % 8);
+
+    ASSERT_EQ(torrent::dht_common_prefix(id, other), bit);
+    ASSERT_EQ(torrent::dht_common_prefix(other, id), bit);
+  }
+
+  for (int i = 0; i < 1000; i++) {
+    torrent::HashString one = random_id();
+    torrent::HashString two = one;
+
+    // Share a random number of leading bytes.
+    for (auto j = torrent::random_uniform_uint32(0, 20); j < 20; j++)
+      two[j] = static_cast<char>(torrent::random_uniform_uint32(0, 255));
+
+    ASSERT_EQ(torrent::dht_common_prefix(one, two),
+              reference_common_prefix(one, two));
+  }
+}
+
+TEST_F(test_dht_distance, test_is_closer) {
+  for (int i = 0; i < 10000; i++) {
+    torrent::HashString target = random_id();
+    torrent::HashString one    = random_id();
+    torrent::HashString two    = one;
+
+    for (auto j = torrent::random_uniform_uint32(0, 20); j < 20; j++)
+      two[j] = static_cast<char>(torrent::random_uniform_uint32(0, 255));
+
+    ASSERT_EQ(torrent::dht_is_closer(target, one, two),
+              reference_is_closer(target, one, two));
+    ASSERT_EQ(torrent::dht_is_closer(target, two, one),
+              reference_is_closer(target, two, one));
+  }
+
+  torrent::HashString target = random_id();
+
+  ASSERT_FALSE(torrent::dht_is_closer(target, target, target));
+}
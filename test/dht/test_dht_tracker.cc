@@ -0,0 +1,100 @@
+#include <cstring>
+
+#include "dht/dht_tracker.h"
+#include "utils/sha1.h"
+
+#include "test/helpers/fixture.h"
+
+class test_dht_tracker : public test_fixture {};
+
+static bool
+bloom_contains(torrent::raw_string bloom, uint32_t addr) {
+  char hash[20];
+
+  torrent::Sha1 sha;
+  sha.init();
+  sha.update(&addr, sizeof(addr));
+  sha.final_c(hash);
+
+  unsigned int index1 = ((uint8_t)hash[0] | ((uint8_t)hash[1] << 8)) % 2048;
+  unsigned int index2 = ((uint8_t)hash[2] | ((uint8_t)hash[3] << 8)) % 2048;
+
+  return (bloom.data()[index1 / 8] & (1 << (index1 % 8))) &&
+         (bloom.data()[index2 / 8] & (1 << (index2 % 8)));
+}
+
+TEST_F(test_dht_tracker, test_add_peer) {
+  torrent::DhtTracker tracker;
+
+  ASSERT_TRUE(tracker.add_peer(htonl(0x0a000001), htons(6881)));
+  ASSERT_TRUE(tracker.add_peer(htonl(0x0a000002), htons(6881)));
+  ASSERT_FALSE(tracker.add_peer(htonl(0x0a000001), htons(6882)));
+  ASSERT_FALSE(tracker.add_peer(htonl(0x0a000003), 0));
+
+  ASSERT_EQ(tracker.size(), 2);
+  ASSERT_EQ(tracker.get_peers().size(), 2 * 8);
+}
+
+TEST_F(test_dht_tracker, test_replace_oldest) {
+  torrent::DhtTracker tracker;
+
+  torrent::cachedTime = torrent::utils::timer::from_seconds(1000);
+
+  for (uint32_t i = 0; i < torrent::DhtTracker::max_size; i++) {
+    ASSERT_TRUE(tracker.add_peer(htonl(0x0a000000 + i), htons(6881)));
+    torrent::cachedTime += torrent::utils::timer::from_seconds(1);
+  }
+
+  ASSERT_FALSE(tracker.add_peer(htonl(0x0b000000), htons(6881)));
+  ASSERT_EQ(tracker.size(), torrent::DhtTracker::max_size);
+
+  // The first, oldest, peer was replaced and can be re-added as new
+  // once the table has room.
+  tracker.prune(1);
+  ASSERT_EQ(tracker.size(), 2);
+
+  ASSERT_TRUE(tracker.add_peer(htonl(0x0a000000), htons(6881)));
+  ASSERT_FALSE(tracker.add_peer(htonl(0x0b000000), htons(6881)));
+}
+
+TEST_F(test_dht_tracker, test_prune) {
+  torrent::DhtTracker tracker;
+
+  torrent::cachedTime = torrent::utils::timer::from_seconds(1000);
+
+  for (uint32_t i = 0; i < 10; i++)
+    tracker.add_peer(htonl(0x0a000000 + i), htons(6881));
+
+  torrent::cachedTime += torrent::utils::timer::from_seconds(100);
+
+  for (uint32_t i = 0; i < 10; i += 2)
+    tracker.add_peer(htonl(0x0a000000 + i), htons(6881));
+
+  tracker.prune(50);
+  ASSERT_EQ(tracker.size(), 5);
+
+  // Remaining peers are still indexed.
+  for (uint32_t i = 0; i < 10; i += 2)
+    ASSERT_FALSE(tracker.add_peer(htonl(0x0a000000 + i), htons(6881)));
+
+  ASSERT_TRUE(tracker.add_peer(htonl(0x0a000001), htons(6881)));
+}
+
+TEST_F(test_dht_tracker, test_bloom) {
+  torrent::DhtTracker tracker;
+
+  tracker.add_peer(htonl(0x0a000001), htons(6881), true);
+  tracker.add_peer(htonl(0x0a000002), htons(6881), false);
+
+  ASSERT_EQ(tracker.bloom_seeds().size(), torrent::DhtTracker::bloom_size);
+  ASSERT_EQ(tracker.bloom_peers().size(), torrent::DhtTracker::bloom_size);
+
+  ASSERT_TRUE(bloom_contains(tracker.bloom_seeds(), htonl(0x0a000001)));
+  ASSERT_TRUE(bloom_contains(tracker.bloom_peers(), htonl(0x0a000002)));
+
+  // A peer that completes moves to the seed filter.
+  tracker.add_peer(htonl(0x0a000002), htons(6881), true);
+
+  ASSERT_TRUE(bloom_contains(tracker.bloom_seeds(), htonl(0x0a000002)));
+  ASSERT_FALSE(bloom_contains(tracker.bloom_peers(), htonl(0x0a000002)));
+}
@@ -0,0 +1,152 @@
+
+#include "download/available_list.h"
+#include "torrent/peer/peer_info.h"
+
+#include "test/helpers/fixture.h"
+
+class test_available_list : public test_fixture {};
+
+static torrent::utils::socket_address
+make_inet_address(uint32_t addr, uint16_t port) {
+  torrent::utils::socket_address sa;
+  sa.sa_inet()->clear();
+  sa.sa_inet()->set_address_h(addr);
+  sa.sa_inet()->set_port(port);
+
+  return sa;
+}
+
+TEST_F(test_available_list, test_push_back) {
+  torrent::AvailableList list;
+
+  auto sa1 = make_inet_address(0x0a000001, 6881);
+  auto sa2 = make_inet_address(0x0a000001, 6882);
+
+  ASSERT_TRUE(list.push_back(&sa1));
+  ASSERT_FALSE(list.push_back(&sa1));
+  ASSERT_TRUE(list.push_back(&sa2));
+
+  ASSERT_EQ(list.size(), 2);
+  ASSERT_TRUE(list.contains(sa1));
+  ASSERT_TRUE(list.contains(sa2));
+
+  list.erase(sa1);
+
+  ASSERT_EQ(list.size(), 1);
+  ASSERT_FALSE(list.contains(sa1));
+  ASSERT_TRUE(list.contains(sa2));
+
+  list.erase(sa1);
+  ASSERT_EQ(list.size(), 1);
+
+  list.clear();
+  ASSERT_TRUE(list.empty());
+  ASSERT_FALSE(list.contains(sa2));
+}
+
+TEST_F(test_available_list, test_pop_all) {
+  torrent::AvailableList list;
+
+  for (uint32_t i = 0; i < 64; i++) {
+    auto sa = make_inet_address(0x0a000000 + i, 6881);
+    list.push_back(&sa);
+  }
+
+  for (uint32_t i = 0; i < 64; i++) {
+    auto sa = list.pop_best();
+
+    ASSERT_FALSE(list.contains(sa));
+    ASSERT_EQ(list.size(), 63 - i);
+
+    // Every remaining address must still be indexed at its new
+    // position.
+    for (const auto& remaining : list)
+      ASSERT_TRUE(list.contains(remaining));
+  }
+}
+
+TEST_F(test_available_list, test_insert_bulk) {
+  torrent::AvailableList list;
+  torrent::AddressList   addresses;
+
+  list.set_max_size(1000000);
+
+  // Insert 100k addresses, a fifth of which are duplicates, the same
+  // size as a large tracker or DHT response batch.
+  for (uint32_t i = 0; i < 100000; i++)
+    addresses.push_back(make_inet_address(0x0a000000 + (i % 80000), 6881));
+
+  ASSERT_EQ(list.insert(&addresses), 80000);
+  ASSERT_EQ(list.size(), 80000);
+
+  ASSERT_EQ(list.insert(&addresses), 0);
+  ASSERT_EQ(list.size(), 80000);
+
+  for (uint32_t i = 0; i < 80000; i += 997)
+    ASSERT_TRUE(list.contains(make_inet_address(0x0a000000 + i, 6881)));
+}
+
+TEST_F(test_available_list, test_pop_best) {
+  torrent::AvailableList list;
+
+  // Push in an order that exercises both sift directions.
+  for (uint32_t i = 0; i < 64; i++) {
+    auto sa = make_inet_address(0x0a000000 + i, 6881);
+    list.push_back(&sa, (i * 37) % 64);
+  }
+
+  auto sa = make_inet_address(0x0a000000 + 5, 6881);
+  list.update(sa, 1000);
+  list.erase(make_inet_address(0x0a000000 + 10, 6881));
+
+  ASSERT_EQ(list.best_score(), 1000);
+  ASSERT_EQ(list.pop_best(), sa);
+
+  uint32_t previous = ~uint32_t();
+
+  while (!list.empty()) {
+    uint32_t score = list.best_score();
+
+    ASSERT_LE(score, previous);
+    list.pop_best();
+
+    for (const auto& remaining : list)
+      ASSERT_TRUE(list.contains(remaining));
+
+    previous = score;
+  }
+}
+
+TEST_F(test_available_list, test_score) {
+  using torrent::AvailableList;
+
+  auto sa = make_inet_address(0x0a000001, 6881);
+
+  torrent::PeerInfo fresh(sa.c_sockaddr());
+  torrent::PeerInfo connected(sa.c_sockaddr());
+  torrent::PeerInfo failed(sa.c_sockaddr());
+  torrent::PeerInfo corrupt(sa.c_sockaddr());
+
+  connected.set_last_connection(1000);
+  failed.set_failed_handshakes(2);
+  failed.set_last_handshake(1000);
+  corrupt.set_failed_counter(2);
+
+  auto tier = [](const torrent::PeerInfo* info, int source, uint32_t now) {
+    return AvailableList::score(info, source, now) >> 16;
+  };
+
+  ASSERT_GT(tier(&fresh, AvailableList::source_pex, 2000),
+            tier(&fresh, AvailableList::source_tracker, 2000));
+  ASSERT_GT(tier(&fresh, AvailableList::source_tracker, 2000),
+            tier(&fresh, AvailableList::source_unknown, 2000));
+  ASSERT_EQ(tier(&fresh, AvailableList::source_unknown, 2000),
+            tier(nullptr, AvailableList::source_unknown, 2000));
+
+  ASSERT_GT(tier(&connected, 0, 2000), tier(&fresh, 0, 2000));
+  ASSERT_LT(tier(&failed, 0, 2000), tier(&fresh, 0, 2000));
+  ASSERT_LT(tier(&corrupt, 0, 2000), tier(&fresh, 0, 2000));
+
+  // Still backing off a minute after the second failure.
+  ASSERT_LT(tier(&failed, 0, 1060), tier(&failed, 0, 2000));
+}
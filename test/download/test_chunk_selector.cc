@@ -0,0 +1,72 @@
+#include "download/chunk_selector.h"
+#include "globals.h"
+#include "protocol/peer_chunks.h"
+
+#include "test/helpers/fixture.h"
+
+class test_chunk_selector : public test_fixture {};
+
+namespace {
+
+struct test_download_data : public torrent::download_data {
+  using download_data::mutable_completed_bitfield;
+  using download_data::mutable_normal_priority;
+};
+
+} // namespace
+
+TEST_F(test_chunk_selector, test_deadline) {
+  test_download_data     data;
+  torrent::ChunkSelector selector(&data);
+  torrent::PeerChunks    peer_chunks;
+
+  data.mutable_completed_bitfield()->set_size_bits(16);
+  data.mutable_completed_bitfield()->allocate();
+  data.mutable_completed_bitfield()->unset_all();
+  data.mutable_normal_priority()->insert(0, 16);
+  selector.initialize(nullptr);
+
+  peer_chunks.bitfield()->set_size_bits(16);
+  peer_chunks.bitfield()->allocate();
+  peer_chunks.bitfield()->set_all();
+  peer_chunks.bitfield()->unset(2);
+
+  auto start = torrent::utils::timer::from_seconds(1000);
+
+  torrent::cachedTime = start;
+  selector.set_deadline(2, 4, 100);
+
+  ASSERT_TRUE(selector.is_deadline_enabled());
+  ASSERT_EQ(selector.deadline(1), torrent::utils::timer());
+  ASSERT_EQ(selector.deadline(2), start);
+  ASSERT_EQ(selector.deadline(5),
+            start + torrent::utils::timer::from_milliseconds(300));
+  ASSERT_EQ(selector.deadline(6), torrent::utils::timer());
+
+  // The peer doesn't have chunk 2.
+  ASSERT_EQ(selector.find_deadline(&peer_chunks), 3);
+  selector.using_index(3);
+  ASSERT_EQ(selector.find_deadline(&peer_chunks), 4);
+
+  // Chunks 3 and 4 complete 150ms and 50ms late, with the stalls
+  // overlapping.
+  torrent::cachedTime = start + torrent::utils::timer::from_milliseconds(250);
+
+  data.mutable_completed_bitfield()->set(3);
+  data.mutable_completed_bitfield()->set(4);
+  selector.received_deadline_chunk(3);
+  selector.received_deadline_chunk(4);
+  selector.received_deadline_chunk(5);
+
+  ASSERT_EQ(selector.deadline_misses(), 2);
+  ASSERT_EQ(selector.deadline_stall_usec(), 150000);
+
+  // Moving past chunk 2 counts it as missed, chunk 5 isn't due yet.
+  selector.set_deadline(6, 4, 100);
+  ASSERT_EQ(selector.deadline_misses(), 3);
+
+  selector.set_deadline(6, 0, 100);
+  ASSERT_FALSE(selector.is_deadline_enabled());
+
+  selector.cleanup();
+}
@@ -0,0 +1,109 @@
+#include <cstring>
+#include <vector>
+
+#include "download/connection_index.h"
+#include "torrent/exceptions.h"
+#include "torrent/utils/socket_address.h"
+
+#include "test/helpers/fixture.h"
+
+class test_connection_index : public test_fixture {};
+
+namespace {
+
+// The index never dereferences the peers.
+torrent::Peer*
+fake_peer(uintptr_t i) {
+  return reinterpret_cast<torrent::Peer*>((i + 1) * 64);
+}
+
+struct fake_connection {
+  torrent::Peer*                peer;
+  torrent::HashString           id;
+  torrent::utils::socket_address address;
+};
+
+std::vector<fake_connection>
+make_connections(uint32_t count) {
+  std::vector<fake_connection> connections(count);
+
+  for (uint32_t i = 0; i < count; i++) {
+    auto& c = connections[i];
+
+    c.peer = fake_peer(i);
+    std::fill(c.id.begin(), c.id.end(), 0);
+    std::memcpy(c.id.begin(), &i, sizeof(i));
+
+    c.address.sa_inet()->clear();
+    c.address.sa_inet()->set_address_h(0x0a000000 + i);
+    c.address.set_port(6881);
+  }
+
+  return connections;
+}
+
+} // namespace
+
+TEST_F(test_connection_index, test_basic) {
+  torrent::ConnectionIndex index;
+  auto                     connections = make_connections(3);
+
+  for (uint32_t i = 0; i < connections.size(); i++)
+    index.insert(connections[i].peer,
+                 connections[i].id,
+                 connections[i].address.c_sockaddr(),
+                 i);
+
+  ASSERT_EQ(index.size(), 3);
+  ASSERT_EQ(index.find(connections[1].id), connections[1].peer);
+  ASSERT_EQ(index.find(connections[2].address.c_sockaddr()),
+            connections[2].peer);
+  ASSERT_EQ(index.position(connections[2].peer), 2);
+
+  // Same address on another port is a different connection.
+  torrent::utils::socket_address other = connections[0].address;
+  other.set_port(6882);
+  ASSERT_EQ(index.find(other.c_sockaddr()), nullptr);
+
+  ASSERT_THROW(index.insert(connections[0].peer,
+                            connections[0].id,
+                            connections[0].address.c_sockaddr(),
+                            0),
+               torrent::internal_error);
+
+  index.erase(connections[1].peer);
+  index.set_position(connections[2].peer, 1);
+
+  ASSERT_EQ(index.find(connections[1].id), nullptr);
+  ASSERT_EQ(index.find(connections[1].address.c_sockaddr()), nullptr);
+  ASSERT_EQ(index.position(connections[1].peer),
+            torrent::ConnectionIndex::npos);
+  ASSERT_EQ(index.position(connections[2].peer), 1);
+
+  ASSERT_THROW(index.erase(connections[1].peer), torrent::internal_error);
+
+  index.clear();
+  ASSERT_EQ(index.size(), 0);
+  ASSERT_EQ(index.find(connections[0].id), nullptr);
+}
+
+TEST_F(test_connection_index, test_duplicate_keys) {
+  torrent::ConnectionIndex index;
+  auto                     connections = make_connections(2);
+
+  // Both connections share the id and address of the first.
+  index.insert(connections[0].peer,
+               connections[0].id,
+               connections[0].address.c_sockaddr(),
+               0);
+  index.insert(connections[1].peer,
+               connections[0].id,
+               connections[0].address.c_sockaddr(),
+               1);
+
+  index.erase(connections[0].peer);
+
+  ASSERT_EQ(index.find(connections[0].id), connections[1].peer);
+  ASSERT_EQ(index.find(connections[0].address.c_sockaddr()),
+            connections[1].peer);
+}
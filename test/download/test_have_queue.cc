@@ -0,0 +1,65 @@
+#include <cstring>
+
+#include "download/have_queue.h"
+
+#include "test/helpers/fixture.h"
+
+class test_have_queue : public test_fixture {};
+
+TEST_F(test_have_queue, test_push_back) {
+  torrent::HaveQueue queue;
+
+  ASSERT_TRUE(queue.empty());
+
+  queue.push_back(torrent::utils::timer(10), 1);
+  queue.push_back(torrent::utils::timer(10), 0x01020304);
+  queue.push_back(torrent::utils::timer(5), 3);
+
+  ASSERT_EQ(queue.size(), 3);
+
+  // Timestamps are kept strictly increasing.
+  ASSERT_EQ(queue.time_at(0), torrent::utils::timer(10));
+  ASSERT_EQ(queue.time_at(1), torrent::utils::timer(11));
+  ASSERT_EQ(queue.time_at(2), torrent::utils::timer(12));
+  ASSERT_EQ(queue.back_time(), torrent::utils::timer(12));
+
+  const char expected[] = { 0, 0, 0, 5, 4, 1, 2, 3, 4 };
+  ASSERT_EQ(std::memcmp(queue.message_at(1), expected, sizeof(expected)), 0);
+  ASSERT_EQ(queue.message_at(2) - queue.message_at(0),
+            2 * torrent::HaveQueue::message_size);
+}
+
+TEST_F(test_have_queue, test_find) {
+  torrent::HaveQueue queue;
+
+  queue.push_back(torrent::utils::timer(10), 1);
+  queue.push_back(torrent::utils::timer(20), 2);
+  queue.push_back(torrent::utils::timer(30), 3);
+
+  ASSERT_EQ(queue.find(torrent::utils::timer(0)), 0);
+  ASSERT_EQ(queue.find(torrent::utils::timer(10)), 0);
+  ASSERT_EQ(queue.find(torrent::utils::timer(11)), 1);
+  ASSERT_EQ(queue.find(torrent::utils::timer(30)), 2);
+  ASSERT_EQ(queue.find(torrent::utils::timer(31)), 3);
+}
+
+TEST_F(test_have_queue, test_prune) {
+  torrent::HaveQueue queue;
+
+  for (int i = 1; i <= 10; i++)
+    queue.push_back(torrent::utils::timer(i * 10), i);
+
+  queue.prune(torrent::utils::timer(20));
+  ASSERT_EQ(queue.size(), 8);
+  ASSERT_EQ(queue.time_at(0), torrent::utils::timer(30));
+  ASSERT_EQ(queue.find(torrent::utils::timer(35)), 1);
+  ASSERT_EQ(queue.message_at(0)[8], 3);
+
+  queue.prune(torrent::utils::timer(75));
+  ASSERT_EQ(queue.size(), 3);
+  ASSERT_EQ(queue.time_at(0), torrent::utils::timer(80));
+  ASSERT_EQ(queue.message_at(0)[8], 8);
+
+  queue.prune(torrent::utils::timer(100));
+  ASSERT_TRUE(queue.empty());
+}
@@ -0,0 +1,53 @@
+#include "net/data_buffer.h"
+
+#include "test/helpers/fixture.h"
+
+class test_data_buffer : public test_fixture {};
+
+TEST_F(test_data_buffer, test_basic) {
+  torrent::DataBuffer empty;
+
+  ASSERT_TRUE(empty.empty());
+  ASSERT_FALSE(empty.owned());
+  ASSERT_EQ(empty.length(), 0);
+
+  char*               data = new char[16];
+  torrent::DataBuffer buffer(data, data + 16);
+
+  ASSERT_FALSE(buffer.empty());
+  ASSERT_TRUE(buffer.owned());
+  ASSERT_EQ(buffer.data(), data);
+  ASSERT_EQ(buffer.length(), 16);
+
+  buffer.clear();
+  ASSERT_TRUE(buffer.empty());
+  ASSERT_EQ(buffer.length(), 0);
+}
+
+TEST_F(test_data_buffer, test_shared) {
+  char*               data = new char[16];
+  torrent::DataBuffer buffer(data, data + 16);
+  torrent::DataBuffer first  = buffer.clone();
+  torrent::DataBuffer second = buffer.clone();
+
+  ASSERT_FALSE(buffer.owned());
+  ASSERT_EQ(first.data(), data);
+  ASSERT_EQ(second.data(), data);
+
+  buffer.clear();
+  first.clear();
+
+  ASSERT_TRUE(second.owned());
+  ASSERT_EQ(second.data(), data);
+  ASSERT_EQ(second.length(), 16);
+}
+
+TEST_F(test_data_buffer, test_release) {
+  char*               data = new char[8];
+  torrent::DataBuffer buffer(data, data + 8);
+  torrent::DataBuffer released = buffer.release();
+
+  ASSERT_TRUE(buffer.empty());
+  ASSERT_TRUE(released.owned());
+  ASSERT_EQ(released.data(), data);
+}
@@ -0,0 +1,169 @@
+#include <arpa/inet.h>
+#include <cstdlib>
+#include <unistd.h>
+
+#include "torrent/connection_manager.h"
+#include "torrent/exceptions.h"
+#include "torrent/net/ip_filter.h"
+#include "torrent/net/socket_address.h"
+
+#include "test/helpers/fixture.h"
+
+class test_ip_filter : public test_fixture {};
+
+using torrent::ip_filter;
+
+static uint32_t
+inet(const char* address) {
+  in_addr addr;
+  inet_pton(AF_INET, address, &addr);
+  return ntohl(addr.s_addr);
+}
+
+static in6_addr
+inet6(const char* address) {
+  in6_addr addr;
+  inet_pton(AF_INET6, address, &addr);
+  return addr;
+}
+
+// Keeps the compiled buffer 8-byte aligned.
+struct compiled_filter {
+  compiled_filter(const std::string& data)
+    : buffer((data.size() + 7) / 8) {
+    std::memcpy(buffer.data(), data.data(), data.size());
+    size = data.size();
+  }
+
+  const char* data() const {
+    return reinterpret_cast<const char*>(buffer.data());
+  }
+
+  std::vector<uint64_t> buffer;
+  size_t                size;
+};
+
+TEST_F(test_ip_filter, test_lookup_v4) {
+  compiled_filter compiled(ip_filter::compile(
+    {
+      { inet("10.0.0.0"), inet("10.255.255.255"), 0 },
+      { inet("192.168.1.0"), inet("192.168.1.255"), 5 },
+      { inet("192.168.1.128"), inet("192.168.2.10"), 3 },
+      { inet("255.255.255.0"), inet("255.255.255.255"), 0 },
+      { inet("0.0.0.0"), inet("0.0.0.255"), 2 },
+    },
+    {}));
+
+  ip_filter filter;
+  ASSERT_TRUE(filter.open(compiled.data(), compiled.size));
+
+  ASSERT_EQ(filter.lookup_v4(inet("0.0.0.0")), 2);
+  ASSERT_EQ(filter.lookup_v4(inet("0.0.1.0")), 1);
+  ASSERT_EQ(filter.lookup_v4(inet("9.255.255.255")), 1);
+  ASSERT_EQ(filter.lookup_v4(inet("10.0.0.0")), 0);
+  ASSERT_EQ(filter.lookup_v4(inet("10.128.0.1")), 0);
+  ASSERT_EQ(filter.lookup_v4(inet("11.0.0.0")), 1);
+
+  // Overlapping ranges take the lowest value.
+  ASSERT_EQ(filter.lookup_v4(inet("192.168.1.127")), 5);
+  ASSERT_EQ(filter.lookup_v4(inet("192.168.1.128")), 3);
+  ASSERT_EQ(filter.lookup_v4(inet("192.168.2.10")), 3);
+  ASSERT_EQ(filter.lookup_v4(inet("192.168.2.11")), 1);
+
+  ASSERT_EQ(filter.lookup_v4(inet("255.255.254.255")), 1);
+  ASSERT_EQ(filter.lookup_v4(inet("255.255.255.255")), 0);
+
+  auto sa = torrent::sa_make_inet();
+  reinterpret_cast<sockaddr_in*>(sa.get())->sin_addr.s_addr =
+    htonl(inet("10.1.2.3"));
+  ASSERT_EQ(filter.lookup(sa.get()), 0);
+
+  auto mapped = torrent::sa_make_inet6();
+  reinterpret_cast<sockaddr_in6*>(mapped.get())->sin6_addr =
+    inet6("::ffff:192.168.1.1");
+  ASSERT_EQ(filter.lookup(mapped.get()), 5);
+}
+
+TEST_F(test_ip_filter, test_lookup_v6) {
+  compiled_filter compiled(ip_filter::compile(
+    {},
+    {
+      { inet6("2001:db8::"), inet6("2001:db8::ffff"), 0 },
+      { inet6("2001:db8::100"), inet6("2001:db9::"), 4 },
+      { inet6("ff00::"), inet6("ffff:ffff:ffff:ffff:ffff:ffff:ffff:ffff"), 0 },
+    },
+    7));
+
+  ip_filter filter;
+  ASSERT_TRUE(filter.open(compiled.data(), compiled.size));
+  ASSERT_EQ(filter.default_value(), 7);
+
+  ASSERT_EQ(filter.lookup_v6(inet6("::")), 7);
+  ASSERT_EQ(filter.lookup_v6(inet6("2001:db7:ffff::")), 7);
+  ASSERT_EQ(filter.lookup_v6(inet6("2001:db8::1")), 0);
+  ASSERT_EQ(filter.lookup_v6(inet6("2001:db8::1:0")), 4);
+  ASSERT_EQ(filter.lookup_v6(inet6("2001:db9::")), 4);
+  ASSERT_EQ(filter.lookup_v6(inet6("2001:db9::1")), 7);
+  ASSERT_EQ(filter.lookup_v6(inet6("ffff::1")), 0);
+  ASSERT_EQ(filter.lookup_v4(inet("1.2.3.4")), 7);
+
+  ASSERT_THROW(ip_filter::compile(
+                 {}, { { inet6("2001:db9::"), inet6("2001:db8::"), 0 } }),
+               torrent::input_error);
+}
+
+TEST_F(test_ip_filter, test_open_file) {
+  char path[] = "/tmp/libtorrent_ip_filter_XXXXXX";
+  int  fd     = mkstemp(path);
+
+  auto compiled =
+    ip_filter::compile({ { inet("10.0.0.0"), inet("10.0.0.255"), 0 } }, {});
+
+  ASSERT_EQ(write(fd, compiled.data(), compiled.size()), compiled.size());
+  close(fd);
+
+  ip_filter filter;
+  ASSERT_TRUE(filter.open_file(path));
+  ASSERT_EQ(filter.lookup_v4(inet("10.0.0.1")), 0);
+  ASSERT_EQ(filter.lookup_v4(inet("10.0.1.1")), 1);
+
+  filter.close();
+  ASSERT_EQ(filter.lookup_v4(inet("10.0.0.1")), 1);
+
+  unlink(path);
+
+  compiled_filter corrupt(compiled);
+  reinterpret_cast<char*>(corrupt.buffer.data())[corrupt.size - 1] ^= 1;
+  ASSERT_FALSE(filter.open(corrupt.data(), corrupt.size));
+  ASSERT_FALSE(filter.open(corrupt.data(), corrupt.size - 4));
+  ASSERT_FALSE(filter.is_open());
+}
+
+TEST_F(test_ip_filter, test_connection_manager) {
+  torrent::ConnectionManager cm;
+
+  compiled_filter compiled(
+    ip_filter::compile({ { inet("10.0.0.0"), inet("10.0.0.255"), 0 } }, {}));
+
+  auto filter = std::make_shared<ip_filter>();
+  ASSERT_TRUE(filter->open(compiled.data(), compiled.size));
+
+  auto sa = torrent::sa_make_inet();
+  reinterpret_cast<sockaddr_in*>(sa.get())->sin_addr.s_addr =
+    htonl(inet("10.0.0.1"));
+
+  ASSERT_EQ(cm.filter(sa.get()), 1);
+
+  cm.set_address_filter(filter);
+  ASSERT_EQ(cm.filter(sa.get()), 0);
+
+  // The slot is only asked about addresses the filter lets through.
+  int calls = 0;
+  cm.set_filter([&calls](const sockaddr*) { return ++calls; });
+  ASSERT_EQ(cm.filter(sa.get()), 0);
+  ASSERT_EQ(calls, 0);
+
+  cm.set_address_filter(nullptr);
+  ASSERT_EQ(cm.filter(sa.get()), 1);
+  ASSERT_EQ(calls, 1);
+}
@@ -0,0 +1,192 @@
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <netdb.h>
+
+#include "globals.h"
+#include "net/resolver.h"
+
+#include "test/helpers/fixture.h"
+
+class test_resolver : public test_fixture {};
+
+namespace {
+
+struct lookup_counter {
+  std::mutex              lock;
+  std::condition_variable cond;
+  bool                    has_work{ false };
+  std::atomic<int>        lookups{ 0 };
+  std::atomic<int>        error{ 0 };
+};
+
+void
+setup_resolver(torrent::Resolver* resolver, lookup_counter* counter) {
+  resolver->slot_has_work() = [counter]() {
+    std::lock_guard lk(counter->lock);
+    counter->has_work = true;
+    counter->cond.notify_all();
+  };
+
+  resolver->slot_lookup_host() = [counter](const char*,
+                                           int,
+                                           int,
+                                           torrent::utils::socket_address* sa) {
+    counter->lookups++;
+
+    if (counter->error != 0)
+      return counter->error.load();
+
+    sa->sa_inet()->clear();
+    sa->sa_inet()->set_address_c_str("10.0.0.1");
+    return 0;
+  };
+}
+
+// Wait for the workers and deliver results until no requests are pending.
+void
+wait_for_work(torrent::Resolver* resolver, lookup_counter* counter) {
+  std::unique_lock lk(counter->lock);
+
+  while (resolver->pending_size() != 0) {
+    counter->cond.wait(lk, [counter]() { return counter->has_work; });
+    counter->has_work = false;
+
+    lk.unlock();
+    resolver->work();
+    lk.lock();
+  }
+}
+
+} // namespace
+
+TEST_F(test_resolver, test_coalesce_and_cache) {
+  torrent::Resolver resolver;
+  lookup_counter    counter;
+  int               results = 0;
+
+  setup_resolver(&resolver, &counter);
+  torrent::cachedTime = torrent::utils::timer::from_seconds(1000);
+
+  auto slot = [&results](const sockaddr* sa, int err) {
+    ASSERT_NE(sa, nullptr);
+    ASSERT_EQ(err, 0);
+    ASSERT_EQ(torrent::utils::socket_address::cast_from(sa)->address_str(),
+              "10.0.0.1");
+    results++;
+  };
+
+  ASSERT_NE(resolver.resolve("example.com", PF_INET, SOCK_DGRAM, slot),
+            nullptr);
+  ASSERT_NE(resolver.resolve("example.com", PF_INET, SOCK_DGRAM, slot),
+            nullptr);
+  ASSERT_EQ(resolver.pending_size(), 1);
+
+  wait_for_work(&resolver, &counter);
+
+  ASSERT_EQ(results, 2);
+  ASSERT_EQ(counter.lookups, 1);
+  ASSERT_EQ(resolver.cache_size(), 1);
+
+  // Cached results are delivered synchronously.
+  ASSERT_EQ(resolver.resolve("example.com", PF_INET, SOCK_DGRAM, slot),
+            nullptr);
+  ASSERT_EQ(results, 3);
+  ASSERT_EQ(resolver.lookups(), 1);
+
+  // Other socket types are separate entries.
+  ASSERT_NE(resolver.resolve("example.com", PF_INET, SOCK_STREAM, slot),
+            nullptr);
+  wait_for_work(&resolver, &counter);
+  ASSERT_EQ(results, 4);
+  ASSERT_EQ(resolver.lookups(), 2);
+
+  torrent::cachedTime += torrent::utils::timer::from_seconds(resolver.ttl());
+
+  ASSERT_NE(resolver.resolve("example.com", PF_INET, SOCK_DGRAM, slot),
+            nullptr);
+  wait_for_work(&resolver, &counter);
+  ASSERT_EQ(results, 5);
+  ASSERT_EQ(resolver.lookups(), 3);
+}
+
+TEST_F(test_resolver, test_negative_cache) {
+  torrent::Resolver resolver;
+  lookup_counter    counter;
+  int               failed = 0;
+
+  setup_resolver(&resolver, &counter);
+  torrent::cachedTime = torrent::utils::timer::from_seconds(1000);
+  counter.error       = EAI_NONAME;
+
+  auto slot = [&failed](const sockaddr* sa, int err) {
+    ASSERT_EQ(sa, nullptr);
+    ASSERT_EQ(err, EAI_NONAME);
+    failed++;
+  };
+
+  ASSERT_NE(resolver.resolve("invalid", PF_UNSPEC, SOCK_DGRAM, slot), nullptr);
+  wait_for_work(&resolver, &counter);
+  ASSERT_EQ(failed, 1);
+
+  ASSERT_EQ(resolver.resolve("invalid", PF_UNSPEC, SOCK_DGRAM, slot), nullptr);
+  ASSERT_EQ(failed, 2);
+
+  torrent::cachedTime +=
+    torrent::utils::timer::from_seconds(resolver.negative_ttl());
+
+  ASSERT_NE(resolver.resolve("invalid", PF_UNSPEC, SOCK_DGRAM, slot), nullptr);
+  wait_for_work(&resolver, &counter);
+  ASSERT_EQ(failed, 3);
+  ASSERT_EQ(counter.lookups, 2);
+}
+
+TEST_F(test_resolver, test_blocked_slot) {
+  torrent::Resolver resolver;
+  lookup_counter    counter;
+  int               first  = 0;
+  int               second = 0;
+
+  setup_resolver(&resolver, &counter);
+  torrent::cachedTime = torrent::utils::timer::from_seconds(1000);
+
+  torrent::Resolver::result_slot* other = nullptr;
+
+  // A callback clearing another slot of the same request blocks it.
+  auto blocking = [&](const sockaddr*, int) {
+    first++;
+    *other = torrent::Resolver::result_slot();
+  };
+
+  ASSERT_NE(resolver.resolve("example.com", PF_INET, SOCK_DGRAM, blocking),
+            nullptr);
+
+  other = resolver.resolve(
+    "example.com", PF_INET, SOCK_DGRAM, [&](const sockaddr*, int) {
+      second++;
+    });
+  ASSERT_NE(other, nullptr);
+
+  wait_for_work(&resolver, &counter);
+
+  ASSERT_EQ(first, 1);
+  ASSERT_EQ(second, 0);
+}
+
+TEST_F(test_resolver, test_no_ttl) {
+  torrent::Resolver resolver;
+  lookup_counter    counter;
+
+  setup_resolver(&resolver, &counter);
+  resolver.set_ttl(0);
+
+  for (int i = 0; i < 2; i++) {
+    ASSERT_NE(resolver.resolve(
+                "example.com", PF_INET, SOCK_DGRAM, [](const sockaddr*, int) {}),
+              nullptr);
+    wait_for_work(&resolver, &counter);
+  }
+
+  ASSERT_EQ(resolver.cache_size(), 0);
+  ASSERT_EQ(counter.lookups, 2);
+}
@@ -0,0 +1,89 @@
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "net/socket_datagram.h"
+
+#include "test/helpers/fixture.h"
+
+class test_socket_datagram : public test_fixture {};
+
+namespace {
+
+class datagram_socket : public torrent::SocketDatagram {
+public:
+  datagram_socket() {
+    int fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+    ::fcntl(fd, F_SETFL, O_NONBLOCK);
+
+    sockaddr_in sa{};
+    sa.sin_family      = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    ::bind(fd, reinterpret_cast<sockaddr*>(&sa), sizeof(sa));
+    set_fd(torrent::SocketFd(fd));
+  }
+
+  ~datagram_socket() override {
+    get_fd().close();
+    get_fd().clear();
+  }
+
+  torrent::utils::socket_address local_address() {
+    torrent::utils::socket_address sa;
+    socklen_t                      length = sizeof(sa);
+
+    ::getsockname(get_fd().get_fd(), sa.c_sockaddr(), &length);
+    return sa;
+  }
+
+  void event_read() override {}
+  void event_write() override {}
+  void event_error() override {}
+};
+
+} // namespace
+
+TEST_F(test_socket_datagram, test_batch) {
+  datagram_socket sender;
+  datagram_socket receiver;
+
+  auto destination = receiver.local_address();
+
+  const char* messages[] = { "one", "two", "three" };
+  torrent::SocketDatagram::write_entry writes[3];
+
+  for (int i = 0; i < 3; i++)
+    writes[i] = { messages[i],
+                  static_cast<unsigned int>(std::strlen(messages[i])),
+                  &destination,
+                  0 };
+
+  sender.write_datagrams(writes, 3);
+
+  for (int i = 0; i < 3; i++)
+    ASSERT_EQ(writes[i].written, static_cast<int>(std::strlen(messages[i])));
+
+  char buffers[torrent::SocketDatagram::max_batch][64];
+  torrent::SocketDatagram::read_entry
+    reads[torrent::SocketDatagram::max_batch];
+
+  for (unsigned int i = 0; i < torrent::SocketDatagram::max_batch; i++) {
+    reads[i].buffer = buffers[i];
+    reads[i].length = sizeof(buffers[i]);
+  }
+
+  ASSERT_EQ(receiver.read_datagrams(reads, torrent::SocketDatagram::max_batch),
+            3);
+
+  for (int i = 0; i < 3; i++) {
+    ASSERT_EQ(std::string(buffers[i], reads[i].read), messages[i]);
+    ASSERT_EQ(reads[i].address.port(), sender.local_address().port());
+  }
+
+  // Drained socket.
+  ASSERT_EQ(receiver.read_datagrams(reads, torrent::SocketDatagram::max_batch),
+            -1);
+}
@@ -0,0 +1,74 @@
+#include "torrent/buildinfo.h"
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "net/socket_fd.h"
+#include "torrent/net/tcp_stats.h"
+
+#include "test/helpers/fixture.h"
+
+class test_socket_fd : public test_fixture {};
+
+namespace {
+
+// Returns a connected loopback TCP pair, blocking until accepted.
+std::pair<int, int>
+connect_pair() {
+  int listener = ::socket(AF_INET, SOCK_STREAM, 0);
+
+  sockaddr_in sa{};
+  sa.sin_family      = AF_INET;
+  sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t length   = sizeof(sa);
+
+  ::bind(listener, reinterpret_cast<sockaddr*>(&sa), sizeof(sa));
+  ::listen(listener, 1);
+  ::getsockname(listener, reinterpret_cast<sockaddr*>(&sa), &length);
+
+  int client = ::socket(AF_INET, SOCK_STREAM, 0);
+  ::connect(client, reinterpret_cast<sockaddr*>(&sa), sizeof(sa));
+
+  int server = ::accept(listener, nullptr, nullptr);
+  ::close(listener);
+
+  return { client, server };
+}
+
+} // namespace
+
+TEST_F(test_socket_fd, test_tcp_stats) {
+  auto fds = connect_pair();
+
+  torrent::SocketFd client(fds.first);
+  torrent::tcp_stats stats;
+
+#ifdef LT_HAVE_TCP_INFO
+  ASSERT_TRUE(client.get_tcp_stats(&stats));
+  ASSERT_NE(stats.rtt_usec, 0);
+  ASSERT_NE(stats.cwnd, 0);
+  ASSERT_NE(stats.mss, 0);
+  ASSERT_EQ(stats.sampled, 0);
+#else
+  ASSERT_FALSE(client.get_tcp_stats(&stats));
+#endif
+
+  ::close(fds.first);
+  ::close(fds.second);
+}
+
+TEST_F(test_socket_fd, test_notsent_lowat) {
+  auto fds = connect_pair();
+
+  torrent::SocketFd client(fds.first);
+
+#ifdef LT_HAVE_TCP_NOTSENT_LOWAT
+  ASSERT_TRUE(client.set_notsent_lowat(16 << 10));
+#else
+  ASSERT_FALSE(client.set_notsent_lowat(16 << 10));
+#endif
+
+  ::close(fds.first);
+  ::close(fds.second);
+}
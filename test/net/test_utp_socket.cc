@@ -0,0 +1,260 @@
+#include <cstring>
+#include <deque>
+#include <random>
+#include <string>
+
+#include "net/utp_socket.h"
+
+#include "test/helpers/fixture.h"
+
+class test_utp_socket : public test_fixture {};
+
+namespace {
+
+using torrent::UtpSocket;
+
+// One direction of an emulated path: a bottleneck serializing packets
+// at 'rate' bytes per second into an unbounded queue, followed by a
+// fixed propagation delay, dropping a share of the packets at random.
+struct utp_link {
+  struct entry {
+    uint64_t    arrival;
+    std::string data;
+  };
+
+  utp_link(uint64_t d, uint64_t r, double l) : delay(d), rate(r), loss(l) {}
+
+  uint64_t delay;
+  uint64_t rate;
+  double   loss;
+
+  uint64_t busy_until{ 0 };
+  uint64_t queued_time{ 0 };
+  uint64_t packets{ 0 };
+  uint64_t now{ 0 };
+
+  std::deque<entry>                      in_transit;
+  std::mt19937                           generator{ 4711 };
+  std::uniform_real_distribution<double> distribution{ 0.0, 1.0 };
+
+  void send(const char* data, unsigned int length) {
+    if (distribution(generator) < loss)
+      return;
+
+    uint64_t start = std::max(now, busy_until);
+    busy_until     = start + uint64_t(length) * 1000000 / rate;
+
+    queued_time += start - now;
+    packets++;
+
+    in_transit.push_back({ busy_until + delay, std::string(data, length) });
+  }
+
+  void deliver(UtpSocket* socket) {
+    while (!in_transit.empty() && in_transit.front().arrival <= now) {
+      auto packet = std::move(in_transit.front());
+      in_transit.pop_front();
+
+      UtpSocket::header h;
+      auto offset = UtpSocket::read_header(packet.data.data(),
+                                           packet.data.size(),
+                                           &h);
+      ASSERT_NE(offset, 0u);
+
+      if (socket->state() == UtpSocket::state_idle) {
+        ASSERT_EQ(h.type, UtpSocket::st_syn);
+        socket->accept(h, now);
+        continue;
+      }
+
+      socket->receive(h,
+                      packet.data.data() + offset,
+                      packet.data.size() - offset,
+                      now);
+    }
+  }
+};
+
+struct utp_path {
+  utp_path(uint64_t delay, uint64_t rate, double loss = 0.0)
+    : forward(delay, rate, loss), backward(delay, rate, loss) {
+    backward.generator.seed(1234);
+
+    sender.slot_send_packet() = [this](const char* data, unsigned int length) {
+      forward.send(data, length);
+    };
+    receiver.slot_send_packet() = [this](const char* data,
+                                         unsigned int length) {
+      backward.send(data, length);
+    };
+  }
+
+  // Advances the clock in 1ms steps, moving 'data' from the sender
+  // to the receiver until it has all arrived and both ends closed, or
+  // 'limit' has passed.
+  void transfer(const std::string& data, uint64_t limit) {
+    sender.connect(100, now);
+
+    size_t written = 0;
+
+    for (; now < limit; now += 1000) {
+      forward.now  = now;
+      backward.now = now;
+
+      forward.deliver(&receiver);
+      backward.deliver(&sender);
+
+      if (sender.is_connected() && written < data.size()) {
+        written += sender.write(data.data() + written, data.size() - written);
+
+        if (written == data.size())
+          sender.close();
+      }
+
+      if (receiver.read_size() != 0) {
+        received.append(receiver.read_data(), receiver.read_size());
+        receiver.consume(receiver.read_size());
+      }
+
+      if (receiver.is_eof())
+        receiver.close();
+
+      sender.flush(now);
+      receiver.flush(now);
+      sender.tick(now);
+      receiver.tick(now);
+
+      if (sender.is_closed() && receiver.is_closed())
+        break;
+    }
+  }
+
+  utp_link forward;
+  utp_link backward;
+
+  UtpSocket sender;
+  UtpSocket receiver;
+
+  uint64_t    now{ 1000000 };
+  std::string received;
+};
+
+std::string
+make_data(size_t length) {
+  std::string  data(length, '\0');
+  std::mt19937 generator(42);
+
+  for (auto& c : data)
+    c = static_cast<char>(generator());
+
+  return data;
+}
+
+} // namespace
+
+TEST_F(test_utp_socket, test_header) {
+  UtpSocket::header h{ UtpSocket::st_data, 0x1234, 0xdeadbeef, 0x01020304,
+                       0x100000,           0xfffe, 0x0001 };
+
+  char buffer[UtpSocket::header_size + 8];
+  UtpSocket::write_header(buffer, h);
+
+  UtpSocket::header r;
+  ASSERT_EQ(UtpSocket::read_header(buffer, UtpSocket::header_size, &r),
+            UtpSocket::header_size);
+  ASSERT_EQ(r.type, h.type);
+  ASSERT_EQ(r.connection_id, h.connection_id);
+  ASSERT_EQ(r.timestamp, h.timestamp);
+  ASSERT_EQ(r.timestamp_difference, h.timestamp_difference);
+  ASSERT_EQ(r.wnd_size, h.wnd_size);
+  ASSERT_EQ(r.seq_nr, h.seq_nr);
+  ASSERT_EQ(r.ack_nr, h.ack_nr);
+
+  ASSERT_EQ(UtpSocket::read_header(buffer, UtpSocket::header_size - 1, &r),
+            0u);
+
+  // A selective ack extension is skipped.
+  buffer[1]                          = 1;
+  buffer[UtpSocket::header_size]     = 0;
+  buffer[UtpSocket::header_size + 1] = 4;
+  ASSERT_EQ(UtpSocket::read_header(buffer, sizeof(buffer) - 2, &r),
+            UtpSocket::header_size + 6);
+  ASSERT_EQ(UtpSocket::read_header(buffer, UtpSocket::header_size + 5, &r),
+            0u);
+
+  buffer[0] = (UtpSocket::st_data << 4) | 2;
+  ASSERT_EQ(UtpSocket::read_header(buffer, sizeof(buffer), &r), 0u);
+}
+
+TEST_F(test_utp_socket, test_transfer) {
+  utp_path path(20000, 4 << 20);
+  auto     data = make_data(4 << 20);
+
+  path.transfer(data, 60 * 1000000);
+
+  ASSERT_TRUE(path.received == data);
+  ASSERT_TRUE(path.sender.is_closed());
+  ASSERT_TRUE(path.receiver.is_closed());
+  ASSERT_EQ(path.sender.error(), 0);
+  ASSERT_EQ(path.receiver.error(), 0);
+  ASSERT_EQ(path.sender.retransmits(), 0u);
+}
+
+TEST_F(test_utp_socket, test_loss) {
+  utp_path path(30000, 2 << 20, 0.02);
+  auto     data = make_data(2 << 20);
+
+  path.transfer(data, 300 * 1000000);
+
+  ASSERT_TRUE(path.received == data);
+  ASSERT_EQ(path.sender.error(), 0);
+  ASSERT_NE(path.sender.retransmits(), 0u);
+}
+
+TEST_F(test_utp_socket, test_connect_timeout) {
+  utp_path path(20000, 1 << 20, 1.0);
+
+  path.transfer(std::string("x"), 5 * 1000000);
+
+  ASSERT_TRUE(path.sender.is_closed());
+  ASSERT_EQ(path.sender.error(), ETIMEDOUT);
+}
+
+TEST_F(test_utp_socket, test_reset) {
+  utp_path path(20000, 1 << 20);
+
+  path.sender.connect(100, path.now);
+  path.now += 100000;
+  path.forward.now = path.now;
+  path.forward.deliver(&path.receiver);
+  ASSERT_TRUE(path.receiver.is_connected());
+
+  path.receiver.reset(path.now);
+  ASSERT_EQ(path.receiver.error(), ECONNABORTED);
+
+  path.now += 100000;
+  path.backward.now = path.now;
+  path.backward.deliver(&path.sender);
+
+  // The reset raced the SYN-ACK, so the sender connects and then
+  // sees the reset.
+  ASSERT_TRUE(path.sender.is_closed());
+  ASSERT_EQ(path.sender.error(), ECONNRESET);
+}
+
+TEST_F(test_utp_socket, test_ledbat_delay) {
+  // A 1 MiB/s bottleneck with an unbounded queue; a loss based
+  // sender would fill it without limit.
+  utp_path path(25000, 1 << 20);
+  auto     data = make_data(12 << 20);
+
+  path.transfer(data, 10 * 1000000);
+
+  uint64_t delivered = path.received.size();
+  uint64_t average   = path.forward.queued_time / path.forward.packets;
+
+  ASSERT_GT(delivered, 7u << 20);
+  ASSERT_LT(average, 2 * UtpSocket::target_delay);
+  ASSERT_LT(path.sender.queue_delay(), 2 * UtpSocket::target_delay);
+  ASSERT_GT(path.sender.rtt_usec(), 50000u);
+}
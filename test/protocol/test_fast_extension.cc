@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cstring>
+#include <netinet/in.h>
+#include <string>
+#include <vector>
+
+#include "protocol/fast_extension.h"
+#include "protocol/protocol_base.h"
+#include "torrent/bitfield.h"
+
+#include "test/helpers/fixture.h"
+
+class test_fast_extension : public test_fixture {};
+
+namespace {
+
+sockaddr_in
+make_inet(const char* address) {
+  sockaddr_in sa{};
+  sa.sin_family = AF_INET;
+  inet_pton(AF_INET, address, &sa.sin_addr);
+  return sa;
+}
+
+} // namespace
+
+TEST_F(test_fast_extension, test_allowed_fast_set) {
+  // The example given in BEP 6.
+  auto sa   = make_inet("80.4.4.200");
+  auto hash = std::string(20, '\xaa');
+
+  auto seven = torrent::allowed_fast_set(
+    reinterpret_cast<sockaddr*>(&sa), hash.data(), 1313, 7);
+  auto nine = torrent::allowed_fast_set(
+    reinterpret_cast<sockaddr*>(&sa), hash.data(), 1313, 9);
+
+  ASSERT_EQ(seven,
+            (std::vector<uint32_t>{ 1059, 431, 808, 1217, 287, 376, 1188 }));
+  ASSERT_EQ(nine,
+            (std::vector<uint32_t>{
+              1059, 431, 808, 1217, 287, 376, 1188, 353, 508 }));
+
+  // Only the /24 network counts.
+  auto neighbour = make_inet("80.4.4.1");
+  ASSERT_EQ(torrent::allowed_fast_set(
+              reinterpret_cast<sockaddr*>(&neighbour), hash.data(), 1313, 9),
+            nine);
+
+  sockaddr_in6 mapped{};
+  mapped.sin6_family           = AF_INET6;
+  mapped.sin6_addr.s6_addr[10] = 0xff;
+  mapped.sin6_addr.s6_addr[11] = 0xff;
+  std::memcpy(mapped.sin6_addr.s6_addr + 12, &sa.sin_addr, 4);
+  ASSERT_EQ(torrent::allowed_fast_set(
+              reinterpret_cast<sockaddr*>(&mapped), hash.data(), 1313, 9),
+            nine);
+
+  sockaddr_in6 sin6{};
+  sin6.sin6_family = AF_INET6;
+  inet_pton(AF_INET6, "2001:db8::1", &sin6.sin6_addr);
+  ASSERT_TRUE(torrent::allowed_fast_set(
+                reinterpret_cast<sockaddr*>(&sin6), hash.data(), 1313, 9)
+                .empty());
+
+  // Small torrents get every chunk, once.
+  auto all = torrent::allowed_fast_set(
+    reinterpret_cast<sockaddr*>(&sa), hash.data(), 3, 10);
+  std::sort(all.begin(), all.end());
+  ASSERT_EQ(all, (std::vector<uint32_t>{ 0, 1, 2 }));
+
+  ASSERT_TRUE(torrent::allowed_fast_set(
+                reinterpret_cast<sockaddr*>(&sa), hash.data(), 0, 10)
+                .empty());
+}
+
+TEST_F(test_fast_extension, test_messages) {
+  torrent::ProtocolBase protocol;
+  auto                  buffer = protocol.buffer();
+
+  protocol.write_have_all(true);
+  protocol.write_have_all(false);
+  protocol.write_suggest(7);
+  protocol.write_reject(torrent::Piece(3, 16384, 16384));
+  protocol.write_allowed_fast(9);
+
+  ASSERT_EQ(buffer->remaining(),
+            2 * torrent::ProtocolBase::sizeof_have_all +
+              torrent::ProtocolBase::sizeof_suggest +
+              torrent::ProtocolBase::sizeof_reject +
+              torrent::ProtocolBase::sizeof_allowed_fast);
+
+  ASSERT_EQ(buffer->read_32(), 1u);
+  ASSERT_EQ(buffer->read_8(), torrent::ProtocolBase::HAVE_ALL);
+  ASSERT_EQ(buffer->read_32(), 1u);
+  ASSERT_EQ(buffer->read_8(), torrent::ProtocolBase::HAVE_NONE);
+
+  ASSERT_EQ(buffer->read_32(), 5u);
+  ASSERT_EQ(buffer->read_8(), 0x0d);
+  ASSERT_EQ(buffer->read_32(), 7u);
+
+  ASSERT_EQ(buffer->read_32(), 13u);
+  ASSERT_EQ(buffer->read_8(), 0x10);
+  ASSERT_TRUE(protocol.can_read_reject_body());
+  ASSERT_EQ(protocol.read_request(), torrent::Piece(3, 16384, 16384));
+
+  ASSERT_EQ(buffer->read_32(), 5u);
+  ASSERT_EQ(buffer->read_8(), 0x11);
+  ASSERT_EQ(buffer->read_32(), 9u);
+
+  ASSERT_EQ(protocol.last_command(), torrent::ProtocolBase::ALLOWED_FAST);
+}
+
+TEST_F(test_fast_extension, test_shared_bitfield) {
+  torrent::Bitfield seed;
+  seed.set_size_bits(20);
+  seed.allocate();
+  seed.set_all();
+
+  torrent::Bitfield peer;
+  peer.share(seed);
+
+  ASSERT_TRUE(peer.is_shared());
+  ASSERT_TRUE(peer.is_all_set());
+  ASSERT_EQ(peer.begin(), seed.begin());
+
+  // Handshakes hand their bitfield to the connection by swapping.
+  torrent::Bitfield connection;
+  connection.swap(peer);
+
+  ASSERT_TRUE(connection.is_shared());
+  ASSERT_FALSE(peer.is_shared());
+  ASSERT_TRUE(peer.empty());
+
+  connection.clear();
+
+  ASSERT_FALSE(connection.is_shared());
+  ASSERT_TRUE(connection.empty());
+  ASSERT_FALSE(seed.empty());
+  ASSERT_TRUE(seed.get(19));
+
+  // Copies of a shared bitfield own their data.
+  peer.share(seed);
+  connection.copy(peer);
+
+  ASSERT_FALSE(connection.is_shared());
+  ASSERT_NE(connection.begin(), seed.begin());
+  ASSERT_TRUE(connection.is_all_set());
+}
@@ -1,4 +1,5 @@
 #include <gtest/gtest.h>
+#include <unistd.h>
 
 #include "download/delegator.h"
 #include "protocol/peer_chunks.h"
@@ -140,6 +141,34 @@ TEST_F(TestRequestList, test_basic) {
   CLEANUP_ALL();
 }
 
+TEST_F(TestRequestList, test_rtt_pipe_size) {
+  SETUP_ALL(basic);
+
+  const torrent::Piece* piece = request_list->delegate();
+
+  usleep(5000);
+
+  ASSERT_TRUE(request_list->downloading(*piece));
+  ASSERT_GE(request_list->rtt_usec(), 5000);
+
+  request_list->transfer()->adjust_position(piece->length());
+  request_list->finished();
+
+  // At 100 MiB/s four times the bandwidth-delay product of a 5 ms
+  // round trip is over 130 blocks.
+  delegator->set_pipe_bounds(2, 20);
+  ASSERT_EQ(request_list->calculate_pipe_size(100 << 20), 20);
+
+  // Slow peers keep the minimum in flight.
+  delegator->set_pipe_bounds(16, 256);
+  ASSERT_EQ(request_list->calculate_pipe_size(1 << 10), 16);
+
+  delegator->set_pipe_bounds(2, 0);
+  ASSERT_EQ(request_list->calculate_pipe_size(100 << 20), 102400 / 5 + 18);
+
+  CLEANUP_ALL();
+}
+
 TEST_F(TestRequestList, test_single_request) {
   SETUP_ALL(basic);
 
@@ -256,3 +285,124 @@ TEST_F(TestRequestList, test_choke_unchoke_transfer) {
   CLEAR_TRANSFERS();
   CLEANUP_ALL();
 }
+
+TEST_F(TestRequestList, test_rejected) {
+  SETUP_ALL_WITH_3(basic);
+  VERIFY_QUEUE_SIZES(3, 0, 0, 0);
+  ASSERT_EQ(peer_info->transfer_counter(), 3);
+
+  request_list->rejected(*piece_2);
+  VERIFY_QUEUE_SIZES(2, 0, 0, 0);
+  ASSERT_EQ(peer_info->transfer_counter(), 2);
+
+  // Unknown and repeated rejects are ignored.
+  request_list->rejected(torrent::Piece(1000, 0, 1 << 10));
+  VERIFY_QUEUE_SIZES(2, 0, 0, 0);
+
+  // Rejects also apply to requests made before being choked.
+  request_list->choked();
+  request_list->rejected(*piece_3);
+  VERIFY_QUEUE_SIZES(0, 0, 0, 1);
+
+  ASSERT_TRUE(request_list->downloading(*piece_1));
+  request_list->transfer()->adjust_position(piece_1->length());
+  request_list->finished();
+
+  VERIFY_QUEUE_SIZES(0, 0, 0, 0);
+
+  CLEAR_TRANSFERS();
+  CLEANUP_ALL();
+}
+
+//
+// Deadline tests:
+//
+
+static uint32_t
+deadline_find_peer_chunk(torrent::PeerChunks*, bool) {
+  static const uint32_t indices[] = { 7, 0, 1, 2, 3 };
+  static int            next      = 0;
+
+  return indices[next++];
+}
+
+static torrent::PeerChunks*
+create_deadline_peer_chunks(torrent::PeerInfo* peer_info) {
+  auto peer_chunks = new torrent::PeerChunks;
+
+  peer_chunks->set_peer_info(peer_info);
+  peer_chunks->bitfield()->set_size_bits(16);
+  peer_chunks->bitfield()->allocate();
+  peer_chunks->bitfield()->set_all();
+
+  return peer_chunks;
+}
+
+TEST_F(TestRequestList, test_deadline) {
+  SETUP_ALL(basic);
+
+  peer_chunks->bitfield()->set_size_bits(16);
+  peer_chunks->bitfield()->allocate();
+  peer_chunks->bitfield()->set_all();
+
+  torrent::PeerInfo slow_info(peer_info_address.c_sockaddr());
+  torrent::PeerInfo other_info(peer_info_address.c_sockaddr());
+
+  torrent::PeerChunks* slow_chunks  = create_deadline_peer_chunks(&slow_info);
+  torrent::PeerChunks* other_chunks = create_deadline_peer_chunks(&other_info);
+
+  torrent::RequestList slow_list;
+  torrent::RequestList other_list;
+  slow_list.set_delegator(delegator);
+  slow_list.set_peer_chunks(slow_chunks);
+  other_list.set_delegator(delegator);
+  other_list.set_peer_chunks(other_chunks);
+
+  // Chunks 5 to 7 are in the read-ahead window.
+  delegator->slot_chunk_find() = &deadline_find_peer_chunk;
+  delegator->slot_chunk_deadline() = [](uint32_t index) {
+    if (index < 5 || index > 7)
+      return torrent::utils::timer();
+
+    return torrent::utils::timer::from_seconds(2000 + index);
+  };
+  delegator->slot_chunk_find_deadline() = [delegator](torrent::PeerChunks*) {
+    for (uint32_t index = 5; index <= 7; index++)
+      if (delegator->transfer_list()->find(index) ==
+          delegator->transfer_list()->end())
+        return index;
+
+    return ~uint32_t();
+  };
+  delegator->slot_peer_fast() = [slow_chunks](torrent::PeerChunks* pc) {
+    return pc != slow_chunks;
+  };
+  delegator->set_deadline_enabled(true);
+
+  ASSERT_EQ(request_list->delegate()->index(), 5);
+  ASSERT_EQ(request_list->delegate()->index(), 6);
+
+  // Slow peers don't start pieces with a deadline.
+  ASSERT_EQ(slow_list.delegate()->index(), 0);
+
+  // Nothing has timed out yet, so the next deadline chunk is started.
+  ASSERT_EQ(other_list.delegate()->index(), 7);
+
+  // Blocks that got no response in time are requested again, earliest
+  // deadline first.
+  SET_CACHED_TIME(3);
+  ASSERT_EQ(other_list.delegate()->index(), 5);
+  ASSERT_EQ(other_list.delegate()->index(), 6);
+  ASSERT_EQ(slow_list.delegate()->index(), 1);
+
+  request_list->clear();
+  slow_list.clear();
+  other_list.clear();
+
+  CLEAR_TRANSFERS();
+
+  delete slow_chunks;
+  delete other_chunks;
+
+  CLEANUP_ALL();
+}
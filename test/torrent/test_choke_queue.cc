@@ -0,0 +1,146 @@
+#include <algorithm>
+#include <vector>
+
+#include "torrent/download/choke_queue.h"
+#include "torrent/utils/random.h"
+
+#include "test/helpers/fixture.h"
+
+namespace torrent {
+
+void choke_select_highest(choke_queue::iterator first,
+                          choke_queue::iterator last,
+                          uint32_t              count);
+
+void choke_manager_allocate_slots(choke_queue::iterator     first,
+                                  choke_queue::iterator     last,
+                                  uint32_t                  max,
+                                  uint32_t*                 weights,
+                                  choke_queue::target_type* target);
+
+} // namespace torrent
+
+class test_choke_queue : public test_fixture {};
+
+using connection_list = torrent::choke_queue::container_type;
+
+// Synthetic peers with random weights spread over all orders, the
+// connection pointers are never dereferenced.
+static connection_list
+synthetic_connections(unsigned int size) {
+  connection_list connections;
+  connections.reserve(size);
+
+  for (unsigned int i = 0; i < size; i++)
+    connections.emplace_back(
+      nullptr,
+      torrent::random_uniform_uint32(0, 3) * torrent::choke_queue::order_base +
+        torrent::random_uniform_uint32(0, (1 << 20) - 1));
+
+  return connections;
+}
+
+static std::vector<uint32_t>
+weights_of(connection_list::iterator first, connection_list::iterator last) {
+  std::vector<uint32_t> weights;
+
+  for (; first != last; first++)
+    weights.push_back(first->weight);
+
+  std::sort(weights.begin(), weights.end());
+  return weights;
+}
+
+TEST_F(test_choke_queue, test_select_highest) {
+  for (unsigned int count : { 0u, 1u, 10u, 999u, 1000u, 2000u }) {
+    auto connections = synthetic_connections(1000);
+    auto sorted      = weights_of(connections.begin(), connections.end());
+
+    torrent::choke_select_highest(
+      connections.begin(), connections.end(), count);
+
+    auto selected = std::min<uint32_t>(count, connections.size());
+    auto tail     = weights_of(connections.end() - selected, connections.end());
+
+    ASSERT_TRUE(std::equal(tail.begin(), tail.end(), sorted.end() - selected));
+  }
+}
+
+TEST_F(test_choke_queue, test_allocate_slots_unsorted) {
+  uint32_t weights[torrent::choke_queue::order_max_size] = { 1, 3, 6, 9 };
+
+  auto connections = synthetic_connections(1000);
+
+  torrent::choke_queue::target_type
+    target[torrent::choke_queue::order_max_size + 1];
+
+  torrent::choke_manager_allocate_slots(
+    connections.begin(), connections.end(), 100, weights, target);
+
+  ASSERT_TRUE(target[0].second == connections.begin());
+  ASSERT_TRUE(target[torrent::choke_queue::order_max_size].second ==
+              connections.end());
+
+  uint32_t total = 0;
+
+  for (uint32_t i = 0; i < torrent::choke_queue::order_max_size; i++) {
+    ASSERT_TRUE(std::all_of(
+      target[i].second, target[i + 1].second, [i](auto& v) {
+        return v.weight / torrent::choke_queue::order_base == i;
+      }));
+    ASSERT_LE(target[i].first,
+              (uint32_t)std::distance(target[i].second, target[i + 1].second));
+
+    total += target[i].first;
+  }
+
+  ASSERT_EQ(total, 100);
+}
+
+// Stand-in for a choke cycle over 100 groups with 200 peers each,
+// checking the linear selection picks the same peers a full sort of
+// every group and of the merged candidates would.
+TEST_F(test_choke_queue, test_synthetic_cycle) {
+  const unsigned int groups = 100;
+  const unsigned int peers  = 200;
+  const unsigned int slots  = 4;
+
+  connection_list candidates;
+  connection_list reference;
+
+  for (unsigned int i = 0; i < groups; i++) {
+    auto group = synthetic_connections(peers);
+    auto copy  = group;
+
+    torrent::choke_select_highest(group.begin(), group.end(), slots);
+    candidates.insert(candidates.end(), group.end() - slots, group.end());
+
+    std::sort(copy.begin(), copy.end(), [](auto& a, auto& b) {
+      return a.weight < b.weight;
+    });
+    reference.insert(reference.end(), copy.end() - slots, copy.end());
+  }
+
+  ASSERT_EQ(weights_of(candidates.begin(), candidates.end()),
+            weights_of(reference.begin(), reference.end()));
+
+  uint32_t weights[torrent::choke_queue::order_max_size] = { 1, 1, 1, 1 };
+
+  torrent::choke_queue::target_type
+    target[torrent::choke_queue::order_max_size + 1];
+
+  torrent::choke_manager_allocate_slots(
+    candidates.begin(), candidates.end(), 50, weights, target);
+
+  for (uint32_t i = 0; i < torrent::choke_queue::order_max_size; i++) {
+    auto first = target[i].second;
+    auto last  = target[i + 1].second;
+    auto count = target[i].first;
+    auto order = weights_of(first, last);
+
+    torrent::choke_select_highest(first, last, count);
+
+    auto picked = weights_of(last - count, last);
+    ASSERT_TRUE(std::equal(picked.begin(), picked.end(), order.end() - count));
+  }
+}
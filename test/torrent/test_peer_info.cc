@@ -0,0 +1,185 @@
+#include <algorithm>
+#include <memory>
+#include <set>
+#include <vector>
+
+#include "globals.h"
+#include "manager.h"
+#include "torrent/peer/peer_info.h"
+#include "torrent/peer/peer_list.h"
+#include "torrent/utils/socket_address.h"
+
+#include "test/helpers/fixture.h"
+
+class test_peer_info : public test_fixture {};
+
+// Inserting addresses retrieves the client info through the manager.
+class test_peer_list : public test_fixture {
+public:
+  void SetUp() override {
+    test_fixture::SetUp();
+
+    torrent::cachedTime = torrent::utils::timer::from_seconds(100000);
+    torrent::manager    = new torrent::Manager;
+  }
+
+  void TearDown() override {
+    delete torrent::manager;
+    torrent::manager = nullptr;
+    test_fixture::TearDown();
+  }
+};
+
+static torrent::utils::socket_address
+make_inet_address(uint32_t addr, uint16_t port) {
+  torrent::utils::socket_address sa;
+  sa.sa_inet()->clear();
+  sa.sa_inet()->set_address_h(addr);
+  sa.sa_inet()->set_port(port);
+
+  return sa;
+}
+
+TEST_F(test_peer_info, test_address) {
+  auto sa = make_inet_address(0x0a000001, 6881);
+
+  torrent::utils::socket_address sa6;
+  sa6.sa_inet6()->clear();
+  sa6.sa_inet6()->set_port(6882);
+
+  auto peer4 = std::make_unique<torrent::PeerInfo>(sa.c_sockaddr());
+  auto peer6 = std::make_unique<torrent::PeerInfo>(sa6.c_sockaddr());
+
+  auto address4 =
+    torrent::utils::socket_address::cast_from(peer4->socket_address());
+  auto address6 =
+    torrent::utils::socket_address::cast_from(peer6->socket_address());
+
+  ASSERT_EQ(*address4, sa);
+  ASSERT_EQ(address4->port(), 6881);
+  ASSERT_EQ(address6->family(), torrent::utils::socket_address::af_inet6);
+  ASSERT_EQ(address6->port(), 6882);
+}
+
+// Peers that never got through a handshake share zeroed connection
+// details.
+TEST_F(test_peer_info, test_empty_details) {
+  auto sa = make_inet_address(0x0a000001, 6881);
+
+  auto peer1 = std::make_unique<torrent::PeerInfo>(sa.c_sockaddr());
+  auto peer2 = std::make_unique<torrent::PeerInfo>(sa.c_sockaddr());
+
+  ASSERT_TRUE(std::all_of(
+    peer1->id().begin(), peer1->id().end(), [](char c) { return c == 0; }));
+  ASSERT_EQ(peer1->id_hex()[0], '\0');
+  ASSERT_EQ(peer1->tcp().sampled, 0);
+  ASSERT_EQ(peer1->tcp().rtt_usec, 0);
+  ASSERT_EQ(&peer1->id(), &peer2->id());
+}
+
+// Allocate more than a slab worth, then free and reallocate out of
+// order.
+TEST_F(test_peer_info, test_pool) {
+  std::vector<torrent::PeerInfo*> peers;
+
+  for (uint32_t i = 0; i < 3000; i++) {
+    auto sa = make_inet_address(0x0a000000 + i, 6881);
+    peers.push_back(new torrent::PeerInfo(sa.c_sockaddr()));
+  }
+
+  std::vector<torrent::PeerInfo*> sorted = peers;
+  std::sort(sorted.begin(), sorted.end());
+
+  ASSERT_EQ(std::adjacent_find(sorted.begin(), sorted.end()), sorted.end());
+
+  for (uint32_t i = 0; i < peers.size(); i++) {
+    auto address =
+      torrent::utils::socket_address::cast_from(peers[i]->socket_address());
+
+    ASSERT_EQ(address->sa_inet()->address_h(), 0x0a000000 + i);
+  }
+
+  for (uint32_t i = 0; i < peers.size(); i += 2) {
+    delete peers[i];
+    peers[i] = nullptr;
+  }
+
+  for (uint32_t i = 0; i < peers.size(); i += 2) {
+    auto sa  = make_inet_address(0x0b000000 + i, 6881);
+    peers[i] = new torrent::PeerInfo(sa.c_sockaddr());
+  }
+
+  for (uint32_t i = 0; i < peers.size(); i++) {
+    auto address =
+      torrent::utils::socket_address::cast_from(peers[i]->socket_address());
+
+    ASSERT_EQ(address->sa_inet()->address_h(),
+              (i % 2 == 0 ? 0x0b000000 : 0x0a000000) + i);
+  }
+
+  for (auto peer : peers)
+    delete peer;
+}
+
+TEST_F(test_peer_info, test_empty_peer_list) {
+  torrent::PeerList list;
+
+  ASSERT_TRUE(list.empty());
+  ASSERT_EQ(list.size(), 0);
+  ASSERT_EQ(list.begin(), list.end());
+  ASSERT_EQ(list.cull_peers(torrent::PeerList::cull_old), 0);
+}
+
+// Enough peers to collide and grow the table several times, then cull
+// two thirds of them, emptying slots in the middle of probe chains.
+TEST_F(test_peer_list, test_cull_rehash) {
+  torrent::PeerList               list;
+  std::set<torrent::PeerInfo*>    survivors;
+  std::vector<torrent::PeerInfo*> peers;
+
+  for (uint32_t i = 0; i < 3000; i++) {
+    auto sa   = make_inet_address(0x0a000000 + i, 6881);
+    auto peer = list.insert_address(sa.c_sockaddr(), 0);
+
+    ASSERT_NE(peer, nullptr);
+    peers.push_back(peer);
+  }
+
+  ASSERT_EQ(list.size(), 3000);
+
+  // The same address on another port is a duplicate.
+  auto duplicate = make_inet_address(0x0a000000 + 1234, 6882);
+  ASSERT_EQ(list.insert_address(duplicate.c_sockaddr(), 0), nullptr);
+  ASSERT_EQ(list.size(), 3000);
+
+  // Peers that connected recently are kept.
+  for (uint32_t i = 0; i < peers.size(); i += 3) {
+    peers[i]->set_last_connection(torrent::cachedTime.seconds());
+    survivors.insert(peers[i]);
+  }
+
+  ASSERT_EQ(list.cull_peers(torrent::PeerList::cull_old), 2000);
+  ASSERT_EQ(list.size(), survivors.size());
+
+  std::set<torrent::PeerInfo*> found;
+
+  for (const auto& [key, peer] : list)
+    found.insert(peer);
+
+  ASSERT_EQ(std::distance(list.begin(), list.end()), list.size());
+  ASSERT_TRUE(found == survivors);
+
+  // Survivors are still found under their address, while culled
+  // addresses can be inserted again.
+  for (uint32_t i = 0; i < peers.size(); i++) {
+    auto sa   = make_inet_address(0x0a000000 + i, 6881);
+    auto peer = list.insert_address(sa.c_sockaddr(), 0);
+
+    if (i % 3 == 0)
+      ASSERT_EQ(peer, nullptr);
+    else
+      ASSERT_NE(peer, nullptr);
+  }
+
+  ASSERT_EQ(list.size(), 3000);
+}
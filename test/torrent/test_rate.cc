@@ -0,0 +1,113 @@
+#include <deque>
+
+#include "globals.h"
+#include "torrent/rate.h"
+#include "torrent/utils/random.h"
+
+#include "test/helpers/fixture.h"
+
+class test_rate : public test_fixture {};
+
+namespace {
+
+// The previous deque based implementation, kept as a reference.
+class deque_rate {
+public:
+  deque_rate(int32_t span)
+    : m_span(span) {}
+
+  uint64_t rate() {
+    discard_old();
+    return m_current / m_span;
+  }
+
+  void insert(uint64_t bytes) {
+    discard_old();
+
+    if (m_container.empty() ||
+        m_container.front().first != torrent::cachedTime.seconds())
+      m_container.emplace_front(torrent::cachedTime.seconds(), bytes);
+    else
+      m_container.front().second += bytes;
+
+    m_current += bytes;
+  }
+
+private:
+  void discard_old() {
+    while (!m_container.empty() &&
+           m_container.back().first <
+             torrent::cachedTime.seconds() - m_span) {
+      m_current -= m_container.back().second;
+      m_container.pop_back();
+    }
+  }
+
+  std::deque<std::pair<int32_t, uint64_t>> m_container;
+
+  uint64_t m_current{ 0 };
+  int32_t  m_span;
+};
+
+} // namespace
+
+TEST_F(test_rate, test_span) {
+  torrent::cachedTime = torrent::utils::timer::from_seconds(1000);
+
+  torrent::Rate rate(30);
+
+  rate.insert(3000);
+  ASSERT_EQ(rate.rate(), 100);
+  ASSERT_EQ(rate.total(), 3000);
+
+  torrent::cachedTime += torrent::utils::timer::from_seconds(30);
+  ASSERT_EQ(rate.rate(), 100);
+
+  torrent::cachedTime += torrent::utils::timer::from_seconds(1);
+  ASSERT_EQ(rate.rate(), 0);
+  ASSERT_EQ(rate.total(), 3000);
+
+  rate.insert(300);
+  rate.reset_rate();
+  ASSERT_EQ(rate.rate(), 0);
+  ASSERT_EQ(rate.total(), 3300);
+}
+
+TEST_F(test_rate, test_bucket_width) {
+  ASSERT_EQ(torrent::Rate(30).bucket_width(), 1);
+  ASSERT_EQ(torrent::Rate(60).bucket_width(), 2);
+  ASSERT_EQ(torrent::Rate(600).bucket_width(), 19);
+
+  torrent::cachedTime = torrent::utils::timer::from_seconds(1000);
+
+  torrent::Rate rate(600);
+
+  for (int i = 0; i < 1200; i++) {
+    rate.insert(600);
+    torrent::cachedTime += torrent::utils::timer::from_seconds(1);
+  }
+
+  // Coarser buckets expire up to one bucket width late.
+  ASSERT_GE(rate.rate(), 600);
+  ASSERT_LE(rate.rate(), 600 + 19);
+}
+
+TEST_F(test_rate, test_matches_deque) {
+  torrent::cachedTime = torrent::utils::timer::from_seconds(1000);
+
+  torrent::Rate rate(30);
+  deque_rate    reference(30);
+
+  for (int i = 0; i < 10000; i++) {
+    auto bytes = torrent::random_uniform_uint32(0, 1 << 16);
+
+    rate.insert(bytes);
+    reference.insert(bytes);
+
+    if (torrent::random_uniform_uint32(0, 3) == 0)
+      torrent::cachedTime += torrent::utils::timer::from_seconds(
+        torrent::random_uniform_uint32(0, 40));
+
+    ASSERT_EQ(rate.rate(), reference.rate());
+  }
+}
@@ -0,0 +1,202 @@
+#include <cstdlib>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "torrent/object.h"
+#include "torrent/object_stream.h"
+#include "torrent/utils/resume_binary.h"
+
+#include "test/helpers/fixture.h"
+
+class test_resume_binary : public test_fixture {};
+
+static torrent::Object
+create_resume(unsigned int files, unsigned int peers) {
+  torrent::Object resume = torrent::Object::create_map();
+
+  resume.insert_key("bitfield", std::string(128, '\xf0'));
+  resume.insert_key("uncertain_pieces.timestamp", int64_t(1000));
+  resume.insert_key("uncertain_pieces", std::string("\0\0\0\x05", 4));
+
+  auto& file_list =
+    resume.insert_key("files", torrent::Object::create_list()).as_list();
+
+  for (unsigned int i = 0; i < files; i++) {
+    auto& file = file_list.emplace_back(torrent::Object::create_map());
+
+    file.insert_key("completed", int64_t(i));
+    file.insert_key("mtime", int64_t(1600000000 + i));
+    file.insert_key("priority", int64_t(i % 3));
+  }
+
+  auto& peer_list =
+    resume.insert_key("peers", torrent::Object::create_list()).as_list();
+
+  for (unsigned int i = 0; i < peers; i++) {
+    auto& peer = peer_list.emplace_back(torrent::Object::create_map());
+    char  inet[6] = { 10, 0, char(i >> 8), char(i), 0x1a, char(0xe1) };
+
+    peer.insert_key("inet", std::string(inet, sizeof(inet)));
+    peer.insert_key("failed", int64_t(i % 4));
+    peer.insert_key("last", int64_t(1000 + i));
+  }
+
+  auto& trackers = resume.insert_key("trackers", torrent::Object::create_map());
+  auto& tracker  = trackers.insert_key("http://example.com/announce",
+                                      torrent::Object::create_map());
+
+  tracker.insert_key("enabled", int64_t(1));
+  tracker.insert_key("extra_tracker", int64_t(1));
+  tracker.insert_key("group", int64_t(2));
+
+  return resume;
+}
+
+static std::string
+bencode(const torrent::Object& object) {
+  std::stringstream stream;
+  torrent::object_write_bencode(&stream, &object);
+  return stream.str();
+}
+
+static ino_t
+file_inode(const std::string& path) {
+  struct stat st {};
+  stat(path.c_str(), &st);
+  return st.st_ino;
+}
+
+static std::string
+temporary_path() {
+  char path[] = "/tmp/libtorrent_resume_XXXXXX";
+  int  fd     = mkstemp(path);
+
+  close(fd);
+  unlink(path);
+  return path;
+}
+
+TEST_F(test_resume_binary, test_round_trip) {
+  auto resume  = create_resume(10, 10);
+  auto encoded = torrent::resume_binary_encode(resume);
+
+  torrent::resume_binary binary;
+  ASSERT_TRUE(binary.open(encoded.data(), encoded.size()));
+
+  for (uint16_t type = torrent::resume_binary::section_bitfield;
+       type < torrent::resume_binary::section_max;
+       type++)
+    ASSERT_TRUE(binary.has_section(
+      static_cast<torrent::resume_binary::section_type>(type)));
+
+  torrent::Object decoded = torrent::Object::create_map();
+  ASSERT_TRUE(torrent::resume_binary_decode(binary, decoded));
+  ASSERT_EQ(bencode(decoded), bencode(resume));
+
+  torrent::Object without_peers = torrent::Object::create_map();
+  ASSERT_TRUE(torrent::resume_binary_decode(binary, without_peers, false));
+  ASSERT_FALSE(without_peers.has_key("peers"));
+}
+
+// Tracker urls aren't limited to 16 bit lengths.
+TEST_F(test_resume_binary, test_long_tracker_url) {
+  auto        resume = create_resume(1, 1);
+  std::string url    = "http://example.com/" + std::string(70000, 'x');
+
+  resume.get_key("trackers").insert_key(url, torrent::Object::create_map());
+
+  auto encoded = torrent::resume_binary_encode(resume);
+
+  torrent::resume_binary binary;
+  ASSERT_TRUE(binary.open(encoded.data(), encoded.size()));
+
+  torrent::Object decoded = torrent::Object::create_map();
+  ASSERT_TRUE(torrent::resume_binary_decode(binary, decoded));
+  ASSERT_TRUE(decoded.get_key("trackers").has_key(url));
+  ASSERT_EQ(bencode(decoded), bencode(resume));
+}
+
+TEST_F(test_resume_binary, test_uniform_bitfield) {
+  torrent::Object resume = torrent::Object::create_map();
+  resume.insert_key("bitfield", int64_t(1024));
+
+  auto encoded = torrent::resume_binary_encode(resume);
+
+  torrent::resume_binary binary;
+  ASSERT_TRUE(binary.open(encoded.data(), encoded.size()));
+  ASSERT_FALSE(binary.has_section(torrent::resume_binary::section_files));
+
+  torrent::Object decoded = torrent::Object::create_map();
+  ASSERT_TRUE(torrent::resume_binary_decode(binary, decoded));
+  ASSERT_EQ(decoded.get_key_value("bitfield"), 1024);
+}
+
+TEST_F(test_resume_binary, test_invalid) {
+  auto encoded = torrent::resume_binary_encode(create_resume(10, 10));
+
+  torrent::resume_binary binary;
+
+  ASSERT_FALSE(binary.open(encoded.data(), encoded.size() - 1));
+  ASSERT_FALSE(binary.open(encoded.data(), 4));
+
+  std::string corrupt = encoded;
+  corrupt[corrupt.size() - 10] ^= 0x1;
+  ASSERT_FALSE(binary.open(corrupt.data(), corrupt.size()));
+
+  std::string version = encoded;
+  version[5] = torrent::resume_binary::version + 1;
+  ASSERT_FALSE(binary.open(version.data(), version.size()));
+
+  ASSERT_TRUE(binary.open(encoded.data(), encoded.size()));
+}
+
+TEST_F(test_resume_binary, test_write_skips_unchanged) {
+  auto path   = temporary_path();
+  auto resume = create_resume(10, 10);
+
+  ASSERT_EQ(torrent::resume_binary_write(
+              path, torrent::resume_binary_encode(resume)),
+            5);
+
+  ino_t inode = file_inode(path);
+
+  // Unchanged data leaves the file alone.
+  ASSERT_EQ(torrent::resume_binary_write(
+              path, torrent::resume_binary_encode(resume)),
+            0);
+  ASSERT_EQ(file_inode(path), inode);
+
+  // Changed data replaces the file, counting only the changed
+  // bitfield and file entries.
+  resume.insert_key("bitfield", std::string(128, '\xff'));
+  resume.get_key_list("files").front().insert_key("mtime", int64_t(1));
+
+  ASSERT_EQ(torrent::resume_binary_write(
+              path, torrent::resume_binary_encode(resume)),
+            2);
+  ASSERT_NE(file_inode(path), inode);
+  ASSERT_NE(access((path + ".new").c_str(), F_OK), 0);
+
+  torrent::resume_binary binary;
+  torrent::Object        decoded = torrent::Object::create_map();
+
+  ASSERT_TRUE(binary.open_file(path));
+  ASSERT_TRUE(torrent::resume_binary_decode(binary, decoded));
+  ASSERT_EQ(bencode(decoded), bencode(resume));
+  binary.close();
+
+  // A changed layout replaces the whole file.
+  resume = create_resume(10, 20);
+
+  ASSERT_EQ(torrent::resume_binary_write(
+              path, torrent::resume_binary_encode(resume)),
+            5);
+  ASSERT_TRUE(binary.open_file(path));
+
+  decoded = torrent::Object::create_map();
+  ASSERT_TRUE(torrent::resume_binary_decode(binary, decoded));
+  ASSERT_EQ(bencode(decoded), bencode(resume));
+
+  unlink(path.c_str());
+}
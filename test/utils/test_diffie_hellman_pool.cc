@@ -0,0 +1,126 @@
+#include <cstring>
+
+#include "protocol/handshake_encryption.h"
+#include "utils/diffie_hellman_pool.h"
+
+#include "test/helpers/fixture.h"
+
+class test_diffie_hellman_pool : public test_fixture {};
+
+static void
+setup_pool(torrent::DiffieHellmanPool* pool, int* need_work, int* has_work) {
+  pool->slot_generate_key() = []() {
+    return std::make_unique<torrent::DiffieHellman>(
+      torrent::HandshakeEncryption::dh_prime,
+      torrent::HandshakeEncryption::dh_prime_length,
+      torrent::HandshakeEncryption::dh_generator,
+      torrent::HandshakeEncryption::dh_generator_length);
+  };
+  pool->slot_need_work() = [need_work]() { (*need_work)++; };
+  pool->slot_has_work()  = [has_work]() { (*has_work)++; };
+}
+
+TEST_F(test_diffie_hellman_pool, test_refill) {
+  torrent::DiffieHellmanPool pool;
+  int                        need_work = 0;
+  int                        has_work  = 0;
+
+  setup_pool(&pool, &need_work, &has_work);
+  pool.set_target(4);
+
+  ASSERT_EQ(pool.size(), 0);
+
+  // An empty pool generates keys inline and asks for a refill.
+  ASSERT_TRUE(pool.acquire()->is_valid());
+  ASSERT_EQ(need_work, 1);
+
+  pool.perform();
+  ASSERT_EQ(pool.size(), 4);
+  ASSERT_EQ(has_work, 0);
+
+  ASSERT_TRUE(pool.acquire()->is_valid());
+  ASSERT_TRUE(pool.acquire()->is_valid());
+  ASSERT_EQ(pool.size(), 2);
+  ASSERT_EQ(need_work, 1);
+
+  ASSERT_TRUE(pool.acquire()->is_valid());
+  ASSERT_EQ(pool.size(), 1);
+  ASSERT_EQ(need_work, 2);
+}
+
+TEST_F(test_diffie_hellman_pool, test_compute_secret) {
+  torrent::DiffieHellmanPool pool;
+  int                        need_work = 0;
+  int                        has_work  = 0;
+
+  setup_pool(&pool, &need_work, &has_work);
+  pool.set_target(0);
+
+  auto local  = pool.acquire();
+  auto remote = pool.acquire();
+
+  unsigned char local_pub[96];
+  unsigned char remote_pub[96];
+  local->store_pub_key(local_pub, 96);
+  remote->store_pub_key(remote_pub, 96);
+
+  ASSERT_TRUE(remote->compute_secret(local_pub, 96));
+
+  int  id = 0;
+  bool delivered = false;
+
+  pool.slot_done() = [&](torrent::DiffieHellmanPool::id_type done_id,
+                         torrent::DiffieHellmanPool::key_ptr key,
+                         bool                                result) {
+    ASSERT_EQ(done_id, &id);
+    ASSERT_TRUE(result);
+    ASSERT_EQ(key->size(), remote->size());
+    ASSERT_EQ(std::memcmp(key->c_str(), remote->c_str(), key->size()), 0);
+    delivered = true;
+  };
+
+  pool.compute_secret(&id, std::move(local), remote_pub, 96);
+  ASSERT_EQ(need_work, 1);
+
+  pool.work();
+  ASSERT_FALSE(delivered);
+
+  pool.perform();
+  ASSERT_EQ(has_work, 1);
+
+  pool.work();
+  ASSERT_TRUE(delivered);
+}
+
+TEST_F(test_diffie_hellman_pool, test_cancel) {
+  torrent::DiffieHellmanPool pool;
+  int                        need_work = 0;
+  int                        has_work  = 0;
+
+  setup_pool(&pool, &need_work, &has_work);
+  pool.set_target(0);
+
+  unsigned char pubkey[96];
+  pool.acquire()->store_pub_key(pubkey, 96);
+
+  int id_pending = 0;
+  int id_done    = 0;
+  int delivered  = 0;
+
+  pool.slot_done() = [&](torrent::DiffieHellmanPool::id_type,
+                         torrent::DiffieHellmanPool::key_ptr,
+                         bool) { delivered++; };
+
+  pool.compute_secret(&id_done, pool.acquire(), pubkey, 96);
+  pool.perform();
+
+  pool.compute_secret(&id_pending, pool.acquire(), pubkey, 96);
+
+  pool.cancel(&id_done);
+  pool.cancel(&id_pending);
+
+  pool.perform();
+  pool.work();
+
+  ASSERT_EQ(delivered, 0);
+}
@@ -0,0 +1,62 @@
+#include "utils/token_bucket.h"
+
+#include "test/helpers/fixture.h"
+
+class test_token_bucket : public test_fixture {};
+
+using torrent::utils::timer;
+
+TEST_F(test_token_bucket, test_unlimited) {
+  torrent::TokenBucket bucket;
+
+  ASSERT_TRUE(bucket.is_unlimited());
+
+  for (int i = 0; i < 1000; i++)
+    ASSERT_TRUE(bucket.try_consume(timer::from_seconds(1)));
+}
+
+TEST_F(test_token_bucket, test_burst) {
+  torrent::TokenBucket bucket;
+
+  bucket.set_rate(10, 5, timer::from_seconds(100));
+
+  for (int i = 0; i < 5; i++)
+    ASSERT_TRUE(bucket.try_consume(timer::from_seconds(100)));
+
+  ASSERT_FALSE(bucket.can_consume(timer::from_seconds(100)));
+  ASSERT_FALSE(bucket.try_consume(timer::from_seconds(100)));
+}
+
+TEST_F(test_token_bucket, test_refill) {
+  torrent::TokenBucket bucket;
+  timer                now = timer::from_seconds(100);
+
+  bucket.set_rate(10, 5, now);
+
+  for (int i = 0; i < 5; i++)
+    ASSERT_TRUE(bucket.try_consume(now));
+
+  // One token every 100ms.
+  ASSERT_FALSE(bucket.try_consume(now + timer::from_milliseconds(99)));
+  ASSERT_TRUE(bucket.try_consume(now + timer::from_milliseconds(100)));
+  ASSERT_FALSE(bucket.try_consume(now + timer::from_milliseconds(100)));
+
+  // Refilling is capped at the burst size.
+  now += timer::from_seconds(3600);
+
+  for (int i = 0; i < 5; i++)
+    ASSERT_TRUE(bucket.try_consume(now));
+
+  ASSERT_FALSE(bucket.try_consume(now));
+}
+
+TEST_F(test_token_bucket, test_slow_rate) {
+  torrent::TokenBucket bucket;
+  timer                now = timer::from_seconds(100);
+
+  bucket.set_rate(1, 1, now);
+
+  ASSERT_TRUE(bucket.try_consume(now));
+  ASSERT_FALSE(bucket.try_consume(now + timer::from_milliseconds(999)));
+  ASSERT_TRUE(bucket.try_consume(now + timer::from_seconds(1)));
+}